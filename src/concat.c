@@ -17,7 +17,10 @@
 #include "val_list.h"
 #include "vm_err.h"
 #include "vm_debug.h"
+#include "vm_super.h"
+#include "vm_parser.h"
 #include "opcodes.h"
+#include "defpool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -62,6 +65,13 @@
 //  - optimize - code optimization
 //  - oop - object oriented programming library
 
+#ifdef POOL_STATS
+static void print_pool_stats() { pool_fprint_stats(stderr); }
+#endif
+#ifdef VM_OPSTATS
+static void print_opstats() { vm_opstats_fprint(stderr); }
+#endif
+
 //int readline(char *buffer, int size) {
 //  if (!fgets(buffer,size,stdin)) {
 //    if (errno != 0) {
@@ -75,6 +85,12 @@
 
 int main(int argc, char *argv[]) {
   concat_init();
+#ifdef POOL_STATS
+  atexit(print_pool_stats);
+#endif
+#ifdef VM_OPSTATS
+  atexit(print_opstats);
+#endif
   vm_t vm;
   err_t r;
   val_t t;
@@ -162,6 +178,8 @@ int main(int argc, char *argv[]) {
           printf("ERROR: failed to set debug-catch mode");
           return 1;
         }
+      } else if (!strcmp(arg,"-P")) { //write the parser fsm tables as C source and exit (see make parser-fsm)
+        return vm_write_parser(stdout) ? 1 : 0;
       } else if (!strcmp(arg,"-q")) { //quiet mode (don't print non-empty stack on normal exit)
         quiet = 1;
       } else if (!strcmp(arg,"--")) {
@@ -0,0 +1,112 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "defpool.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+
+//slow paths for DEFINE_THREAD_POOL (fast paths are inline in defpool.h)
+
+#ifdef POOL_STATS
+struct pool_stats pool_stats = { 0, 0, 0, 0 };
+#endif
+
+//each thread keeps a list of the pools it owns so we can orphan them on thread exit
+static pthread_key_t tpool_key;
+static pthread_once_t tpool_key_once = PTHREAD_ONCE_INIT;
+
+static void _tpool_thread_exit(void *arg) {
+  struct tpool *p = (struct tpool*)arg, *next;
+  for(; p; p = next) {
+    next = p->tnext;
+    *p->local = NULL;
+    p->local = NULL;
+    p->tnext = NULL;
+    pthread_mutex_lock(&p->c->lock);
+    p->onext = p->c->orphans;
+    p->c->orphans = p;
+    pthread_mutex_unlock(&p->c->lock);
+  }
+}
+static void _tpool_key_init() {
+  pthread_key_create(&tpool_key,_tpool_thread_exit);
+}
+
+//get pool for current thread (adopt orphaned pool, or allocate new one)
+static struct tpool* _tpool_attach(struct tpool **local, struct tpool_class *c) {
+  struct tpool *p;
+  pthread_once(&tpool_key_once,_tpool_key_init);
+
+  pthread_mutex_lock(&c->lock);
+  if ((p = c->orphans)) c->orphans = p->onext;
+  pthread_mutex_unlock(&c->lock);
+
+  if (!p) {
+    if (!(p = malloc(sizeof(struct tpool)))) return NULL;
+    POOL_STAT(mallocs);
+    p->c = c;
+    p->free = NULL;
+    p->remote = NULL;
+    p->carve = p->carve_end = NULL;
+  }
+  p->onext = NULL;
+  p->local = local;
+  p->tnext = pthread_getspecific(tpool_key);
+  pthread_setspecific(tpool_key,p);
+  *local = p;
+  return p;
+}
+
+void* tpool_alloc_slow(struct tpool **local, struct tpool_class *c) {
+  struct tpool *p;
+  void *v;
+  if (!(p = *local) && !(p = _tpool_attach(local,c))) return NULL;
+
+  //local list empty -- take everything other threads have freed back to us
+  if ((v = __atomic_exchange_n(&p->remote,NULL,__ATOMIC_ACQUIRE))) {
+    p->free = *(void**)v;
+    POOL_STAT(allocs);
+    return v;
+  }
+
+  //carve from newest chunk, getting new chunk as needed
+  if (p->carve_end - p->carve < (ptrdiff_t)c->size) {
+    struct tpool_chunk *chunk;
+    if (posix_memalign((void**)&chunk,c->chunk_size,c->chunk_size)) return NULL;
+    POOL_STAT(mallocs);
+    chunk->owner = p;
+    p->carve = (char*)chunk + TPOOL_CHUNK_HEADER;
+    p->carve_end = (char*)chunk + c->chunk_size;
+  }
+  v = p->carve;
+  p->carve += c->size;
+  POOL_STAT(allocs);
+  return v;
+}
+
+void tpool_free_remote(struct tpool *owner, void *v) {
+  void *head = __atomic_load_n(&owner->remote,__ATOMIC_RELAXED);
+  POOL_STAT(remote_frees);
+  do {
+    *(void**)v = head;
+  } while(!__atomic_compare_exchange_n(&owner->remote,&head,v,1,__ATOMIC_RELEASE,__ATOMIC_RELAXED));
+}
+
+void pool_fprint_stats(FILE *file) {
+#ifdef POOL_STATS
+  fprintf(file,"pool: %" PRIu64 " allocs, %" PRIu64 " frees (%" PRIu64 " remote), %" PRIu64 " mallocs\n",
+      pool_stats.allocs, pool_stats.frees, pool_stats.remote_frees, pool_stats.mallocs);
+#endif
+}
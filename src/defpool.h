@@ -12,10 +12,21 @@
 //See the License for the specific language governing permissions and
 //limitations under the License.
 
+#ifndef __DEFPOOL_H__
+#define __DEFPOOL_H__ 1
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
 //Macros for generating typed memory pools
 //  - each of the macros defines a (de)allocator with a type, a unit of allocation, an allocation function name, and a free function name
 //  - DEFINE_NO_POOL - uses malloc directory (no memory pool) and ignores alloc_size
 //  - DEFINE_SIMPLE_POOL - allocates chunks, keeping free entries in a linked list stack (never frees memory, just returns to stack for reuse)
+//  - DEFINE_THREAD_POOL - threadsafe per-thread slab pool (see below)
+//  - DEFINE_DEFAULT_POOL - DEFINE_THREAD_POOL, or DEFINE_NO_POOL when compiled with -DNO_POOL (e.g. for asan/valgrind)
+//  - DEFINE_SIZED_POOL/DEFINE_DEFAULT_SIZED_POOL - same for variable-sized allocations (size classes 32..4096 bytes, malloc for larger)
 //DEFINE_SIMPLE_POOL:
 //    - uses a linked-list stack to keep free entries
 //      - good locality side-effect of this is that we always take the most-recently freed value
@@ -24,19 +35,18 @@
 //    - current implementation never returns memory to system
 //      - with this linked-list stack implementation, to return system memory you would identify allocation blocks and count how many free entries we have in each block (e.g. by sorting-by-block), and then we can free blocks where we have all the entries for that block in the free pool
 //      - compaction when we don't have full free blocks is more difficult, but since everything is in one of the stacks is still possible (and probably never worth it)
-//TODO: need threadsafe version of the memory pool
-//  - we need either a separate pool per thread (and then either merge or free all when thread finished), or appropriate locking
-//    - per-thread pools
-//      - faster (obviously, no locks)
-//      - need a mechanism to pass around thread-specific pool pointer (probably thread local var, but that may be harder to port everywhere vs locking)
-//      - on thread close need to make sure to clean everything up -- free all (problematic with inter-thread comms), or add to pool of thread calling join (need pool pointer in vm val)
-//    - locking -- slower, but means process just needs one pool for each type, no possibly messy cleanup cases
+//DEFINE_THREAD_POOL:
+//    - each thread has its own pool (thread local pointer per pool type), so alloc/free are lock-free linked-list stack ops in the common case
+//    - chunks are aligned to their size, so the chunk header (and owning pool) is found by masking the entry address
+//    - freeing an entry owned by another thread pushes it to the owner's remote-free list (lock-free push, owner takes the whole list when local list runs dry)
+//    - when a thread exits its pools are orphaned (entries may still be live in other threads), and new threads adopt orphaned pools before allocating new ones
+//    - like DEFINE_SIMPLE_POOL, chunks are never returned to the system
+//    - with POOL_STATS defined we count allocs/frees/mallocs across all pools (see pool_fprint_stats)
 
 //TODO: add helgrind annotations so helgrind (valgrind) knows reused pool entries are "new" memory
 //  ANNOTATE_NEW_MEMORY(v,sizeof(type));
 //TODO: add appropriate memcheck annotations (possibly VALGRIND_CREATE_BLOCK/VALGRIND_DISCARD, probably VALGRIND_MEMPOOL_*
 
-//#define DEFINE_DEFAULT_POOL(type,alloc_size,alloc_name,free_name) DEFINE_NO_POOL(type,alloc_size,alloc_name,free_name)
 
 #define DEFINE_SIMPLE_POOL(type,alloc_size,alloc_name,free_name) \
 union ualloc_##alloc_name { \
@@ -71,5 +81,123 @@ void free_name(type *v) { \
 }
 
 #define DEFINE_NO_POOL(type,alloc_size,alloc_name,free_name) \
-  type* alloc_name() { return malloc(sizeof(type)); } \
-  void free_name(type *v) { free(v); }
+  type* alloc_name() { POOL_STAT(allocs); POOL_STAT(mallocs); return malloc(sizeof(type)); } \
+  void free_name(type *v) { POOL_STAT(frees); free(v); }
+
+
+//thread pool internals (implemented in defpool.c)
+
+struct tpool;
+
+//tpool_class -- one per pooled type/size (shared by all threads)
+struct tpool_class {
+  size_t size; //entry size
+  size_t chunk_size; //chunk size and alignment (power of 2)
+  pthread_mutex_t lock; //protects orphans
+  struct tpool *orphans; //pools left by exited threads
+};
+
+//tpool -- per-thread pool for one class
+struct tpool {
+  struct tpool_class *c;
+  struct tpool **local; //thread local pointer to this pool (cleared when orphaned)
+  void *free; //local free list (only touched by owner)
+  void *remote; //remote free list (pushed by other threads, taken all at once by owner)
+  char *carve, *carve_end; //unused space in newest chunk
+  struct tpool *tnext; //next pool owned by same thread
+  struct tpool *onext; //next orphaned pool of class
+};
+
+//chunk header (padded to a cache line), entries follow
+struct tpool_chunk {
+  struct tpool *owner;
+};
+#define TPOOL_CHUNK_HEADER 64
+
+#define TPOOL_CLASS_INIT(sz,chunk) { .size = (((sz)+15)&~(size_t)15), .chunk_size = (chunk), .lock = PTHREAD_MUTEX_INITIALIZER, .orphans = NULL }
+#define TPOOL_OWNER(v,c) (((struct tpool_chunk*)((uintptr_t)(v) & ~((uintptr_t)(c)->chunk_size-1)))->owner)
+
+void* tpool_alloc_slow(struct tpool **local, struct tpool_class *c);
+void tpool_free_remote(struct tpool *owner, void *v);
+
+#ifdef POOL_STATS
+struct pool_stats {
+  uint64_t allocs;
+  uint64_t frees;
+  uint64_t remote_frees;
+  uint64_t mallocs; //system allocations (chunks, oversized entries, or everything with NO_POOL)
+};
+extern struct pool_stats pool_stats;
+#define POOL_STAT(stat) __sync_add_and_fetch(&pool_stats.stat,1)
+#else
+#define POOL_STAT(stat) do{}while(0)
+#endif
+void pool_fprint_stats(FILE *file);
+
+static inline void* tpool_alloc(struct tpool **local, struct tpool_class *c) {
+  struct tpool *p = *local;
+  void *v;
+  if (p && (v = p->free)) {
+    POOL_STAT(allocs);
+    p->free = *(void**)v;
+    return v;
+  }
+  return tpool_alloc_slow(local,c);
+}
+static inline void tpool_free(struct tpool *local, struct tpool_class *c, void *v) {
+  struct tpool *owner = TPOOL_OWNER(v,c);
+  POOL_STAT(frees);
+  if (owner == local) {
+    *(void**)v = local->free;
+    local->free = v;
+  } else {
+    tpool_free_remote(owner,v);
+  }
+}
+
+#define DEFINE_THREAD_POOL(type,alloc_size,alloc_name,free_name) \
+static struct tpool_class tpoolclass_##alloc_name = TPOOL_CLASS_INIT(sizeof(type),alloc_size); \
+static __thread struct tpool *tpool_##alloc_name = NULL; \
+type* alloc_name() { return (type*)tpool_alloc(&tpool_##alloc_name,&tpoolclass_##alloc_name); } \
+void free_name(type *v) { tpool_free(tpool_##alloc_name,&tpoolclass_##alloc_name,v); }
+
+
+//sized pools
+// - alloc takes requested size by pointer and updates it to the actual (size class) size, so callers can use the slack
+// - free takes the size returned by alloc (callers recompute it from their buffer size)
+#define TPOOL_MIN_SHIFT 5
+#define TPOOL_MAX_SHIFT 12
+#define TPOOL_NCLASSES (TPOOL_MAX_SHIFT-TPOOL_MIN_SHIFT+1)
+#define TPOOL_MAX_SIZE ((size_t)1<<TPOOL_MAX_SHIFT)
+#define tpool_sizeclass(n) ((n) <= ((size_t)1<<TPOOL_MIN_SHIFT) ? 0 : (64 - __builtin_clzll((n)-1) - TPOOL_MIN_SHIFT))
+#define TPOOL_SIZED_INIT(chunk) { TPOOL_CLASS_INIT(32,chunk), TPOOL_CLASS_INIT(64,chunk), TPOOL_CLASS_INIT(128,chunk), TPOOL_CLASS_INIT(256,chunk), \
+  TPOOL_CLASS_INIT(512,chunk), TPOOL_CLASS_INIT(1024,chunk), TPOOL_CLASS_INIT(2048,chunk), TPOOL_CLASS_INIT(4096,chunk) }
+
+#define DEFINE_SIZED_POOL(alloc_size,alloc_name,free_name) \
+static struct tpool_class tpoolclass_##alloc_name[TPOOL_NCLASSES] = TPOOL_SIZED_INIT(alloc_size); \
+static __thread struct tpool *tpool_##alloc_name[TPOOL_NCLASSES]; \
+void* alloc_name(size_t *size) { \
+  if (*size > TPOOL_MAX_SIZE) { POOL_STAT(allocs); POOL_STAT(mallocs); return malloc(*size); } \
+  int i = tpool_sizeclass(*size); \
+  *size = tpoolclass_##alloc_name[i].size; \
+  return tpool_alloc(&tpool_##alloc_name[i],&tpoolclass_##alloc_name[i]); \
+} \
+void free_name(void *v, size_t size) { \
+  if (size > TPOOL_MAX_SIZE) { POOL_STAT(frees); free(v); return; } \
+  int i = tpool_sizeclass(size); \
+  tpool_free(tpool_##alloc_name[i],&tpoolclass_##alloc_name[i],v); \
+}
+
+#define DEFINE_NO_SIZED_POOL(alloc_size,alloc_name,free_name) \
+  void* alloc_name(size_t *size) { POOL_STAT(allocs); POOL_STAT(mallocs); return malloc(*size); } \
+  void free_name(void *v, size_t size) { POOL_STAT(frees); free(v); }
+
+#ifdef NO_POOL
+#define DEFINE_DEFAULT_POOL(type,alloc_size,alloc_name,free_name) DEFINE_NO_POOL(type,alloc_size,alloc_name,free_name)
+#define DEFINE_DEFAULT_SIZED_POOL(alloc_size,alloc_name,free_name) DEFINE_NO_SIZED_POOL(alloc_size,alloc_name,free_name)
+#else
+#define DEFINE_DEFAULT_POOL(type,alloc_size,alloc_name,free_name) DEFINE_THREAD_POOL(type,alloc_size,alloc_name,free_name)
+#define DEFINE_DEFAULT_SIZED_POOL(alloc_size,alloc_name,free_name) DEFINE_SIZED_POOL(alloc_size,alloc_name,free_name)
+#endif
+
+#endif
@@ -17,6 +17,43 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <sched.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+void futex_wait(unsigned int *addr, unsigned int val) {
+  syscall(SYS_futex,addr,FUTEX_WAIT_PRIVATE,val,NULL,NULL,0);
+}
+void futex_wake(unsigned int *addr, int n) {
+  syscall(SYS_futex,addr,FUTEX_WAKE_PRIVATE,n,NULL,NULL,0);
+}
+#else
+void futex_wait(unsigned int *addr, unsigned int val) {
+  (void)addr; (void)val;
+  sched_yield();
+}
+void futex_wake(unsigned int *addr, int n) {
+  (void)addr; (void)n;
+}
+#endif
+
+void futex_lock(unsigned int *lock) {
+  unsigned int c = 0;
+  if (!__atomic_compare_exchange_n(lock,&c,1,0,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED)) {
+    if (c != 2) c = __atomic_exchange_n(lock,2,__ATOMIC_ACQUIRE);
+    while (c != 0) {
+      futex_wait(lock,2);
+      c = __atomic_exchange_n(lock,2,__ATOMIC_ACQUIRE);
+    }
+  }
+}
+void futex_unlock(unsigned int *lock) {
+  if (2 == __atomic_exchange_n(lock,0,__ATOMIC_RELEASE)) futex_wake(lock,1);
+}
 
 char *_strdup(const char *s) {
   size_t len = strlen(s);
@@ -90,15 +127,10 @@ const char *strnchr(const char *haystack, unsigned int haystackn, char c) {
 const char *strnstrn(const char *haystack, unsigned int haystackn, const char *needle, unsigned int needlen) {
   if (!needlen) return haystack;
   else if (needlen > haystackn) return NULL;
-  unsigned int matchlen=0;
-  while(haystackn--) {
-    if (*haystack == needle[matchlen]) {
-      matchlen++;
-      if (matchlen==needlen) return haystack-needlen+1;
-    } else {
-      matchlen=0;
-    }
-    haystack++;
+  unsigned int start, matchlen;
+  for(start=0; start + needlen <= haystackn; ++start) {
+    for(matchlen=0; matchlen<needlen && haystack[start+matchlen] == needle[matchlen]; ++matchlen);
+    if (matchlen==needlen) return haystack+start;
   }
   return NULL;
 }
@@ -106,16 +138,10 @@ const char *strnstrn(const char *haystack, unsigned int haystackn, const char *n
 const char *rstrnstrn(const char *haystack, unsigned int haystackn, const char *needle, unsigned int needlen) {
   if (!needlen) return haystack+haystackn;
   else if (needlen > haystackn) return NULL;
-  unsigned int matchi=needlen-1;
-  haystack+=haystackn-1;
-  while(haystackn--) {
-    if (*haystack == needle[matchi]) {
-      if (matchi==0) return haystack;
-      else matchi--;
-    } else {
-      matchi=needlen-1;
-    }
-    haystack--;
+  unsigned int start = haystackn - needlen + 1, matchlen;
+  while(start--) {
+    for(matchlen=0; matchlen<needlen && haystack[start+matchlen] == needle[matchlen]; ++matchlen);
+    if (matchlen==needlen) return haystack+start;
   }
   return NULL;
 }
@@ -28,7 +28,18 @@
 #define refcount_inc(refcount) __sync_add_and_fetch(&(refcount),1)
 #define refcount_dec(refcount) __sync_sub_and_fetch(&(refcount),1)
 //if singleton returns true then we are currently looking at the only copy, so we can safely modify it in-place
-#define refcount_singleton(refcount) (1 == __sync_fetch_and_add(&(refcount),0))
+#define refcount_singleton(refcount) (1 == __atomic_load_n(&(refcount),__ATOMIC_ACQUIRE))
+
+//======= futex functions ========
+// - futex_wait sleeps only if *addr still equals val (so a wake between our check and the sleep isn't lost)
+// - without futexes (non-linux) futex_wait just yields and callers spin on their atomic
+//
+void futex_wait(unsigned int *addr, unsigned int val);
+void futex_wake(unsigned int *addr, int n);
+
+//3-state futex mutex on a lock word (0 unlocked, 1 locked, 2 locked and someone may be asleep on it) -- same scheme as the ref lock
+void futex_lock(unsigned int *lock);
+void futex_unlock(unsigned int *lock);
 
 #define ASSERT_CONCAT_(a, b) a##b
 #define ASSERT_CONCAT(a, b) ASSERT_CONCAT_(a, b)
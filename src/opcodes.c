@@ -16,6 +16,8 @@
 #include "helpers.h"
 
 STATIC_ASSERT(N_BYTECODES<256,"number of basic bytecode ops doesn't fit into byte");
+STATIC_ASSERT(N_OPS-N_CORE_OPS<=256,"number of extended ops doesn't fit into escaped byte");
+STATIC_ASSERT(N_CORE_OPS==213,"core opcodes are frozen (append new ops to OPCODES_EXT)");
 
 #define OP_STRING(op,opstr,effects) opstr
 #define TYPE_STRING(op,opstr,effects) ("type_" opstr)
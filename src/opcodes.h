@@ -22,7 +22,12 @@
 //   - at least for a high level of abstraction/widening, but support for different levels of analysis would be good
 //   - could be either natives or implemented in concat
 // TODO: set fixed order for core opcodes, and set fixed id for quit opcode so stripped down VMs can use subset of core opcode range (plus interconstructions)
-#define OPCODES(opcode) \
+// - split into core and extended ranges, so compiled bytecode keeps decoding to the same ops as the table grows
+//   - OPCODES_CORE is frozen: each core op is one byte in bytecode, followed by the typecodes (never insert, remove, or reorder)
+//   - OPCODES_EXT are appended after the last one: in bytecode they are TYPECODE_extop followed by one byte (op - N_CORE_OPS)
+#define OPCODES(opcode) OPCODES_CORE(opcode), OPCODES_EXT(opcode)
+
+#define OPCODES_CORE(opcode) \
   opcode(NULL,"NULL","--"), \
   opcode(end,"end","--"), \
   opcode(break,"break","--"), \
@@ -174,8 +179,8 @@
   opcode(dict_has,"dict.has","{DICT} ident -- bool"), \
   opcode(dict_get,"dict.get","{DICT} ident -- val"), \
   opcode(dict_put,"dict.put","{DICT} val ident --"), \
-  opcode(open,"open","\"path\" \"mode\" -- file(\"path\")"), \
-  opcode(close,"close","file() --"), \
+  opcode(open,"open","\"path\" \"mode\" -- file(\"path\")  (mode \"m\" -- \"contents\")"), \
+  opcode(close,"close","file() -- | chan() -- chan()"), \
   opcode(readline,"readline","file() -- file() \"line\""), \
   opcode(stdin_readline,"stdin.readline","-- \"line\""), \
   opcode(read,"read","file() len -- file() \"str\""), \
@@ -237,6 +242,41 @@
   opcode(socket_connect,"socket.connect","fd(A) B C -- fd(A)"), \
   opcode(effects,"effects","\\dup -- \"A -- A A\"")
 
+#define OPCODES_EXT(opcode) \
+  opcode(each,"each","(A B) [C] -- A C B C"), \
+  opcode(eachr,"eachr","(A B) [C] -- B C A C"), \
+  opcode(map,"map","(A B) [C] -- (A C B C)"), \
+  opcode(mapr,"mapr","(A B) [C] -- (A C B C)"), \
+  opcode(filter,"filter","(1 2 3) [2 %] -- (1 3)"), \
+  opcode(times,"times","2 [A] -- A A"), \
+  opcode(while,"while","[C] [A] -- C A C A C | [C] [A] -- C"), \
+  opcode(_loop,"_loop","???"), \
+  opcode(compile,"compile","[A B] -- bytecode(A B) | \"...\" -- bytecode(...)"), \
+  opcode(submit,"submit","(A B C) (D E F) -- vm_running(A B C <|> F E D)"), \
+  opcode(await,"await","vm(...) -- (...)"), \
+  opcode(chan,"chan","N -- chan()"), \
+  opcode(send,"send","chan() A -- chan()"), \
+  opcode(recv,"recv","chan() -- chan() A 1 | chan() -- chan() 0"), \
+  opcode(try_recv,"try_recv","chan() -- chan() A 1 | chan() -- chan() 0"), \
+  opcode(flush,"flush","--"), \
+  opcode(split,"split","\"A,B;C\" \",;\" -- (\"A\" \"B\" \"C\") | \"A,,B\" \",\" -- (\"A\" \"\" \"B\")"), \
+  opcode(sortby,"sortby","(D A C B) [<] -- (A B C D) | (\"bb\" \"a\" \"ccc\") [[size] dip size <] -- (\"a\" \"bb\" \"ccc\")"), \
+  opcode(psort,"psort","(D A C B) -- (A B C D)"), \
+  opcode(pmap,"pmap","(A B) [C] -- (A C B C)"), \
+  opcode(pfilter,"pfilter","(1 2 3) [2 %] -- (1 3)"), \
+  opcode(vec,"vec","(1 2 3) -- vec( 1 2 3 ) | vec( 1 2 3 ) -- (1 2 3)"), \
+  opcode(vreduce,"vreduce","(1 2 3) \"sum\" -- 6 | vec( 1 2 3 ) \"mean\" -- 2.0"), \
+  opcode(dot,"dot","vec( 1 2 3 ) vec( 4 5 6 ) -- 32"), \
+  opcode(clock,"clock","\"ms\" -- 1760000000000 | \"mono.ns\" -- 81234567890123"), \
+  opcode(dup_eval,"dup eval","[A] -- [A] A"), \
+  opcode(dip_eval,"dip eval","[A] [B] -- B A"), \
+  opcode(swap_pop,"swap pop","A B -- B"), \
+  opcode(dup_dip,"\\dup dip","A B -- A A B"), \
+  opcode(zero_gt,"0 >","A -- bool"), \
+  opcode(parser,"parser","(\",\") ( (-1 1 \"skip\" 0) ) -- parser(1 states, 2 classes)"), \
+  opcode(parse,"parse","\"a,b\" parser -- (\"a\" \"b\") | file parser -- (tokens)"), \
+  opcode(dict_keys,"dict.keys","{DICT} -- {DICT} (keys)")
+
 //TYPECODE - list of concat VM typecodes (opcodes used in bytecode for storing vals)
 // - takes macro function with three arguments (C code opcode, concat opcode string, stack effects string)
 #define TYPECODES(typecode) \
@@ -253,7 +293,8 @@
   typecode(dict,"dict",""), \
   typecode(ref,"ref",""), \
   typecode(file,"file",""), \
-  typecode(vm,"vm","") \
+  typecode(vm,"vm",""), \
+  typecode(int64,"int64","") \
 
 //TODO: macros for builtin vm dictionary (to normalize vm code and feature set)
 // - WIP code below (BUILTIN* macros)
@@ -410,10 +451,12 @@
 typedef enum { OPCODES(OP_ENUM), N_OPS, N_OPCODES = OP_quit } opcode_t;
 #undef OP_ENUM
 
-//bytecode opcodes (normal vm opcodes, typecodes, extra unsafe bytecode ops for use in compiled code)
+//bytecode opcodes (core vm opcodes, typecodes, extra unsafe bytecode ops for use in compiled code)
+// - extop is the escape for the extended opcode range (next byte is op - N_CORE_OPS)
 #define OPCODE_ENUM(op,opstr,effects) OPCODE_##op
 #define TYPECODE_ENUM(op,opstr,effects) TYPECODE_##op
-typedef enum { OPCODES(OPCODE_ENUM), TYPECODES(TYPECODE_ENUM), N_BYTECODES } bytecode_t;
+typedef enum { OPCODES_CORE(OPCODE_ENUM), TYPECODES(TYPECODE_ENUM), TYPECODE_extop, N_BYTECODES } bytecode_t;
+#define N_CORE_OPS TYPECODE_int8
 #undef TYPECODE_ENUM
 #undef OPCODE_ENUM
 
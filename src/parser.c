@@ -15,6 +15,8 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 #include "parser.h"
 
 //parser.c - single-pass finite-state-machine parser implementation
@@ -24,6 +26,13 @@
 #define _PSTATE_BITS_ (5)
 static const int _PSTATE_MASK_ = ((1<<_PSTATE_BITS_)-1);
 
+// parser_classify - map input byte -> pclass (table lookup unless PARSER_CLASSIFY_FN)
+#ifdef PARSER_CLASSIFY_FN
+#define parser_classify(p,c) ((p)->classify(c))
+#else
+#define parser_classify(p,c) ((p)->classes[(unsigned char)(c)])
+#endif
+
 // gets friendly op description
 const char* parser_get_opname(enum parse_op op) {
   switch(op) {
@@ -31,8 +40,8 @@ const char* parser_get_opname(enum parse_op op) {
     case PARSE_SPLITA_BEFORE: return "split before";
     case PARSE_SPLITA_AFTER: return "split after";
     case PARSE_SPLITA_SKIP: return "split skip";
-    case PARSE_NOOP_4: return "ERROR: parser no-op 4";
-    case PARSE_NOOP_5: return "ERROR: parser no-op 5";
+    case PARSE_ACC_BEGIN: return "split before, begin accumulator";
+    case PARSE_ACC_DIGIT: return "keep, accumulate digit";
     case PARSE_NOOP_6: return "ERROR: parser no-op 6";
     case PARSE_ERR: return "parse error";
     default: return NULL;
@@ -40,9 +49,46 @@ const char* parser_get_opname(enum parse_op op) {
 }
 
 //parser_state_init - initialize parser to start new parse
-// - just sets state to -1 to init when we use it
+// - just sets state to -1 to init when we use it (and starts with no carry)
 void parser_state_init(struct parser_state *pstate) {
   pstate->state = -1; //if state<0, everything else ignored
+  pstate->acc = 0;
+  pstate->accn = 0;
+  pstate->carry = NULL;
+  pstate->carryn = 0;
+  pstate->carrysize = 0;
+}
+
+void parser_state_destroy(struct parser_state *pstate) {
+  free(pstate->carry);
+  parser_state_init(pstate);
+}
+
+//parser_carry - append the part of a token in the current chunk to the carry buffer
+// - used as the tail handler for parser_feed (so it has the handler signature), and when a split finishes a carried token
+static int parser_carry(const char *tok, int len, int state, int next_state, void *arg) {
+  struct parser_state *pstate = arg;
+  if (pstate->carryn + len > pstate->carrysize) {
+    int size = (pstate->carrysize ? pstate->carrysize : 64);
+    char *c;
+    while (size < pstate->carryn + len) size *= 2;
+    if (!(c = realloc(pstate->carry,size))) return -1;
+    pstate->carry = c;
+    pstate->carrysize = size;
+  }
+  memcpy(pstate->carry + pstate->carryn,tok,len);
+  pstate->carryn += len;
+  return 0;
+}
+
+//parser_handle - call handler on a finished token (joining it to the carry first if it started in an earlier chunk)
+static inline int parser_handle(struct parser_state *pstate, parse_handler_t *handler, void *arg, const char *tok, int len, int state, int next_state) {
+  int ret;
+  if (!pstate->carryn) return handler(tok,len,state,next_state,arg);
+  if (0 != (ret = parser_carry(tok,len,state,next_state,pstate))) return ret;
+  ret = handler(pstate->carry,pstate->carryn,state,next_state,arg);
+  pstate->carryn = 0;
+  return ret;
 }
 
 //parser_rules_init - initialize parser rules
@@ -54,17 +100,84 @@ int parser_rules_init(struct parser_rules *p, int nstates, int nclasses, int ini
   p->init_state=init_state;
   p->fin_state=fin_state;
   p->classify = classifier;
+  p->loaded = 0;
+#ifndef PARSER_CLASSIFY_FN
+  int c;
+  for(c=0;c<256;++c) p->classes[c] = (unsigned char)classifier((char)c);
+#endif
   return 0;
 }
 
+//parser_rules_load - initialize parser rules from prebuilt tables
+// - the fsm table is used directly (so loading is just a few stores and a 256 byte copy)
+void parser_rules_load(struct parser_rules *p, const state_entry_t *fsm, const unsigned char *classes, int nstates, int nclasses, int init_state, int fin_state, char_classifier_t *classifier) {
+  p->v = (state_entry_t*)fsm; //never written through (loaded is set)
+  p->nstates=nstates;
+  p->nclasses=nclasses;
+  p->init_state=init_state;
+  p->fin_state=fin_state;
+  p->classify = classifier;
+  p->loaded = 1;
+#ifndef PARSER_CLASSIFY_FN
+  if (classes) memcpy(p->classes,classes,256);
+  else {
+    int c;
+    for(c=0;c<256;++c) p->classes[c] = (unsigned char)classifier((char)c);
+  }
+#endif
+}
+
+//parser_rules_write - write rules as C source
+// - one row of entries per state, and the class table 16 bytes per row
+int parser_rules_write(FILE *f, struct parser_rules *p, const char *name) {
+  char uname[64];
+  int i,j;
+  for(i=0;name[i] && i<(int)sizeof(uname)-1;++i) uname[i] = toupper((unsigned char)name[i]);
+  uname[i] = '\0';
+
+  fprintf(f,"#ifndef __%s_H__\n#define __%s_H__ 1\n\n",uname,uname);
+  fprintf(f,"//%s.h - prebuilt parser fsm (written by parser_rules_write, do not edit)\n\n",name);
+  fprintf(f,"#define %s_NSTATES %d\n",uname,p->nstates);
+  fprintf(f,"#define %s_NCLASSES %d\n",uname,p->nclasses);
+  fprintf(f,"#define %s_INIT_STATE %d\n",uname,p->init_state);
+  fprintf(f,"#define %s_FIN_STATE %d\n\n",uname,p->fin_state);
+
+  fprintf(f,"static const state_entry_t %s_entries[%d] = {\n",name,p->nstates*p->nclasses);
+  for(i=0;i<p->nstates;++i) {
+    fprintf(f," ");
+    for(j=0;j<p->nclasses;++j) fprintf(f," 0x%02x,",parser_get_entry(p,i,j));
+    fprintf(f," //state %d\n",i);
+  }
+  fprintf(f,"};\n\n");
+
+  fprintf(f,"static const unsigned char %s_classes[256] = {\n",name);
+  for(i=0;i<256;i+=16) {
+    fprintf(f," ");
+    for(j=i;j<i+16;++j) fprintf(f," %2d,",(int)parser_classify(p,(char)j));
+    fprintf(f," //0x%02x\n",i);
+  }
+  fprintf(f,"};\n\n#endif\n");
+  return ferror(f) ? -1 : 0;
+}
+
+int parser_rules_equal(struct parser_rules *a, struct parser_rules *b) {
+  int c;
+  if (a->nstates != b->nstates || a->nclasses != b->nclasses) return 0;
+  if (a->init_state != b->init_state || a->fin_state != b->fin_state) return 0;
+  if (memcmp(a->v,b->v,sizeof(state_entry_t) * a->nstates * a->nclasses)) return 0;
+  for(c=0;c<256;++c) if (parser_classify(a,(char)c) != parser_classify(b,(char)c)) return 0;
+  return 1;
+}
+
 void parser_rules_clear(struct parser_rules *p) {
   p->v=NULL;
   p->nstates=p->nclasses=0;
   p->classify=NULL;
+  p->loaded=0;
 }
 
 void parser_rules_destroy(struct parser_rules *p) {
-  free(p->v);
+  if (!p->loaded) free(p->v);
   p->v=NULL;
   p->nstates=p->nclasses=0;
   p->classify=NULL;
@@ -269,7 +382,7 @@ int parser_validate(struct parser_rules *p, const char *str, int len, int *state
   //if we restrict to only terminating FSM we can skip this check (while(1) or goto loop)
   // - but in that case we need some additional return values to distinguish between parse error and end of string
 while (len--) {
-  pclass = p->classify(*str++);
+  pclass = parser_classify(p,*str++);
 #ifdef PARSER_SAFETY_CHECKS
   if (pclass >= p->nclasses) goto parse_error; // invalid pclass
 #endif
@@ -319,6 +432,8 @@ int parser_eval(struct parser_rules *p, const char *str, int len, struct parser_
   enum parse_op op;
   const char *tok; //keeps start of token
   state_entry_t entry;
+  unsigned int d;
+  struct parser_state _pstate; //if we weren't given pstate, we still need somewhere for the accumulator
 
   // First load or initialize parser state
   // - if empty string
@@ -331,12 +446,16 @@ int parser_eval(struct parser_rules *p, const char *str, int len, struct parser_
   } else { //else initilize parse state
     next_state = p->init_state;
     tok = str;
+    if (!pstate) pstate = &_pstate;
+    pstate->acc = 0;
+    pstate->accn = 0;
+    pstate->carryn = 0;
   }
 
   // ops - parser op jump table - one for each op (3 bits - 8 ops)
   const void * const ops[] = {
     &&begin_loop, &&op_PARSE_SPLITA_BEFORE, &&op_PARSE_SPLITA_AFTER, &&op_PARSE_SPLITA_SKIP,
-    &&parse_error, &&parse_error, &&parse_error, &&parse_error
+    &&op_PARSE_ACC_BEGIN, &&op_PARSE_ACC_DIGIT, &&parse_error, &&parse_error
   };
 
 #ifdef PARSER_SAFETY_CHECKS
@@ -366,17 +485,17 @@ parse_error: //end of loop with return value = -1
 //   // main loop classifies char, looks up entry, and jumps to op (via lookup table)
 //   -- NOSPLIT op jumps directly here
 //   1. if end of string jump to End of String code
-//   2. get pclass for next char (call classifier)
+//   2. get pclass for next char (class table lookup, or call classifier with PARSER_CLASSIFY_FN)
 //   ## if pclass invalid jump to Error Handler (only if if PARSER_SAFETY_CHECKS enabled)
 //   3. lookup entry = fsm[state][pclass]
 //   4. unpack entry into (op, next_state)
-//   5. jump to ops[op] Op Handler (NOOP through ERR jump to Error Handler)
+//   5. jump to ops[op] Op Handler (NOOP_6 and ERR jump to Error Handler)
 begin_loop: //loop starts here
   //printf("begin loop: state=%d, len=%d\n",state,len);
   state=next_state;
   if (len == 0) goto string_end; //if we restrict to only terminating FSM we can skip this check
   --len;
-  pclass = p->classify(*str++);
+  pclass = parser_classify(p,*str++);
 #ifdef PARSER_SAFETY_CHECKS
   if (pclass >= p->nstates) goto parse_error;
 #endif
@@ -387,6 +506,28 @@ begin_loop: //loop starts here
   //loop: state=0, char='p', pclass=10, op(1)=split before, next_state=4
   goto *ops[op];
 
+// ================ Accumulate Digit Op Handler ================
+//   // keep building the token like NOSPLIT, adding the digit to the accumulator
+//   1. acc = acc*10 + digit (and count the byte in accn)
+//   2. jump to start of loop
+op_PARSE_ACC_DIGIT:
+  pstate->acc = pstate->acc*10 + (unsigned char)(str[-1] - '0');
+  pstate->accn++;
+  goto begin_loop;
+
+// ================ Accumulator Begin Op Handler ================
+//   // split before this char (like SPLIT_BEFORE), then start the accumulator for the new token
+//   1. if the finished token isn't empty, call handler on it (its acc is still intact)
+//   2. reset acc to the digit value of this char (or 0 if it isn't a digit, e.g. a sign), and accn to 1 (this char)
+//   3. jump to Next Token Handler (past the accn reset)
+op_PARSE_ACC_BEGIN:
+  len_off = 1; tok_off = 1;
+  if ((str-tok > 1 || pstate->carryn) && 0 != (ret = parser_handle(pstate, handler, arg, tok, str-tok-1, state, next_state))) goto parser_exit;
+  d = (unsigned char)str[-1] - '0';
+  pstate->acc = (d < 10 ? d : 0);
+  pstate->accn = 1;
+  goto tok_next_acc;
+
 // ================ Split Before/After Op Handlers ================
 //   // split off a token (before/after current char) and jump to Token Handler
 //   1. set len_off - 0/1: whether current token excludes/includes this char
@@ -404,26 +545,28 @@ op_PARSE_SPLITA_AFTER:  len_off = 0; tok_off = 0; goto tok_handle;
 op_PARSE_SPLITA_SKIP: // split token on this char (so char is thrown out)
   len_off = 1; tok_off = 0;
 len_check: //split before jumps here to confirm tok not empty
-  if (str-tok == 1) goto tok_next; //NOTE: we already incremented str above
+  if (str-tok == 1 && !pstate->carryn) goto tok_next; //NOTE: we already incremented str above (a carried tok isn't empty)
 //// fall through
 //
 // ================ Token Handler ================
 //   // call Token Handler callback and jump to error or fall through
-//   1. call handler function on token we just split off
+//   1. call handler function on token we just split off (joined to the carry if it started in an earlier chunk, see parser_feed)
 //   2. if handler ret != 0 jump to parser exit
 //   -- fall through to Next Token Handler
 tok_handle: //call handler on finished token
-  if (0 != (ret = handler(tok, str-tok-len_off, state, next_state, arg))) goto parser_exit;
+  if (0 != (ret = parser_handle(pstate, handler, arg, tok, str-tok-len_off, state, next_state))) goto parser_exit;
 //// fall through
 //
 // ================ Next Token Handler ================
 //   // inits next token and jumps to exit/error/loop
-//   1. initialize next token to point to current char + tok_off
+//   1. initialize next token to point to current char + tok_off (with nothing accumulated)
 //   2. if next_state = fin_state jump to Parser Exit
 //   ## if next_state invalid jump to Error Handler (only if if PARSER_SAFETY_CHECKS enabled)
 //   3. jump to start of loop
 tok_next: // if we are skipping handler (empty tok) jump to here
   //printf("tok_next: state=%d, char='%c', pclass=%d, op=%d, next_state=%d, tok_off=%d, len_off=%d\n",state,str[-1], pclass, op, next_state,tok_off,len_off);
+  pstate->accn = 0;
+tok_next_acc: //ACC_BEGIN jumps here, since the char it starts the next token with is accumulated
   tok = str - tok_off; // next token starts after/before current char if tok_off is 0/1
   if (next_state == p->fin_state) goto parser_exit;
 #ifdef PARSER_SAFETY_CHECKS
@@ -449,15 +592,33 @@ string_end:
 //
 // ================  Parser Exit ================
 //   // save parser state and return ret
-//   1. save parser state (if pstate not null)
+//   1. save parser state (to our own _pstate if we weren't given one)
 //   2. return ret
 parser_exit: // save parser state and return
   //printf("parser_exit: state=%d, char='%c', pclass=%d, op=%d, next_state=%d\n",state,str[-1], pclass, op, next_state);
-  if (pstate) {
-    pstate->state = state;
-    pstate->tok = tok;
-    pstate->ptr = str;
-    pstate->len = len;
-  }
+  pstate->state = state;
+  pstate->tok = tok;
+  pstate->ptr = str;
+  pstate->len = len;
+  return ret;
+}
+
+// parser_feed - continue a parse with the next chunk of input
+// - tokens inside the chunk go straight to handler, the unfinished tail (if any) is appended to the carry
+int parser_feed(struct parser_rules *p, const char *chunk, int len, struct parser_state *pstate, parse_handler_t *handler, void *arg) {
+  if (pstate->state < 0) pstate->state = p->init_state;
+  else if (pstate->state == p->fin_state) return 0;
+  pstate->tok = chunk;
+  pstate->ptr = chunk;
+  pstate->len = len;
+  return parser_eval(p,NULL,0,pstate,handler,arg,NULL,NULL,parser_carry,pstate);
+}
+
+// parser_finish - end of input, so hand the carry (if any) to handler as the final token
+int parser_finish(struct parser_rules *p, struct parser_state *pstate, parse_handler_t *handler, void *arg) {
+  int ret = 0;
+  if (pstate->carryn) ret = handler(pstate->carry, pstate->carryn, pstate->state, p->fin_state, arg);
+  pstate->carryn = 0;
+  pstate->state = -1;
   return ret;
 }
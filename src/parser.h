@@ -29,6 +29,11 @@
 // 3. call parser_validate_rules on rules if not known good
 //    - alternatively enable PARSER_SAFETY_CHECKS
 // 4. call parser_validate to validate a string, and parser_eval to tokenize it
+//
+// Prebuilt rules:
+// - parser_rules_write writes a built ruleset out as C source (the fsm entries and class table as const byte arrays)
+// - parser_rules_load points a ruleset at those arrays (no allocation, and none of the parser_set_* calls at startup)
+// - see vm_parser_fsm.h (make parser-fsm) for the concat parser
 
 // Building Rules:
 //
@@ -54,6 +59,11 @@
 //  - call parser_validate_rules on the parser rules before use to verify safety
 //#define PARSER_SAFETY_CHECKS 1
 
+//the classifier is only called while building the rules (parser_rules_init fills a 256-entry byte -> pclass table)
+// - the fsm loop then classifies each byte with a single table lookup (no function call or conditionals)
+// - PARSER_CLASSIFY_FN calls the classifier for every byte instead (saves the 256 bytes per ruleset on tiny MCUs)
+//#define PARSER_CLASSIFY_FN 1
+
 // The general idea behind this parser is to generate a finite statemachine with the parsing rules, then eval the FSM for each char
 // - short+fast FSM/VM to evaluate parsing rules
 //   - general purpose (parsing is completely determined by ruleset, classifier, and supplied handlers)
@@ -61,6 +71,7 @@
 // - fsm is just a lookup table that maps (state,pclass) to (op,newstate)
 //   - every input char mapped to parse class (by supplied classifier)
 //   - when op is a SPLIT op, splits off next token and calls tok handler
+//   - ACC ops build a decimal value for the token as it is scanned (so the handler doesn't need to re-parse number tokens)
 //
 // Parser Ruleset
 // - fsm rulset packed as a byte array of size nstates*nclasses
@@ -71,21 +82,18 @@
 //   - parse_op - 3 bits - index into 8 entry opcode table
 //   - these are just current limits, state_entry_t could be swapped for larger
 //
-// - each fsm rule / vm instruction is 1 byte (max 32 states, 8 opcodes, only 5 currently used)
+// - each fsm rule / vm instruction is 1 byte (max 32 states, 8 opcodes, only 7 currently used)
 // - fsm state transitions looked up in ruleset byte array, which gives next state and opcode
 //
 // There is a separate function parser_validate to validate string without tokenizing
 // - the validator runs a shorter/faster loop just to check if fsm reaches finish state
 
 
-//TODO: add functions for saving/loading fsm (so at least in release mode we just load the static FSM string rather than build the FSM)
 //TODO: better document how to build ruleset with examples (also refactor function names as appropriate)
 
 //IDEAS:
 // - list of FSMs and/or state stack to support more complicated rulesets and recursion
-//   - use the spare ops for navigating between FSMs and the stack
-// - 256-entry lookup array option for classifier
-//   - more RAM for tiny MCUs, but reduces classifier to a single array lookup (no function call or conditionals)
+//   - use the spare op for navigating between FSMs and the stack
 
 
 // state_entry_t - fsm entry - fsm maps (state,class) -> entry, which contains (op,next_state)
@@ -95,16 +103,20 @@ typedef unsigned char state_entry_t;
 // parse_op - tells fsm what to do with a byte (based on pclass)
 // - NOSPLIT             -> continue collecting bytes
 // - SPLIT_BEFORE|AFTER  -> handler is called (split token before/after current)
+// - ACC_BEGIN           -> SPLIT_BEFORE, then start the accumulator of the new token (digit value of this char, or 0 for a sign/prefix)
+// - ACC_DIGIT           -> NOSPLIT, and add this decimal digit to the accumulator (acc = acc*10 + digit)
 // - ERR                 -> parse error (stops parsing)
-// - TODO: decide what to do with remaining opcodes
+// - the accumulator is pstate->acc -- handlers can use it for tokens whose state guarantees every digit went through ACC_DIGIT
+//   - or check pstate->accn (bytes of the current token that went through the ACC ops) against the token length
+// - TODO: decide what to do with the remaining opcode
 enum parse_op {
   PARSE_NOSPLIT=0,     //don't split token (keep building)
 //FIXME: remove A from SPLITA and update vm_parser to match (after parser refactor finished)
   PARSE_SPLITA_BEFORE,  //split token before this char (so char becomes part of next tok)
   PARSE_SPLITA_AFTER,   //split token after this char (so char included in this token)
   PARSE_SPLITA_SKIP,    //split token on this char (so char is thrown out)
-  PARSE_NOOP_4,         // unused parse op -- figure out what to do with this
-  PARSE_NOOP_5,         // unused parse op -- figure out what to do with this
+  PARSE_ACC_BEGIN,      //split token before this char and reset the accumulator (to this char if it is a digit)
+  PARSE_ACC_DIGIT,      //don't split token, and accumulate this (digit) char
   PARSE_NOOP_6,         // unused parse op -- figure out what to do with this
   PARSE_ERR             //parse error
 };
@@ -135,25 +147,51 @@ struct parser_rules {
 //FIXME: remove _err and update vm_parser to match (after parser refactor finished)
   int _err;
   char_classifier_t *classify;
+#ifndef PARSER_CLASSIFY_FN
+  unsigned char classes[256]; //byte -> pclass (filled from classify by parser_rules_init)
+#endif
+  int loaded; //v points at a const table from parser_rules_load (so destroy doesn't free it)
   //parse_handler_t *handler;
 };
 
 //parser_state describes the state of a parsing job (to allow for continuations)
+// - carry holds the start of a token cut off at the end of a chunk by parser_feed (joined with the rest of the token on the next split)
+// - acc is the value built by the ACC ops for the current token (valid in the handler for the token that built it)
+//   - accn counts the bytes of the token that went through the ACC ops (so acc only covers the whole token if accn == its length)
 struct parser_state {
   int state;
   const char *tok;
   const char *ptr;
   int len;
   int skip;
+  unsigned long acc;
+  int accn;
+  char *carry;
+  int carryn;
+  int carrysize;
 };
 
 // create empty parser
 void parser_state_init(struct parser_state *pstate);
 
+// release parser state resources (the carry buffer)
+void parser_state_destroy(struct parser_state *pstate);
+
 // init parser fsm rules with n states, n classes, init/fin/err states, and classifier
+// - the classifier must be a pure function of the char (it is only called here to build the class table)
 //FIXME: remove _err and update vm_parser to match (after parser refactor finished)
 int parser_rules_init(struct parser_rules *p, int nstates, int nclasses, int init_state, int fin_state, int _err, char_classifier_t *classifier/*, parse_handler_t *handler*/);
 
+// init parser fsm rules from prebuilt tables (e.g. written by parser_rules_write)
+// - fsm is used in place (must outlive the rules), classes is copied (or built from the classifier if NULL)
+void parser_rules_load(struct parser_rules *p, const state_entry_t *fsm, const unsigned char *classes, int nstates, int nclasses, int init_state, int fin_state, char_classifier_t *classifier);
+
+// write parser rules as C source (NAME_NSTATES/NCLASSES/INIT_STATE/FIN_STATE defines, plus name_entries and name_classes arrays for parser_rules_load)
+int parser_rules_write(FILE *f, struct parser_rules *p, const char *name);
+
+// compare two rulesets (returns 1 if they would parse identically)
+int parser_rules_equal(struct parser_rules *a, struct parser_rules *b);
+
 // clear parser rules (NOTE: doesn't destroy)
 void parser_rules_clear(struct parser_rules *p);
 
@@ -233,10 +271,19 @@ int parser_validate(struct parser_rules *p, const char *str, int len, int *state
 
 //evaluate a string using a parser ruleset, calling handler as needed during the parse
 // - any time the parser reaches a SPLIT rule, it calls handler, skipping empty tokens
+// - handlers that use the ACC ops need pstate (acc is only kept there)
 // - if (!pstate || pstate->state <= 0) then parser initialized to init state at start of string
 //   - otherwise parser is initialized using pstate and starts from there (so str is ignored)
 // - len sets the max number of chars the parser will look at
 //   - can just set arbitrarily high (e.g. -1) if FSM termination is guaranteed (e.g. null-terminated string)
 //FIXME: remove _h/_arg arguments and update vm_parser to match (after parser refactor finished)
 int parser_eval(struct parser_rules *p, const char *str, int len, struct parser_state *pstate, parse_handler_t *handler, void *arg, parse_handler_t *_h, void *_arg, parse_handler_t *tail_handler, void *arg_tail);
+
+//streaming parse - feed input in arbitrary-sized chunks (e.g. straight from a file/fd read buffer)
+// - pstate must be initialized with parser_state_init (and released with parser_state_destroy)
+// - handler is called as soon as each token completes, with a pointer into the chunk when the token is inside it
+//   - only a token cut off by the end of a chunk is copied (into pstate->carry) until the next chunk finishes it
+// - parser_finish ends the input, handing any trailing token to handler (like the parser_eval tail handler), and resets pstate for a new parse
+int parser_feed(struct parser_rules *p, const char *chunk, int len, struct parser_state *pstate, parse_handler_t *handler, void *arg);
+int parser_finish(struct parser_rules *p, struct parser_state *pstate, parse_handler_t *handler, void *arg);
 #endif
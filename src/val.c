@@ -21,6 +21,10 @@
 #include "val_file.h"
 #include "val_fd.h"
 #include "val_vm.h"
+#include "val_chan.h"
+#include "val_vec.h"
+#include "val_parser.h"
+#include "val_int.h"
 #include "val_printf.h"
 #include "vm_err.h"
 #include "opcodes.h"
@@ -47,7 +51,7 @@ inline val_t __dbl_val(const double f) { return (val_t)(~( *((val64_t*)&f) )); }
 
 //TODO: we need a new thread-safe pool allocator.
 //DEFINE_SIMPLE_POOL(valstruct_t,4096,_valstruct_alloc,_valstruct_release)
-DEFINE_NO_POOL(valstruct_t,4096,_valstruct_alloc,_valstruct_release)
+DEFINE_DEFAULT_POOL(valstruct_t,65536,_valstruct_alloc,_valstruct_release)
 
 
 void val_destroy(val_t val) {
@@ -84,10 +88,25 @@ void val_destroy(val_t val) {
         case TYPE_VM:
           _val_vm_destroy(v);
           break;
+        case TYPE_CHAN:
+          _val_chan_destroy(v);
+          break;
+        case TYPE_VEC:
+          _val_vec_destroy(v);
+          break;
+        case TYPE_PARSER:
+          _val_parser_destroy(v);
+          break;
+        case TYPE_INT64:
+          _val_int64_destroy(v);
+          break;
         default:
           _fatal(ERR_NOT_IMPLEMENTED);
       }
       return;
+    case _FRAME_TAG:
+      _lbuf_release(__frame_buf(val));
+      return;
     default:
       return; //skip releasing valstruct
   }
@@ -120,8 +139,7 @@ err_t val_clone(val_t *val, val_t orig) {
       if (!(p = _valstruct_alloc())) return _fatal(ERR_MALLOC);
 
       origp = __str_ptr(orig);
-      *p=*origp;
-      if (p->v.str.buf) refcount_inc(p->v.str.buf->refcount);
+      _val_str_clone(p,origp);
       *val = __val_dbg(__str_val(p),dbg);
       return 0;
     case _LST_TAG:
@@ -152,6 +170,18 @@ err_t val_clone(val_t *val, val_t orig) {
         case TYPE_VM:
           if ((e = val_vm_clone(val,origp->v.vm))) goto bad_e;
           break;
+        case TYPE_CHAN:
+          if ((e = _val_chan_clone(val,origp))) goto bad_e;
+          break;
+        case TYPE_VEC:
+          if ((e = _val_vec_clone(val,origp))) goto bad_e;
+          break;
+        case TYPE_PARSER:
+          if ((e = _val_parser_clone(val,origp))) goto bad_e;
+          break;
+        case TYPE_INT64:
+          if ((e = _val_int64_clone(val,origp))) goto bad_e;
+          break;
         default:
           _fatal(ERR_NOT_IMPLEMENTED);
           //*p=*origp;
@@ -160,6 +190,10 @@ err_t val_clone(val_t *val, val_t orig) {
       __val_dbg_val(*val) = dbg;
 #endif
       return 0;
+    case _FRAME_TAG: //work stack copies (e.g. trycatch) share the frame buffer
+      refcount_inc(__frame_buf(orig)->refcount);
+      *val = __val_dbg(__val_dbg_strip(orig),dbg);
+      return 0;
     case _TAG5:
       return _fatal(ERR_BADTYPE);
     default: //base case (for inlined val)
@@ -216,7 +250,10 @@ err_t val_validate(val_t val) {
       if (op < 0 || op >= N_OPS) return _throw(ERR_BADTYPE);
       return 0;
     case _INT_TAG:
-      if (__val_int47(val) >= (1UL << 32)) return _throw(ERR_BADTYPE);
+      if (((val64_t)val & ((1UL << 47) - 1)) >= (1UL << 32)) return _throw(ERR_BADTYPE);
+      return 0;
+    case _INT47_TAG:
+      if (__val_int47(val) >= INT32_MIN && __val_int47(val) <= INT32_MAX) return _throw(ERR_BADTYPE); //should have been int32
       return 0;
     case _STR_TAG:
       v = __str_ptr(val);
@@ -224,8 +261,8 @@ err_t val_validate(val_t val) {
       len = v->v.str.len;
 
       if (v->v.str.buf) {
-        if (v->v.str.buf->refcount < 1) return _throw(ERR_BADTYPE);
-        if (v->v.str.buf->refcount > 10000) return _throw(ERR_BADTYPE); //NOTE: this doesn't actually guarantee val is bad, but seems highly unlikely during VM debugging
+        if ((v->v.str.buf->refcount & ~SBUF_MAPPED) < 1) return _throw(ERR_BADTYPE);
+        if ((v->v.str.buf->refcount & ~SBUF_MAPPED) > 10000) return _throw(ERR_BADTYPE); //NOTE: this doesn't actually guarantee val is bad, but seems highly unlikely during VM debugging
         size = v->v.str.buf->size;
         if (off > size || len > size || off+len > size) return _throw(ERR_BADTYPE);
       } else {
@@ -236,7 +273,8 @@ err_t val_validate(val_t val) {
           return 0;
         case TYPE_IDENT:
           return 0;
-        //case TYPE_BYTECODE:
+        case TYPE_BYTECODE:
+          return 0;
         default:
           return _throw(ERR_BADTYPE);
       }
@@ -285,9 +323,31 @@ err_t val_validate(val_t val) {
           return 0;
         case TYPE_VM:
           return vm_validate(v->v.vm);
+        case TYPE_CHAN:
+          if (!v->v.chan.q) return _throw(ERR_BADTYPE);
+          if (v->v.chan.refcount < 1) return _throw(ERR_BADTYPE);
+          if (v->v.chan.refcount > 10000) return _throw(ERR_BADTYPE); //NOTE: this doesn't actually guarantee val is bad, but seems highly unlikely during VM debugging
+          return 0;
+        case TYPE_VEC:
+          if (!v->v.vec.buf) return _throw(ERR_BADTYPE);
+          if (v->v.vec.buf->refcount < 1) return _throw(ERR_BADTYPE);
+          if (v->v.vec.len > v->v.vec.buf->size) return _throw(ERR_BADTYPE);
+          return 0;
+        case TYPE_PARSER:
+          if (!v->v.parser.rules) return _throw(ERR_BADTYPE);
+          if (v->v.parser.refcount < 1) return _throw(ERR_BADTYPE);
+          if (v->v.parser.refcount > 10000) return _throw(ERR_BADTYPE); //NOTE: this doesn't actually guarantee val is bad, but seems highly unlikely during VM debugging
+          return 0;
+        case TYPE_INT64:
+          if (v->v.i64 >= VAL_INT47_MIN && v->v.i64 <= VAL_INT47_MAX) return _throw(ERR_BADTYPE); //should have been inline
+          return 0;
         default:
           return _throw(ERR_BADTYPE);
       }
+    case _FRAME_TAG:
+      if (__frame_buf(val)->refcount < 1) return _throw(ERR_BADTYPE);
+      if (__frame_buf(val)->refcount > 10000) return _throw(ERR_BADTYPE); //NOTE: this doesn't actually guarantee val is bad, but seems highly unlikely during VM debugging
+      return 0;
     //case _TAG5:
     default:
       return _throw(ERR_BADTYPE);
@@ -329,7 +389,7 @@ int val_ispush(val_t val) {
 //
 //wrap a value so it's evaluation (inside a quotation) is the original value
 err_t val_qprotect(val_t *val) {
-  if (val_ispush(*val) || val_is_code(*val) || val_is_file(*val)) return 0;
+  if (val_ispush(*val) || val_is_code(*val) || val_is_bytecode(*val) || val_is_file(*val)) return 0;
   //else if (val_is_code(*val)) return val_code_wrap(val);
   else if (val_is_ident(*val)) return _val_str_rcat_ch(__str_ptr(*val),'\\');
   else {
@@ -343,7 +403,7 @@ err_t val_qprotect(val_t *val) {
 //wrap a value so its evaluation (directly on the work stack) is the original value
 err_t val_protect(val_t *val) {
   if (val_ispush(*val)) return 0;
-  else if (val_is_code(*val) || val_is_file(*val)) return val_code_wrap(val);
+  else if (val_is_code(*val) || val_is_bytecode(*val) || val_is_file(*val)) return val_code_wrap(val);
   else if (val_is_ident(*val)) return _val_str_rcat_ch(__str_ptr(*val),'\\');
   else {
     err_t e;
@@ -357,6 +417,7 @@ err_t val_protect(val_t *val) {
 int val_as_bool(val_t val) {
   if (val_is_int(val)) return __val_int(val) != 0;
   else if (val_is_double(val)) return __val_dbl(val) != 0;
+  else if (val_is_wideint(val)) return 1; //wide ints are never 0
   else if (val_is_lst(val)) return !_val_lst_empty(__lst_ptr(val));
   else if (val_is_str(val)) return !_val_str_empty(__str_ptr(val));
   //else if (val_is_vm(val)) return !_val_vm_finished(__val_ptr(val));
@@ -369,6 +430,8 @@ int val_compare(val_t lhs,val_t rhs) {
     } else if (val_is_double(rhs)) {
       double c = (double)__val_int(lhs) - __val_dbl(rhs);
       return c == 0 ? 0 : (c > 0 ? 1 : -1);
+    } else if (val_is_wideint(rhs)) {
+      return val_num_cmp(lhs,rhs);
     } else {
       return -1; //type mismatch
     }
@@ -378,10 +441,17 @@ int val_compare(val_t lhs,val_t rhs) {
       c -= __val_dbl(rhs);
     } else if (val_is_int(rhs)) {
       c -= (double)__val_int(rhs);
+    } else if (val_is_wideint(rhs)) {
+      c = val_num_cmp(lhs,rhs);
+      return c == 2 ? 0 : c;
     } else { //type mismatch
       c = -1;
     }
     return c == 0 ? 0 : (c > 0 ? 1 : -1);
+  } else if (val_is_wideint(lhs)) {
+    if (!val_is_integer(rhs) && !val_is_double(rhs)) return -1; //type mismatch
+    int c = val_num_cmp(lhs,rhs);
+    return c == 2 ? 0 : c;
   } else if (val_is_str(lhs) && val_is_str(rhs)) {
     return _val_str_compare(__str_ptr(lhs),__str_ptr(rhs));
   } else if (val_is_lst(lhs) && val_is_lst(rhs)) {
@@ -397,20 +467,26 @@ int val_eq(val_t lhs,val_t rhs) {
     } else if (val_is_double(rhs)) {
       return (double)__val_int(lhs) == __val_dbl(rhs);
     } else {
-      return 0; //type mismatch
+      return 0; //type mismatch (or wide int, which is never in int32 range)
     }
   } else if (val_is_double(lhs)) {
     if (val_is_double(rhs)) {
       return  __val_dbl(lhs) == __val_dbl(rhs);
     } else if (val_is_int(rhs)) {
       return  __val_dbl(lhs) == (double)__val_int(rhs);
+    } else if (val_is_wideint(rhs)) {
+      return val_num_cmp(lhs,rhs) == 0;
     } else { //type mismatch
       return 0;
     }
+  } else if (val_is_wideint(lhs)) {
+    return (val_is_wideint(rhs) || val_is_double(rhs)) && val_num_cmp(lhs,rhs) == 0;
   } else if (val_is_str(lhs) && val_is_str(rhs)) {
     return __str_ptr(lhs)->type == __str_ptr(rhs)->type && _val_str_eq(__str_ptr(lhs),__str_ptr(rhs));
   } else if (val_is_lst(lhs) && val_is_lst(rhs)) {
     return __lst_ptr(lhs)->type == __lst_ptr(rhs)->type && _val_lst_eq(__lst_ptr(lhs),__lst_ptr(rhs));
+  } else if (val_is_vec(lhs) && val_is_vec(rhs)) {
+    return _val_vec_eq(__vec_ptr(lhs),__vec_ptr(rhs));
   } else {
     return 0;
   }
@@ -421,6 +497,8 @@ int val_lt(val_t lhs,val_t rhs) {
       return __val_int(lhs) < __val_int(rhs);
     } else if (val_is_double(rhs)) {
       return (double)__val_int(lhs) < __val_dbl(rhs);
+    } else if (val_is_wideint(rhs)) {
+      return val_num_cmp(lhs,rhs) == -1;
     } else {
       return 0; //type mismatch
     }
@@ -429,9 +507,13 @@ int val_lt(val_t lhs,val_t rhs) {
       return  __val_dbl(lhs) < __val_dbl(rhs);
     } else if (val_is_int(rhs)) {
       return  __val_dbl(lhs) < (double)__val_int(rhs);
+    } else if (val_is_wideint(rhs)) {
+      return val_num_cmp(lhs,rhs) == -1;
     } else { //type mismatch
       return 0;
     }
+  } else if (val_is_wideint(lhs)) {
+    return (val_is_integer(rhs) || val_is_double(rhs)) && val_num_cmp(lhs,rhs) == -1;
   } else if (val_is_str(lhs) && val_is_str(rhs)) {
     return _val_str_lt(__str_ptr(lhs),__str_ptr(rhs));
   } else if (val_is_lst(lhs) && val_is_lst(rhs)) {
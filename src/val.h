@@ -38,7 +38,7 @@
 //
 // Core val_t Types:
 // - opcode/native - index into dowork vm jump table
-// - int (32 bit) - up to 47 bits available, 32 for performance
+// - int (32 bit) - 32 for performance, with int47 (own tag) and heap int64 for values that overflow it
 // - float (64 bit) - double float (bit inverted so all other types fit in NaN space)
 // - tagged pointer to valstruct - uses bits in NaN space and outside canonical pointer space (currently 47 bits for intel) for tag
 //
@@ -65,6 +65,7 @@
 // - lst types - valstruct contains offset+length view on refcounted val_t array buffer
 //   - code - code/quotation to eval
 //   - list - list of vals that just gets pushed on eval
+// - frame - vm-internal borrowed view on a code buffer (never a user-visible val, see vm_dowork)
 // - ref - threadsafe refcounted reference val, TODO: ref currently too heavy
 // - vm - used for threading, debugging, or other cases where vm on vm stack is useful
 // - file - c FILE* (with filename if DEBUG_FILENAME is set)
@@ -139,7 +140,7 @@
 //   - pointer - if we currently store opcodes in normal pointer space
 //   - tagged pointer - pointer to struct for extended val
 //     - one of: list-type, string-type, other
-//   - integer - 32 bits used, but up to 47 bits available
+//   - integer - 32 bits used (int47 tag for wider ints, see val_int.h)
 //
 //IEEE754 64bit NaN
 // - bit fields:
@@ -189,6 +190,10 @@ enum val_type {
   TYPE_FILE,
   TYPE_FD,
   TYPE_VM,
+  TYPE_CHAN,
+  TYPE_VEC,
+  TYPE_INT64,
+  TYPE_PARSER,
   //TYPE_NATIVE,
   //TYPE_DOUBLE,
   //TYPE_INT,
@@ -268,6 +273,10 @@ typedef struct _sbuf_t {
   char p[];
 } sbuf_t;
 
+//high refcount bit marks an sbuf backed by a read-only file mapping (see _sbuf_mmap)
+// - refcount never equals 1, so every write copies out first, and the last release unmaps instead of freeing
+#define SBUF_MAPPED 0x80000000u
+
 typedef struct _lbuf_t {
   unsigned int size;
   unsigned int refcount;
@@ -279,6 +288,15 @@ typedef struct _str_t {
   unsigned int off;
   unsigned int len;
   sbuf_t *buf;
+  //ident caches (see _val_str_hash32_cached and _val_dict_get_ident)
+  // - hash is valid while view matches hview (buffer writes go through l/rreserve, which clear it)
+  // - lval is the def for dictionary generation lgen (lseq is a seqlock, since code may be shared between threads)
+  // - bytecode (never an ident) keeps its validated view in lgen instead (see val_bytecode.h)
+  uint64_t hview;
+  uint32_t hash;
+  uint32_t lseq;
+  uint64_t lgen;
+  val_t lval;
 } str_t;
 
 typedef struct _lst_t {
@@ -291,25 +309,67 @@ typedef struct _lst_t {
 // ref_t valstruct contains a shared val_t, refcount, and synchronization primitives
 // - supports lock/unlock (at language level via guard ops for safety)
 // - wait/signal/broadcast to implement any other thread synchronization on top of ref_t
+// - lock and wake are futex words (see val_ref.c), so uncontended lock/unlock is a single atomic op
 
 typedef struct _ref_t {
-  // TODO: shrink down ref_t (currently largest type)
-  // - extra indirection level (at least for part)?
-  // - use tag bit with different ref_t type instead of valstruct?
   val_t val;
   unsigned int refcount;
-  sem_t lock;
-  sem_t wait;
-  unsigned int nwait;
+  unsigned int lock; //0 unlocked, 1 locked, 2 locked with (possible) sleepers
+  unsigned int wake; //wakeups posted by signal/broadcast not yet taken by a waiter
+  unsigned int nwait; //waiters that haven't been signalled yet (protected by lock)
 } ref_t;
 
+// chan_t valstruct is a shared handle (like ref_t) to a lock-free MPMC channel (see val_chan.c)
+// - bounded (ring buffer) or unbounded (linked blocks), threads only block when it is empty (or full)
+struct chanbuf;
+typedef struct _chan_t {
+  struct chanbuf *q;
+  unsigned int refcount;
+} chan_t;
+
+// vec_t valstruct is a packed numeric array (see val_vec.c) -- int64 or double elements stored unboxed in a refcounted vbuf_t
+// - clones share the buffer, and writers take it over only when they are the single owner (copy-on-write like lbuf_t)
+enum vec_kind { VEC_INT, VEC_DBL };
+typedef struct _vbuf_t {
+  unsigned int size;
+  unsigned int refcount;
+  uint64_t p[]; //int64_t or double elements (by vec kind)
+} vbuf_t;
+typedef struct _vec_t {
+  vbuf_t *buf;
+  unsigned int len;
+  enum vec_kind kind;
+} vec_t;
+
+// parser_t valstruct is a user-built fsm parser (see val_parser.c) -- shared by clones like chan_t, and read-only once built
+struct parser_rules;
+typedef struct _parser_t {
+  struct parser_rules *rules;
+  uint32_t intstates; //bit per state whose tokens are ints (from the parser accumulator)
+  unsigned int refcount;
+} parser_t;
+
+// rbuf_t is the read buffer shared by file_t/fd_t (see val_rbuf.c)
+// - unread bytes are buf->p[off..off+len), and lines are handed out as str views into buf
+typedef struct _rbuf_t {
+  sbuf_t *buf;
+  unsigned int off;
+  unsigned int len;
+  unsigned int lock; //futex lock word (see futex_lock in helpers.h)
+} rbuf_t;
+
 // file_t/fd_t contain FILE_* or integer file descriptor respecitvely for filesystem access
+// - reads go through rbuf (straight from the file descriptor, bypassing stdio buffering)
+// - parse is the streaming parser state (partial token carried between chunks) once the file is evaluated (see vm_dowork)
 // - with DEBUG_FILENAME they also keep filename string for debug printing
 
+struct vm_parse_code_state;
 typedef struct _file_t {
   FILE *f;
   enum { NONE=0,DOCLOSE=1} flags;
   int refcount;
+  rbuf_t rbuf;
+  struct vm_parse_code_state *parse;
 #ifdef DEBUG_FILENAME
   char *fname; //name of the file (just for printing to user, not needed in real impl)
   //TODO: support DEBUG_LINENO
@@ -320,6 +380,8 @@ typedef struct _fd_t {
   int fd;
   enum { FD_NONE=0,FD_DOCLOSE=1} flags;
   int refcount;
+  rbuf_t rbuf;
+  struct vm_parse_code_state *parse;
 #ifdef DEBUG_FILENAME
   char *fname; //name of the file (just for printing to user, not needed in release)
   //TODO: support DEBUG_LINENO
@@ -333,6 +395,7 @@ struct _valstruct_t;
 typedef struct _dict_t {
   struct hashtable *h;
   struct _valstruct_t *next;
+  uint64_t gen; //generation -- unique per dictionary state, changes on any put/scope change (for ident lookup caches)
 } dict_t;
 
 // valstruct_t has a type enum and union of implemented valstruct types
@@ -346,6 +409,10 @@ typedef struct _valstruct_t {
     file_t file;
     fd_t fd;
     vm_t *vm;
+    chan_t chan;
+    vec_t vec;
+    parser_t parser;
+    int64_t i64;
   } v;
 } valstruct_t;
 
@@ -353,10 +420,14 @@ typedef struct _valstruct_t {
 #define _OP_TAG    (0x0000)
 //integer type (normally 32bits, but actually a 47 bit field)
 #define _INT_TAG    (0x0001)
+//ints that don't fit in 32 bits, but do fit in 47 (sign extended) -- see val_int.h
+#define _INT47_TAG  (0x0003)
 #define _STR_TAG    (0x0002)
 #define _LST_TAG    (0x0004)
 //generic value type (look at valstruct to get 
 #define _VAL_TAG    (0x0008)
+//borrowed code frame (lbuf_t pointer) -- only ever on the vm work stack, see vm_dowork
+#define _FRAME_TAG  (0x0005)
 //TODO: figure out what to do with these? (reference val, bare native, errnum, short ident, bitmap, and s9 come to mind) -- or remap types altogether
 #define _TAG5       (0x00F0)
 
@@ -381,26 +452,33 @@ val_t __dbl_val(const double f);
 #define VALDBL_MANT_BITS 53
 
 // int32 in non-canonical pointer space (can actually use up to 47 bits, but 32 bits standard for performance)
+// - ints that overflow 32 bits are int47 (separate tag, so val_is_int still means int32), then heap int64 (see val_int.h)
 #define val_is_int(v) ((((uint64_t)(v))>>47) == _INT_TAG)
 #define __int_val(i) (val_t)( (uint64_t)((uint32_t)(i)) | ((uint64_t)_INT_TAG<<47) )
 #define __int32_val(i) (val_t)( (uint64_t)((uint32_t)(i)) | ((uint64_t)_INT_TAG<<47) )
-#define __int47_val(i) (val_t)( (uint64_t)((uint64_t)(i) & ((1UL<<47)-1)) | ((uint64_t)_INT_TAG<<47) )
 #define __val_int(v) (*((int32_t*)&(v)))
 #define __val_int32(v) (*((int32_t*)&(v)))
-#define __val_int47(v) (*((int64_t*)&(v)) & ~((uint64_t)_INT_TAG<<47))
+#define val_is_int47(v) ((((uint64_t)(v))>>47) == _INT47_TAG)
+#define __int47_val(i) (val_t)( (uint64_t)((uint64_t)(i) & ((1UL<<47)-1)) | ((uint64_t)_INT47_TAG<<47) )
+#define __val_int47(v) ((int64_t)((uint64_t)(v) << 17) >> 17)
+#define VAL_INT47_MIN (-(1L<<46))
+#define VAL_INT47_MAX ((1L<<46)-1)
 
 // str/lst/other tagged valstruct pointer
 #define val_is_str(v) ((((uint64_t)(v))>>47) == _STR_TAG)
 #define val_is_lst(v) ((((uint64_t)(v))>>47) == _LST_TAG)
 #define val_is_val(v) ((((uint64_t)(v))>>47) == _VAL_TAG)
+#define val_is_frame(v) ((((uint64_t)(v))>>47) == _FRAME_TAG)
 #define __str_ptr(v) ((valstruct_t*)((uint64_t)(v)& ~(((uint64_t)_STR_TAG<<47))))
 #define __lst_ptr(v) ((valstruct_t*)((uint64_t)(v)& ~(((uint64_t)_LST_TAG<<47))))
 #define __val_ptr(v) ((valstruct_t*)((uint64_t)(v)& ~(((uint64_t)_VAL_TAG<<47))))
+#define __frame_buf(v) ((lbuf_t*)((uint64_t)(v)& ~(((uint64_t)_FRAME_TAG<<47))))
 // generic valstruct pointer -- if we have specific bit set/clear instructions the specific versions above may be faster, and also they tend to cause nice segfaults when our assumption fails
 #define val_ptr(v) ((valstruct_t*)((v)& ((1UL<<47)-1)))
 #define __str_val(p) (val_t)((uint64_t)(p) | ((uint64_t)_STR_TAG<<47))
 #define __lst_val(p) (val_t)((uint64_t)(p) | ((uint64_t)_LST_TAG<<47))
 #define __val_val(p) (val_t)((uint64_t)(p) | ((uint64_t)_VAL_TAG<<47))
+#define __frame_val(buf) (val_t)((uint64_t)(buf) | ((uint64_t)_FRAME_TAG<<47))
 
 #ifdef VAL_POINTER_CHECKS
 //FIXME: implement typechecking in pointer functions/macros
@@ -415,6 +493,9 @@ val_t __dbl_val(const double f);
 //valstruct_t* __file_ptr(val_t t);
 //valstruct_t* __fd_ptr(val_t t);
 //valstruct_t* __vm_ptr(val_t t);
+//valstruct_t* __chan_ptr(val_t t);
+//valstruct_t* __vec_ptr(val_t t);
+//valstruct_t* __parser_ptr(val_t t);
 //
 //val_t __string_val(valstruct_t *p);
 //val_t __ident_val(valstruct_t *p);
@@ -426,6 +507,9 @@ val_t __dbl_val(const double f);
 //val_t __file_val(valstruct_t *p);
 //val_t __fd_val(valstruct_t *p);
 //val_t __vm_val(valstruct_t *p);
+//val_t __chan_val(valstruct_t *p);
+//val_t __vec_val(valstruct_t *p);
+//val_t __parser_val(valstruct_t *p);
 #else
 #define __string_ptr(v) __str_ptr(v)
 #define __ident_ptr(v) __str_ptr(v)
@@ -437,6 +521,9 @@ val_t __dbl_val(const double f);
 #define __file_ptr(v) __val_ptr(v)
 #define __fd_ptr(v) __val_ptr(v)
 #define __vm_ptr(v) __val_ptr(v)
+#define __chan_ptr(v) __val_ptr(v)
+#define __vec_ptr(v) __val_ptr(v)
+#define __parser_ptr(v) __val_ptr(v)
 
 #define __string_val(p) __str_val(p)
 #define __ident_val(p) __str_val(p)
@@ -448,6 +535,9 @@ val_t __dbl_val(const double f);
 #define __file_val(p) __val_val(p)
 #define __fd_val(p) __val_val(p)
 #define __vm_val(p) __val_val(p)
+#define __chan_val(p) __val_val(p)
+#define __vec_val(p) __val_val(p)
+#define __parser_val(p) __val_val(p)
 #endif
 
 // the specific valstruct types are checked by checking pointer tag and then valstruct.type
@@ -461,6 +551,13 @@ val_t __dbl_val(const double f);
 #define val_is_dict(val) (val_is_val(val) && __val_ptr(val)->type == TYPE_DICT)
 #define val_is_ref(val) (val_is_val(val) && __val_ptr(val)->type == TYPE_REF)
 #define val_is_vm(val) (val_is_val(val) && __val_ptr(val)->type == TYPE_VM)
+#define val_is_chan(val) (val_is_val(val) && __val_ptr(val)->type == TYPE_CHAN)
+#define val_is_vec(val) (val_is_val(val) && __val_ptr(val)->type == TYPE_VEC)
+#define val_is_parser(val) (val_is_val(val) && __val_ptr(val)->type == TYPE_PARSER)
+#define val_is_int64(val) (val_is_val(val) && __val_ptr(val)->type == TYPE_INT64)
+//int of any width (int32, int47 or heap int64) -- wide ints are only ever the values that don't fit in the narrower ones
+#define val_is_wideint(val) (val_is_int47(val) || val_is_int64(val))
+#define val_is_integer(val) (val_is_int(val) || val_is_wideint(val))
 
 //functions for dealing with vals (mostly just for gdb inspection, we use the above macros in code)
 //TODO: add these back (with new names, or macro switch to pick macros or functions, or just use inline functions for all)
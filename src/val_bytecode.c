@@ -16,8 +16,11 @@
 #include "val_string.h"
 #include "val_list.h"
 #include "val_printf.h"
+#include "val_int.h"
 #include "opcodes.h"
 
+#include <string.h>
+
 val_t val_empty_bytecode() { return _strval_alloc(TYPE_BYTECODE); }
 err_t val_bytecode_init_empty(val_t *v) { return _strval_init(v,TYPE_BYTECODE); }
 
@@ -53,15 +56,21 @@ err_t bytecode_rpush_int32(valstruct_t *b, int32_t i) {
     *((int32_t*)p) = i;
     return nbytes;
   //} else { //TODO: add intermediate integers (8/16 probably mostly sufficient on avr) -- OR use varbyte for everything else
-  //  const int nbytes = 9; //op + int64
-  //  if ((e = _val_str_rextend(b,nbytes,&p))) return e;
-  //  *(p++) = (char)TYPECODE_int64;
-  //  *((int64_t*)p) = i;
-  //  return nbytes;
   }
 
 }
 
+//wide ints (int47 and heap int64 vals) -- always 8 bytes since they don't fit in 32
+err_t bytecode_rpush_int64(valstruct_t *b, int64_t i) {
+  err_t e;
+  const int nbytes = 1 + sizeof(i); //op + int64
+  char *p;
+  if ((e = _val_str_rextend(b,nbytes,&p))) return e;
+  *(p++) = (char)TYPECODE_int64;
+  memcpy(p,&i,sizeof(i));
+  return nbytes;
+}
+
 //TODO: normalize float bit layout for architectures where needed
 err_t bytecode_rpush_dbl(valstruct_t *b, double f) {
   err_t e;
@@ -103,7 +112,7 @@ err_t _bytecode_rpush_lst(valstruct_t *b, bytecode_t op, const val_t *vp, unsign
   *(p++) = (char)op;
   p += _bytecode_write_vbyte32(p,len);
   for(;len>0;++vp,--len) {
-    if ((e = bytecode_rpush(b,*vp))) return e;
+    if (0>(e = bytecode_rpush(b,*vp))) return e;
     else nbytes += e;
   }
   return nbytes;
@@ -128,12 +137,22 @@ err_t bytecode_rpush(valstruct_t *b, val_t val) {
     unsigned int len;
     switch(__val_tag(val)) {
       case _OP_TAG:
-        if ((e = _val_str_cat_ch(b,__val_op(val)))) return e;
-        else return 1;
+        op = __val_op(val);
+        if (op < N_CORE_OPS) {
+          if ((e = _val_str_cat_ch(b,op))) return e;
+          else return 1;
+        } else if (op < N_OPS) { //extended op - escape byte + offset into the extended range
+          if ((e = _val_str_cat_ch(b,TYPECODE_extop)) || (e = _val_str_cat_ch(b,op - N_CORE_OPS))) return e;
+          else return 2;
+        } else {
+          return _throw(ERR_BADTYPE);
+        }
         break;
       case _INT_TAG:
         return bytecode_rpush_int32(b,__val_int(val));
         break;
+      case _INT47_TAG:
+        return bytecode_rpush_int64(b,__val_int47(val));
       case _STR_TAG:
         v = __str_ptr(val);
         len = v->v.str.len;
@@ -177,6 +196,7 @@ err_t bytecode_rpush(valstruct_t *b, val_t val) {
         return _bytecode_rpush_lst(b,op,_val_lst_begin(v),len);
       case _VAL_TAG:
         v = __val_ptr(val);
+        if (v->type == TYPE_INT64) return bytecode_rpush_int64(b,v->v.i64);
         return _throw(ERR_NOT_IMPLEMENTED);
 
         switch(v->type) {
@@ -195,21 +215,105 @@ err_t bytecode_rpush(valstruct_t *b, val_t val) {
     return _throw(ERR_NOT_IMPLEMENTED);
   }
 }
+//length of the vbyte at p (or 0 if it runs past len)
+static unsigned int _bytecode_vbyte_len(const char *p, unsigned int len) {
+  unsigned int n;
+  for(n = 0; n < len && n < 5; ++n) {
+    if (!((unsigned char)p[n] & 0x80)) return n+1;
+  }
+  return 0;
+}
+
+//returns the encoded length of the bytecode item at p (or error if p doesn't hold a full valid item)
+// - used to validate bytecode before we eval it (vm_dowork and bytecode_lpop trust lengths once validated)
+int bytecode_next(const char *p, unsigned int len) {
+  bytecode_t op;
+  uint32_t n;
+  unsigned int hdr;
+  int r;
+  if (!len) return _throw(ERR_EMPTY);
+  op = (bytecode_t)(unsigned char)*p;
+  if (op < N_CORE_OPS) return 1;
+  switch(op) {
+    case TYPECODE_extop:
+      if (len < 2) return _throw(ERR_BADARGS);
+      if ((unsigned char)p[1] >= N_OPS - N_CORE_OPS) return _throw(ERR_BADTYPE);
+      return 2;
+    case TYPECODE_int8: n = 1; hdr = 1; break;
+    case TYPECODE_int32: n = sizeof(int32_t); hdr = 1; break;
+    case TYPECODE_int64: n = sizeof(int64_t); hdr = 1; break;
+    case TYPECODE_float: n = sizeof(double); hdr = 1; break;
+    case TYPECODE_qstring:
+    case TYPECODE_qident:
+      if (len < 2) return _throw(ERR_BADARGS);
+      n = (unsigned char)p[1]; hdr = 2;
+      break;
+    case TYPECODE_string:
+    case TYPECODE_ident:
+    case TYPECODE_bytecode:
+      if (!_bytecode_vbyte_len(p+1,len-1)) return _throw(ERR_BADARGS);
+      hdr = 1 + _bytecode_read_vbyte32(p+1,&n);
+      if (op == TYPECODE_bytecode && hdr <= len && n <= len-hdr) { //nested bytecode must be valid too
+        unsigned int off;
+        for(off = 0; off < n; off += r) {
+          if (0>(r = bytecode_next(p+hdr+off,n-off))) return r;
+        }
+      }
+      break;
+    case TYPECODE_list:
+    case TYPECODE_code:
+      if (!_bytecode_vbyte_len(p+1,len-1)) return _throw(ERR_BADARGS);
+      hdr = 1 + _bytecode_read_vbyte32(p+1,&n);
+      for(r = hdr; n; --n) { //n is element count (not byte length) for lists
+        int el;
+        if ((unsigned int)r > len) return _throw(ERR_BADARGS);
+        if (0>(el = bytecode_next(p+r,len-r))) return el;
+        r += el;
+      }
+      if ((unsigned int)r > len) return _throw(ERR_BADARGS);
+      return r;
+    default:
+      return _throw(ERR_BADTYPE);
+  }
+  if (hdr > len || n > len-hdr) return _throw(ERR_BADARGS);
+  return hdr+n;
+}
+
+err_t bytecode_validate(valstruct_t *b) {
+  const char *p = _val_str_begin(b);
+  unsigned int len = _val_str_len(b);
+  int r;
+  for(; len; p += r, len -= r) {
+    if (0>(r = bytecode_next(p,len))) return r;
+  }
+  _bytecode_setvalid(b);
+  return 0;
+}
+
+//decode (and drop) the first val from validated bytecode
+// - strings/idents/bytecode share the bytecode buffer, so only lists need to allocate beyond the valstruct
 err_t bytecode_lpop(valstruct_t *b, val_t *val) {
   if (_val_str_empty(b)) return _throw(ERR_EMPTY);
-  char *p = _val_str_begin(b);
-  bytecode_t op = (bytecode_t)(*p);
-  if (op < N_OPS) {
+  const char *p = _val_str_begin(b);
+  bytecode_t op = (bytecode_t)(unsigned char)*p;
+  if (op < N_CORE_OPS) {
     *val = __op_val(op);
     b->v.str.off += 1;
     b->v.str.len -= 1;
     return 0;
+  } else if (op == TYPECODE_extop) {
+    *val = __op_val(N_CORE_OPS + (unsigned char)p[1]);
+    b->v.str.off += 2;
+    b->v.str.len -= 2;
+    return 0;
   } else {
     err_t e;
     uint32_t len;
     unsigned int n;
     valstruct_t *v;
-    val_t *vp;
+    int32_t i;
+    int64_t i64;
+    double f;
     //TODO: should I use computed goto with array of labels, or switch statment?
     ++p;
     switch(op) {
@@ -219,14 +323,22 @@ err_t bytecode_lpop(valstruct_t *b, val_t *val) {
         b->v.str.len -= 2;
         break;
       case TYPECODE_int32:
-        *val = __int_val((int32_t)*p);
-        b->v.str.off += 5;
-        b->v.str.len -= 5;
+        memcpy(&i,p,sizeof(i));
+        *val = __int_val(i);
+        b->v.str.off += 1+sizeof(i);
+        b->v.str.len -= 1+sizeof(i);
+        break;
+      case TYPECODE_int64:
+        memcpy(&i64,p,sizeof(i64));
+        if ((e = val_int64_init(val,i64))) return e;
+        b->v.str.off += 1+sizeof(i64);
+        b->v.str.len -= 1+sizeof(i64);
         break;
       case TYPECODE_float:
-        *val = __dbl_val((double)*p);
-        b->v.str.off += 9;
-        b->v.str.len -= 9;
+        memcpy(&f,p,sizeof(f));
+        *val = __dbl_val(f);
+        b->v.str.off += 1+sizeof(f);
+        b->v.str.len -= 1+sizeof(f);
         break;
       case TYPECODE_string:
         n = _bytecode_read_vbyte32(p,&len);
@@ -259,35 +371,27 @@ err_t bytecode_lpop(valstruct_t *b, val_t *val) {
       case TYPECODE_bytecode:
         n = _bytecode_read_vbyte32(p,&len);
         if ((e = _val_str_substr_clone(val,b,n+1,len))) return e;
+        _bytecode_setvalid(__str_ptr(*val)); //nested in validated bytecode
         b->v.str.off += 1+n+len;
         b->v.str.len -= 1+n+len;
         break;
       case TYPECODE_list:
-        return _throw(ERR_NOT_IMPLEMENTED);
-        n = _bytecode_read_vbyte32(p,&len);
-        *val = val_empty_list();
-        v = __val_ptr(*val);
-        if ((e = _val_lst_rreserve(v,len))) return e;
-
-        b->v.str.off += 1+n;
-        b->v.str.len -= 1+n;
-        while(len--) {
-          if ((e = bytecode_lpop(b,vp++))) return e;
-        }
-        return 0;
       case TYPECODE_code:
-        return _throw(ERR_NOT_IMPLEMENTED);
         n = _bytecode_read_vbyte32(p,&len);
-        *val = val_empty_code();
-        v = __val_ptr(*val);
-        if ((e = _val_lst_rextend(v,len,&vp))) return e;
-
+        *val = (op == TYPECODE_list ? val_empty_list() : val_empty_code());
+        v = __lst_ptr(*val);
         b->v.str.off += 1+n;
         b->v.str.len -= 1+n;
+        if (len && (e = _val_lst_rreserve(v,len))) goto out_lst;
         while(len--) {
-          if ((e = bytecode_lpop(b,vp++))) return e;
+          val_t el;
+          if ((e = bytecode_lpop(b,&el))) goto out_lst;
+          if ((e = _val_lst_rpush(v,el))) { val_destroy(el); goto out_lst; }
         }
         return 0;
+out_lst:
+        val_destroy(*val);
+        return e;
       case TYPECODE_dict:
       case TYPECODE_ref:
       case TYPECODE_file:
@@ -16,6 +16,7 @@
 #define __VAL_BYTECODE_H__ 1
 
 #include "val.h"
+#include "val_string.h"
 
 
 val_t val_empty_bytecode();
@@ -26,6 +27,15 @@ int val_bytecode_fprintf(valstruct_t *v,FILE *file, const struct printf_fmt *fmt
 int val_bytecode_sprintf(valstruct_t *v,valstruct_t *buf, const struct printf_fmt *fmt);
 
 err_t bytecode_rpush(valstruct_t *b, val_t val);
+err_t bytecode_rpush_int64(valstruct_t *b, int64_t i);
+err_t bytecode_lpop(valstruct_t *b, val_t *val);
+int bytecode_next(const char *p, unsigned int len);
+err_t bytecode_validate(valstruct_t *b);
+
+//bytecode_validate stamps the validated view into lgen (otherwise only used by idents), so later evals of that view (or clones of it) skip validation
+// - slicing changes the view and writes go through l/rreserve (which clear lgen), so edited bytecode is validated again before we decode it
+#define _bytecode_valid(bc) ((bc)->v.str.lgen == _str_view(bc))
+#define _bytecode_setvalid(bc) ((bc)->v.str.lgen = _str_view(bc))
 
 
 unsigned int _bytecode_write_vbyte32(char *buf, uint32_t v);
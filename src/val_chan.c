@@ -0,0 +1,409 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "val_chan.h"
+#include "val_list.h"
+#include "val_printf.h"
+#include "helpers.h"
+#include <valgrind/helgrind.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+
+//channel internals -- same algorithms as the crossbeam array (bounded) and list (unbounded) channels
+//
+//bounded: ring of cap slots, each with a stamp saying whose turn it is
+// - head/tail are {lap, mark, index}: index in the low bits, then mark_bit (closed, tail only), then lap counter
+// - slot i is writable by the sender whose tail == stamp, and readable by the receiver whose head+1 == stamp
+// - senders/receivers claim a slot with CAS on tail/head, then write/read it and publish the next stamp
+//
+//unbounded: linked list of blocks of CHAN_BLOCK_CAP slots, head/tail are (position << CHAN_SHIFT) | mark
+// - each block covers one lap of CHAN_LAP positions, the last position in the lap is never a slot
+//   (a tail sitting there means the sender that filled the block is still installing the next one)
+// - slot state bits say whether the val was written and read, and readers free a block once every slot is read
+//   (a reader that finds an unread slot sets CHAN_DESTROY on it and leaves the free to that slot's reader)
+// - tail mark = closed, head mark = head and tail are in different blocks (so receivers can skip the empty check)
+//
+//blocking: recv_seq/send_seq are futex event counters, bumped on every send/recv when anyone is waiting on them
+
+#define CHAN_LAP 32
+#define CHAN_BLOCK_CAP (CHAN_LAP-1)
+#define CHAN_SHIFT 1
+#define CHAN_MARK 1
+
+#define CHAN_WRITE 1
+#define CHAN_READ 2
+#define CHAN_DESTROY 4
+
+struct chanslot {
+  size_t stamp; //bounded: turn stamp, unbounded: CHAN_WRITE/READ/DESTROY state
+  val_t val;
+};
+
+struct chanblock {
+  struct chanblock *next;
+  struct chanslot slots[CHAN_BLOCK_CAP];
+};
+
+struct chanbuf {
+  size_t head __attribute__((aligned(64)));
+  struct chanblock *head_block;
+  size_t tail __attribute__((aligned(64)));
+  struct chanblock *tail_block;
+  unsigned int recv_seq __attribute__((aligned(64))); //bumped after each send (receivers sleep on it)
+  unsigned int recv_wait;
+  unsigned int send_seq; //bumped after each recv (senders sleep on it while full)
+  unsigned int send_wait;
+  size_t cap; //0 for unbounded
+  size_t mark_bit, one_lap;
+  struct chanslot slots[];
+};
+
+//wait for a slot another thread has claimed but not finished with yet
+static inline void _chan_snooze() {
+  sched_yield();
+}
+
+static inline void _chan_notify(unsigned int *seq, unsigned int *waiters) {
+  __atomic_add_fetch(seq,1,__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(waiters,__ATOMIC_SEQ_CST)) futex_wake(seq,1);
+}
+
+//bounded ring
+
+static err_t _ring_trysend(struct chanbuf *q, val_t val) {
+  size_t tail = __atomic_load_n(&q->tail,__ATOMIC_RELAXED), head, index, lap, stamp;
+  struct chanslot *slot;
+  for(;;) {
+    if (tail & q->mark_bit) return _throw(ERR_CLOSED);
+    index = tail & (q->mark_bit - 1);
+    lap = tail & ~(q->one_lap - 1);
+    slot = &q->slots[index];
+    stamp = __atomic_load_n(&slot->stamp,__ATOMIC_ACQUIRE);
+    if (tail == stamp) { //our turn -- claim slot
+      size_t next = index + 1 < q->cap ? tail + 1 : lap + q->one_lap;
+      if (__atomic_compare_exchange_n(&q->tail,&tail,next,1,__ATOMIC_SEQ_CST,__ATOMIC_RELAXED)) {
+        slot->val = val;
+        __atomic_store_n(&slot->stamp,tail + 1,__ATOMIC_RELEASE);
+        return 0;
+      }
+    } else if (stamp + q->one_lap == tail + 1) { //slot still holds last lap's val -- full unless head moved
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      head = __atomic_load_n(&q->head,__ATOMIC_RELAXED);
+      if (head + q->one_lap == tail) return ERR_EMPTY; //full (ERR_EMPTY means "try again later" for both directions)
+      tail = __atomic_load_n(&q->tail,__ATOMIC_RELAXED);
+    } else { //another sender claimed this slot and hasn't moved tail yet
+      _chan_snooze();
+      tail = __atomic_load_n(&q->tail,__ATOMIC_RELAXED);
+    }
+  }
+}
+
+static err_t _ring_tryrecv(struct chanbuf *q, val_t *val) {
+  size_t head = __atomic_load_n(&q->head,__ATOMIC_RELAXED), tail, index, lap, stamp;
+  struct chanslot *slot;
+  for(;;) {
+    index = head & (q->mark_bit - 1);
+    lap = head & ~(q->one_lap - 1);
+    slot = &q->slots[index];
+    stamp = __atomic_load_n(&slot->stamp,__ATOMIC_ACQUIRE);
+    if (head + 1 == stamp) { //val ready -- claim it
+      size_t next = index + 1 < q->cap ? head + 1 : lap + q->one_lap;
+      if (__atomic_compare_exchange_n(&q->head,&head,next,1,__ATOMIC_SEQ_CST,__ATOMIC_RELAXED)) {
+        *val = slot->val;
+        __atomic_store_n(&slot->stamp,head + q->one_lap,__ATOMIC_RELEASE);
+        return 0;
+      }
+    } else if (stamp == head) { //slot empty -- channel empty unless a send is in progress
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      tail = __atomic_load_n(&q->tail,__ATOMIC_RELAXED);
+      if ((tail & ~q->mark_bit) == head) return (tail & q->mark_bit) ? ERR_EOF : ERR_EMPTY;
+      _chan_snooze();
+      head = __atomic_load_n(&q->head,__ATOMIC_RELAXED);
+    } else {
+      _chan_snooze();
+      head = __atomic_load_n(&q->head,__ATOMIC_RELAXED);
+    }
+  }
+}
+
+//unbounded block list
+
+static struct chanblock* _block_new() {
+  return calloc(1,sizeof(struct chanblock));
+}
+
+//free block once every slot from start on has been read (otherwise the reader of the first unread slot will)
+static void _block_destroy(struct chanblock *b, unsigned int start) {
+  unsigned int i;
+  for(i = start; i < CHAN_BLOCK_CAP - 1; ++i) {
+    struct chanslot *slot = &b->slots[i];
+    if (!(__atomic_load_n(&slot->stamp,__ATOMIC_ACQUIRE) & CHAN_READ)
+        && !(__atomic_fetch_or(&slot->stamp,CHAN_DESTROY,__ATOMIC_ACQ_REL) & CHAN_READ)) {
+      return;
+    }
+  }
+  free(b);
+}
+
+static err_t _list_send(struct chanbuf *q, val_t val) {
+  size_t tail = __atomic_load_n(&q->tail,__ATOMIC_ACQUIRE), offset;
+  struct chanblock *block = __atomic_load_n(&q->tail_block,__ATOMIC_ACQUIRE), *next = NULL, *b;
+  for(;;) {
+    if (tail & CHAN_MARK) {
+      free(next);
+      return _throw(ERR_CLOSED);
+    }
+    offset = (tail >> CHAN_SHIFT) % CHAN_LAP;
+    if (offset == CHAN_BLOCK_CAP) { //another sender is installing the next block
+      _chan_snooze();
+      tail = __atomic_load_n(&q->tail,__ATOMIC_ACQUIRE);
+      block = __atomic_load_n(&q->tail_block,__ATOMIC_ACQUIRE);
+      continue;
+    }
+    if (offset + 1 == CHAN_BLOCK_CAP && !next) { //we may fill this block, so have the next one ready
+      if (!(next = _block_new())) return _throw(ERR_MALLOC);
+    }
+    if (!block) { //first send -- install first block
+      if (!(b = _block_new())) {
+        free(next);
+        return _throw(ERR_MALLOC);
+      }
+      if (__atomic_compare_exchange_n(&q->tail_block,&block,b,0,__ATOMIC_RELEASE,__ATOMIC_RELAXED)) {
+        __atomic_store_n(&q->head_block,b,__ATOMIC_RELEASE);
+        block = b;
+      } else {
+        free(b);
+        tail = __atomic_load_n(&q->tail,__ATOMIC_ACQUIRE);
+        block = __atomic_load_n(&q->tail_block,__ATOMIC_ACQUIRE);
+        continue;
+      }
+    }
+    if (__atomic_compare_exchange_n(&q->tail,&tail,tail + (1 << CHAN_SHIFT),1,__ATOMIC_SEQ_CST,__ATOMIC_ACQUIRE)) {
+      if (offset + 1 == CHAN_BLOCK_CAP) { //we took the last slot -- install next block and skip the end-of-lap position
+        __atomic_store_n(&q->tail_block,next,__ATOMIC_RELEASE);
+        __atomic_fetch_add(&q->tail,1 << CHAN_SHIFT,__ATOMIC_RELEASE);
+        __atomic_store_n(&block->next,next,__ATOMIC_RELEASE);
+        next = NULL;
+      }
+      free(next);
+      block->slots[offset].val = val;
+      __atomic_fetch_or(&block->slots[offset].stamp,CHAN_WRITE,__ATOMIC_RELEASE);
+      return 0;
+    }
+    block = __atomic_load_n(&q->tail_block,__ATOMIC_ACQUIRE);
+  }
+}
+
+static err_t _list_tryrecv(struct chanbuf *q, val_t *val) {
+  size_t head = __atomic_load_n(&q->head,__ATOMIC_ACQUIRE), tail, offset, next_head;
+  struct chanblock *block = __atomic_load_n(&q->head_block,__ATOMIC_ACQUIRE), *next;
+  struct chanslot *slot;
+  for(;;) {
+    offset = (head >> CHAN_SHIFT) % CHAN_LAP;
+    if (offset == CHAN_BLOCK_CAP) { //another receiver is moving head to the next block
+      _chan_snooze();
+      head = __atomic_load_n(&q->head,__ATOMIC_ACQUIRE);
+      block = __atomic_load_n(&q->head_block,__ATOMIC_ACQUIRE);
+      continue;
+    }
+    next_head = head + (1 << CHAN_SHIFT);
+    if (!(next_head & CHAN_MARK)) { //head and tail may be in the same block, check for empty
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      tail = __atomic_load_n(&q->tail,__ATOMIC_RELAXED);
+      if (head >> CHAN_SHIFT == tail >> CHAN_SHIFT) return (tail & CHAN_MARK) ? ERR_EOF : ERR_EMPTY;
+      if ((head >> CHAN_SHIFT) / CHAN_LAP != (tail >> CHAN_SHIFT) / CHAN_LAP) next_head |= CHAN_MARK;
+    }
+    if (!block) { //first send still installing first block
+      _chan_snooze();
+      head = __atomic_load_n(&q->head,__ATOMIC_ACQUIRE);
+      block = __atomic_load_n(&q->head_block,__ATOMIC_ACQUIRE);
+      continue;
+    }
+    if (__atomic_compare_exchange_n(&q->head,&head,next_head,1,__ATOMIC_SEQ_CST,__ATOMIC_ACQUIRE)) {
+      if (offset + 1 == CHAN_BLOCK_CAP) { //we took the last slot -- move head to the next block
+        while (!(next = __atomic_load_n(&block->next,__ATOMIC_ACQUIRE))) _chan_snooze();
+        size_t next_index = (next_head & ~(size_t)CHAN_MARK) + (1 << CHAN_SHIFT);
+        if (__atomic_load_n(&next->next,__ATOMIC_RELAXED)) next_index |= CHAN_MARK;
+        __atomic_store_n(&q->head_block,next,__ATOMIC_RELEASE);
+        __atomic_store_n(&q->head,next_index,__ATOMIC_RELEASE);
+      }
+      slot = &block->slots[offset];
+      while (!(__atomic_load_n(&slot->stamp,__ATOMIC_ACQUIRE) & CHAN_WRITE)) _chan_snooze();
+      *val = slot->val;
+      if (offset + 1 == CHAN_BLOCK_CAP) {
+        _block_destroy(block,0);
+      } else if (__atomic_fetch_or(&slot->stamp,CHAN_READ,__ATOMIC_ACQ_REL) & CHAN_DESTROY) {
+        _block_destroy(block,offset + 1);
+      }
+      return 0;
+    }
+    block = __atomic_load_n(&q->head_block,__ATOMIC_ACQUIRE);
+  }
+}
+
+static err_t _chan_trysend(struct chanbuf *q, val_t val) {
+  err_t e;
+  if ((e = q->cap ? _ring_trysend(q,val) : _list_send(q,val))) return e;
+  _chan_notify(&q->recv_seq,&q->recv_wait);
+  return 0;
+}
+static err_t _chan_tryrecv(struct chanbuf *q, val_t *val) {
+  err_t e;
+  if ((e = q->cap ? _ring_tryrecv(q,val) : _list_tryrecv(q,val))) return e;
+  if (q->cap) _chan_notify(&q->send_seq,&q->send_wait);
+  return 0;
+}
+
+err_t val_chan_init(val_t *val, unsigned int cap) {
+  valstruct_t *v;
+  struct chanbuf *q;
+  size_t i, mark_bit = 1;
+  if (cap) while (mark_bit < (size_t)cap + 1) mark_bit <<= 1;
+  if (!(q = aligned_alloc(64,(sizeof(struct chanbuf) + sizeof(struct chanslot)*cap + 63) & ~(size_t)63))) return _throw(ERR_MALLOC);
+  if (!(v = _valstruct_alloc())) {
+    free(q);
+    return _throw(ERR_MALLOC);
+  }
+  q->head = q->tail = 0;
+  q->head_block = q->tail_block = NULL;
+  q->recv_seq = q->recv_wait = q->send_seq = q->send_wait = 0;
+  q->cap = cap;
+  q->mark_bit = mark_bit;
+  q->one_lap = mark_bit*2;
+  for(i = 0; i < cap; ++i) {
+    q->slots[i].stamp = i;
+    val_clear(&q->slots[i].val);
+  }
+  v->type = TYPE_CHAN;
+  v->v.chan.q = q;
+  v->v.chan.refcount = 1;
+  *val = __chan_val(v);
+  return 0;
+}
+
+err_t _val_chan_send(valstruct_t *chan, val_t val) {
+  struct chanbuf *q = chan->v.chan.q;
+  unsigned int s;
+  err_t e;
+  //receiver gets its own copy of list buffers (same as thread stacks, see FIXME on op_thread)
+  if (val_is_lst(val) && (e = _val_lst_deref(__lst_ptr(val)))) return e;
+  ANNOTATE_HAPPENS_BEFORE(q);
+  for(;;) {
+    if (ERR_EMPTY != (e = _chan_trysend(q,val))) return e;
+    //full -- sleep until a receiver makes room (rechecking after we register so we can't miss the wake)
+    __atomic_add_fetch(&q->send_wait,1,__ATOMIC_SEQ_CST);
+    s = __atomic_load_n(&q->send_seq,__ATOMIC_SEQ_CST);
+    if (ERR_EMPTY == (e = _chan_trysend(q,val))) futex_wait(&q->send_seq,s);
+    __atomic_sub_fetch(&q->send_wait,1,__ATOMIC_SEQ_CST);
+    if (e != ERR_EMPTY) return e;
+  }
+}
+
+err_t _val_chan_tryrecv(valstruct_t *chan, val_t *val) {
+  err_t e;
+  if (!(e = _chan_tryrecv(chan->v.chan.q,val))) ANNOTATE_HAPPENS_AFTER(chan->v.chan.q);
+  return e;
+}
+
+err_t _val_chan_recv(valstruct_t *chan, val_t *val) {
+  struct chanbuf *q = chan->v.chan.q;
+  unsigned int s;
+  err_t e;
+  for(;;) {
+    if (ERR_EMPTY != (e = _chan_tryrecv(q,val))) break;
+    __atomic_add_fetch(&q->recv_wait,1,__ATOMIC_SEQ_CST);
+    s = __atomic_load_n(&q->recv_seq,__ATOMIC_SEQ_CST);
+    if (ERR_EMPTY == (e = _chan_tryrecv(q,val))) futex_wait(&q->recv_seq,s);
+    __atomic_sub_fetch(&q->recv_wait,1,__ATOMIC_SEQ_CST);
+    if (e != ERR_EMPTY) break;
+  }
+  if (!e) ANNOTATE_HAPPENS_AFTER(q);
+  return e;
+}
+
+err_t _val_chan_close(valstruct_t *chan) {
+  struct chanbuf *q = chan->v.chan.q;
+  __atomic_fetch_or(&q->tail,q->cap ? q->mark_bit : CHAN_MARK,__ATOMIC_SEQ_CST);
+  //wake everyone so blocked senders throw and blocked receivers drain and see EOF
+  __atomic_add_fetch(&q->recv_seq,1,__ATOMIC_SEQ_CST);
+  __atomic_add_fetch(&q->send_seq,1,__ATOMIC_SEQ_CST);
+  futex_wake(&q->recv_seq,INT_MAX);
+  futex_wake(&q->send_seq,INT_MAX);
+  return 0;
+}
+
+err_t _val_chan_clone(val_t *ret, valstruct_t *orig) {
+  *ret = __chan_val(orig);
+  refcount_inc(orig->v.chan.refcount);
+  return 0;
+}
+
+void _val_chan_destroy(valstruct_t *chan) {
+  if (0 == refcount_dec(chan->v.chan.refcount)) {
+    struct chanbuf *q = chan->v.chan.q;
+    size_t head,tail;
+    ANNOTATE_HAPPENS_AFTER(chan);
+    ANNOTATE_HAPPENS_BEFORE_FORGET_ALL(chan);
+    //last reference -- destroy any vals still in the channel
+    if (q->cap) {
+      head = q->head;
+      tail = q->tail & ~q->mark_bit;
+      while (head != tail) {
+        size_t index = head & (q->mark_bit - 1);
+        val_destroy(q->slots[index].val);
+        head = index + 1 < q->cap ? head + 1 : (head & ~(q->one_lap - 1)) + q->one_lap;
+      }
+    } else {
+      struct chanblock *block = q->head_block, *next;
+      head = q->head & ~(size_t)CHAN_MARK;
+      tail = q->tail & ~(size_t)CHAN_MARK;
+      while (head != tail) {
+        size_t offset = (head >> CHAN_SHIFT) % CHAN_LAP;
+        if (offset < CHAN_BLOCK_CAP) {
+          val_destroy(block->slots[offset].val);
+        } else {
+          next = block->next;
+          free(block);
+          block = next;
+        }
+        head += 1 << CHAN_SHIFT;
+      }
+      free(block);
+    }
+    free(q);
+    _valstruct_release(chan);
+  } else {
+    ANNOTATE_HAPPENS_BEFORE(chan);
+  }
+}
+
+static int _val_chan_snprint(valstruct_t *chan, char *buf, size_t n) {
+  struct chanbuf *q = chan->v.chan.q;
+  int closed = 0 != (__atomic_load_n(&q->tail,__ATOMIC_RELAXED) & (q->cap ? q->mark_bit : CHAN_MARK));
+  if (q->cap) return snprintf(buf,n,"chan(%zu%s)",q->cap,closed ? " closed" : "");
+  else return snprintf(buf,n,"chan(%s)",closed ? "closed" : "");
+}
+
+int val_chan_fprintf(valstruct_t *chan, FILE *file, const fmt_t *fmt) {
+  char buf[64];
+  _val_chan_snprint(chan,buf,sizeof(buf));
+  return val_fprint_cstr(file,buf);
+}
+int val_chan_sprintf(valstruct_t *chan, valstruct_t *buf, const fmt_t *fmt) {
+  char cbuf[64];
+  _val_chan_snprint(chan,cbuf,sizeof(cbuf));
+  return val_sprint_cstr(buf,cbuf);
+}
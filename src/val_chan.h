@@ -0,0 +1,39 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef __VAL_CHAN_H__
+#define __VAL_CHAN_H__ 1
+
+#include "val.h"
+
+// chan - lock-free multi-producer multi-consumer channel for passing vals between threads
+// - bounded channels are a ring buffer (sends block while full), unbounded channels are a linked list of blocks
+// - send/recv never take a lock, threads only sleep (on a futex) when the channel is empty (or full)
+// - close marks the channel closed: sends then throw ERR_CLOSED, and recv drains what's left before returning ERR_EOF
+// - clones share the channel (like ref), and sent vals are owned by the channel until received
+
+err_t val_chan_init(val_t *val, unsigned int cap); //new channel holding up to cap vals (cap=0 for unbounded)
+
+err_t _val_chan_send(valstruct_t *chan, val_t val); //send val (channel takes it on success), blocks while full
+err_t _val_chan_recv(valstruct_t *chan, val_t *val); //receive next val, blocks while empty
+err_t _val_chan_tryrecv(valstruct_t *chan, val_t *val); //receive next val, or ERR_EMPTY if none ready
+err_t _val_chan_close(valstruct_t *chan);
+
+err_t _val_chan_clone(val_t *ret, valstruct_t *orig);
+void _val_chan_destroy(valstruct_t *chan);
+
+int val_chan_fprintf(valstruct_t *v,FILE *file, const struct printf_fmt *fmt);
+int val_chan_sprintf(valstruct_t *v,valstruct_t *buf, const struct printf_fmt *fmt);
+
+#endif
@@ -15,6 +15,7 @@
 #include "val_dict.h"
 #include "val_hash.h"
 #include "val_string.h"
+#include "val_list.h"
 #include "val_printf.h"
 #include "val.h"
 #include "helpers.h"
@@ -23,12 +24,17 @@
 #include <stdlib.h>
 
 //TODO: validate the dictionary refcount managment and scoping semantics
-//TODO: make dict threadsafe (or ensure we deep copy when we could break threadsafety)
 //TODO: evaluate dict code structure
 //  - we currently preserve valstruct_t pointers to fit with other type implementations
 //  - the means a lot more data movement required on push/pop
 //  - faster implementation might be swapping valstruct ptr on push/pop -- but then need more unique cases in other code
 
+//dictionary generation counter
+// - every dict state gets a unique generation (clones share gen, since they share hashtables until written)
+// - ident lookup caches (see _val_dict_get_ident) are only valid while the dict gen matches
+static uint64_t _dict_gen = 0;
+#define _dict_newgen(d) ((d)->v.dict.gen = __sync_add_and_fetch(&_dict_gen,1))
+
 void _val_dict_destroy_(valstruct_t *dict) {
   //VM_DEBUG_VAL_DESTROY(dict);
   if (dict->v.dict.next) {
@@ -41,23 +47,38 @@ err_t _val_dict_init(valstruct_t *dict) {
   if (!(dict->v.dict.h = alloc_hashtable())) return _throw(ERR_MALLOC);
   dict->type = TYPE_DICT;
   dict->v.dict.next = NULL;
+  _dict_newgen(dict);
   return 0;
 }
 err_t _val_dict_clone(val_t *ret, valstruct_t *orig) {
-  //*ret = __dict_val(orig);
-  //refcount_inc(orig->v.dict.h->refcount);
   valstruct_t *v;
+  err_t e;
   if (!(v = _valstruct_alloc())) return _throw(ERR_MALLOC);
-  *v = *orig;
-  refcount_inc(orig->v.dict.h->refcount);
-  if (orig->v.dict.next) refcount_inc(orig->v.dict.next->v.dict.h->refcount);
+  if ((e = _val_dict_clone_(v,orig))) { _valstruct_release(v); return e; }
   *ret = __dict_val(v);
   return 0;
 }
-void _val_dict_clone_(valstruct_t *ret, valstruct_t *orig) { //FIXME: bug here -- also contains ref to next, will end up double-releasing next
+err_t _val_dict_clone_(valstruct_t *ret, valstruct_t *orig) {
+  //hashtables are shared by ref, but each scope valstruct is owned by one dict (destroy releases the whole chain)
+  valstruct_t *next;
+  err_t e;
   *ret = *orig;
   refcount_inc(orig->v.dict.h->refcount);
-  if (orig->v.dict.next) refcount_inc(orig->v.dict.next->v.dict.h->refcount);
+  if (orig->v.dict.next) {
+    if (!(next = _valstruct_alloc())) { e = _throw(ERR_MALLOC); goto out_h; }
+    if ((e = _val_dict_clone_(next,orig->v.dict.next))) { _valstruct_release(next); goto out_h; }
+    ret->v.dict.next = next;
+  }
+  return 0;
+out_h:
+  release_hashtable(ret->v.dict.h);
+  return e;
+}
+err_t _val_dict_init_scope(valstruct_t *dict, valstruct_t *parent) {
+  err_t e;
+  if ((e = _val_dict_clone_(dict,parent))) return e;
+  if ((e = _val_dict_newscope(dict))) { _val_dict_destroy_(dict); return e; }
+  return 0;
 }
 
 err_t _val_dict_deref(valstruct_t *dict) {
@@ -66,6 +87,7 @@ err_t _val_dict_deref(valstruct_t *dict) {
   if ((e = hash_clone(&h,dict->v.dict.h))) return e;
   release_hashtable(dict->v.dict.h);
   dict->v.dict.h = h;
+  _dict_newgen(dict); //new table, so cached lookups are stale
   return 0;
 }
 
@@ -78,6 +100,7 @@ err_t _val_dict_newscope(valstruct_t *dict) {
   if (!(h = alloc_hashtable())) goto out_parent;
   dict->v.dict.next = parent;
   dict->v.dict.h = h;
+  _dict_newgen(dict);
   return 0;
 out_parent:
   _valstruct_release(parent);
@@ -97,6 +120,8 @@ void _val_dict_popscope(valstruct_t *dict, val_t *scope) {
 
   n->v.dict.h = h;
   n->v.dict.next=NULL;
+  _dict_newgen(n);
+  _dict_newgen(dict);
 
   *scope = __dict_val(n);
 }
@@ -107,38 +132,72 @@ void _val_dict_dropscope(valstruct_t *dict) {
   release_hashtable(dict->v.dict.h);
   dict->v.dict = n->v.dict;
   _valstruct_release(n);
+  _dict_newgen(dict);
 }
 
 void _val_dict_pushscope(valstruct_t *dict, valstruct_t *scope) {
+  //scope takes over the old top table (and the rest of the chain, so pop/dropscope get it back), dict gets scope table
   struct hashtable *h = scope->v.dict.h;
   scope->v.dict.h = dict->v.dict.h;
+  scope->v.dict.next = dict->v.dict.next;
   dict->v.dict.h = h;
   dict->v.dict.next = scope;
+  _dict_newgen(scope);
+  _dict_newgen(dict);
 }
 
 val_t _val_dict_get(valstruct_t *dict, valstruct_t *key) {
+  uint32_t khash = _val_str_hash32_cached(key);
   for(;dict; dict=dict->v.dict.next) {
-    val_t ret = hash_get(dict->v.dict.h,key);
+    val_t ret = hash_geth(dict->v.dict.h,key,khash);
     if (!val_is_null(ret)) return ret;
   }
   return VAL_NULL;
 }
 
+val_t _val_dict_get_ident(valstruct_t *dict, valstruct_t *ident) {
+  //hash first -- this drops the lookup cache if ident has changed since we cached it
+  uint32_t khash = _val_str_hash32_cached(ident);
+  uint64_t gen = dict->v.dict.gen;
+  uint32_t seq = __atomic_load_n(&ident->v.str.lseq,__ATOMIC_ACQUIRE);
+  val_t ret;
+  if (!(seq & 1) && ident->v.str.lgen == gen) {
+    ret = ident->v.str.lval;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&ident->v.str.lseq,__ATOMIC_RELAXED) == seq) return ret;
+  }
+
+  for(ret = VAL_NULL; dict; dict=dict->v.dict.next) {
+    ret = hash_geth(dict->v.dict.h,ident,khash);
+    if (!val_is_null(ret)) break;
+  }
+
+  //cache def (unless another thread is writing the cache right now, then we just skip it)
+  if (!val_is_null(ret) && !(seq & 1) && __atomic_compare_exchange_n(&ident->v.str.lseq,&seq,seq+1,0,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED)) {
+    ident->v.str.lgen = gen;
+    ident->v.str.lval = ret;
+    __atomic_store_n(&ident->v.str.lseq,seq+2,__ATOMIC_RELEASE);
+  }
+  return ret;
+}
+
 int _val_dict_put(valstruct_t *dict, valstruct_t *key, val_t val) {
-  if (dict->v.dict.h->refcount>1) {
+  if (!refcount_singleton(dict->v.dict.h->refcount)) {
     err_t e;
     if ((e = _val_dict_deref(dict))) return e;
   }
+  _dict_newgen(dict);
   return hash_put(dict->v.dict.h,key,val,1);
 }
 
 int _val_dict_put_(valstruct_t *dict, const char *key, unsigned int klen, val_t val) {
-  if (dict->v.dict.h->refcount>1) {
+  if (!refcount_singleton(dict->v.dict.h->refcount)) {
     err_t e;
     if ((e = _val_dict_deref(dict))) return e;
   }
   int r;
   val_t keystr;
+  _dict_newgen(dict);
   if ((r = val_ident_init_cstr(&keystr,key,klen))) return r;
   r = hash_put(dict->v.dict.h,__str_ptr(keystr),val,1);
   if (r <= 0) { val_destroy(keystr); }
@@ -147,8 +206,9 @@ int _val_dict_put_(valstruct_t *dict, const char *key, unsigned int klen, val_t
 
 err_t _val_dict_swap(valstruct_t *dict, valstruct_t *key, val_t *val) {
   val_t *def;
-  if (dict->v.dict.h->refcount==1 && NULL!=(def = _hash_get(dict->v.dict.h,key))) {
+  if (refcount_singleton(dict->v.dict.h->refcount) && NULL!=(def = _hash_get_mut(dict->v.dict.h,key))) {
     val_swap(def,val);
+    _dict_newgen(dict);
     return 0;
   } else {
     for(dict=dict->v.dict.next;dict; dict=dict->v.dict.next) {
@@ -161,6 +221,25 @@ err_t _val_dict_swap(valstruct_t *dict, valstruct_t *key, val_t *val) {
   }
 }
 
+static int _val_dict_keys_visit(struct hashentry *e, void *arg) {
+  valstruct_t *k;
+  err_t r;
+  if (!(k = _valstruct_alloc())) return _throw(ERR_MALLOC);
+  _val_str_clone(k,&e->k);
+  if ((r = _val_lst_rpush(arg,__str_val(k)))) val_destroy(__str_val(k));
+  return r;
+}
+err_t _val_dict_keys(valstruct_t *dict, val_t *keys) {
+  err_t e;
+  *keys = val_empty_list();
+  if (0>(e = hash_visit(dict->v.dict.h,_val_dict_keys_visit,__lst_ptr(*keys)))) {
+    val_destroy(*keys);
+    *keys = VAL_NULL;
+    return e;
+  }
+  return 0;
+}
+
 int val_dict_fprintf(valstruct_t *v,FILE *file, const struct printf_fmt *fmt) {
   return val_fprint_cstr(file,"{DICT}"); //TODO: IMPLEMENTME
 }
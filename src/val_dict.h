@@ -20,7 +20,7 @@
 #include "val.h"
 
 // NOTES:
-// - copy-on-write - cloning dict just adds ref, writing to dict creates full clone
+// - copy-on-write - cloning dict just adds ref, writing to a shared dict only copies the hashtable nodes on the path to the key (see val_hash.h)
 // - scoped - child dictionaries write to current layer, and read through to parent/next when key not found
 //   - dict keeps next pointer to parent dict
 // - built on top of val_hash hashtable implementation
@@ -30,9 +30,10 @@
 //
 //   Management:
 //   - init    - create new dictionary
-//   - clone   - clone dictionary (just adds reference)
+//   - clone   - clone dictionary (just adds references to the hashtables of each scope)
+//   - init_scope - create new dictionary as an empty child scope of (a clone of) parent
 //   - destroy - destroy dictionary (and free resources)
-//   - deref   - clones underlying hashtable and releases old so dict has sole ownership
+//   - deref   - clones underlying hashtable (O(1), nodes stay shared) and releases old so dict has sole ownership
 //   
 //   Scoping:
 //   - newscope  - creates new dictionary layer (scope) to isolate writes (current dict then refers to child)
@@ -43,6 +44,7 @@
 //
 //   Read/Write:
 //   - get  - lookup key and get value in current/parent dict, or NULL if not found (NOTE: value is NOT cloned)
+//   - get_ident - like get, but caches the def in the key valstruct (skips hashing and scope walk until dict changes)
 //   - put  - write key-value pair into dict
 //   - put_ - like put but takes char pointer and length (automatically creates val to hold key string)
 //   - swap - swap value in dict (if in parent scope, clones instead of swaps)
@@ -51,7 +53,8 @@
 void _val_dict_destroy_(valstruct_t *dict);
 err_t _val_dict_init(valstruct_t *dict);
 err_t _val_dict_clone(val_t *ret, valstruct_t *orig);
-void _val_dict_clone_(valstruct_t *ret, valstruct_t *orig);
+err_t _val_dict_clone_(valstruct_t *ret, valstruct_t *orig);
+err_t _val_dict_init_scope(valstruct_t *dict, valstruct_t *parent);
 err_t _val_dict_deref(valstruct_t *dict);
 
 err_t _val_dict_newscope(valstruct_t *dict);
@@ -61,9 +64,14 @@ void _val_dict_dropscope(valstruct_t *dict);
 void _val_dict_pushscope(valstruct_t *dict, valstruct_t *scope);
 
 val_t _val_dict_get(valstruct_t *dict, valstruct_t *key);
+//get with lookup cache -- caches def in ident (see str_t), valid until dict gen changes (put/scope ops)
+val_t _val_dict_get_ident(valstruct_t *dict, valstruct_t *ident);
 int _val_dict_put(valstruct_t *dict, valstruct_t *key, val_t val);
 int _val_dict_put_(valstruct_t *dict, const char *key, unsigned int klen, val_t val);
 
+//list of the keys defined in the dict's own (innermost) scope, in hash order
+err_t _val_dict_keys(valstruct_t *dict, val_t *keys);
+
 //swap val out of dict -- only actually swaps when def is in dict->h, otherwise clones
 err_t _val_dict_swap(valstruct_t *dict, valstruct_t *key, val_t *val);
 
@@ -29,12 +29,13 @@
 #include "val_fd.h"
 #include "val_num.h"
 #include "val_fd_internal.h"
+#include "val_rbuf.h"
 #include "val_string.h"
 #include "val_printf.h"
+#include "vm_parser.h"
 //#include "val_math.h"
 #include "helpers.h"
 
-//FIXME: threadsafe fd IO
 
 valstruct_t _val_fd_stdin = {
   .type = TYPE_FD,
@@ -108,6 +109,8 @@ err_t val_fd_init_socket(val_t *val, int domain, int type, int protocol) {
 #endif
     v->v.fd.flags = FD_DOCLOSE;
     v->v.fd.refcount = 1;
+    _rbuf_init(&v->v.fd.rbuf);
+    v->v.fd.parse = NULL;
     *val = __fd_val(v);
     return 0;
   }
@@ -152,6 +155,8 @@ err_t _val_fd_accept(valstruct_t *f, val_t *conn, struct sockaddr* addr, socklen
 #endif
     v->v.fd.flags = FD_DOCLOSE;
     v->v.fd.refcount = 1;
+    _rbuf_init(&v->v.fd.rbuf);
+    v->v.fd.parse = NULL;
     *conn = __fd_val(v);
     return 0;
   }
@@ -189,6 +194,8 @@ err_t val_fd_open(val_t *val, const char *fname, int flags, mode_t mode) {
 #endif
     v->v.fd.flags = FD_DOCLOSE;
     v->v.fd.refcount = 1;
+    _rbuf_init(&v->v.fd.rbuf);
+    v->v.fd.parse = NULL;
     *val = __fd_val(v);
     return 0;
   }
@@ -215,6 +222,11 @@ void _val_fd_destroy(valstruct_t *f) {
     //f->v.fd.fname = (char*)9;
 #endif
     if (f->v.fd.flags & FD_DOCLOSE) close(f->v.fd.fd);
+    _rbuf_destroy(&f->v.fd.rbuf);
+    if (f->v.fd.parse) {
+      vm_parse_code_state_destroy(f->v.fd.parse);
+      free(f->v.fd.parse);
+    }
     _valstruct_release(f);
   }
 }
@@ -259,19 +271,18 @@ int _val_fd_fd(valstruct_t *fd) {
 
 //TODO: we need a way to tag vals with the fd and line number they came from in debug mode
 int _val_fd_readline(valstruct_t *f, valstruct_t *buf) {
-  //FIXME: handle case where line is longer than FD_BUF
-  int n;
-  err_t e;
-  if(0>(n = _val_fd_readline_(f,FD_BUF,FD_BUFLEN))) return n;
-  if ((e = _val_str_rreserve(buf,n))) return e;
-
-  _val_str_cat_cstr(buf,FD_BUF,n);
-  return n;
+  return _rbuf_readline(&f->v.fd.rbuf,f->v.fd.fd,buf);
+}
+int _val_fd_readchunk(valstruct_t *f, valstruct_t *buf) {
+  return _rbuf_readchunk(&f->v.fd.rbuf,f->v.fd.fd,buf);
+}
+void _val_fd_unread(valstruct_t *f, unsigned int n) {
+  _rbuf_unread(&f->v.fd.rbuf,n);
 }
 int _val_fd_read(valstruct_t *f, valstruct_t *buf, int nbytes) {
   int r;
   if ((r = _val_str_rreserve(buf,nbytes))) return r;
-  if (0>(r = _val_fd_read_(f,_val_str_end(buf),FD_BUFLEN))) return r;
+  if (0>(r = _val_fd_read_(f,_val_str_end(buf),nbytes))) return r;
 
   buf->v.str.len += r;
   return r;
@@ -283,7 +294,9 @@ int _val_fd_write(valstruct_t *f, valstruct_t *buf) {
 //whence: SEEK_SET, SEEK_CURE, SEEK_END (from stdio.h)
 //TODO: handle files over 4GB (32bit)
 err_t _val_fd_seek(valstruct_t *f, long offset, int whence) {
-  if ((0 != lseek(f->v.fd.fd,offset,whence))) {
+  if (whence == SEEK_CUR) offset -= _rbuf_pending(&f->v.fd.rbuf); //relative to what we've read, not what's buffered
+  _rbuf_discard(&f->v.fd.rbuf);
+  if ((-1 == lseek(f->v.fd.fd,offset,whence))) {
     //TODO: process errno
     return ERR_IO_ERROR;
   } else return 0;
@@ -291,7 +304,8 @@ err_t _val_fd_seek(valstruct_t *f, long offset, int whence) {
 }
 
 long _val_fd_pos(valstruct_t *f) {
-  return lseek(f->v.fd.fd,0,SEEK_CUR); //TODO: handle errors
+  off_t pos = lseek(f->v.fd.fd,0,SEEK_CUR); //TODO: handle errors
+  return pos < 0 ? pos : pos - _rbuf_pending(&f->v.fd.rbuf);
   //alternatively: long pos; if ((0 != fgetpos(f->v.fd.fd,&pos))) { return ERR_IO_ERROR; } else return pos;
 }
 
@@ -306,28 +320,17 @@ err_t _val_fd_close(valstruct_t *f) {
 }
 
 int _val_fd_readline_(valstruct_t *f, char *buffer, int buflen) {
-  return _throw(ERR_NOT_IMPLEMENTED);
-  //if (NULL == fgets(buffer,buflen,f->v.fd.fd)) {
-  //  //if (errno == 0) return ERR_EOF;
-  //  //else return _throw(ERR_IO_ERROR);
-  //  if (feof(f->v.fd.fd)) return ERR_EOF;
-  //  else return _throw(ERR_IO_ERROR);
-  //}
-  //int len = strlen(buffer);
-  //return len;
+  return _rbuf_readline_(&f->v.fd.rbuf,f->v.fd.fd,buffer,buflen);
 }
 int _val_fd_read_(valstruct_t *f, char *buffer, int nbytes) {
-  ssize_t n = read(f->v.fd.fd,buffer,nbytes);
-  if (n == -1) {
-    return _throw(ERR_IO_ERROR);
-  } else if (n == 0) {
-    return ERR_EOF;
-  } else {
-    return (int)n;
-  }
+  return _rbuf_read(&f->v.fd.rbuf,f->v.fd.fd,buffer,nbytes);
 }
 int _val_fd_write_(valstruct_t *f, const char *buffer, int nbytes) {
-  ssize_t n = write(f->v.fd.fd,buffer,nbytes);
+  ssize_t n;
+  unsigned int pending;
+  //write where reading left off (sockets/pipes can't seek, and their reads and writes are separate streams anyway)
+  if ((pending = _rbuf_pending(&f->v.fd.rbuf)) && 0<=lseek(f->v.fd.fd,-(off_t)pending,SEEK_CUR)) _rbuf_discard(&f->v.fd.rbuf);
+  n = write(f->v.fd.fd,buffer,nbytes);
   if (n == -1) {
     return _throw(ERR_IO_ERROR);
   } else {
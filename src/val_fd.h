@@ -24,10 +24,7 @@
 //FIXME: document fd val interface
 
 
-//TODO: come up with buffer/block manager for files
-//TODO: support threadsafe file io
-#define FD_BUFLEN 500
-char FD_BUF[FD_BUFLEN];
+//reads go through a per-fd read buffer (see val_rbuf.h), so fds can be read from any thread
 
 extern valstruct_t _val_fd_stdin;
 extern valstruct_t _val_fd_stdout;
@@ -63,6 +60,8 @@ FILE* _val_fd_f(valstruct_t *fd);
 int _val_fd_close(valstruct_t *f);
 
 int _val_fd_readline(valstruct_t *f, valstruct_t *buf);
+int _val_fd_readchunk(valstruct_t *f, valstruct_t *buf); //everything buffered (or the next read), for streaming parses
+void _val_fd_unread(valstruct_t *f, unsigned int n); //give back the tail of the last read (see _rbuf_unread)
 int _val_fd_read(valstruct_t *f, valstruct_t *buf, int nbytes);
 int _val_fd_write(valstruct_t *f, valstruct_t *buf);
 
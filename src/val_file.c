@@ -24,12 +24,14 @@
 #include "vm_err.h"
 #include "val_file.h"
 #include "val_file_internal.h"
+#include "val_rbuf.h"
 #include "val_string.h"
 #include "val_printf.h"
+#include "vm_debug.h"
+#include "vm_parser.h"
 //#include "val_math.h"
 #include "helpers.h"
 
-//FIXME: threadsafe file IO
 
 valstruct_t _val_file_stdin = {
   .type = TYPE_FILE,
@@ -114,11 +116,41 @@ int val_file_init(val_t *val, const char *fname, const char *mode) {
 #endif
     v->v.file.flags = DOCLOSE;
     v->v.file.refcount = 1;
+    _rbuf_init(&v->v.file.rbuf);
+    v->v.file.parse = NULL;
     *val = __file_val(v);
     return 0;
   }
 }
 
+int val_file_map(val_t *val, const char *fname) {
+  struct stat st;
+  sbuf_t *buf = NULL;
+  valstruct_t *v;
+  int fd;
+  if (0>(fd = open(fname,O_RDONLY))) return _throw(ERR_IO_ERROR);
+  if (fstat(fd,&st) || !S_ISREG(st.st_mode) || st.st_size > (off_t)(~0u & ~SBUF_MAPPED)) {
+    close(fd);
+    return _throw(ERR_IO_ERROR);
+  }
+  if (st.st_size && !(buf = _sbuf_mmap(fd,(unsigned int)st.st_size))) {
+    close(fd);
+    return _throw(ERR_IO_ERROR);
+  }
+  close(fd); //mapping stays valid after close
+  if (!(v = _valstruct_alloc())) {
+    if (buf) _sbuf_release(buf);
+    return _throw(ERR_MALLOC);
+  }
+  v->type = TYPE_STRING;
+  v->v.str.buf = buf;
+  v->v.str.off = 0;
+  v->v.str.len = (buf ? buf->size : 0);
+  _val_str_clearcache(v);
+  *val = __str_val(v);
+  VM_DEBUG_VAL_INIT(val);
+  return 0;
+}
 
 int val_file_print(val_t val) {
 #ifdef DEBUG_FILENAME
@@ -136,6 +168,11 @@ void _val_file_destroy(valstruct_t *f) {
     //f->v.file.fname = (char*)9;
 #endif
     if (f->v.file.flags & DOCLOSE) fclose(f->v.file.f);
+    _rbuf_destroy(&f->v.file.rbuf);
+    if (f->v.file.parse) {
+      vm_parse_code_state_destroy(f->v.file.parse);
+      free(f->v.file.parse);
+    }
     _valstruct_release(f);
   }
 }
@@ -180,19 +217,18 @@ FILE* _val_file_f(valstruct_t *file) {
 
 //TODO: we need a way to tag vals with the file and line number they came from in debug mode
 int _val_file_readline(valstruct_t *f, valstruct_t *buf) {
-  //FIXME: handle case where line is longer than FILE_BUF
-  int n;
-  err_t e;
-  if(0>(n = _val_file_readline_(f,FILE_BUF,FILE_BUFLEN))) return n;
-  if ((e = _val_str_rreserve(buf,n))) return e;
-
-  _val_str_cat_cstr(buf,FILE_BUF,n);
-  return n;
+  return _rbuf_readline(&f->v.file.rbuf,fileno(f->v.file.f),buf);
+}
+int _val_file_readchunk(valstruct_t *f, valstruct_t *buf) {
+  return _rbuf_readchunk(&f->v.file.rbuf,fileno(f->v.file.f),buf);
+}
+void _val_file_unread(valstruct_t *f, unsigned int n) {
+  _rbuf_unread(&f->v.file.rbuf,n);
 }
 int _val_file_read(valstruct_t *f, valstruct_t *buf, int nbytes) {
   int r;
   if ((r = _val_str_rreserve(buf,nbytes))) return r;
-  if (0>(r = _val_file_read_(f,_val_str_end(buf),FILE_BUFLEN))) return r;
+  if (0>(r = _val_file_read_(f,_val_str_end(buf),nbytes))) return r;
 
   buf->v.str.len += r;
   return r;
@@ -204,6 +240,13 @@ int _val_file_write(valstruct_t *f, valstruct_t *buf) {
 //whence: SEEK_SET, SEEK_CURE, SEEK_END (from stdio.h)
 //TODO: handle files over 4GB (32bit)
 err_t _val_file_seek(valstruct_t *f, long offset, int whence) {
+  if (whence == SEEK_CUR) { //relative to what we've read (stdio doesn't know about rbuf reads)
+    long pos;
+    if (0>(pos = _val_file_pos(f))) return ERR_IO_ERROR;
+    offset += pos;
+    whence = SEEK_SET;
+  }
+  _rbuf_discard(&f->v.file.rbuf);
   if ((0 != fseek(f->v.file.f,offset,whence))) {
     //TODO: process errno
     return ERR_IO_ERROR;
@@ -211,8 +254,12 @@ err_t _val_file_seek(valstruct_t *f, long offset, int whence) {
   //alternatively (with only SEEK_SET support): fsetpos(f->v.file.f,offset)
 }
 
+//reads bypass stdio (see val_rbuf.h), so we ask the fd where we are (after flushing writes) and back up over unread bytes
 long _val_file_pos(valstruct_t *f) {
-  return ftell(f->v.file.f); //TODO: handle errors
+  off_t pos;
+  fflush(f->v.file.f);
+  if (0>(pos = lseek(fileno(f->v.file.f),0,SEEK_CUR))) return -1; //TODO: handle errors
+  return (long)pos - _rbuf_pending(&f->v.file.rbuf);
   //alternatively: long pos; if ((0 != fgetpos(f->v.file.f,&pos))) { return ERR_IO_ERROR; } else return pos;
 }
 
@@ -227,26 +274,18 @@ err_t _val_file_close(valstruct_t *f) {
 }
 
 int _val_file_readline_(valstruct_t *f, char *buffer, int buflen) {
-  if (NULL == fgets(buffer,buflen,f->v.file.f)) {
-    //if (errno == 0) return ERR_EOF;
-    //else return _throw(ERR_IO_ERROR);
-    if (feof(f->v.file.f)) return ERR_EOF;
-    else return _throw(ERR_IO_ERROR);
-  }
-  int len = strlen(buffer);
-  return len;
+  return _rbuf_readline_(&f->v.file.rbuf,fileno(f->v.file.f),buffer,buflen);
 }
 int _val_file_read_(valstruct_t *f, char *buffer, int nbytes) {
-  ssize_t n = fread(buffer,1,nbytes,f->v.file.f);
-  if (n == 0) {
-    if (feof(f->v.file.f)) return ERR_EOF;
-    else return _throw(ERR_IO_ERROR);
-  } else {
-    return (int)n;
-  }
+  return _rbuf_read(&f->v.file.rbuf,fileno(f->v.file.f),buffer,nbytes);
 }
 int _val_file_write_(valstruct_t *f, const char *buffer, int nbytes) {
-  ssize_t n = fwrite(buffer, 1,nbytes,f->v.file.f);
+  ssize_t n;
+  long pos;
+  if (_rbuf_pending(&f->v.file.rbuf) && 0<=(pos = _val_file_pos(f)) && 0 == fseek(f->v.file.f,pos,SEEK_SET)) { //write where reading left off
+    _rbuf_discard(&f->v.file.rbuf);
+  }
+  n = fwrite(buffer, 1,nbytes,f->v.file.f);
   if (!n) {
     if (feof(f->v.file.f)) return _throw(ERR_EOF);
     else if (ferror(f->v.file.f)) return _throw(ERR_IO_ERROR);
@@ -22,10 +22,7 @@
 
 //FIXME: document file val interface
 
-//TODO: come up with buffer/block manager for files
-//TODO: support threadsafe file io
-#define FILE_BUFLEN 500
-char FILE_BUF[FILE_BUFLEN];
+//reads go through a per-file read buffer (see val_rbuf.h), so files can be read from any thread
 
 extern valstruct_t _val_file_stdin;
 extern valstruct_t _val_file_stdout;
@@ -44,6 +41,11 @@ valstruct_t * _val_file_stderr_ref();
 
 int val_file_init(val_t *val, const char *fname, const char *mode);
 
+//map whole file read-only as a string val (no copy -- substr/splitn/find/rest all return views into the mapping)
+// - writes to the string (or its views) copy out first, and the mapping goes away with the last view
+// - the file shouldn't be truncated while mapped (reading past the new end raises SIGBUS)
+int val_file_map(val_t *val, const char *fname);
+
 int val_file_print(val_t val);
 void _val_file_destroy(valstruct_t *f);
 err_t _val_file_clone(val_t *ret, valstruct_t *orig);
@@ -59,6 +61,8 @@ int _val_file_close(valstruct_t *f);
 
 int _val_file_readline(valstruct_t *f, valstruct_t *buf);
 int _val_file_read(valstruct_t *f, valstruct_t *buf, int nbytes);
+int _val_file_readchunk(valstruct_t *f, valstruct_t *buf); //everything buffered (or the next read), for streaming parses
+void _val_file_unread(valstruct_t *f, unsigned int n); //give back the tail of the last read (see _rbuf_unread)
 int _val_file_write(valstruct_t *f, valstruct_t *buf);
 
 err_t _val_file_seek(valstruct_t *f, long offset, int whence);
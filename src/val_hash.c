@@ -15,22 +15,140 @@
 #include "val_hash.h"
 #include "val_hash_internal.h"
 #include "val_string.h"
-#include "defpool.h"
 #include "helpers.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <valgrind/helgrind.h>
 
-inline unsigned int hash_bucket(const uint32_t khash, const unsigned int nbuckets) { return khash & (nbuckets-1); } //currently assumes nbuckets is a power of 2
-//inline unsigned int hash_bucket(const uint32_t khash, const unsigned int nbuckets) { return khash % nbuckets; } //doesn't assume nbuckets is a power of 2
+//key hashes are FNV-1, where the last byte only touches the low bits, so we mix before indexing (otherwise k1,k2,... would all share the first few levels)
+static inline uint32_t _hash_mix(uint32_t khash) { khash ^= khash>>16; khash *= 0x45d9f3bu; khash ^= khash>>16; return khash; }
+
+#define _hash_frag(mh,shift) (((mh)>>(shift)) & (HASH_FANOUT-1))
+#define _hash_collision(shift) ((shift) >= 32) //used up all hash bits
+#define _node_pos(map,bit) __builtin_popcount((map) & ((bit)-1))
+#define _node_nchildren(nd) __builtin_popcount((nd)->nodemap)
+#define _node_children(nd) ((struct hashnode**)((nd)->entries + (nd)->n))
+#define _node_size(n,nc) (sizeof(struct hashnode) + (n)*sizeof(struct hashentry) + (nc)*sizeof(struct hashnode*))
+
+static struct hashnode* _node_alloc(unsigned int n, unsigned int nc) {
+  struct hashnode *nd;
+  if (!(nd = malloc(_node_size(n,nc)))) return NULL;
+  nd->refcount = 1;
+  nd->datamap = nd->nodemap = 0;
+  nd->n = n;
+  return nd;
+}
+
+static void _node_release(struct hashnode *nd) {
+  if (0 == (refcount_dec(nd->refcount))) {
+    ANNOTATE_HAPPENS_AFTER(nd);
+    ANNOTATE_HAPPENS_BEFORE_FORGET_ALL(nd);
+    unsigned int i, nc = _node_nchildren(nd);
+    for(i=0;i<nd->n;++i) _hashentry_dispose(&nd->entries[i]);
+    for(i=0;i<nc;++i) _node_release(_node_children(nd)[i]);
+    free(nd);
+  } else {
+    ANNOTATE_HAPPENS_BEFORE(nd);
+  }
+}
+
+//free node (and child nodes) whose entries were moved out
+static void _node_free_moved(struct hashnode *nd) {
+  unsigned int i, nc = _node_nchildren(nd);
+  for(i=0;i<nc;++i) _node_free_moved(_node_children(nd)[i]);
+  free(nd);
+}
+
+//make sure we own *ndp before writing to it -- if shared, replace our ref with a copy
+static err_t _node_own(struct hashnode **ndp) {
+  struct hashnode *nd = *ndp, *c;
+  unsigned int i, nc;
+  err_t e;
+  if (refcount_singleton(nd->refcount)) return 0;
+  nc = _node_nchildren(nd);
+  if (!(c = _node_alloc(nd->n,nc))) return _throw(ERR_MALLOC);
+  c->datamap = nd->datamap;
+  c->nodemap = nd->nodemap;
+  for(i=0;i<nd->n;++i) {
+    if ((e = val_clone(&c->entries[i].v,nd->entries[i].v))) {
+      while(i--) _hashentry_dispose(&c->entries[i]);
+      free(c);
+      return e;
+    }
+    _val_str_clone(&c->entries[i].k,&nd->entries[i].k);
+    c->entries[i].khash = nd->entries[i].khash;
+  }
+  for(i=0;i<nc;++i) {
+    _node_children(c)[i] = _node_children(nd)[i];
+    refcount_inc(_node_children(c)[i]->refcount);
+  }
+  _node_release(nd);
+  *ndp = c;
+  return 0;
+}
+
+//insert entry at pos in owned node (bit is 0 for collision nodes)
+static err_t _node_insert(struct hashnode **ndp, unsigned int pos, uint32_t bit, struct hashentry *e) {
+  struct hashnode *nd = *ndp;
+  unsigned int nc = _node_nchildren(nd);
+  if (!(nd = realloc(nd,_node_size(nd->n+1,nc)))) return _throw(ERR_MALLOC);
+  memmove(nd->entries+nd->n+1,nd->entries+nd->n,nc*sizeof(struct hashnode*));
+  memmove(nd->entries+pos+1,nd->entries+pos,(nd->n-pos)*sizeof(struct hashentry));
+  nd->entries[pos] = *e;
+  nd->n++;
+  nd->datamap |= bit;
+  *ndp = nd;
+  return 0;
+}
+
+//remove entry at pos from owned node (entry must already be disposed or moved)
+static void _node_remove(struct hashnode *nd, unsigned int pos, uint32_t bit) {
+  unsigned int nc = _node_nchildren(nd);
+  memmove(nd->entries+pos,nd->entries+pos+1,(nd->n-pos-1)*sizeof(struct hashentry));
+  memmove(nd->entries+nd->n-1,nd->entries+nd->n,nc*sizeof(struct hashnode*));
+  nd->n--;
+  nd->datamap &= ~bit;
+}
+
+//replace entry at pos in owned node with child (entry moved into child), in place since node only shrinks
+static void _node_split(struct hashnode *nd, unsigned int pos, uint32_t bit, struct hashnode *child) {
+  unsigned int cpos;
+  _node_remove(nd,pos,bit);
+  nd->nodemap |= bit;
+  cpos = _node_pos(nd->nodemap,bit);
+  memmove(_node_children(nd)+cpos+1,_node_children(nd)+cpos,(_node_nchildren(nd)-1-cpos)*sizeof(struct hashnode*));
+  _node_children(nd)[cpos] = child;
+}
+
+//new node (or chain of nodes, while the hashes agree) holding both entries (moved, not cloned)
+static struct hashnode* _node_pair(struct hashentry *a, struct hashentry *b, unsigned int shift) {
+  struct hashnode *nd, *c;
+  if (_hash_collision(shift)) {
+    if (!(nd = _node_alloc(2,0))) return NULL;
+    nd->entries[0] = *a;
+    nd->entries[1] = *b;
+    return nd;
+  }
+  uint32_t fa = _hash_frag(_hash_mix(a->khash),shift), fb = _hash_frag(_hash_mix(b->khash),shift);
+  if (fa != fb) {
+    if (!(nd = _node_alloc(2,0))) return NULL;
+    nd->datamap = (1u<<fa) | (1u<<fb);
+    nd->entries[fa>fb] = *a;
+    nd->entries[fa<fb] = *b;
+  } else {
+    if (!(c = _node_pair(a,b,shift+HASH_BITS))) return NULL;
+    if (!(nd = _node_alloc(0,1))) { _node_free_moved(c); return NULL; }
+    nd->nodemap = 1u<<fa;
+    _node_children(nd)[0] = c;
+  }
+  return nd;
+}
 
 struct hashtable* alloc_hashtable() {
-  unsigned int nbuckets = DEFAULT_HASH_BUCKETS;
   struct hashtable *h;
-  if (!(h = malloc(sizeof(struct hashtable) + (sizeof(struct hashentry*) * nbuckets)))) return NULL;
-  memset(h->buckets,0,sizeof(struct hashentry*) * nbuckets); //zero bucket pointers
-  h->nbuckets = nbuckets;
+  if (!(h = malloc(sizeof(struct hashtable)))) return NULL;
+  if (!(h->root = _node_alloc(0,0))) { free(h); return NULL; }
   h->refcount=1;
   h->size = 0;
   return h;
@@ -39,10 +157,7 @@ void release_hashtable(struct hashtable *h) {
   if (0 == (refcount_dec(h->refcount))) {
     ANNOTATE_HAPPENS_AFTER(h);
     ANNOTATE_HAPPENS_BEFORE_FORGET_ALL(h);
-    unsigned int i;
-    for(i=0;i<h->nbuckets;++i) {
-      _hashchain_dispose(h->buckets[i]);
-    }
+    _node_release(h->root);
     free(h);
   } else {
     ANNOTATE_HAPPENS_BEFORE(h);
@@ -50,225 +165,141 @@ void release_hashtable(struct hashtable *h) {
 }
 
 err_t hash_clone(struct hashtable **ret, struct hashtable *orig) {
-  *ret = alloc_hashtable();
-  unsigned int i;
-  struct hashentry *e;
-  for(i=0;i<orig->nbuckets;++i) {
-    if ((e = orig->buckets[i])) {
-      struct hashentry *re;
-      if (!(re = alloc_hashentry_clone(&e->k,e->v,e->khash,NULL))) goto err_malloc;
-      (*ret)->buckets[i] = re;
-      for(e=e->next; e; e=e->next) {
-        if (!(re->next = alloc_hashentry_clone(&e->k,e->v,e->khash,NULL))) goto err_malloc;
-        re = re->next;
-      }
-    }
-  }
+  //just share the root -- nodes get copied as either table writes to them
+  struct hashtable *h;
+  if (!(h = malloc(sizeof(struct hashtable)))) return _throw(ERR_MALLOC);
+  h->root = orig->root;
+  refcount_inc(h->root->refcount);
+  h->size = orig->size;
+  h->refcount = 1;
+  *ret = h;
   return 0;
-err_malloc:
-  return _throw(ERR_MALLOC);
 }
 
-
-
-//we use a pool for hashentries, since we tend to need a lot of these when we need a few, and good-practice is that you aren't freeing many of these anyways
-//TODO: needs a threadsafe / thread-local pool allocator
-//DEFINE_SIMPLE_POOL(struct hashentry,4096,_hashentry_alloc,_hashentry_free)
-DEFINE_NO_POOL(struct hashentry,4096,_hashentry_alloc,_hashentry_free)
-
-void _hashentry_release(struct hashentry *e) {
+void _hashentry_dispose(struct hashentry *e) {
   _val_str_destroy_(&e->k);
   val_destroy(e->v);
-  _hashentry_free(e);
-}
-void _hashchain_dispose(struct hashentry *e) {
-  while(e) { //loop through entries, freeing each one
-    struct hashentry *n=e->next;
-    _hashentry_release(e);
-    e=n;
-  }
 }
 
-struct hashentry* alloc_hashentry(valstruct_t *key, val_t value, uint32_t khash, struct hashentry *next) {
+static struct hashentry* _hash_find(struct hashtable *h, valstruct_t *key, uint32_t khash) {
+  struct hashnode *nd = h->root;
+  uint32_t mh = _hash_mix(khash), bit;
+  unsigned int shift, i;
   struct hashentry *e;
-  if (!(e = _hashentry_alloc())) return NULL;
-  e->next  = next;
-  e->khash = khash;
-  e->k     = *key;
-  _valstruct_release(key);
-  e->v     = value;
-  return e;
-}
-
-struct hashentry* alloc_hashentry_clone(valstruct_t *key, val_t value, uint32_t khash, struct hashentry *next) {
-  struct hashentry *e;
-  if (!(e = _hashentry_alloc())) return NULL;
-  val_t vcln;
-  int r;
-  _val_str_clone(&e->k,key);
-  if ((r = val_clone(&vcln,value))) goto out_kentry;
-  e->next  = next;
-  e->khash = khash;
-  e->v     = vcln;
-  return e;
-out_kentry:
-  _val_str_destroy_(&e->k);
-  _hashentry_free(e);
+  for(shift=0; !_hash_collision(shift); shift+=HASH_BITS) {
+    bit = 1u<<_hash_frag(mh,shift);
+    if (nd->datamap & bit) {
+      e = &nd->entries[_node_pos(nd->datamap,bit)];
+      return (e->khash==khash && _val_str_eq(key,&e->k)) ? e : NULL;
+    } else if (nd->nodemap & bit) {
+      nd = _node_children(nd)[_node_pos(nd->nodemap,bit)];
+    } else {
+      return NULL;
+    }
+  }
+  for(i=0;i<nd->n;++i) {
+    if (nd->entries[i].khash==khash && _val_str_eq(key,&nd->entries[i].k)) return &nd->entries[i];
+  }
   return NULL;
 }
 
-
 val_t hash_get(struct hashtable *h, valstruct_t *key) {
-  uint32_t khash=_val_str_hash32(key);
-  struct hashentry *e;
-  for (e = h->buckets[hash_bucket(khash,h->nbuckets)]; e; e=e->next) { //loop through bucket list
-    if (e->khash==khash && _val_str_eq(key,&e->k)) { //found it
-      return e->v;
-    } else if (khash<e->khash || (e->khash==khash && _val_str_compare(key,&e->k)<0)) { //past it. search failed
-      break;
-    }
-  }
-  return VAL_NULL;
+  return hash_geth(h,key,_val_str_hash32_cached(key));
+}
+val_t hash_geth(struct hashtable *h, valstruct_t *key, uint32_t khash) {
+  struct hashentry *e = _hash_find(h,key,khash);
+  return e ? e->v : VAL_NULL;
 }
 val_t* _hash_get(struct hashtable *h, valstruct_t *key) {
-  uint32_t khash=_val_str_hash32(key);
+  struct hashentry *e = _hash_find(h,key,_val_str_hash32_cached(key));
+  return e ? &e->v : NULL;
+}
+val_t* _hash_get_mut(struct hashtable *h, valstruct_t *key) {
+  uint32_t khash = _val_str_hash32_cached(key), mh = _hash_mix(khash), bit;
+  struct hashnode **ndp = &h->root, *nd;
+  unsigned int shift, i;
   struct hashentry *e;
-  for (e = h->buckets[hash_bucket(khash,h->nbuckets)]; e; e=e->next) { //loop through bucket list
-    if (e->khash==khash && _val_str_eq(key,&e->k)) { //found it
+  if (!_hash_find(h,key,khash)) return NULL; //so we don't copy nodes for a miss
+  for(shift=0;; shift+=HASH_BITS) {
+    if (_node_own(ndp)) return NULL;
+    nd = *ndp;
+    if (_hash_collision(shift)) break;
+    bit = 1u<<_hash_frag(mh,shift);
+    if (nd->datamap & bit) {
+      e = &nd->entries[_node_pos(nd->datamap,bit)];
       return &e->v;
-    } else if (khash<e->khash || (e->khash==khash && _val_str_compare(key,&e->k)<0)) { //past it. search failed
-      break;
     }
+    ndp = &_node_children(nd)[_node_pos(nd->nodemap,bit)];
   }
-  return NULL;
-}
-
-val_t hash_get_(struct hashtable *h, const char *key, unsigned int len) {
-  uint32_t khash=_val_cstr_hash32(key,len);
-  struct hashentry *e;
-  for (e = h->buckets[hash_bucket(khash,h->nbuckets)]; e; e=e->next) { //loop through bucket list
-    if (e->khash==khash && !_val_str_cstr_compare(&e->k,key,len)) { //found it
-      return e->v;
-    } else if (khash<e->khash || (e->khash==khash && _val_str_cstr_compare(&e->k,key,len)>0)) { //past it. search failed
-      break;
-    }
+  for(i=0;i<nd->n;++i) {
+    if (nd->entries[i].khash==khash && _val_str_eq(key,&nd->entries[i].k)) return &nd->entries[i].v;
   }
-  return VAL_NULL;
+  return NULL;
 }
 
 int hash_put(struct hashtable *h, valstruct_t *key, val_t value, int overwrite) {
-  uint32_t khash=_val_str_hash32(key);
-  struct hashentry *e;
-  e = h->buckets[hash_bucket(khash,h->nbuckets)];
+  uint32_t khash=_val_str_hash32_cached(key), mh = _hash_mix(khash), bit=0;
+  struct hashnode **ndp = &h->root, *nd, *c;
+  struct hashentry *e, ne;
+  unsigned int shift, pos;
+  err_t r;
+  if ((e = _hash_find(h,key,khash)) && !overwrite) return 0;
 
-  if (!e || khash<e->khash || (khash==e->khash && _val_str_compare(key,&e->k) < 0)) { //no bucket list in this table, or our key goes first
-    struct hashentry *t;
-    if (!(t = alloc_hashentry(key,value,khash,e))) return -1;
-    h->buckets[hash_bucket(khash,h->nbuckets)] = t;
-    h->size++;
-    return 1;
-  } else if (e->khash==khash && _val_str_eq(key,&e->k)) { //found key at head of list
-    if (!overwrite) return 0;
-    _val_str_destroy(key);
-    val_destroy(e->v);
-    e->v = value;
-    return 2;
-  } else { //else, search for key in list
-    for(; e; e=e->next) { //scan bucket entries
-      if (e->next && e->next->khash==khash && _val_str_eq(key,&e->next->k)) { //found it
-        if (!overwrite) return 0;
-        _val_str_destroy(key);
-        val_destroy(e->next->v);
-        e->next->v = value;
-        return 2;
-      } else if (!e->next || khash<e->next->khash || (e->next->khash==khash && _val_str_compare(key,&e->next->k)<0)) { //past it (or this is the tail of the list). insert here
-        //now insert our k,v pair
-        struct hashentry *t;
-        if (!(t = alloc_hashentry(key,value,khash,e->next))) return -1;
-        e->next = t;
-        h->size++;
-        return 1;
+  for(shift=0;; shift+=HASH_BITS) {
+    if ((r = _node_own(ndp))) return r;
+    nd = *ndp;
+    if (_hash_collision(shift)) {
+      for(pos=0;pos<nd->n;++pos) {
+        if (nd->entries[pos].khash==khash && _val_str_eq(key,&nd->entries[pos].k)) { e = &nd->entries[pos]; goto replace; }
       }
+      bit = 0;
+      goto insert;
     }
-    return -1;
-  }
-}
-
-int hash_put_copy(struct hashtable *h, valstruct_t *key, val_t value, int overwrite) {
-  uint32_t khash=_val_str_hash32(key);
-  struct hashentry *e;
-  int r;
-  e = h->buckets[hash_bucket(khash,h->nbuckets)];
-
-  if (!e || khash<e->khash || (khash==e->khash && _val_str_compare(key,&e->k) < 0)) { //no bucket list in this table, or our key goes first
-    struct hashentry *t;
-    if (!(t = alloc_hashentry_clone(key,value,khash,e))) return -1;
-    h->buckets[hash_bucket(khash,h->nbuckets)] = t;
-    h->size++;
-    return 1;
-  } else if (e->khash==khash && _val_str_eq(key,&e->k)) { //found key at head of list
-    if (!overwrite) return 0;
-    val_destroy(e->v);
-    if ((r = val_clone(&e->v,value))) return r;
-    return 2;
-  } else { //else, search for key in list
-    for(; e; e=e->next) { //scan bucket entries
-      if (e->next && e->next->khash==khash && _val_str_eq(key,&e->next->k)) { //found it
-        if (!overwrite) return 0;
-        val_destroy(e->next->v);
-        if ((r = val_clone(&e->next->v,value))) return r;
-        return 2;
-      } else if (!e->next || khash<e->next->khash || (e->next->khash==khash && _val_str_compare(key,&e->next->k)<0)) { //past it (or this is the tail of the list). insert here
-        //now insert our k,v pair
-        struct hashentry *t;
-        if (!(t = alloc_hashentry_clone(key,value,khash,e->next))) return -1;
-        e->next = t;
-        h->size++;
-        return 1;
-      }
+    bit = 1u<<_hash_frag(mh,shift);
+    if (nd->datamap & bit) {
+      pos = _node_pos(nd->datamap,bit);
+      e = &nd->entries[pos];
+      if (e->khash==khash && _val_str_eq(key,&e->k)) goto replace;
+      //slot taken by another key -- push both down into a new child
+      ne.khash = khash; ne.v = value; ne.k = *key;
+      if (!(c = _node_pair(e,&ne,shift+HASH_BITS))) return _throw(ERR_MALLOC);
+      _node_split(nd,pos,bit,c);
+      goto inserted;
+    } else if (nd->nodemap & bit) {
+      ndp = &_node_children(nd)[_node_pos(nd->nodemap,bit)];
+    } else {
+      pos = _node_pos(nd->datamap,bit);
+      goto insert;
     }
-    return -1;
   }
-}
 
-int hash_delete(struct hashtable *h, valstruct_t *key) {
-  if (!h) return -1;
-  uint32_t khash=_val_str_hash32(key);
-  struct hashentry *e;
-
-  e = h->buckets[hash_bucket(khash,h->nbuckets)];
-  if (!e) { //no bucket list in this table
-    return 0;
-  } else if (e->khash==khash && _val_str_eq(key,&e->k)) { //found key at head of list
-    h->buckets[hash_bucket(khash,h->nbuckets)] = e->next;
-    h->size--;
-    _hashentry_release(e);
-    return 1;
-  } else { //else, search for key in list
-    for(; e->next; e=e->next) { //scan bucket entries
-      if (e->next->khash==khash && _val_str_eq(key,&e->next->k)) { //found it
-        struct hashentry *t=e->next;
-        e->next=t->next;
-        h->size--;
-        _hashentry_release(t);
-        return 1;
-      } else if (khash<e->next->khash || (e->next->khash==khash && _val_str_compare(key,&e->next->k)<0)) { //past it. move on to parent scope
-        break;
-      }
-    }
-  }
+insert:
+  ne.khash = khash; ne.v = value; ne.k = *key;
+  if ((r = _node_insert(ndp,pos,bit,&ne))) return r;
+inserted:
+  _valstruct_release(key);
+  h->size++;
+  return 1;
 
-  return 0;
+replace:
+  _val_str_destroy(key);
+  val_destroy(e->v);
+  e->v = value;
+  return 2;
 }
 
-int hash_visit(struct hashtable *h, hash_visitor *visit, void *arg) {
-  unsigned int i;
-  struct hashentry *e;
+
+static int _node_visit(struct hashnode *nd, hash_visitor *visit, void *arg) {
+  unsigned int i, nc = _node_nchildren(nd);
   int r=0;
-  for(i=0;i<h->nbuckets;++i) {
-    for(e=h->buckets[i]; e; e=e->next) {
-      if ((r=visit(e,arg)) < 0) return r;
-    }
+  for(i=0;i<nd->n;++i) {
+    if ((r=visit(&nd->entries[i],arg)) < 0) return r;
+  }
+  for(i=0;i<nc;++i) {
+    if ((r=_node_visit(_node_children(nd)[i],visit,arg)) < 0) return r;
   }
   return r;
 }
+int hash_visit(struct hashtable *h, hash_visitor *visit, void *arg) {
+  return _node_visit(h->root,visit,arg);
+}
@@ -35,27 +35,38 @@
 //STATIC_ASSERT(sizeof(int)==4,"code assumes 32bit integers. Update source");
 
 
-//default number of hash buckets (# hash buckets must always be power of 2, or you need to replace hash_bucket() function)
-#define DEFAULT_HASH_BUCKETS 128
-
-
-
+// persistent hashtable (hash array mapped trie, CHAMP layout)
+// - each node indexes 5 bits of the (mixed) key hash -- datamap marks slots holding an entry, nodemap slots holding a child node
+// - entries (key, val, and hash) are stored inline in the node, followed by the child node pointers
+// - below the last hash bits is a collision node (datamap/nodemap empty, n entries with the same hash)
+// - nodes are refcounted and never written while shared:
+//   - hash_clone just adds a ref to the root, so cloning is O(1)
+//   - put/delete copy each shared node on the path to the key (path copying), and only write nodes they own
+//   - so readers never need locks, even when other threads are writing clones of the same table
+
+#define HASH_BITS 5
+#define HASH_FANOUT (1<<HASH_BITS)
 
 struct hashentry {
   valstruct_t k; //key string
   val_t v; //value
   uint32_t khash; //we save the key hash to speed up hash searches
-  struct hashentry *next;
+};
+
+struct hashnode {
+  unsigned int refcount; //number of tables/parent nodes that refer to this node
+  uint32_t datamap; //bitmap of slots with entries
+  uint32_t nodemap; //bitmap of slots with child nodes
+  unsigned int n; //number of entries (popcount(datamap), except in collision nodes)
+  struct hashentry entries[]; //n entries (then popcount(nodemap) child pointers)
 };
 
 struct hashtable {
-  unsigned int nbuckets; //number of bucket pointers
   unsigned int size; //number of inserted elements
   unsigned int refcount; //number of references that exist to this ht
-  struct hashentry *buckets[]; //array of bucket pointers
+  struct hashnode *root;
 };
 
-unsigned int hash_bucket(const uint32_t khash, const unsigned int nbuckets);
 
 struct hashtable* alloc_hashtable();
 void release_hashtable(struct hashtable *h);
@@ -65,16 +76,16 @@ err_t hash_clone(struct hashtable **ret, struct hashtable *orig);
 typedef int (hash_visitor)(struct hashentry *e, void *arg);
 
 val_t hash_get(struct hashtable *h, valstruct_t *key);
+val_t hash_geth(struct hashtable *h, valstruct_t *key, uint32_t khash); //hash_get with precomputed key hash
 val_t* _hash_get(struct hashtable *h, valstruct_t *key);
-val_t hash_get_(struct hashtable *h, const char *key, unsigned int len);
+val_t* _hash_get_mut(struct hashtable *h, valstruct_t *key); //like _hash_get, but copies shared nodes on the path so the val can be written (NULL if not found)
 
 //returns -1 on error, 0 if key already exists and overwrite==0, 1 if inserts new item, 2 if updates existing item -- key and value both consumed when r>0 (otherwise left alone)
 int hash_put(struct hashtable *h, valstruct_t *key, val_t value, int overwrite);
-//returns -1 on error, 0 if key already exists and overwrite==0, 1 if inserts new item, 2 if updates existing item -- key and value cloned as needed
-int hash_put_copy(struct hashtable *h, valstruct_t *key, val_t value, int overwrite);
 
 
-//visits every entry in current hashtable, calling vistor visit() on every entry.
+//visits every entry in current hashtable, calling vistor visit() on every entry (visit must not put/delete).
+//  - entries are visited node by node (a node's own entries, then its children), so the order follows the key hashes
 //  - on negative return value from visit(), returns that value
 //  - if every call to func returns >= 0, in the end returns last return value from visit()
 //  - arg is passed unmodified to each call of func (to e.g. track state)
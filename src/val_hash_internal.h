@@ -16,9 +16,7 @@
 #define __VAL_HASH_INTERNAL_H__ 1
 #include "val_hash.h"
 
-void _hashchain_dispose(struct hashentry *e);
-
-struct hashentry* alloc_hashentry(valstruct_t *key, val_t value, uint32_t khash, struct hashentry *next);
-struct hashentry* alloc_hashentry_clone(valstruct_t *key, val_t value, uint32_t khash, struct hashentry *next);
+//destroy key and val of entry
+void _hashentry_dispose(struct hashentry *e);
 
 #endif
@@ -0,0 +1,183 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "val_int.h"
+#include "helpers.h"
+
+#include <stdint.h>
+#include <math.h>
+
+err_t val_int64_init(val_t *ret, int64_t i) {
+  valstruct_t *v;
+  if (i >= INT32_MIN && i <= INT32_MAX) {
+    *ret = __int_val((int32_t)i);
+  } else if (i >= VAL_INT47_MIN && i <= VAL_INT47_MAX) {
+    *ret = __int47_val(i);
+  } else {
+    if (!(v = _valstruct_alloc())) return _throw(ERR_MALLOC);
+    v->type = TYPE_INT64;
+    v->v.i64 = i;
+    *ret = __val_val(v);
+  }
+  return 0;
+}
+
+int64_t val_int64(val_t v) {
+  if (val_is_int(v)) return __val_int(v);
+  else if (val_is_int47(v)) return __val_int47(v);
+  else return __val_ptr(v)->v.i64;
+}
+
+double val_num_dbl(val_t v) {
+  if (val_is_double(v)) return __val_dbl(v);
+  else return (double)val_int64(v);
+}
+
+err_t val_int_fromdbl(val_t *ret, double f) {
+  //doubles in [-2^63,2^63) truncate to an int64 (the range check is false for NaN)
+  if (!(f >= -9223372036854775808.0 && f < 9223372036854775808.0)) return _throw(ERR_BADARGS);
+  return val_int64_init(ret,(int64_t)f);
+}
+
+//replace *v with i (reusing v's heap int64 when both are heap ints, and keeping any debug val)
+static err_t _val_int64_set(val_t *v, int64_t i) {
+  err_t e;
+  val_t t;
+  if (val_is_int64(*v)) {
+    if (i < VAL_INT47_MIN || i > VAL_INT47_MAX) {
+      __val_ptr(*v)->v.i64 = i;
+      return 0;
+    }
+    _valstruct_release(__val_ptr(*v));
+  }
+  if ((e = val_int64_init(&t,i))) return e;
+  __val_set(v,t);
+  return 0;
+}
+static void _val_dbl_set(val_t *v, double f) {
+  if (val_is_int64(*v)) _valstruct_release(__val_ptr(*v));
+  __val_set(v,__dbl_val(f));
+}
+
+err_t val_int_binop(val_t *lhs, val_t rhs, enum int_op op) {
+  err_t e;
+  int64_t a, b, r;
+  if ((!val_is_integer(*lhs) && !val_is_double(*lhs)) || (!val_is_integer(rhs) && !val_is_double(rhs))) return _throw(ERR_BADTYPE);
+
+  if (val_is_double(*lhs) || val_is_double(rhs)) {
+    double x = val_num_dbl(*lhs), y = val_num_dbl(rhs);
+    switch(op) {
+      case INT_ADD: x += y; break;
+      case INT_SUB: x -= y; break;
+      case INT_MUL: x *= y; break;
+      case INT_DIV: x /= y; break;
+      default: return _throw(ERR_BADTYPE); //no double % or bit ops
+    }
+    _val_dbl_set(lhs,x);
+    val_destroy(rhs);
+    return 0;
+  }
+
+  a = val_int64(*lhs);
+  b = val_int64(rhs);
+  switch(op) {
+    case INT_ADD:
+      if (__builtin_add_overflow(a,b,&r)) goto dbl;
+      break;
+    case INT_SUB:
+      if (__builtin_sub_overflow(a,b,&r)) goto dbl;
+      break;
+    case INT_MUL:
+      if (__builtin_mul_overflow(a,b,&r)) goto dbl;
+      break;
+    case INT_DIV:
+      if (!b) return _throw(ERR_BADARGS);
+      if (b == -1 && a == INT64_MIN) goto dbl;
+      r = a / b;
+      break;
+    case INT_MOD:
+      if (!b) return _throw(ERR_BADARGS);
+      r = (b == -1) ? 0 : a % b;
+      break;
+    case INT_AND: r = a & b; break;
+    case INT_OR: r = a | b; break;
+    case INT_XOR: r = a ^ b; break;
+    case INT_LSHIFT: //a * 2^b, so bits shifted past int64 give a double like mul
+      if (b < 0) return _throw(ERR_BADARGS);
+      if (!a) r = 0;
+      else if (b >= 63 || a > (INT64_MAX >> b) || a < (INT64_MIN >> b)) {
+        _val_dbl_set(lhs,ldexp((double)a,b < 2048 ? (int)b : 2048));
+        val_destroy(rhs);
+        return 0;
+      } else r = (int64_t)((uint64_t)a << b);
+      break;
+    case INT_RSHIFT: //arithmetic (sign extending) shift
+      if (b < 0) return _throw(ERR_BADARGS);
+      r = a >> (b < 63 ? b : 63);
+      break;
+    default:
+      return _throw(ERR_BADARGS);
+  }
+  if ((e = _val_int64_set(lhs,r))) return e;
+  val_destroy(rhs);
+  return 0;
+
+dbl: //past int64 -- fall back to double math
+  switch(op) {
+    case INT_ADD: _val_dbl_set(lhs,(double)a + (double)b); break;
+    case INT_SUB: _val_dbl_set(lhs,(double)a - (double)b); break;
+    case INT_MUL: _val_dbl_set(lhs,(double)a * (double)b); break;
+    default: _val_dbl_set(lhs,(double)a / (double)b); break;
+  }
+  val_destroy(rhs);
+  return 0;
+}
+
+err_t val_int_neg(val_t *v) {
+  int64_t i = val_int64(*v);
+  if (i == INT64_MIN) {
+    _val_dbl_set(v,-(double)i);
+    return 0;
+  }
+  return _val_int64_set(v,-i);
+}
+
+err_t val_int_not(val_t *v) {
+  return _val_int64_set(v,~val_int64(*v));
+}
+
+int val_num_cmp(val_t lhs, val_t rhs) {
+  if (val_is_double(lhs) || val_is_double(rhs)) {
+    //long double holds every int64 exactly (on x86), so mixed compares don't round the int
+    long double x = val_is_double(lhs) ? __val_dbl(lhs) : (long double)val_int64(lhs);
+    long double y = val_is_double(rhs) ? __val_dbl(rhs) : (long double)val_int64(rhs);
+    return x < y ? -1 : (x > y ? 1 : (x == y ? 0 : 2));
+  } else {
+    int64_t x = val_int64(lhs), y = val_int64(rhs);
+    return x < y ? -1 : (x > y ? 1 : 0);
+  }
+}
+
+err_t _val_int64_clone(val_t *ret, valstruct_t *orig) {
+  valstruct_t *v;
+  if (!(v = _valstruct_alloc())) return _throw(ERR_MALLOC);
+  v->type = TYPE_INT64;
+  v->v.i64 = orig->v.i64;
+  *ret = __val_val(v);
+  return 0;
+}
+
+void _val_int64_destroy(valstruct_t *v) {
+  _valstruct_release(v);
+}
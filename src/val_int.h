@@ -0,0 +1,45 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef __VAL_INT_H__
+#define __VAL_INT_H__ 1
+
+#include "val.h"
+
+// val_int - ints wider than the inline int32
+// - an int is inline int32 whenever it fits, so all the existing int32 code (and val_is_int) is unchanged
+// - math ops check int32 results for overflow (a single branch) and redo overflowed ops here in 64 bits
+// - wider values are inline int47 (own tag, no allocation) up to +-2^46, else a heap int64 valstruct
+//   - every int is kept in the narrowest form that holds it, so equal values always have the same representation
+// - int64 add/sub/mul (and lshift) that overflow give a double (like mixing ints and doubles), and divide by zero throws ERR_BADARGS
+// - bit ops take ints of any width (as 64 bit two's complement), shift counts must be >= 0
+//
+// TODO: arbitrary precision ints past int64 (bigint valstruct) if we ever need them
+
+enum int_op { INT_ADD, INT_SUB, INT_MUL, INT_DIV, INT_MOD, INT_AND, INT_OR, INT_XOR, INT_LSHIFT, INT_RSHIFT };
+
+err_t val_int64_init(val_t *ret, int64_t i); //narrowest int val for i
+int64_t val_int64(val_t v); //value of any int (int32/int47/int64)
+err_t val_int_fromdbl(val_t *ret, double f); //truncate double to int (ERR_BADARGS if out of int64 range or NaN)
+double val_num_dbl(val_t v); //int of any width or double as double
+
+err_t val_int_binop(val_t *lhs, val_t rhs, enum int_op op); //lhs = lhs op rhs for numbers where one is a wide int (or an int32 op overflowed), consumes rhs
+err_t val_int_neg(val_t *v); //negate any int (in place)
+err_t val_int_not(val_t *v); //bitwise not of any int (in place)
+int val_num_cmp(val_t lhs, val_t rhs); //-1/0/1 compare of numbers where one is a wide int (2 if unordered, i.e. NaN)
+
+err_t _val_int64_clone(val_t *ret, valstruct_t *orig);
+void _val_int64_destroy(valstruct_t *v);
+
+#endif
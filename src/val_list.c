@@ -18,6 +18,7 @@
 #include "val_printf.h"
 #include "vm_err.h"
 #include "helpers.h"
+#include "defpool.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -246,9 +247,14 @@ void _val_lst_init(valstruct_t *v, enum val_type type) {
 
 
 
+//lbufs come from size-classed pool, so size is rounded up to fill the size class
+DEFINE_DEFAULT_SIZED_POOL(65536,_lbuf_pool_alloc,_lbuf_pool_free)
+
 lbuf_t* _lbuf_alloc(unsigned int size) {
   lbuf_t *p;
-  if (!(p = malloc(sizeof(lbuf_t)+sizeof(val_t)*size))) return NULL;
+  size_t n = sizeof(lbuf_t)+sizeof(val_t)*size;
+  if (!(p = _lbuf_pool_alloc(&n))) return NULL;
+  size = (n-sizeof(lbuf_t))/sizeof(val_t);
   p->size=size;
   p->dirty=0;
   p->refcount=1;
@@ -256,6 +262,10 @@ lbuf_t* _lbuf_alloc(unsigned int size) {
   return p;
 }
 
+void _lbuf_free(lbuf_t *buf) {
+  _lbuf_pool_free(buf,sizeof(lbuf_t)+sizeof(val_t)*buf->size);
+}
+
 inline void _lst_release(valstruct_t *v) {
   if (0 == (refcount_dec(v->v.lst.buf->refcount))) {
     ANNOTATE_HAPPENS_AFTER(v);
@@ -270,12 +280,31 @@ inline void _lst_release(valstruct_t *v) {
         val_destroy(*p);
       }
     }
-    free(v->v.lst.buf);
+    _lbuf_free(v->v.lst.buf);
   } else {
     ANNOTATE_HAPPENS_BEFORE(v);
   }
 }
 
+//borrowed references have no view, so we mark the buffer dirty (every val in it may still be live) and the last release destroys them all
+void _lbuf_borrow(lbuf_t *buf) {
+  refcount_inc(buf->refcount);
+  if (!buf->dirty) buf->dirty=1;
+}
+void _lbuf_release(lbuf_t *buf) {
+  if (0 == (refcount_dec(buf->refcount))) {
+    ANNOTATE_HAPPENS_AFTER(buf);
+    ANNOTATE_HAPPENS_BEFORE_FORGET_ALL(buf);
+    val_t *p,*end;
+    for(p=buf->p,end=p+buf->size; p!=end; ++p) {
+      val_destroy(*p);
+    }
+    _lbuf_free(buf);
+  } else {
+    ANNOTATE_HAPPENS_BEFORE(buf);
+  }
+}
+
 
 val_t val_empty_list() {
   return _lstval_alloc(TYPE_LIST);
@@ -346,7 +375,7 @@ err_t _val_lst_deep_clone(valstruct_t *ret, valstruct_t *orig) {
     // - sbufs,lbufs, probably use hashtable of deep cloned buffers (keyed on orig buffer address)
     // - this same code will be used/needed for creating self-contained bytecode vals
     if ((e = val_clonen(newbuf->p,_val_lst_begin(orig),len))) {
-      free(newbuf);
+      _lbuf_free(newbuf);
       return e;
     }
     ret->v.lst.buf = newbuf;
@@ -555,9 +584,9 @@ err_t _val_lst_move(valstruct_t *lst, val_t *dst) { //moves contents of list v t
       for(p=_val_lst_end(lst),end=_val_lst_bufend(lst); p!=end; ++p) {
         val_destroy(*p);
       }
-      free(lst->v.lst.buf); //FIXME: was _lst_release
+      _lbuf_free(lst->v.lst.buf); //FIXME: was _lst_release
     } else { //clean singleton -- just free buffer
-      free(lst->v.lst.buf);
+      _lbuf_free(lst->v.lst.buf);
     }
     return 0;
   } else {
@@ -569,7 +598,7 @@ err_t _val_lst_move(valstruct_t *lst, val_t *dst) { //moves contents of list v t
 
 err_t _val_lst_deref(valstruct_t *lst) {
   //argcheck_r(val_islisttype(list));
-  if (!_val_lst_buf(lst) || _lst_singleref(lst)) {
+  if (!lst->v.lst.buf || _lst_singleref(lst)) {
     return 0;
   } else if (_val_lst_empty(lst)) {
     _lst_release(lst);
@@ -605,7 +634,7 @@ err_t _val_lst_realloc(valstruct_t *v, unsigned int left, unsigned int right) {
   err_t e;
   if (len) {
     if ((e = _val_lst_move(v, newbuf->p + left))) {
-      free(newbuf);
+      _lbuf_free(newbuf);
       return e;
     }
   }
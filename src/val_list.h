@@ -100,7 +100,10 @@ unsigned int _val_lst_size(valstruct_t *v);
 val_t _lstval_init(enum val_type type);
 
 lbuf_t* _lbuf_alloc(unsigned int size);
+void _lbuf_free(lbuf_t *buf); //free buffer (doesn't destroy vals)
 void _lst_release(valstruct_t *v);
+void _lbuf_borrow(lbuf_t *buf); //take a view-less buffer reference (borrowed code frames)
+void _lbuf_release(lbuf_t *buf); //release a _lbuf_borrow reference
 
 val_t val_empty_list();
 val_t val_empty_code();
@@ -133,6 +136,7 @@ err_t _val_lst_deref(valstruct_t *lst);
 err_t _val_lst_cleanderef(valstruct_t *lst); //deref (or clean if singleref)
 err_t _val_lst_realloc(valstruct_t *v, unsigned int left, unsigned int right);
 err_t _val_lst_cat(valstruct_t *lst, valstruct_t *suffix);
+err_t _val_lst_move(valstruct_t *lst, val_t *dst); //move contents to dst (cloning if lbuf is shared) and release lbuf (but not lst)
 err_t _val_lst_lpush(valstruct_t *lst, val_t el);
 err_t _val_lst_rpush(valstruct_t *lst, val_t el);
 err_t _val_lst_rpush2(valstruct_t *lst, val_t a, val_t b);
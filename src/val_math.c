@@ -13,6 +13,7 @@
 //limitations under the License.
 
 #include "val_math.h"
+#include "val_int.h"
 #include "helpers.h"
 #include <stdlib.h>
 #include <ctype.h> //for char classes
@@ -62,14 +63,14 @@ double mul_pow10(double val, int e) {
 //Parse a number val (could be any type)
 // - uses a switch-based state machine to parse
 err_t val_num_parse(val_t *val, const char *s, unsigned int len) {
-  //FIXME: parses digits as positive number, so can't get all the way to -2^63-1 (off by one)
   //FIXME: this currently only works for floats where the decimal digits all fit into a long int (and doesn't handle float rounding correctly)
   
 
   int state = 0;
   // 0    1          2          3       4      5    6   7    8      9      10
   //init +/-  leading_decimal digits decimal digits e  +/- digits space leading_0
-  long int digits=0;
+  unsigned long digits=0; //magnitude (so ints go all the way to -2^63)
+  unsigned long d;
   int ndigits=0;
   int sign=1;
   int exp=0;
@@ -133,11 +134,11 @@ err_t val_num_parse(val_t *val, const char *s, unsigned int len) {
         isfloat=1;
         break;
       case 3:
-        if (ndigits<18 || (ndigits==18 && (digits*10+(*p-'0'))>digits)) {
-          digits *= 10;
-          digits += (*p-'0');
+        if (!exp && !__builtin_mul_overflow(digits,10UL,&d) && !__builtin_add_overflow(d,(unsigned long)(*p-'0'),&d)
+            && d <= (unsigned long)INT64_MAX + (sign < 0)) {
+          digits = d;
           ndigits++;
-        } else {
+        } else { //past int64 -- keep the leading digits and count the rest as the exponent
           isfloat=1;
           ndigits++;
           exp++;
@@ -172,8 +173,7 @@ err_t val_num_parse(val_t *val, const char *s, unsigned int len) {
         *val = __dbl_val(sign * mul_pow10((double)digits,exp+(esign*e)));
         return 0;
       } else {
-        *val = __int_val(sign * digits);
-        return 0;
+        return val_int64_init(val,sign < 0 ? (int64_t)(0 - digits) : (int64_t)digits);
       }
     default: return ERR_BADPARSE;
   }
@@ -181,13 +181,17 @@ err_t val_num_parse(val_t *val, const char *s, unsigned int len) {
 err_t val_int_parse(val_t *val, const char *s, unsigned int len) {
   err_t e;
   if ((e = val_num_parse(val,s,len))) return e;
-  if (val_is_double(*val)) *val = __int_val((int32_t)__val_dbl(*val));
+  if (val_is_double(*val)) return val_int_fromdbl(val,__val_dbl(*val));
   return 0;
 }
 err_t val_double_parse(val_t *val, const char *s, unsigned int len) {
   err_t e;
   if ((e = val_num_parse(val,s,len))) return e;
-  if (val_is_int(*val)) *val = __dbl_val((double)__val_int(*val));
+  if (val_is_integer(*val)) {
+    double f = val_num_dbl(*val);
+    val_destroy(*val);
+    *val = __dbl_val(f);
+  }
   return 0;
 }
 
@@ -357,9 +361,8 @@ err_t val_num_hex_parse(val_t *val, const char *s, unsigned int len) {
         v *= pow(2,e);
         *val = __dbl_val(v);
       } else {
-        *val = __int_val(mant);
+        return val_int64_init(val,neg ? -mant : mant);
       }
-      return 0;
     default: return ERR_BADPARSE;
   }
 }
@@ -57,6 +57,34 @@ int val_int32_sprintf(int32_t v, valstruct_t *buf, const struct printf_fmt *fmt)
   }
 }
 
+//wide ints (see val_int.h) print like int32 (through the long formatter)
+int val_int64_fprintf(int64_t v, FILE *file, const struct printf_fmt *fmt) {
+  char conv = fmt->conversion;
+  if (conv == 'c') {
+    return fprintf(file,"%c",(int)v);
+  } else if (conv=='f' || conv=='e'||conv=='E' || conv=='g'||conv=='G' || conv=='q'||conv=='Q' || conv=='a'||conv=='A') {
+    return _val_double_fprintf((double)v,file,fmt);
+  } else {
+    int r;
+    val_t tbuf;
+    if ((r = val_string_init_empty(&tbuf))) return r;
+    if (0<=(r = val_int64_sprintf(v,__str_ptr(tbuf),fmt))) {
+      r = val_fprint_(file,_val_str_begin(__str_ptr(tbuf)),_val_str_len(__str_ptr(tbuf)));
+    }
+    val_destroy(tbuf);
+    return r;
+  }
+}
+
+int val_int64_sprintf(int64_t v, valstruct_t *buf, const struct printf_fmt *fmt) {
+  char conv = fmt->conversion;
+  if (conv=='f' || conv=='e'||conv=='E' || conv=='g'||conv=='G' || conv=='q'||conv=='Q' || conv=='a'||conv=='A') {
+    return _val_double_sprintf((double)v,buf,fmt);
+  } else {
+    return _val_long_sprintf(v,buf,fmt);
+  }
+}
+
 int val_double_fprintf(double v, FILE *file, const struct printf_fmt *fmt) {
   return _val_double_fprintf(v,file,fmt);
 }
@@ -328,6 +356,13 @@ int _val_num_dstring_sprint(valstruct_t *strbuf, char sign, char *buf, int bufle
 //int _val_long_fprintf(long val, FILE *file, const struct printf_fmt *fmt) {
 //}
 
+//digits of v in base (0 for 0) -- exact for all 64 bit values, unlike log10 on a double
+static int _val_long_ndigits(unsigned long v, unsigned int base) {
+  int n = 0;
+  for(; v; v /= base) ++n;
+  return n;
+}
+
 int _val_long_sprintf(long val, valstruct_t *buf, const struct printf_fmt *fmt) {
   int prec=fmt->precision;
   if (prec == 0 && val == 0) return 0;
@@ -342,7 +377,8 @@ int _val_long_sprintf(long val, valstruct_t *buf, const struct printf_fmt *fmt)
     }
     return 1;
   } else if (fmt->conversion=='d'||fmt->conversion=='i'||fmt->conversion=='v'||fmt->conversion=='V') {
-    int digits = floor( log10( labs( val ) ) ) + 1; //precalculate how many digits
+    unsigned long mag = val < 0 ? -(unsigned long)val : (unsigned long)val;
+    int digits = _val_long_ndigits(mag,10); //precalculate how many digits
     if (digits < prec) digits = prec;
     int thousands = (fmt->flags & PRINTF_F_SQUOTE) && digits>3;
     int chars = digits;
@@ -355,12 +391,11 @@ int _val_long_sprintf(long val, valstruct_t *buf, const struct printf_fmt *fmt)
       int r;
       char *b; //start of our reserved section
       if ((r = _val_str_rextend(buf,chars,&b))) return r;
-      long t = val;
-      char signchar = _val_num_signchar(t<0,fmt->flags);
+      unsigned long t = mag;
+      char signchar = _val_num_signchar(val<0,fmt->flags);
       if (signchar) {
         *(b++) = signchar;
       }
-      if (t<0) t=-t;
       if (thousands&&digits>3) {
         int i=chars; if (signchar) i--;
         int c=0;
@@ -379,7 +414,8 @@ int _val_long_sprintf(long val, valstruct_t *buf, const struct printf_fmt *fmt)
     }
     return chars;
   } else if (fmt->conversion=='o') { //octal
-    int digits = floor( log( labs( val ) )/log(8) ) + 1;
+    unsigned long mag = val < 0 ? -(unsigned long)val : (unsigned long)val;
+    int digits = _val_long_ndigits(mag,8);
     if (digits < prec) digits = prec;
     int chars = digits;
     if (val < 0 || (fmt->flags & (PRINTF_F_PLUS|PRINTF_F_SPACE))) chars++;
@@ -389,10 +425,9 @@ int _val_long_sprintf(long val, valstruct_t *buf, const struct printf_fmt *fmt)
       int r;
       char *b; //start of our reserved section
       if ((r = _val_str_rextend(buf,chars,&b))) return r;
-      long t = val;
+      unsigned long t = mag;
       char signchar = _val_num_signchar(val<0,fmt->flags);
       if (signchar) *(b++) = signchar;
-      if (val<0) val=-val;
 
       if(val != 0 && (fmt->flags & PRINTF_F_ALT)) *(b++) = '0'; // (#) prefix with 0 if first char not already 0
       while(digits--) {
@@ -404,7 +439,8 @@ int _val_long_sprintf(long val, valstruct_t *buf, const struct printf_fmt *fmt)
   //} else if (fmt->conversion=='u') { //unsigned decimal
   //  return _throw(ERR_BADESCAPE);
   } else if (fmt->conversion=='x'||fmt->conversion=='X') { //hex
-    int digits = floor( log( labs( val ) )/log(16) ) + 1;
+    unsigned long mag = val < 0 ? -(unsigned long)val : (unsigned long)val;
+    int digits = _val_long_ndigits(mag,16);
     if (digits < prec) digits = prec;
     int chars = digits;
     if (val < 0 || (fmt->flags & (PRINTF_F_PLUS|PRINTF_F_SPACE))) chars++;
@@ -414,10 +450,9 @@ int _val_long_sprintf(long val, valstruct_t *buf, const struct printf_fmt *fmt)
       int r;
       char *b; //start of our reserved section
       if ((r = _val_str_rextend(buf,chars,&b))) return r;
-      long t = val;
+      unsigned long t = mag;
       char signchar = _val_num_signchar(val<0,fmt->flags);
       if (signchar) *(b++) = signchar;
-      if (val<0) val=-val;
 
       if (fmt->flags & PRINTF_F_ALT) {
         *(b++) = '0';
@@ -22,6 +22,8 @@
 
 int val_int32_fprintf(int32_t v, FILE *file, const struct printf_fmt *fmt);
 int val_int32_sprintf(int32_t v, valstruct_t *buf, const struct printf_fmt *fmt);
+int val_int64_fprintf(int64_t v, FILE *file, const struct printf_fmt *fmt);
+int val_int64_sprintf(int64_t v, valstruct_t *buf, const struct printf_fmt *fmt);
 int val_double_fprintf(double v, FILE *file, const struct printf_fmt *fmt);
 int val_double_sprintf(double v, valstruct_t *buf, const struct printf_fmt *fmt);
 
@@ -0,0 +1,247 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "val_parser.h"
+#include "val_list.h"
+#include "val_string.h"
+#include "val_int.h"
+#include "val_math.h"
+#include "val_file.h"
+#include "val_printf.h"
+#include "parser.h"
+#include "helpers.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//rule op names (index is the parse_op)
+static const char *_val_parser_ops[] = { "keep", "before", "after", "skip", "acc", "digit", NULL, "err" };
+
+static int _val_parser_op(valstruct_t *name) {
+  unsigned int len = _val_str_len(name);
+  int op;
+  for(op=0;op<(int)(sizeof(_val_parser_ops)/sizeof(_val_parser_ops[0]));++op) {
+    if (_val_parser_ops[op] && strlen(_val_parser_ops[op]) == len && !strncmp(_val_parser_ops[op],_val_str_begin(name),len)) return op;
+  }
+  return -1;
+}
+
+//rule fields -- state/class/next_state are ints (-1 for all, or same state for next_state)
+#define RULE_INT(v,lo,hi) (val_is_int(v) && __val_int(v) >= (lo) && __val_int(v) < (hi))
+
+err_t val_parser_init(val_t *ret, valstruct_t *classes, valstruct_t *rules) {
+#ifdef PARSER_CLASSIFY_FN
+  return _throw(ERR_NOT_IMPLEMENTED); //parser vals classify with the table built from the class strings
+#else
+  unsigned char table[256];
+  unsigned int i, nrules = _val_lst_len(rules), nclasses = _val_lst_len(classes) + 1;
+  int s, c, nstates = 1, op;
+  uint32_t intstates = 0;
+  val_t *r;
+  state_entry_t *v;
+  struct parser_rules *p;
+  valstruct_t *parser;
+
+  //classes -- class 0 is every byte not in a class string
+  if (nclasses > 256) return _throw(ERR_BADARGS);
+  memset(table,0,sizeof(table));
+  for(i=1;i<nclasses;++i) {
+    val_t cl = _val_lst_begin(classes)[i-1];
+    unsigned int j;
+    if (!val_is_str(cl)) return _throw(ERR_BADTYPE);
+    for(j=0;j<_val_str_len(__str_ptr(cl));++j) table[(unsigned char)_val_str_begin(__str_ptr(cl))[j]] = i;
+  }
+
+  //first pass checks the rules and counts the states
+  for(i=0;i<nrules;++i) {
+    val_t rule = _val_lst_begin(rules)[i];
+    if (!val_is_lst(rule)) return _throw(ERR_BADTYPE);
+    r = _val_lst_begin(__lst_ptr(rule));
+    switch(_val_lst_len(__lst_ptr(rule))) {
+      case 2: //( state "int" )
+        if (!RULE_INT(r[0],0,31) || !val_is_str(r[1]) || _val_str_len(__str_ptr(r[1])) != 3 || strncmp(_val_str_begin(__str_ptr(r[1])),"int",3)) return _throw(ERR_BADARGS);
+        if (__val_int(r[0]) >= nstates) nstates = __val_int(r[0]) + 1;
+        break;
+      case 4: //( state class op next_state )
+        if (!RULE_INT(r[0],-1,31) || !RULE_INT(r[1],-1,(int)nclasses) || !val_is_str(r[2]) || !RULE_INT(r[3],-1,31)) return _throw(ERR_BADARGS);
+        if (0 > _val_parser_op(__str_ptr(r[2]))) return _throw(ERR_BADARGS);
+        if (__val_int(r[0]) >= nstates) nstates = __val_int(r[0]) + 1;
+        if (__val_int(r[3]) >= nstates) nstates = __val_int(r[3]) + 1;
+        break;
+      default:
+        return _throw(ERR_BADARGS);
+    }
+  }
+
+  //second pass fills the fsm (everything defaults to keep in the same state)
+  if (!(p = malloc(sizeof(struct parser_rules) + sizeof(state_entry_t)*nstates*nclasses))) return _throw(ERR_MALLOC);
+  v = (state_entry_t*)(p+1);
+  for(s=0;s<nstates;++s) for(c=0;c<(int)nclasses;++c) v[s*nclasses+c] = calc_state_entry(PARSE_NOSPLIT,s);
+  for(i=0;i<nrules;++i) {
+    r = _val_lst_begin(__lst_ptr(_val_lst_begin(rules)[i]));
+    if (_val_lst_len(__lst_ptr(_val_lst_begin(rules)[i])) == 2) {
+      intstates |= 1u << __val_int(r[0]);
+      continue;
+    }
+    op = _val_parser_op(__str_ptr(r[2]));
+    for(s=0;s<nstates;++s) {
+      if (__val_int(r[0]) >= 0 && s != __val_int(r[0])) continue;
+      for(c=0;c<(int)nclasses;++c) {
+        if (__val_int(r[1]) >= 0 && c != __val_int(r[1])) continue;
+        v[s*nclasses+c] = calc_state_entry(op,(__val_int(r[3]) < 0 ? s : __val_int(r[3])));
+      }
+    }
+  }
+  parser_rules_load(p,v,table,nstates,nclasses,0,nstates,NULL); //fin state is never a next_state, so parses run to the end of input
+
+  if (!(parser = _valstruct_alloc())) {
+    free(p);
+    return _throw(ERR_MALLOC);
+  }
+  parser->type = TYPE_PARSER;
+  parser->v.parser.rules = p;
+  parser->v.parser.intstates = intstates;
+  parser->v.parser.refcount = 1;
+  *ret = __parser_val(parser);
+  return 0;
+#endif
+}
+#undef RULE_INT
+
+//token handler state -- tokens inside src are taken as views of it, anything else (the carry) is copied
+struct _val_parser_arg {
+  valstruct_t *out;
+  uint32_t intstates;
+  struct parser_state *ps;
+  valstruct_t *src;
+  const char *begin;
+  unsigned int len;
+};
+
+//whether acc holds the value of int token tok -- every byte went through the ACC ops, and they were an optional sign then up to 18 digits (so no overflow)
+static int _val_parser_accint(const char *tok, int len, struct parser_state *ps) {
+  int i = (tok[0] == '-' || tok[0] == '+');
+  if (ps->accn != len || len == i || len - i > 18) return 0;
+  for(; i < len; ++i) {
+    if ((unsigned char)(tok[i] - '0') > 9) return 0;
+  }
+  return 1;
+}
+
+static int _val_parser_handler(const char *tok, int len, int state, int next_state, void *arg) {
+  struct _val_parser_arg *a = arg;
+  val_t t;
+  err_t e;
+  if (a->intstates & (1u << state)) {
+    if (_val_parser_accint(tok,len,a->ps)) e = val_int64_init(&t,(tok[0] == '-' ? -(int64_t)a->ps->acc : (int64_t)a->ps->acc));
+    else if (val_num_parse(&t,tok,len)) return _throw(ERR_BADPARSE); //not all acc'd digits (or too long for acc)
+    else e = 0;
+  } else if (a->src && tok >= a->begin && tok + len <= a->begin + a->len) {
+    e = _val_str_substr_clone(&t,a->src,tok - a->begin,len);
+  } else {
+    e = val_string_init_cstr(&t,tok,len);
+  }
+  if (e) return e;
+  if ((e = _val_lst_rpush(a->out,t))) val_destroy(t);
+  return e;
+}
+
+//parser_eval/feed return -1 for the err op, anything else is an err_t from the handler
+#define PARSER_RET(r) ((r) == -1 ? _throw(ERR_BADPARSE) : (err_t)(r))
+
+err_t val_parser_parse(val_t *ret, valstruct_t *parser, valstruct_t *str) {
+  struct parser_state ps;
+  struct _val_parser_arg a;
+  int r;
+  *ret = val_empty_list();
+  if (!_val_str_len(str)) return 0;
+  parser_state_init(&ps);
+  a.out = __lst_ptr(*ret);
+  a.intstates = parser->v.parser.intstates;
+  a.ps = &ps;
+  a.src = str;
+  a.begin = _val_str_begin(str);
+  a.len = _val_str_len(str);
+  r = parser_eval(parser->v.parser.rules,a.begin,a.len,&ps,_val_parser_handler,&a,NULL,NULL,_val_parser_handler,&a);
+  parser_state_destroy(&ps);
+  if (r) {
+    val_destroy(*ret);
+    *ret = VAL_NULL;
+    return PARSER_RET(r);
+  }
+  return 0;
+}
+
+err_t val_parser_parse_file(val_t *ret, valstruct_t *parser, valstruct_t *file) {
+  struct parser_state ps;
+  struct _val_parser_arg a;
+  val_t buf;
+  int n, r = 0;
+  *ret = val_empty_list();
+  parser_state_init(&ps);
+  a.out = __lst_ptr(*ret);
+  a.intstates = parser->v.parser.intstates;
+  a.ps = &ps;
+  for(;;) {
+    buf = val_empty_string(); //chunk is a view into the file's read buffer
+    if (0 > (n = _val_file_readchunk(file,__str_ptr(buf)))) {
+      val_destroy(buf);
+      a.src = NULL;
+      r = (n == ERR_EOF ? parser_finish(parser->v.parser.rules,&ps,_val_parser_handler,&a) : n);
+      break;
+    }
+    a.src = __str_ptr(buf);
+    a.begin = _val_str_begin(a.src);
+    a.len = n;
+    r = parser_feed(parser->v.parser.rules,a.begin,n,&ps,_val_parser_handler,&a);
+    val_destroy(buf);
+    if (r) break;
+  }
+  parser_state_destroy(&ps);
+  if (r) {
+    val_destroy(*ret);
+    *ret = VAL_NULL;
+    return PARSER_RET(r);
+  }
+  return 0;
+}
+#undef PARSER_RET
+
+err_t _val_parser_clone(val_t *ret, valstruct_t *orig) {
+  *ret = __parser_val(orig);
+  refcount_inc(orig->v.parser.refcount);
+  return 0;
+}
+
+void _val_parser_destroy(valstruct_t *parser) {
+  if (0 == refcount_dec(parser->v.parser.refcount)) {
+    free(parser->v.parser.rules); //entries are allocated with the rules
+    _valstruct_release(parser);
+  }
+}
+
+static int _val_parser_snprint(valstruct_t *parser, char *buf, size_t n) {
+  return snprintf(buf,n,"parser(%d states, %d classes)",parser->v.parser.rules->nstates,parser->v.parser.rules->nclasses);
+}
+
+int val_parser_fprintf(valstruct_t *parser, FILE *file, const fmt_t *fmt) {
+  char buf[64];
+  _val_parser_snprint(parser,buf,sizeof(buf));
+  return val_fprint_cstr(file,buf);
+}
+int val_parser_sprintf(valstruct_t *parser, valstruct_t *buf, const fmt_t *fmt) {
+  char cbuf[64];
+  _val_parser_snprint(parser,cbuf,sizeof(cbuf));
+  return val_sprint_cstr(buf,cbuf);
+}
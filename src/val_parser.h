@@ -0,0 +1,43 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef __VAL_PARSER_H__
+#define __VAL_PARSER_H__ 1
+
+#include "val.h"
+
+// val_parser - parser vals: fsm rulesets (see parser.h) built from concat, for tokenizing data (csv, logs, records) in C
+// - built from a list of char classes and a list of rules, then read-only (clones share the rules, so threads can share a parser)
+// - classes is a list of strings: class i (from 1) is the bytes of the ith string (a later string wins), class 0 is every other byte
+// - rules is a list of ( state class op next_state ), applied in order over the default of ( -1 -1 "keep" <same state> )
+//   - a state or class of -1 sets that rule for every state/class
+//   - op is one of "keep" "before" "after" "skip" "acc" "digit" "err" (split before/after/skip, and the ACC ops -- see enum parse_op)
+//   - ( state "int" ) marks an int state: tokens that end in it become ints (from the acc, so every char must go through acc/digit)
+// - parsing starts in state 0, and states are 5 bits in the fsm entries (so up to 31, the fin state takes the last)
+// - parse splits a string (or the rest of a file, a read buffer at a time) into a list of tokens
+//   - tokens are strings (views of the input when they don't cross a read chunk), or ints for int states
+//   - like the concat parser, empty tokens are dropped, the last token ends at the end of input, and "err" throws a parse error
+
+err_t val_parser_init(val_t *ret, valstruct_t *classes, valstruct_t *rules);
+
+err_t val_parser_parse(val_t *ret, valstruct_t *parser, valstruct_t *str); //list of tokens in str
+err_t val_parser_parse_file(val_t *ret, valstruct_t *parser, valstruct_t *file); //list of tokens in the rest of file
+
+err_t _val_parser_clone(val_t *ret, valstruct_t *orig);
+void _val_parser_destroy(valstruct_t *parser);
+
+int val_parser_fprintf(valstruct_t *parser, FILE *file, const struct printf_fmt *fmt);
+int val_parser_sprintf(valstruct_t *parser, valstruct_t *buf, const struct printf_fmt *fmt);
+
+#endif
@@ -23,6 +23,8 @@
 #include <ctype.h> //for character classes
 #include <string.h> //for strlen
 #include <stdarg.h> //for vararg
+#include <stdlib.h>
+#include <pthread.h>
 
 //standard print formats
 const fmt_t _fmt_v = {
@@ -292,7 +294,7 @@ int val_sprintf(valstruct_t *buf, const char *format, ...) {
   return r;
 }
 
-int val_vfprintf(FILE *file, const char *format, va_list args) {
+static int _val_vfprintf_parsed(FILE *file, const char *format, va_list args) {
   int r;
   int len = strlen(format);
   int rlen=0;
@@ -350,7 +352,7 @@ bad:
   return r;
 }
 
-int val_vsprintf(valstruct_t *buf, const char *format, va_list args) {
+static int _val_vsprintf_parsed(valstruct_t *buf, const char *format, va_list args) {
   int r;
   int len = strlen(format);
   int rlen=0;
@@ -407,6 +409,10 @@ bad:
   return r;
 }
 
+//compiled/cached format versions (see printf_prog below)
+static int _val_fprintfv_hashed(FILE *file, const char *format, int len, uint32_t hash, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack);
+static int _val_sprintfv_hashed(valstruct_t *buf, const char *format, int len, uint32_t hash, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack);
+
 int val_printfv(valstruct_t *format, valstruct_t *args, int isstack) {
   return val_fprintfv(stdout,format,args,isstack,args,isstack);
 }
@@ -417,14 +423,14 @@ int val_printfv_(const char *format, int len, valstruct_t *args, int isstack) {
 int val_fprintfv(FILE *file, valstruct_t *format, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
   //throw_if(ERR_BADARGS,!(format->type == TYPE_STRING) || !val_is_lst(v_args) || !val_is_lst(f_args)); //TODO: argcheck
 
-  return val_fprintfv_(file,_val_str_begin(format),_val_str_len(format),v_args,v_isstack,f_args,f_isstack);
+  return _val_fprintfv_hashed(file,_val_str_begin(format),_val_str_len(format),_val_str_hash32_cached(format),v_args,v_isstack,f_args,f_isstack);
 }
 int val_sprintfv(valstruct_t *buf, valstruct_t *format, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
   //throw_if(ERR_BADARGS,!val_isstring(format) || !val_islist(v_args) || !val_islist(f_args));
-  return val_sprintfv_(buf,_val_str_begin(format),_val_str_len(format),v_args,v_isstack,f_args,f_isstack);
+  return _val_sprintfv_hashed(buf,_val_str_begin(format),_val_str_len(format),_val_str_hash32_cached(format),v_args,v_isstack,f_args,f_isstack);
 }
 
-int val_fprintfv_(FILE *file, const char *format, int len, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
+static int _val_fprintfv_parsed(FILE *file, const char *format, int len, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
   int r;
   int rlen=0;
   int prevn = rlen;
@@ -472,7 +478,7 @@ int val_fprintfv_(FILE *file, const char *format, int len, valstruct_t *v_args,
   }
   return r;
 }
-int val_sprintfv_(valstruct_t *buf, const char *format, int len, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
+static int _val_sprintfv_parsed(valstruct_t *buf, const char *format, int len, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
   int r;
   int rlen=0;
   int prevn = rlen;
@@ -522,6 +528,271 @@ int val_sprintfv_(valstruct_t *buf, const char *format, int len, valstruct_t *v_
   return r;
 }
 
+//compiled printf formats
+// - a format string is parsed once into a printf_prog (literal runs and conversion specs), then cached per thread
+// - cache is direct-mapped on the format hash, and keyed on the format text pointer (sbuf+offset for concat strings) plus hash/len
+//   - same hash/len from a different pointer (e.g. a fresh copy of the same format) compares the text before reusing the prog
+// - formats that fail to parse aren't cached, and fall back to the _parsed functions above (so partial output and errors are unchanged)
+// - padded conversions are formatted once (into the output string, or the per-thread scratch buffer for files) then padded,
+//   instead of formatting once to measure and again to print
+
+#define PRINTF_CACHE_SIZE 32 //per-thread compiled formats (power of 2)
+
+struct printf_step {
+  fmt_t fmt; //conversion spec (ignored for literal runs)
+  const char *str; //literal run (NULL for conversion spec)
+  int len;
+  int vali, precision_arg, field_width_arg; //from _val_printf_parse
+};
+
+typedef struct printf_prog {
+  const char *key; //format text pointer we were compiled from
+  uint32_t hash;
+  int textlen;
+  char *text; //our copy of the format (literal runs and fmt.spec point into this)
+  int n;
+  struct printf_step steps[];
+} printf_prog_t;
+
+struct printf_cache {
+  printf_prog_t *progs[PRINTF_CACHE_SIZE];
+  valstruct_t *scratch; //reusable buffer for padded file conversions
+};
+
+static __thread struct printf_cache *printf_cache = NULL;
+static pthread_key_t printf_cache_key;
+static pthread_once_t printf_cache_once = PTHREAD_ONCE_INIT;
+
+static void _printf_cache_free(void *p) {
+  struct printf_cache *c = (struct printf_cache*)p;
+  int i;
+  for(i = 0; i < PRINTF_CACHE_SIZE; ++i) free(c->progs[i]);
+  val_destroy(__str_val(c->scratch));
+  free(c);
+}
+static void _printf_cache_init() {
+  pthread_key_create(&printf_cache_key,_printf_cache_free);
+}
+
+static struct printf_cache* _printf_cache() {
+  if (!printf_cache) {
+    pthread_once(&printf_cache_once,_printf_cache_init);
+    if (!(printf_cache = calloc(1,sizeof(struct printf_cache)))) return NULL;
+    printf_cache->scratch = __str_ptr(val_empty_string());
+    pthread_setspecific(printf_cache_key,printf_cache); //frees cache at thread exit
+  }
+  return printf_cache;
+}
+
+//parse format into new prog (NULL if it doesn't parse, or on malloc failure)
+static printf_prog_t* _printf_prog_compile(const char *format, int len, uint32_t hash) {
+  printf_prog_t *prog;
+  const char *f, *str;
+  int n = 0, flen = len, r, i;
+  fmt_t fmt;
+  int vali,precision_arg,field_width_arg;
+
+  //first pass counts steps (and validates the whole format)
+  f = format;
+  while(flen && 0<(r = _val_printf_parse(&f,&flen,&str,&fmt,&vali,&precision_arg,&field_width_arg))) ++n;
+  if (flen) return NULL;
+
+  if (!(prog = malloc(sizeof(printf_prog_t) + sizeof(struct printf_step)*n + len))) return NULL;
+  prog->key = format;
+  prog->hash = hash;
+  prog->textlen = len;
+  prog->text = (char*)(prog->steps + n);
+  memcpy(prog->text,format,len);
+  prog->n = n;
+
+  f = prog->text; flen = len;
+  for(i = 0; i < n; ++i) {
+    struct printf_step *step = &prog->steps[i];
+    step->len = _val_printf_parse(&f,&flen,&step->str,&step->fmt,&step->vali,&step->precision_arg,&step->field_width_arg);
+  }
+  return prog;
+}
+
+static printf_prog_t* _printf_prog_get(struct printf_cache *cache, const char *format, int len, uint32_t hash) {
+  printf_prog_t **slot, *prog;
+  if (!cache) return NULL;
+  slot = &cache->progs[hash & (PRINTF_CACHE_SIZE-1)];
+  if ((prog = *slot) && prog->hash == hash && prog->textlen == len) {
+    if (prog->key == format) return prog;
+    if (!memcmp(prog->text,format,len)) {
+      prog->key = format;
+      return prog;
+    }
+  }
+  if (!(prog = _printf_prog_compile(format,len,hash))) return NULL;
+  free(*slot);
+  *slot = prog;
+  return prog;
+}
+
+static char _printf_padc(const fmt_t *fmt) {
+  //zero left-padding (unless numeric and precision set) (see _val_fprintf_padding)
+  if (fmt->flags & PRINTF_F_ZERO && !(fmt->flags & PRINTF_F_MINUS)) {
+    switch(fmt->conversion) {
+      case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': if (fmt->precision>=0) break;
+      default: return '0';
+    }
+  }
+  return ' ';
+}
+
+//print val with padding in one pass -- to file (through scratch buffer) or appended to buf
+static int _printf_prog_val(struct printf_cache *cache, FILE *file, valstruct_t *buf, val_t val, const fmt_t *fmt) {
+  int r, pad;
+  if (fmt->field_width <= 0) {
+    return file ? val_fprintf_(val,file,fmt) : val_sprintf_(val,buf,fmt);
+  } else if (file) {
+    valstruct_t *scratch = cache->scratch;
+    _val_str_clear(scratch);
+    if (0>(r = val_sprintf_(val,scratch,fmt))) return r;
+    r = _val_str_len(scratch);
+    if (r < fmt->field_width && !(fmt->flags & PRINTF_F_MINUS)) {
+      if (0>(pad = _val_fprintf_padding(file,fmt,r,0))) return pad;
+      if (0>(r = val_fprint_(file,_val_str_begin(scratch),r))) return r;
+      return pad + r;
+    }
+    if (0>(r = val_fprint_(file,_val_str_begin(scratch),r))) return r;
+    if (0>(pad = _val_fprintf_padding(file,fmt,r,1))) return pad;
+    return r + pad;
+  } else {
+    unsigned int start = _val_str_len(buf);
+    err_t e;
+    char *p;
+    if (0>(r = val_sprintf_(val,buf,fmt))) return r;
+    r = _val_str_len(buf) - start;
+    if (r >= fmt->field_width) return r;
+    pad = fmt->field_width - r;
+    if (fmt->flags & PRINTF_F_MINUS) {
+      if ((e = _val_str_padright(buf,_printf_padc(fmt),pad))) return e;
+    } else { //left padding -- shift what we just printed over
+      if ((e = _val_str_rextend(buf,pad,&p))) return e;
+      p = _val_str_begin(buf) + start;
+      memmove(p+pad,p,r);
+      memset(p,_printf_padc(fmt),pad);
+    }
+    return fmt->field_width;
+  }
+}
+
+static int _printf_prog_run(struct printf_cache *cache, printf_prog_t *prog, FILE *file, valstruct_t *buf, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
+  int i, r = 0;
+  int rlen=0;
+  int prevn = rlen;
+  fmt_t fmt;
+  val_t *val;
+
+  for(i = 0; i < prog->n; ++i) {
+    struct printf_step *step = &prog->steps[i];
+    if (step->str) {
+      if (0>(r = file ? val_fprint_(file,step->str,step->len) : val_sprint_(buf,step->str,step->len))) return r;
+      rlen += r;
+      continue;
+    }
+    fmt = step->fmt;
+    if ((r = _val_printf_fmt_takeargs(&fmt,step->precision_arg,step->field_width_arg,f_args,f_isstack))) return r;
+
+    if ((r = _val_printf_special(&fmt,step->vali,f_args,f_isstack,rlen,&prevn))) {
+      if (r<0) return r;
+      else r=0;
+    } else if (fmt.conversion == '%') {
+      if (0>(r = file ? val_fprint_(file,"%",1) : val_sprint_(buf,"%",1))) return r;
+      rlen += r;
+    } else {
+      if ((r = _val_printf_takeval(v_args,v_isstack,step->vali,&val))) return r;
+      if (0>(r = _printf_prog_val(cache,file,buf,*val,&fmt))) {
+        int tr;
+        if (0>(tr = file ? val_fprint_(file,fmt.spec-1,fmt.speclen+1) : val_sprint_(buf,fmt.spec-1,fmt.speclen+1))) return tr; //print failed conversion spec
+        fprintf(stdout,"\nprintf conversion error for \"%.*s\"\n",fmt.speclen+1,fmt.spec-1);
+        return r;
+      }
+      rlen += r;
+      if (fmt.flags & PRINTF_F_POP) { if ((r = val_arglist_drop(v_args,v_isstack))) return r; }
+    }
+  }
+  return r;
+}
+
+//c vararg version (see _val_vfprintf_parsed)
+static int _printf_prog_vrun(struct printf_cache *cache, printf_prog_t *prog, FILE *file, valstruct_t *buf, va_list args) {
+  int i, r = 0;
+  int rlen=0;
+  int prevn = rlen;
+  fmt_t fmt;
+
+  for(i = 0; i < prog->n; ++i) {
+    struct printf_step *step = &prog->steps[i];
+    if (step->str) {
+      if (0>(r = file ? val_fprint_(file,step->str,step->len) : val_sprint_(buf,step->str,step->len))) return r;
+      rlen += r;
+      continue;
+    }
+    fmt = step->fmt;
+    throw_if(ERR_BADESCAPE,step->vali>=0 || step->precision_arg>0 || step->field_width_arg>0); //doesn't support indexed args currently
+    if (step->field_width_arg == 0) fmt.field_width = va_arg(args,int);
+    if (step->precision_arg == 0) fmt.precision = va_arg(args,int);
+    if (fmt.conversion == '_') {
+      (void)va_arg(args,val_t);
+    } else if (fmt.conversion == 'n') { //get num bytes printed so far (or since last 'n')
+      if (fmt.flags & PRINTF_F_MINUS) *va_arg(args,int*) = rlen-prevn;
+      else *va_arg(args,int*) = rlen;
+      prevn = rlen;
+    } else if (fmt.conversion == '%') {
+      if (0>(r = file ? val_fprint_(file,"%",1) : val_sprint_(buf,"%",1))) return r;
+      rlen += r;
+    } else {
+      val_t val = va_arg(args,val_t);
+      if (0>(r = _printf_prog_val(cache,file,buf,val,&fmt))) {
+        int tr;
+        if (0>(tr = file ? val_fprint_(file,fmt.spec-1,fmt.speclen+1) : val_sprint_(buf,fmt.spec-1,fmt.speclen+1))) return tr; //print failed conversion spec
+        fprintf(stderr,"\nprintf conversion error for \"%.*s\"\n",fmt.speclen+1,fmt.spec-1);
+        return r;
+      }
+      rlen += r;
+    }
+  }
+  return r;
+}
+
+int val_vfprintf(FILE *file, const char *format, va_list args) {
+  int len = strlen(format);
+  struct printf_cache *cache = _printf_cache();
+  printf_prog_t *prog = _printf_prog_get(cache,format,len,_val_cstr_hash32(format,len));
+  if (!prog) return _val_vfprintf_parsed(file,format,args);
+  return _printf_prog_vrun(cache,prog,file,NULL,args);
+}
+int val_vsprintf(valstruct_t *buf, const char *format, va_list args) {
+  int len = strlen(format);
+  struct printf_cache *cache = _printf_cache();
+  printf_prog_t *prog;
+  if (!buf || !(prog = _printf_prog_get(cache,format,len,_val_cstr_hash32(format,len)))) return _val_vsprintf_parsed(buf,format,args);
+  return _printf_prog_vrun(cache,prog,NULL,buf,args);
+}
+
+static int _val_fprintfv_hashed(FILE *file, const char *format, int len, uint32_t hash, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
+  struct printf_cache *cache = _printf_cache();
+  printf_prog_t *prog = _printf_prog_get(cache,format,len,hash);
+  if (!prog) return _val_fprintfv_parsed(file,format,len,v_args,v_isstack,f_args,f_isstack);
+  return _printf_prog_run(cache,prog,file,NULL,v_args,v_isstack,f_args,f_isstack);
+}
+static int _val_sprintfv_hashed(valstruct_t *buf, const char *format, int len, uint32_t hash, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
+  struct printf_cache *cache = _printf_cache();
+  printf_prog_t *prog;
+  if (!buf || !(prog = _printf_prog_get(cache,format,len,hash))) return _val_sprintfv_parsed(buf,format,len,v_args,v_isstack,f_args,f_isstack);
+  return _printf_prog_run(cache,prog,NULL,buf,v_args,v_isstack,f_args,f_isstack);
+}
+
+int val_fprintfv_(FILE *file, const char *format, int len, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
+  return _val_fprintfv_hashed(file,format,len,_val_cstr_hash32(format,len),v_args,v_isstack,f_args,f_isstack);
+}
+int val_sprintfv_(valstruct_t *buf, const char *format, int len, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
+  return _val_sprintfv_hashed(buf,format,len,_val_cstr_hash32(format,len),v_args,v_isstack,f_args,f_isstack);
+}
+
 //int val_sprintf_truncated_(val_t *val, val_t *buf, const fmt_t *fmt, const fmt_t *trunc_fmt) {
 //  int max_chars = trunc_fmt;
 //  if (trunc_fmt->precision==0) return 0;
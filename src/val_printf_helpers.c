@@ -23,6 +23,10 @@
 #include "val_op.h"
 #include "val_num.h"
 #include "val_vm.h"
+#include "val_chan.h"
+#include "val_vec.h"
+#include "val_parser.h"
+#include "val_bytecode.h"
 
 #include "vm_err.h"
 #include <string.h>
@@ -54,7 +58,9 @@ int val_fprintf_(val_t val, FILE *file, const struct printf_fmt *fmt) {
         case TYPE_STRING:
           r = val_string_fprintf(__string_ptr(val),file,fmt);
           break;
-        //case TYPE_BYTECODE:
+        case TYPE_BYTECODE:
+          r = val_bytecode_fprintf(__bytecode_ptr(val),file,fmt);
+          break;
         default:
           return _throw(ERR_NOT_IMPLEMENTED);
       }
@@ -80,15 +86,33 @@ int val_fprintf_(val_t val, FILE *file, const struct printf_fmt *fmt) {
         case TYPE_VM:
           r = val_vm_fprintf(__vm_ptr(val),file,fmt);
           break;
+        case TYPE_CHAN:
+          r = val_chan_fprintf(__chan_ptr(val),file,fmt);
+          break;
+        case TYPE_VEC:
+          r = val_vec_fprintf(__vec_ptr(val),file,fmt);
+          break;
+        case TYPE_PARSER:
+          r = val_parser_fprintf(__parser_ptr(val),file,fmt);
+          break;
+        case TYPE_INT64:
+          r = val_int64_fprintf(__val_ptr(val)->v.i64,file,fmt);
+          break;
         default:
           return _throw(ERR_NOT_IMPLEMENTED);
       }
       break;
+    case _FRAME_TAG: //only seen when printing raw vm state
+      r = val_fprint_cstr(file,"frame");
+      break;
     case _TAG5:
       return _fatal(ERR_BADTYPE);
     case _INT_TAG:
       r = val_int32_fprintf(__val_int(val),file,fmt);
       break;
+    case _INT47_TAG:
+      r = val_int64_fprintf(__val_int47(val),file,fmt);
+      break;
     default: //double
       r = val_double_fprintf(__val_dbl(val),file,fmt);
       break;
@@ -125,7 +149,9 @@ int val_sprintf_(val_t val, valstruct_t *buf, const struct printf_fmt *fmt) {
         case TYPE_STRING:
           r = val_string_sprintf(__string_ptr(val),buf,fmt);
           break;
-        //case TYPE_BYTECODE:
+        case TYPE_BYTECODE:
+          r = val_bytecode_sprintf(__bytecode_ptr(val),buf,fmt);
+          break;
         default:
           return _throw(ERR_NOT_IMPLEMENTED);
       }
@@ -151,16 +177,34 @@ int val_sprintf_(val_t val, valstruct_t *buf, const struct printf_fmt *fmt) {
         case TYPE_VM:
           r = val_vm_sprintf(__vm_ptr(val),buf,fmt);
           break;
+        case TYPE_CHAN:
+          r = val_chan_sprintf(__chan_ptr(val),buf,fmt);
+          break;
+        case TYPE_VEC:
+          r = val_vec_sprintf(__vec_ptr(val),buf,fmt);
+          break;
+        case TYPE_PARSER:
+          r = val_parser_sprintf(__parser_ptr(val),buf,fmt);
+          break;
+        case TYPE_INT64:
+          r = val_int64_sprintf(__val_ptr(val)->v.i64,buf,fmt);
+          break;
         default:
           return _throw(ERR_NOT_IMPLEMENTED);
       }
       break;
+    case _FRAME_TAG: //only seen when printing raw vm state
+      r = val_sprint_cstr(buf,"frame");
+      break;
     case _TAG5:
       r = _fatal(ERR_BADTYPE);
       break;
     case _INT_TAG:
       r = val_int32_sprintf(__val_int(val),buf,fmt);
       break;
+    case _INT47_TAG:
+      r = val_int64_sprintf(__val_int47(val),buf,fmt);
+      break;
     default: //double
       r = val_double_sprintf(__val_dbl(val),buf,fmt);
       break;
@@ -204,7 +248,13 @@ val_t* val_arglist_get(valstruct_t *list, int isstack, int i) {
 //}
 
 int val_arglist_drop(valstruct_t *list, int isstack) {
-  if (isstack) return _val_lst_rdrop(list);
+  if (isstack) { //vm pushes straight over the slots past the end of the stack, so we destroy instead of leaving it dirty
+    val_t t;
+    err_t e;
+    if ((e = _val_lst_rpop(list,&t))) return e;
+    val_destroy(t);
+    return 0;
+  }
   else return _val_lst_ldrop(list);
 }
 
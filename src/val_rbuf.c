@@ -0,0 +1,169 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "val_rbuf.h"
+#include "val_string.h"
+#include "vm_err.h"
+#include "helpers.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+void _rbuf_init(rbuf_t *r) {
+  r->buf = NULL;
+  r->off = 0;
+  r->len = 0;
+  r->lock = 0;
+}
+
+void _rbuf_destroy(rbuf_t *r) {
+  if (r->buf) _sbuf_release(r->buf);
+  _rbuf_init(r);
+}
+
+//read more bytes from fd after the unread bytes (rbuf must be locked)
+// - returns number of bytes read, ERR_EOF, or error
+static int _rbuf_fill(rbuf_t *r, int fd) {
+  sbuf_t *b = r->buf;
+  ssize_t n;
+  if (!b || r->off + r->len == b->size) { //no free space after unread bytes
+    if (b && r->len < b->size && refcount_singleton(b->refcount)) { //no line views left, so reuse chunk in place
+      memmove(b->p,b->p+r->off,r->len);
+    } else {
+      sbuf_t *nb;
+      unsigned int size = RBUF_CHUNK;
+      while (size < r->len*2) size *= 2; //line didn't fit in chunk
+      if (!(nb = _sbuf_alloc(size))) return _fatal(ERR_MALLOC);
+      if (r->len) memcpy(nb->p,b->p+r->off,r->len);
+      if (b) _sbuf_release(b);
+      r->buf = b = nb;
+    }
+    r->off = 0;
+  }
+  do {
+    n = read(fd,b->p+r->off+r->len,b->size-r->off-r->len);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) return _throw(ERR_IO_ERROR);
+  if (n == 0) return ERR_EOF;
+  r->len += n;
+  return (int)n;
+}
+
+//find end of next line (past the newline, or end of file), filling as needed (rbuf must be locked)
+// - only scans for the newline up to max bytes (returning max bytes even without newline)
+// - returns line length, ERR_EOF if nothing left, or error
+static int _rbuf_nextline(rbuf_t *r, int fd, unsigned int max) {
+  unsigned int scan = 0; //bytes already scanned (relative to off, which a fill may move)
+  const char *p;
+  int e;
+  for(;;) {
+    unsigned int n = (r->len < max ? r->len : max);
+    if (scan < n && (p = memchr(r->buf->p+r->off+scan,'\n',n-scan))) return (int)(p - (r->buf->p+r->off)) + 1;
+    if (n == max) return (int)max;
+    scan = n;
+    if (0>(e = _rbuf_fill(r,fd))) {
+      if (e == ERR_EOF && r->len) return (int)r->len; //last line without newline
+      return e;
+    }
+  }
+}
+
+//take the next n unread bytes, appending them to str (rbuf must be locked)
+// - returns n or error
+static int _rbuf_take(rbuf_t *r, int n, valstruct_t *str) {
+  err_t e;
+  if (!_val_str_len(str)) { //zero-copy -- str becomes a view of the bytes
+    if (str->v.str.buf) _sbuf_release(str->v.str.buf);
+    refcount_inc(r->buf->refcount);
+    str->v.str.buf = r->buf;
+    str->v.str.off = r->off;
+    str->v.str.len = n;
+    _val_str_clearcache(str);
+  } else if ((e = _val_str_cat_cstr(str,r->buf->p+r->off,n))) {
+    return e;
+  }
+  r->off += n;
+  r->len -= n;
+  return n;
+}
+
+int _rbuf_readline(rbuf_t *r, int fd, valstruct_t *str) {
+  int n;
+  futex_lock(&r->lock);
+  if (0<=(n = _rbuf_nextline(r,fd,~0u))) n = _rbuf_take(r,n,str);
+  futex_unlock(&r->lock);
+  return n;
+}
+
+int _rbuf_readchunk(rbuf_t *r, int fd, valstruct_t *str) {
+  int n = 0;
+  futex_lock(&r->lock);
+  if (r->len || 0<(n = _rbuf_fill(r,fd))) n = _rbuf_take(r,(int)r->len,str);
+  futex_unlock(&r->lock);
+  return n;
+}
+
+void _rbuf_unread(rbuf_t *r, unsigned int n) {
+  futex_lock(&r->lock);
+  r->off -= n; //still in the chunk, since only a fill can move unread bytes (and it would have to read them first)
+  r->len += n;
+  futex_unlock(&r->lock);
+}
+
+int _rbuf_readline_(rbuf_t *r, int fd, char *buffer, int buflen) {
+  int n;
+  if (buflen < 2) return _throw(ERR_BADARGS);
+  futex_lock(&r->lock);
+  if (0<(n = _rbuf_nextline(r,fd,buflen-1))) {
+    memcpy(buffer,r->buf->p+r->off,n);
+    buffer[n] = '\0';
+    r->off += n;
+    r->len -= n;
+  }
+  futex_unlock(&r->lock);
+  return n;
+}
+
+int _rbuf_read(rbuf_t *r, int fd, char *buffer, int nbytes) {
+  int n;
+  futex_lock(&r->lock);
+  if (!r->len && nbytes >= (int)(RBUF_CHUNK/2)) { //big read with nothing buffered -- skip the copy
+    do {
+      n = read(fd,buffer,nbytes);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) n = _throw(ERR_IO_ERROR);
+    else if (n == 0) n = ERR_EOF;
+    goto out;
+  }
+  if (!r->len && 0>(n = _rbuf_fill(r,fd))) goto out;
+  n = (r->len < (unsigned int)nbytes ? (int)r->len : nbytes);
+  memcpy(buffer,r->buf->p+r->off,n);
+  r->off += n;
+  r->len -= n;
+out:
+  futex_unlock(&r->lock);
+  return n;
+}
+
+unsigned int _rbuf_pending(rbuf_t *r) {
+  return __atomic_load_n(&r->len,__ATOMIC_RELAXED);
+}
+
+void _rbuf_discard(rbuf_t *r) {
+  futex_lock(&r->lock);
+  r->off += r->len;
+  r->len = 0;
+  futex_unlock(&r->lock);
+}
@@ -0,0 +1,43 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef __VAL_RBUF_H__
+#define __VAL_RBUF_H__ 1
+
+#include "val.h"
+
+// val_rbuf - per-file read buffer (rbuf_t) for file and fd vals
+// - chunks are read straight from the file descriptor into an sbuf, and lines are returned as str views into the chunk (no copy)
+//   - a line view keeps its chunk alive, so clone/substr the line (or let it go) rather than holding thousands of them
+// - refill reads into free space after the unread bytes, slides them to the front if no line views still reference the chunk,
+//   or else copies just the unread tail into a new chunk (doubling the chunk size when a single line doesn't fit)
+// - each rbuf has its own lock, so one file can be read from many threads (every line goes to exactly one reader)
+// - all reads of a file must go through its rbuf, since the bytes in it have already been taken from the file descriptor
+//
+
+#define RBUF_CHUNK (65536 - sizeof(sbuf_t)) //default chunk size (one 64k allocation with the sbuf header)
+
+void _rbuf_init(rbuf_t *r);
+void _rbuf_destroy(rbuf_t *r);
+
+int _rbuf_readline(rbuf_t *r, int fd, valstruct_t *str); //append next line (with newline) to str (as a view if str is empty), returns length or ERR_EOF
+int _rbuf_readchunk(rbuf_t *r, int fd, valstruct_t *str); //append all unread bytes (reading more if none) to str (as a view if str is empty), returns length or ERR_EOF
+void _rbuf_unread(rbuf_t *r, unsigned int n); //give back the last n bytes taken (only right after the read that took them, before anything else reads)
+int _rbuf_readline_(rbuf_t *r, int fd, char *buffer, int buflen); //copy next line to buffer like fgets (at most buflen-1 bytes, null terminated)
+int _rbuf_read(rbuf_t *r, int fd, char *buffer, int nbytes); //read up to nbytes (buffered bytes first), returns count or ERR_EOF
+
+unsigned int _rbuf_pending(rbuf_t *r); //bytes taken from the file descriptor but not read yet
+void _rbuf_discard(rbuf_t *r); //drop pending bytes (after seeking the file descriptor back over them)
+
+#endif
@@ -26,9 +26,9 @@ err_t val_ref_wrap(val_t *val) {
   if (!(ref = _valstruct_alloc())) return ERR_MALLOC;
   ANNOTATE_RWLOCK_CREATE(ref);
   ref->type = TYPE_REF;
+  ref->v.ref.lock = 0;
+  ref->v.ref.wake = 0;
   ref->v.ref.nwait = 0;
-  fatal_if(ERR_LOCK,0 != sem_init(&ref->v.ref.lock,0,1));
-  fatal_if(ERR_LOCK,0 != sem_init(&ref->v.ref.wait,0,0));
   ref->v.ref.refcount = 1;
   ref->v.ref.val = *val;
   *val = __ref_val(ref);
@@ -62,49 +62,69 @@ err_t val_ref_swap(valstruct_t *ref, val_t *val) {
   return 0;
 }
 
+//ref lock is a 3-state futex mutex (0 unlocked, 1 locked, 2 locked and someone may be asleep on it)
+// - lock: CAS 0->1 on the fast path, otherwise mark contended (2) and sleep until we swap 0->2
+// - unlock: swap to 0, and only make the wake syscall if it was contended
 err_t _ref_lock(valstruct_t *ref) {
-  err_t e;
-  throw_if(ERR_LOCK,(e = sem_wait(&ref->v.ref.lock)));
+  unsigned int c = 0;
+  if (!__atomic_compare_exchange_n(&ref->v.ref.lock,&c,1,0,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED)) {
+    if (c != 2) c = __atomic_exchange_n(&ref->v.ref.lock,2,__ATOMIC_ACQUIRE);
+    while (c != 0) {
+      futex_wait(&ref->v.ref.lock,2);
+      c = __atomic_exchange_n(&ref->v.ref.lock,2,__ATOMIC_ACQUIRE);
+    }
+  }
   ANNOTATE_RWLOCK_ACQUIRED(ref,1);
   return 0;
 }
 err_t _ref_trylock(valstruct_t *ref) {
-  err_t e;
-  if (!(e = sem_trywait(&ref->v.ref.lock))) {
+  unsigned int c = 0;
+  if (__atomic_compare_exchange_n(&ref->v.ref.lock,&c,1,0,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED)) {
     ANNOTATE_RWLOCK_ACQUIRED(ref,1);
     return 0;
   }
-  else if (errno == EAGAIN) return ERR_LOCKED;
-  else return _throw(ERR_LOCK);
+  return ERR_LOCKED;
 }
 err_t _ref_unlock(valstruct_t *ref) {
-  err_t e;
   ANNOTATE_RWLOCK_RELEASED(ref,1);
-  throw_if(ERR_LOCK,(e = sem_post(&ref->v.ref.lock)));
+  if (2 == __atomic_exchange_n(&ref->v.ref.lock,0,__ATOMIC_RELEASE)) futex_wake(&ref->v.ref.lock,1);
   return 0;
 }
 
+//wait/signal/broadcast -- wake is a futex semaphore that signal/broadcast post to once per waiter
+// - nwait (under lock) counts waiters not yet signalled, so a signal is never posted without a waiter to take it
+// - a waiter that hasn't gone to sleep yet still gets its wakeup (it sees wake>0 and never sleeps)
 err_t _ref_signal(valstruct_t *ref) {
   if (ref->v.ref.nwait) { //post once if there are waiter(s)
     --ref->v.ref.nwait;
-    throw_if(ERR_LOCK,sem_post(&ref->v.ref.wait));
+    __atomic_add_fetch(&ref->v.ref.wake,1,__ATOMIC_RELEASE);
+    futex_wake(&ref->v.ref.wake,1);
   }
   return 0;
 }
 err_t _ref_broadcast(valstruct_t *ref) {
-  while (ref->v.ref.nwait) { //post once for each waiter
-    --ref->v.ref.nwait;
-    throw_if(ERR_LOCK,sem_post(&ref->v.ref.wait));
+  if (ref->v.ref.nwait) { //post once for each waiter
+    __atomic_add_fetch(&ref->v.ref.wake,ref->v.ref.nwait,__ATOMIC_RELEASE);
+    futex_wake(&ref->v.ref.wake,ref->v.ref.nwait);
+    ref->v.ref.nwait = 0;
   }
   return 0;
 }
-err_t _ref_wait(valstruct_t *ref) {
+err_t _ref_wait(valstruct_t *ref) { //unlock and wait for signal (returns without lock)
   err_t r;
+  unsigned int w;
   ++ref->v.ref.nwait;
   if ((r = _ref_unlock(ref))) return r;
 
-  throw_if(ERR_LOCK,sem_wait(&ref->v.ref.wait));
-  return 0;
+  w = __atomic_load_n(&ref->v.ref.wake,__ATOMIC_RELAXED);
+  for(;;) {
+    if (!w) {
+      futex_wait(&ref->v.ref.wake,0);
+      w = __atomic_load_n(&ref->v.ref.wake,__ATOMIC_RELAXED);
+    } else if (__atomic_compare_exchange_n(&ref->v.ref.wake,&w,w-1,1,__ATOMIC_ACQUIRE,__ATOMIC_RELAXED)) {
+      return 0;
+    }
+  }
 }
 
 err_t val_ref_signal(valstruct_t *ref) {
@@ -169,8 +189,6 @@ void _val_ref_destroy(valstruct_t *ref) {
     //last reference, free resources
     //err_t e; //TODO: trylock as a debug check
     //if ((e = _val_ref_trylock(ref))) { _fatal(e); }
-    sem_destroy(&ref->v.ref.lock);
-    sem_destroy(&ref->v.ref.wait);
     val_destroy(ref->v.ref.val);
     //ANNOTATE_RWLOCK_RELEASED(ref,1);
     ANNOTATE_RWLOCK_DESTROY(ref);
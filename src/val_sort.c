@@ -13,86 +13,361 @@
 //limitations under the License.
 
 #include "val_sort.h"
+#include "val_string.h"
+#include "val_list.h"
+#include "vm_err.h"
 
-void val_qsortp(val_t *p, unsigned int size, int (compare_lt)(val_t lhs, val_t rhs)) {
-  if (size < 2) return;
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SORT_INSERTION 16 //ranges this small are insertion sorted
+#define SORT_RADIX 64 //homogeneous int/double lists at least this long are radix sorted
+
+#define SORT_SWAP(a,b) do{ val_t _t = (a); (a) = (b); (b) = _t; }while(0)
+
+//introsort template -- quicksort (median of 3) that falls back to heapsort past 2*log2(n) levels, insertion sort for small ranges
+// - plus the stable merge of two adjacent sorted runs (into another buffer) for the merge sorts
+// - LT(a,b) is the comparison (with lt the comparator passed through to it)
+// - partition scans are bounds checked, so an inconsistent comparator (e.g. mixed types, or user code) can't run off the range
+// - we recurse on the smaller side and loop on the larger, so C stack depth is at most log2(n)
+#define SORT_DEFINE(name,LT) \
+static void name##_insertion(val_t *p, unsigned int n, int (*lt)(val_t,val_t)) { \
+  unsigned int i,j; \
+  for(i=1;i<n;++i) { \
+    val_t x = p[i]; \
+    for(j=i; j>0 && LT(x,p[j-1]); --j) p[j] = p[j-1]; \
+    p[j] = x; \
+  } \
+} \
+static void name##_siftdown(val_t *p, unsigned int i, unsigned int n, int (*lt)(val_t,val_t)) { \
+  unsigned int c; \
+  while ((c = 2*i+1) < n) { \
+    if (c+1 < n && LT(p[c],p[c+1])) c++; \
+    if (!LT(p[i],p[c])) return; \
+    SORT_SWAP(p[i],p[c]); \
+    i = c; \
+  } \
+} \
+static void name##_heapsort(val_t *p, unsigned int n, int (*lt)(val_t,val_t)) { \
+  unsigned int i; \
+  for(i=n/2;i>0;--i) name##_siftdown(p,i-1,n,lt); \
+  for(i=n-1;i>0;--i) { \
+    SORT_SWAP(p[0],p[i]); \
+    name##_siftdown(p,0,i,lt); \
+  } \
+} \
+static void name##_intro(val_t *p, unsigned int n, unsigned int depth, int (*lt)(val_t,val_t)) { \
+  while (n > SORT_INSERTION) { \
+    unsigned int i = 0, j = n-1, m = n/2; \
+    if (!depth--) { name##_heapsort(p,n,lt); return; } \
+    /* median of 3 -- leaves p[0] <= p[m] <= p[n-1] so they stop the scans */ \
+    if (LT(p[m],p[0])) SORT_SWAP(p[m],p[0]); \
+    if (LT(p[n-1],p[m])) { \
+      SORT_SWAP(p[n-1],p[m]); \
+      if (LT(p[m],p[0])) SORT_SWAP(p[m],p[0]); \
+    } \
+    val_t pv = p[m]; \
+    for(;;) { \
+      do { i++; } while (i < n-1 && LT(p[i],pv)); \
+      do { j--; } while (j > 0 && LT(pv,p[j])); \
+      if (i >= j) break; \
+      SORT_SWAP(p[i],p[j]); \
+    } \
+    /* [0,i) <= pivot <= [i,n) */ \
+    if (i < n-i) { \
+      name##_intro(p,i,depth,lt); \
+      p += i; n -= i; \
+    } else { \
+      name##_intro(p+i,n-i,depth,lt); \
+      n = i; \
+    } \
+  } \
+  name##_insertion(p,n,lt); \
+} \
+static void name##_merge(val_t *dst, val_t *src, unsigned int lo, unsigned int mid, unsigned int hi, int (*lt)(val_t,val_t)) { \
+  unsigned int i = lo, j = mid, k = lo; \
+  while (i < mid && j < hi) dst[k++] = (LT(src[j],src[i]) ? src[j++] : src[i++]); \
+  while (i < mid) dst[k++] = src[i++]; \
+  while (j < hi) dst[k++] = src[j++]; \
+}
+
+#define SORT_LT_FN(a,b) lt(a,b)
+#define SORT_LT_INT(a,b) (__val_int(a) < __val_int(b))
+#define SORT_LT_DBL(a,b) (__val_dbl(a) < __val_dbl(b))
+#define SORT_LT_STR(a,b) _val_str_lt(__str_ptr(a),__str_ptr(b))
+
+SORT_DEFINE(_sort_fn,SORT_LT_FN)
+SORT_DEFINE(_sort_int,SORT_LT_INT)
+SORT_DEFINE(_sort_dbl,SORT_LT_DBL)
+SORT_DEFINE(_sort_str,SORT_LT_STR)
 
-  //we are using the median of first/last/middle for the pivot
-  val_t pval = p[0];
-  const val_t mid = p[size/2];
-  const val_t last = p[size-1];
-  unsigned int i=0, j=size;
-
-  if ((compare_lt(pval,mid) && compare_lt(mid,last)) || (compare_lt(last,mid) && compare_lt(mid,pval)) ) pval=mid;
-  else if ((compare_lt(pval,last) && compare_lt(last,mid)) || (compare_lt(mid,last) && compare_lt(last,pval)) ) pval=last;
-
-  while (1) {
-    j--;
-    while (compare_lt(pval,p[j])) j--; //find last record that should go before pivot
-    while (compare_lt(p[i],pval)) i++; //find first record that should go after pivot
-    if  (i < j) { //swap (if the list isn't fully partitioned)
-      val_swap(&p[i],&p[j]);
-    } else {
-      break; //j is now the pivot, and the list is partitioned
+static unsigned int _sort_depth(unsigned int n) {
+  unsigned int d = 0;
+  while (n >>= 1) d++;
+  return 2*d;
+}
+
+static void _sort_reverse(val_t *p, unsigned int n) {
+  unsigned int i;
+  for(i=0;i<n/2;++i) SORT_SWAP(p[i],p[n-1-i]);
+}
+
+//LSD radix sort on precomputed unsigned keys (nbytes bytes each), moving vals along with their keys
+// - passes where every key has the same byte are skipped
+// - returns -1 (leaving p untouched) if we can't get the buffers
+static int _sort_radix(val_t *p, uint64_t *keys, unsigned int n, unsigned int nbytes) {
+  val_t *tp;
+  uint64_t *tk;
+  unsigned int (*count)[256];
+  unsigned int i,b;
+  if (!(tp = malloc(sizeof(val_t)*n))) return -1;
+  if (!(tk = malloc(sizeof(uint64_t)*n))) { free(tp); return -1; }
+  if (!(count = calloc(nbytes,sizeof(*count)))) { free(tk); free(tp); return -1; }
+
+  for(i=0;i<n;++i) {
+    for(b=0;b<nbytes;++b) count[b][(keys[i] >> (8*b)) & 0xff]++;
+  }
+  for(b=0;b<nbytes;++b) {
+    unsigned int sum = 0, c;
+    if (count[b][keys[0] >> (8*b) & 0xff] == n) continue; //all keys share this byte
+    for(c=0;c<256;++c) {
+      unsigned int t = count[b][c];
+      count[b][c] = sum;
+      sum += t;
+    }
+    for(i=0;i<n;++i) {
+      unsigned int dst = count[b][(keys[i] >> (8*b)) & 0xff]++;
+      tp[dst] = p[i];
+      tk[dst] = keys[i];
     }
-    i++;
+    memcpy(p,tp,sizeof(val_t)*n);
+    memcpy(keys,tk,sizeof(uint64_t)*n);
   }
-  j++; //we put the pivot in the second half (TODO: not sure if this is needed - maybe edge cases)
-  val_qsortp(&p[0], j, compare_lt);
-  val_qsortp(&p[j],size-j, compare_lt);
-}
-void val_qsort(val_t *p, unsigned int size) {
-    if (size < 2) return;
-
-    //we are using the median of first/last/middle for the pivot
-    val_t pval = p[0];
-    const val_t mid = p[size/2];
-    const val_t last = p[size-1];
-    unsigned int i=0, j=size;
-
-    if ((val_lt(pval,mid) && val_lt(mid,last)) || (val_lt(last,mid) && val_lt(mid,pval)) ) pval=mid;
-    else if ((val_lt(pval,last) && val_lt(last,mid)) || (val_lt(mid,last) && val_lt(last,pval)) ) pval=last;
-
-    while (1) {
-      j--;
-      while (val_lt(pval,p[j])) j--; //find last record that should go before pivot
-      while (val_lt(p[i],pval)) i++; //find first record that should go after pivot
-      if  (i < j) { //swap (if the list isn't fully partitioned)
-        val_swap(&p[i],&p[j]);
-      } else {
-        break; //j is now the pivot, and the list is partitioned
-      }
-      i++;
+  free(count);
+  free(tk);
+  free(tp);
+  return 0;
+}
+
+//order-preserving unsigned keys (sign bit flipped for ints, all bits flipped for negative doubles)
+static int _sort_radix_int(val_t *p, unsigned int n) {
+  uint64_t *keys;
+  unsigned int i;
+  int r;
+  if (!(keys = malloc(sizeof(uint64_t)*n))) return -1;
+  for(i=0;i<n;++i) keys[i] = (uint32_t)__val_int(p[i]) ^ 0x80000000u;
+  r = _sort_radix(p,keys,n,4);
+  free(keys);
+  return r;
+}
+static int _sort_radix_dbl(val_t *p, unsigned int n) {
+  uint64_t *keys;
+  unsigned int i;
+  int r;
+  if (!(keys = malloc(sizeof(uint64_t)*n))) return -1;
+  for(i=0;i<n;++i) {
+    double d = __val_dbl(p[i]);
+    uint64_t k;
+    memcpy(&k,&d,sizeof(k));
+    keys[i] = (k >> 63) ? ~k : (k | (1ull << 63));
+  }
+  r = _sort_radix(p,keys,n,8);
+  free(keys);
+  return r;
+}
+
+enum sort_kind { SORT_MIXED, SORT_INT, SORT_DBL, SORT_STR };
+
+static enum sort_kind _sort_kind(val_t *p, unsigned int n) {
+  unsigned int i;
+  if (!n) return SORT_MIXED;
+  if (val_is_int(p[0])) {
+    for(i=1;i<n;++i) if (!val_is_int(p[i])) return SORT_MIXED;
+    return SORT_INT;
+  } else if (val_is_double(p[0])) {
+    for(i=1;i<n;++i) if (!val_is_double(p[i])) return SORT_MIXED;
+    return SORT_DBL;
+  } else if (val_is_str(p[0])) {
+    for(i=1;i<n;++i) if (!val_is_str(p[i])) return SORT_MIXED;
+    return SORT_STR;
+  }
+  return SORT_MIXED;
+}
+
+void val_sortp(val_t *p, unsigned int size, int (compare_lt)(val_t lhs, val_t rhs)) {
+  if (size < 2) return;
+  _sort_fn_intro(p,size,_sort_depth(size),compare_lt);
+}
+
+void val_sort(val_t *p, unsigned int size) {
+  if (size < 2) return;
+  switch(_sort_kind(p,size)) {
+    case SORT_INT:
+      if (size < SORT_RADIX || _sort_radix_int(p,size)) _sort_int_intro(p,size,_sort_depth(size),NULL);
+      return;
+    case SORT_DBL:
+      if (size < SORT_RADIX || _sort_radix_dbl(p,size)) _sort_dbl_intro(p,size,_sort_depth(size),NULL);
+      return;
+    case SORT_STR:
+      _sort_str_intro(p,size,_sort_depth(size),NULL);
+      return;
+    default:
+      _sort_fn_intro(p,size,_sort_depth(size),val_lt);
+      return;
+  }
+}
+
+static int _val_gt(val_t lhs, val_t rhs) { return val_gt(lhs,rhs); }
+void val_rsort(val_t *p, unsigned int size) {
+  if (size < 2) return;
+  switch(_sort_kind(p,size)) {
+    case SORT_INT: case SORT_DBL: case SORT_STR: //sort ascending then flip (equal vals are identical, so order among them doesn't matter)
+      val_sort(p,size);
+      _sort_reverse(p,size);
+      return;
+    default:
+      _sort_fn_intro(p,size,_sort_depth(size),_val_gt);
+      return;
+  }
+}
+
+//stable merge sort -- insertion sort SORT_INSERTION-sized runs in place, then merge runs bottom-up through one buffer
+// - ties keep their original order (we only take from the right run when it is strictly less)
+err_t val_msortp(val_t *p, unsigned int size, int (compare_lt)(val_t lhs, val_t rhs)) {
+  val_t *buf, *src = p, *dst;
+  unsigned int w, lo;
+  if (size < 2) return 0;
+  for(lo=0; lo<size; lo+=SORT_INSERTION) {
+    _sort_fn_insertion(p+lo,(size-lo < SORT_INSERTION ? size-lo : SORT_INSERTION),compare_lt);
+  }
+  if (size <= SORT_INSERTION) return 0;
+  if (!(buf = malloc(sizeof(val_t)*size))) return _throw(ERR_MALLOC);
+  dst = buf;
+  for(w=SORT_INSERTION; w<size; w*=2) {
+    for(lo=0; lo<size; lo+=2*w) {
+      unsigned int mid = (lo+w < size ? lo+w : size), hi = (lo+2*w < size ? lo+2*w : size);
+      _sort_fn_merge(dst,src,lo,mid,hi,compare_lt);
     }
-    j++; //we put the pivot in the second half (TODO: not sure if this is needed - maybe edge cases)
-    val_qsort(&p[0], j);
-    val_qsort(&p[j],size-j);
-}
-void val_rqsort(val_t *p, unsigned int size) {
-    if (size < 2) return;
-
-    //we are using the median of first/last/middle for the pivot
-    val_t pval = p[0];
-    const val_t mid = p[size/2];
-    const val_t last = p[size-1];
-    unsigned int i=0, j=size;
-
-    if ((val_gt(pval,mid) && val_gt(mid,last)) || (val_gt(last,mid) && val_gt(mid,pval)) ) pval=mid;
-    else if ((val_gt(pval,last) && val_gt(last,mid)) || (val_gt(mid,last) && val_gt(last,pval)) ) pval=last;
-
-    while (1) {
-      j--;
-      while (val_gt(pval,p[j])) j--; //find last record that should go before pivot
-      while (val_gt(p[i],pval)) i++; //find first record that should go after pivot
-      if  (i < j) { //swap (if the list isn't fully partitioned)
-        val_swap(&p[i],&p[j]);
-      } else {
-        break; //j is now the pivot, and the list is partitioned
+    val_t *t = src; src = dst; dst = t;
+  }
+  if (src != p) memcpy(p,src,sizeof(val_t)*size);
+  free(buf);
+  return 0;
+}
+err_t val_msort(val_t *p, unsigned int size) {
+  return val_msortp(p,size,val_lt);
+}
+err_t val_rmsort(val_t *p, unsigned int size) {
+  return val_msortp(p,size,_val_gt);
+}
+
+int val_sort_mergeable(val_t *p, unsigned int size) {
+  unsigned int i;
+  switch(_sort_kind(p,size)) {
+    case SORT_INT: case SORT_STR:
+      return 1;
+    case SORT_DBL: //NaN compares false both ways, so where it ends up depends on the algorithm
+      for(i=0;i<size;++i) if (isnan(__val_dbl(p[i]))) return 0;
+      return 1;
+    default: //mixed types don't have a consistent order (see val_lt), so only val_sort itself gives val_sort's order
+      return 0;
+  }
+}
+
+//merge nruns adjacent sorted runs (run k starts at runs[k], runs[0] is 0) into one sorted range, pairwise bottom-up
+// - e.g. to stitch chunks sorted in parallel (see vm_par.c), so it uses the same typed comparisons as val_sort
+err_t val_sort_mergen(val_t *p, unsigned int size, unsigned int *runs, unsigned int nruns) {
+  val_t *buf, *src = p, *dst;
+  unsigned int r, w;
+  enum sort_kind kind;
+  if (nruns < 2 || size < 2) return 0;
+  if (!(buf = malloc(sizeof(val_t)*size))) return _throw(ERR_MALLOC);
+  kind = _sort_kind(p,size);
+  dst = buf;
+  for(w=1; w<nruns; w*=2) {
+    for(r=0; r<nruns; r+=2*w) {
+      unsigned int lo = runs[r];
+      unsigned int mid = (r+w < nruns ? runs[r+w] : size), hi = (r+2*w < nruns ? runs[r+2*w] : size);
+      switch(kind) {
+        case SORT_INT: _sort_int_merge(dst,src,lo,mid,hi,NULL); break;
+        case SORT_DBL: _sort_dbl_merge(dst,src,lo,mid,hi,NULL); break;
+        case SORT_STR: _sort_str_merge(dst,src,lo,mid,hi,NULL); break;
+        default: _sort_fn_merge(dst,src,lo,mid,hi,val_lt); break;
       }
-      i++;
     }
-    j++; //we put the pivot in the second half (TODO: not sure if this is needed - maybe edge cases)
-    val_rqsort(&p[0], j);
-    val_rqsort(&p[j],size-j);
+    val_t *t = src; src = dst; dst = t;
+  }
+  if (src != p) memcpy(p,src,sizeof(val_t)*size);
+  free(buf);
+  return 0;
+}
+
+//resumable stable merge sort (bottom-up, one merge step per comparison)
+// - for comparators we can't call from C (concat code evaluated by the vm), so the caller runs each comparison and resumes us
+// - all state is in 6 vals so it can live on the vm work stack: (src) (dst) width lo i j
+//   - each pass merges pairs of width-sized runs of src into dst (moving vals, leaving VAL_NULL behind), then src/dst swap and width doubles
+//   - lo is the start of the pair being merged, i/j the next indexes in its left/right run (so the next dst index is i+j-mid)
+err_t val_msort_init(val_t *state, val_t list) {
+  valstruct_t *dst;
+  unsigned int n = _val_lst_len(__lst_ptr(list));
+  err_t e;
+  state[1] = val_empty_list();
+  dst = __lst_ptr(state[1]);
+  if ((e = _val_lst_rreserve(dst,n))) goto out_err;
+  while (n--) {
+    if ((e = _val_lst_rpush(dst,VAL_NULL))) goto out_err;
+  }
+  state[0] = list;
+  state[2] = __int_val(1);
+  state[3] = __int_val(0);
+  state[4] = __int_val(0);
+  state[5] = __int_val(1);
+  return 0;
+out_err:
+  val_destroy(state[1]);
+  return e;
 }
 
+#define MSORT_MOVE(from) do{ dst[i+j-mid] = src[from]; val_clear(&src[from]); from++; }while(0)
+
+int val_msort_step(val_t *state, int right_lt, val_t *lhs, val_t *rhs) {
+  val_t *src = _val_lst_begin(__lst_ptr(state[0]));
+  val_t *dst = _val_lst_begin(__lst_ptr(state[1]));
+  unsigned int n = _val_lst_len(__lst_ptr(state[0]));
+  unsigned int w = __val_int(state[2]), lo = __val_int(state[3]), i = __val_int(state[4]), j = __val_int(state[5]);
+  unsigned int mid = (lo+w < n ? lo+w : n), hi = (lo+2*w < n ? lo+2*w : n);
+  err_t e;
+
+  if (right_lt > 0) MSORT_MOVE(j);
+  else if (right_lt == 0) MSORT_MOVE(i);
+
+  for(;;) {
+    if (lo >= n) { //pass finished
+      val_swap(&state[0],&state[1]);
+      val_t *t = src; src = dst; dst = t;
+      w *= 2;
+      if (w >= n) return 0;
+      lo = i = 0;
+      j = w;
+    }
+    mid = (lo+w < n ? lo+w : n);
+    hi = (lo+2*w < n ? lo+2*w : n);
+    if (i < mid && j < hi) break;
+    else if (i < mid) MSORT_MOVE(i);
+    else if (j < hi) MSORT_MOVE(j);
+    else { //pair merged, start the next one
+      lo = i = hi;
+      j = (lo+w < n ? lo+w : n);
+    }
+  }
+  state[2] = __int_val(w);
+  state[3] = __int_val(lo);
+  state[4] = __int_val(i);
+  state[5] = __int_val(j);
+  if ((e = val_clone(lhs,src[j]))) return e;
+  if ((e = val_clone(rhs,src[i]))) { val_destroy(*lhs); return e; }
+  return 1;
+}
+#undef MSORT_MOVE
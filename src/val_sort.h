@@ -16,8 +16,31 @@
 #define __VAL_SORT_H__ 1
 #include "val.h"
 
-void val_qsortp(val_t *p, unsigned int size, int (compare_lt)(val_t lhs, val_t rhs));
-void val_qsort(val_t *p, unsigned int size);
-void val_rqsort(val_t *p, unsigned int size);
+// val_sort - in-place sorting of val arrays (list contents)
+// - val_sort/val_rsort/val_sortp are introsort (unstable, O(n log n) worst case, no allocation)
+//   - val_sort/val_rsort radix sort lists of only ints or only doubles, and compare strings directly for lists of only strings
+// - val_msort/val_rmsort/val_msortp are a stable merge sort (ties keep their order), needing a size-n buffer
+
+void val_sortp(val_t *p, unsigned int size, int (compare_lt)(val_t lhs, val_t rhs));
+void val_sort(val_t *p, unsigned int size);
+void val_rsort(val_t *p, unsigned int size);
+
+err_t val_msortp(val_t *p, unsigned int size, int (compare_lt)(val_t lhs, val_t rhs));
+err_t val_msort(val_t *p, unsigned int size);
+err_t val_rmsort(val_t *p, unsigned int size);
+
+//whether val_sort orders p by value alone (only ints, only doubles without NaNs, or only strings)
+// - then equal vals are interchangeable, so sorting chunks and merging them with val_sort_mergen gives the same list as val_sort
+int val_sort_mergeable(val_t *p, unsigned int size);
+
+//merge nruns adjacent sorted runs (starting at runs[0]=0, runs[1], ...) into one sorted range (same order as val_sort for val_sort_mergeable vals)
+err_t val_sort_mergen(val_t *p, unsigned int size, unsigned int *runs, unsigned int nruns);
+
+//resumable stable merge sort for comparators run by the caller (e.g. concat code on the vm) -- see val_sort.c
+// - state is 6 vals (the first is the list being sorted, and holds the sorted list once done)
+// - step applies the last result (right_lt: 1 if lhs < rhs, 0 if not, -1 on the first call), then
+//   returns 1 with clones of the next pair to compare in lhs/rhs, or 0 when sorted
+err_t val_msort_init(val_t *state, val_t list);
+int val_msort_step(val_t *state, int right_lt, val_t *lhs, val_t *rhs);
 
 #endif
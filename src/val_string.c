@@ -15,13 +15,18 @@
 #include "val_string.h"
 #include "val_string_internal.h"
 #include "val_printf.h"
+#include "val_strscan.h"
+#include "val_list.h"
 #include "vm_err.h"
 #include "vm_debug.h"
 #include "helpers.h"
+#include "defpool.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <valgrind/helgrind.h>
 
 
@@ -135,14 +140,15 @@ int _val_str_sprint_quoted(valstruct_t *v, valstruct_t *buf, int precision) {
              rlen+=i-tok;
            }
            if (buf) {
-             char b[3];
+             char b[4];
              unsigned char c = s[i];
-             b[0] = 'x';
-             b[1] = ( (c>0x9f) ? 'a'+((c>>4) - 10) : '0'+(c>>4));
-             b[2] = ( ((c&0x0f)>9) ? 'a'+((c&0x0f) - 10) : '0'+(c&0x0f));
-             if ((r = _val_str_cat_cstr(v,b,3))) return r;
+             b[0] = '\\';
+             b[1] = 'x';
+             b[2] = ( (c>0x9f) ? 'a'+((c>>4) - 10) : '0'+(c>>4));
+             b[3] = ( ((c&0x0f)>9) ? 'a'+((c&0x0f) - 10) : '0'+(c&0x0f));
+             if ((r = _val_str_cat_cstr(buf,b,4))) return r;
            }
-           rlen+=3;
+           rlen+=4;
            tok=i+1;
          } else {
            //r+=fprintf(file,"%c",*s); break;
@@ -179,6 +185,7 @@ val_t _strval_alloc(enum val_type type) {
   t->v.str.buf=NULL;
   t->v.str.off=0;
   t->v.str.len=0;
+  _val_str_clearcache(t);
   return __str_val(t);
 }
 
@@ -189,6 +196,7 @@ err_t _strval_init(val_t *v, enum val_type type) {
   t->v.str.buf=NULL;
   t->v.str.off=0;
   t->v.str.len=0;
+  _val_str_clearcache(t);
   *v = __str_val(t);
   return 0;
 }
@@ -200,6 +208,7 @@ err_t val_string_init_cstr(val_t *val, const char *str, unsigned int n) {
   if (!(t->v.str.buf=_sbuf_alloc(n))) _fatal(ERR_MALLOC);
   t->v.str.off=0;
   t->v.str.len=n;
+  _val_str_clearcache(t);
   memcpy(_val_str_buf(t),str,n);
   *val = __str_val(t);
   VM_DEBUG_VAL_INIT(val);
@@ -213,6 +222,7 @@ err_t val_ident_init_cstr(val_t *val, const char *str, unsigned int n) {
   if (!(t->v.str.buf=_sbuf_alloc(n))) return -1;
   t->v.str.off=0;
   t->v.str.len=n;
+  _val_str_clearcache(t);
   memcpy(_val_str_buf(t),str,n);
   *val = __str_val(t);
   VM_DEBUG_VAL_INIT(val);
@@ -323,21 +333,58 @@ val_t val_string_temp_cstr(const char *str, unsigned int n) {
   return v;
 }
 
+//sbufs come from size-classed pool, so size is rounded up to the full size class
+DEFINE_DEFAULT_SIZED_POOL(65536,_sbuf_pool_alloc,_sbuf_pool_free)
+
 sbuf_t* _sbuf_alloc(unsigned int size) {
   sbuf_t *p;
-  if (!(p = malloc(sizeof(sbuf_t)+size))) return NULL;
-  p->size=size;
+  size_t n = sizeof(sbuf_t)+size;
+  if (!(p = _sbuf_pool_alloc(&n))) return NULL;
+  p->size=n-sizeof(sbuf_t);
   p->refcount=1;
   VM_DEBUG_STRBUF_INIT(p,size);
   return p;
 }
 
+//the mapping starts one page before the file bytes, so the sbuf header sits at the end of that page and p[] is page aligned
+static size_t _sbuf_map_len(unsigned int size, size_t page) {
+  return page + (((size_t)size + page - 1) & ~(page - 1));
+}
+
+sbuf_t* _sbuf_mmap(int fd, unsigned int size) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t len = _sbuf_map_len(size,page);
+  char *base;
+  sbuf_t *p;
+  //reserve header page + file pages, then map the file (read-only) over everything after the header page
+  if (MAP_FAILED == (base = mmap(NULL,len,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0))) return NULL;
+  if (MAP_FAILED == mmap(base+page,len-page,PROT_READ,MAP_PRIVATE|MAP_FIXED,fd,0)) {
+    munmap(base,len);
+    return NULL;
+  }
+  p = (sbuf_t*)(base + page - sizeof(sbuf_t));
+  p->size = size;
+  p->refcount = 1|SBUF_MAPPED;
+  VM_DEBUG_STRBUF_INIT(p,size);
+  return p;
+}
+
+static void _sbuf_munmap(sbuf_t *buf) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  munmap((char*)buf + sizeof(sbuf_t) - page,_sbuf_map_len(buf->size,page));
+}
+
 inline void _sbuf_release(sbuf_t* buf) {
+  unsigned int r;
   VM_DEBUG_STRBUF_DESTROY(buf);
-  if (0 == (refcount_dec(buf->refcount))) {
+  if (0 == (r = refcount_dec(buf->refcount))) {
+    ANNOTATE_HAPPENS_AFTER(buf);
+    ANNOTATE_HAPPENS_BEFORE_FORGET_ALL(buf);
+    _sbuf_pool_free(buf,sizeof(sbuf_t)+buf->size);
+  } else if (r == SBUF_MAPPED) {
     ANNOTATE_HAPPENS_AFTER(buf);
     ANNOTATE_HAPPENS_BEFORE_FORGET_ALL(buf);
-    free(buf);
+    _sbuf_munmap(buf);
   } else {
     ANNOTATE_HAPPENS_BEFORE(buf);
   }
@@ -345,6 +392,8 @@ inline void _sbuf_release(sbuf_t* buf) {
 
 void _val_str_clone(valstruct_t *ret, valstruct_t *str) {
   *ret = *str;
+  _val_str_clearcache(ret); //str may be shared (and getting cached by another thread), so we don't trust the copied caches
+  if (str->type == TYPE_BYTECODE) ret->v.str.lgen = str->v.str.lgen; //except the validated stamp (only set on owned bytecode, see val_bytecode.h)
   if (ret->v.str.buf) refcount_inc(ret->v.str.buf->refcount);
 }
 
@@ -383,6 +432,8 @@ void _val_str_slide(valstruct_t *v, unsigned int newoff) {
 }
 
 err_t _val_str_lreserve(valstruct_t *v, unsigned int n) {
+  v->v.str.hview = STR_NOVIEW; //caller may write to buffer
+  v->v.str.lgen = 0; //(and drops the bytecode validated stamp)
   if (!v->v.str.buf) {
     if (!(v->v.str.buf = _sbuf_alloc(n))) return _fatal(ERR_MALLOC);
     v->v.str.off = n;
@@ -399,6 +450,8 @@ err_t _val_str_lreserve(valstruct_t *v, unsigned int n) {
 }
 
 err_t _val_str_rreserve(valstruct_t *v, unsigned int n) {
+  v->v.str.hview = STR_NOVIEW; //caller may write to buffer
+  v->v.str.lgen = 0; //(and drops the bytecode validated stamp)
   if (!v->v.str.buf) {
     if (!(v->v.str.buf = _sbuf_alloc(n))) return _fatal(ERR_MALLOC);
     v->v.str.off = 0;
@@ -440,13 +493,13 @@ err_t _val_str_cat(valstruct_t *str, valstruct_t *suffix) {
   } else {
     err_t e;
     //if str has space we pick str to append to, else if suffix has space we prepend to suffix, else we extend and append to str
-    if ((_str_mutable(str) && _str_lrspace(str)>=n) || !(_str_mutable(suffix) && _str_lrspace(suffix)>=n)) {
+    if ((_str_mutable(str) && _str_lrspace(str)>=n) || !(_str_mutable(suffix) && _str_lrspace(suffix)>=_val_str_len(str))) {
       if ((e = _val_str_rreserve(str,n))) return e;
       memcpy(_val_str_end(str), _val_str_begin(suffix), n);
       str->v.str.len+=n;
       _sbuf_release(suffix->v.str.buf);
     } else {
-      if ((e = _val_str_lreserve(suffix,n))) return e;
+      if ((e = _val_str_lreserve(suffix,_val_str_len(str)))) return e;
       memcpy(_val_str_begin(suffix)-_val_str_len(str), _val_str_begin(str), _val_str_len(str));
       _sbuf_release(str->v.str.buf);
       str->v.str.off=suffix->v.str.off-_val_str_len(str);
@@ -468,18 +521,18 @@ err_t _val_str_rcat(valstruct_t *str, valstruct_t *prefix) {
   } else {
     err_t e;
     //if str has space we pick str to append to, else if suffix has space we prepend to suffix, else we extend and append to str
-    if ((_str_mutable(str) && _str_lrspace(str)>=n) || !(_str_mutable(prefix) && _str_lrspace(prefix)>=n)) {
+    if ((_str_mutable(str) && _str_lrspace(str)>=n) || !(_str_mutable(prefix) && _str_lrspace(prefix)>=_val_str_len(str))) {
       if ((e = _val_str_lreserve(str,n))) return e;
       str->v.str.off-=n;
       str->v.str.len+=n;
       memcpy(_val_str_begin(str), _val_str_begin(prefix), n);
       _sbuf_release(prefix->v.str.buf);
     } else {
-      if ((e = _val_str_rreserve(prefix,n))) return e;
+      if ((e = _val_str_rreserve(prefix,_val_str_len(str)))) return e;
       memcpy(_val_str_end(prefix), _val_str_begin(str), _val_str_len(str));
       _sbuf_release(str->v.str.buf);
       str->v.str.buf = prefix->v.str.buf;
-      str->v.str.off=prefix->v.str.off-_val_str_len(str);
+      str->v.str.off=prefix->v.str.off;
       str->v.str.len+=n;
     }
   }
@@ -598,6 +651,7 @@ err_t _val_str_substr_clone(val_t *ret, valstruct_t *str, unsigned int off, unsi
   valstruct_t *v;
   if (!(v = _valstruct_alloc())) return _fatal(ERR_MALLOC);
   *v = *str;
+  _val_str_clearcache(v);
   if (v->v.str.buf) {
     refcount_inc(v->v.str.buf->refcount);
     v->v.str.off+=off;
@@ -607,6 +661,30 @@ err_t _val_str_substr_clone(val_t *ret, valstruct_t *str, unsigned int off, unsi
   return 0;
 }
 
+err_t _val_str_split(val_t *ret, valstruct_t *str, const char *delims, unsigned int ndelims) {
+  err_t e;
+  val_t t;
+  *ret = val_empty_list();
+  if (_val_str_empty(str)) { //one empty field
+    if ((e = _val_str_substr_clone(&t,str,0,0))) goto out_list;
+    if ((e = _val_lst_rpush(__lst_ptr(*ret),t))) goto out_t;
+    return 0;
+  }
+  const char *begin = _val_str_begin(str), *end = begin + _val_str_len(str), *p = begin, *d;
+  do {
+    if (!(d = strscan_firstof(p,end-p,delims,ndelims))) d = end;
+    if ((e = _val_str_substr_clone(&t,str,p-begin,d-p))) goto out_list;
+    if ((e = _val_lst_rpush(__lst_ptr(*ret),t))) goto out_t;
+    p = d+1;
+  } while (d != end);
+  return 0;
+out_t:
+  val_destroy(t);
+out_list:
+  val_destroy(*ret);
+  return e;
+}
+
 const char* _string_find_dq_special(const char *str, unsigned int len) {
   for(;len;++str,--len) {
     if( *str<32 || *str == '"') return str;
@@ -621,7 +699,7 @@ const char* _string_rfind_dq_special(const char *str, unsigned int len) {
 }
 
 int _string_findi(const char *str,unsigned int len, const char *substr,unsigned int substrn) {
-  const char *match = strnstrn(str,len, substr,substrn);
+  const char *match = strscan_find(str,len, substr,substrn);
   if (match) return match-str;
   else return -1;
 }
@@ -631,34 +709,20 @@ int _string_rfindi(const char *str,unsigned int len, const char *substr,unsigned
   else return -1;
 }
 int _string_findi_whitespace(const char *str,unsigned int len) {
-  unsigned int i;
-  for(i=0;i<len;++i) {
-    if (is_space(str[i])) return i;
-  }
-  return -1;
+  const char *p = strscan_firstspace(str,len);
+  return p ? p-str : -1;
 }
 int _string_findi_notwhitespace(const char *str,unsigned int len) {
-  unsigned int i;
-  for(i=0;i<len;++i) {
-    if (!is_space(str[i])) return i;
-  }
-  return -1;
+  const char *p = strscan_firstnotspace(str,len);
+  return p ? p-str : -1;
 }
 int _string_rfindi_notwhitespace(const char *str,unsigned int len) {
-  unsigned int i;
-  if (len) {
-    for(i=len;i>0;--i) {
-      if (!is_space(str[i-1])) return i-1;
-    }
-  }
-  return -1;
+  const char *p = strscan_lastnotspace(str,len);
+  return p ? p-str : -1;
 }
 int _string_findi_of(const char *str,unsigned int len, const char *chars,unsigned int nchars) {
-  unsigned int i;
-  for(i=0;i<len;++i) {
-    if (strnchr(chars,nchars,str[i])) return i;
-  }
-  return -1;
+  const char *p = strscan_firstof(str,len,chars,nchars);
+  return p ? p-str : -1;
 }
 int _string_rfindi_of(const char *str,unsigned int len, const char *chars,unsigned int nchars) {
   unsigned int i;
@@ -787,6 +851,25 @@ uint32_t _val_str_hash32(valstruct_t *str) {
   }
   return h;
 }
+
+//cached version of _val_str_hash32 (used for ident/dictionary key hashing)
+// - the cache is keyed on the view (off+len), since any byte writes go through l/rreserve (which invalidate it)
+// - stores are ordered so a reader that sees hview also sees hash (racing threads can only store the same hash)
+// - when we (re)hash we also drop the lookup cache, since the name may have changed
+uint32_t _val_str_hash32_cached(valstruct_t *str) {
+  uint64_t view = _str_view(str);
+  if (__atomic_load_n(&str->v.str.hview,__ATOMIC_ACQUIRE) == view) return str->v.str.hash;
+  str->v.str.lgen = 0;
+  str->v.str.hash = _val_str_hash32(str);
+  __atomic_store_n(&str->v.str.hview,view,__ATOMIC_RELEASE);
+  return str->v.str.hash;
+}
+void _val_str_clearcache(valstruct_t *str) {
+  str->v.str.hview = STR_NOVIEW;
+  str->v.str.lseq = 0;
+  str->v.str.lgen = 0;
+}
+
 uint64_t _val_str_hash64(valstruct_t *str) {
   register uint64_t h = 14695981039346656037u;
   if (_val_str_empty(str)) return h;
@@ -52,6 +52,10 @@
 //sbuf_t val_const_concat_buf = { .size = sizeof("concat")-1, .refcount = 1, .p = "concat" };
 //valstruct_t val_const_concat_ = { .type = TYPE_STRING, .v.str = { .off = 0, .len = NONE, .buf = &val_const_concat_buf } };
 
+//hview for a str with no cached hash (can't match a real view, since off+len fit in the buffer)
+#define STR_NOVIEW (~(uint64_t)0)
+#define _str_view(s) (((uint64_t)(s)->v.str.len << 32) | (s)->v.str.off)
+
 int _val_str_empty(valstruct_t *str);
 int _val_str_small(valstruct_t *str);
 
@@ -79,6 +83,7 @@ err_t val_string_init_quoted(val_t *val, const char *str, unsigned int len);
 val_t val_string_temp_cstr(const char *str, unsigned int n);
 
 sbuf_t* _sbuf_alloc(unsigned int size);
+sbuf_t* _sbuf_mmap(int fd, unsigned int size); //read-only mapping of the first size bytes of fd (unmapped on last release)
 void _sbuf_release(sbuf_t *buf);
 
 void _val_str_clone(valstruct_t *ret, valstruct_t *str);
@@ -93,6 +98,7 @@ err_t val_ident_init_empty(val_t *v);
 
 err_t _val_str_lreserve(valstruct_t *v, unsigned int n);
 err_t _val_str_rreserve(valstruct_t *v, unsigned int n);
+void _val_str_slide(valstruct_t *v, unsigned int newoff); //move contents to offset newoff in (unique) buffer
 err_t _val_str_lextend(valstruct_t *v, unsigned int n, char **p);
 err_t _val_str_rextend(valstruct_t *v, unsigned int n, char **p);
 
@@ -115,6 +121,8 @@ void _val_str_trim(valstruct_t *str);
 err_t _val_str_splitn(valstruct_t *str, val_t *rhs, unsigned int off);
 //unsafe cloned substring (doesn't do bounds checking)
 err_t _val_str_substr_clone(val_t *ret, valstruct_t *str, unsigned int off, unsigned int len);
+//split str at every byte in delims into a list of views (n delimiters give n+1 fields, including empty ones)
+err_t _val_str_split(val_t *ret, valstruct_t *str, const char *delims, unsigned int ndelims);
 
 int _val_str_compare(valstruct_t *lhs, valstruct_t *rhs);
 int _val_str_lt(valstruct_t *lhs, valstruct_t *rhs);
@@ -129,6 +137,8 @@ err_t _val_str_padleft(valstruct_t *str, char c, int n);
 err_t _val_str_padright(valstruct_t *str, char c, int n);
 
 uint32_t _val_str_hash32(valstruct_t *str);
+uint32_t _val_str_hash32_cached(valstruct_t *str); //caches hash in str (see str_t)
+void _val_str_clearcache(valstruct_t *str); //reset cached hash and ident lookup
 uint64_t _val_str_hash64(valstruct_t *str);
 uint32_t _val_cstr_hash32(const char *s, unsigned int n);
 uint64_t _val_cstr_hash64(const char *s, unsigned int n);
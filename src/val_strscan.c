@@ -0,0 +1,183 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "val_strscan.h"
+#include "helpers.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define STRSCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#define STRSCAN_MAXSET 8 //largest char set the vector firstof compares byte by byte (bigger sets use a bitmap)
+
+static inline int _is_space(char c) {
+  return c == ' ' || (unsigned char)(c - 9) <= 4;
+}
+
+//scalar kernels -- the helpers.c loops
+static const char *_firstspace_scalar(const char *h, unsigned int n) {
+  for(;n;++h,--n) {
+    if (is_space(*h)) return h;
+  }
+  return NULL;
+}
+static const char *_firstnotspace_scalar(const char *h, unsigned int n) {
+  for(;n;++h,--n) {
+    if (!is_space(*h)) return h;
+  }
+  return NULL;
+}
+static const char *_lastnotspace_scalar(const char *h, unsigned int n) {
+  while (n--) {
+    if (!is_space(h[n])) return h+n;
+  }
+  return NULL;
+}
+
+//shared pieces for the vector kernels
+static const char *_find_tail(const char *h, unsigned int n, const char *needle, unsigned int needlen, unsigned int i) {
+  for(; i + needlen <= n; ++i) {
+    if (h[i] == needle[0] && !memcmp(h+i+1,needle+1,needlen-1)) return h+i;
+  }
+  return NULL;
+}
+static const char *_firstof_table(const char *h, unsigned int n, const char *chars, unsigned int charsn) {
+  uint64_t set[4] = {0,0,0,0};
+  unsigned int i;
+  for(i=0;i<charsn;++i) set[(unsigned char)chars[i] >> 6] |= 1ull << (chars[i] & 63);
+  for(i=0;i<n;++i) {
+    if (set[(unsigned char)h[i] >> 6] & (1ull << (h[i] & 63))) return h+i;
+  }
+  return NULL;
+}
+
+#ifdef STRSCAN_X86
+
+#define SIMD_SFX(name) name##_sse2
+#define SIMD_TARGET __attribute__((target("sse2")))
+#define SIMD_V __m128i
+#define SIMD_W 16
+#define SIMD_FULL 0xffffu
+#define SIMD_LOAD(p) _mm_loadu_si128((const __m128i*)(p))
+#define SIMD_SET1(c) _mm_set1_epi8(c)
+#define SIMD_EQ(a,b) _mm_cmpeq_epi8(a,b)
+#define SIMD_AND(a,b) _mm_and_si128(a,b)
+#define SIMD_OR(a,b) _mm_or_si128(a,b)
+#define SIMD_SUB(a,b) _mm_sub_epi8(a,b)
+#define SIMD_MINU(a,b) _mm_min_epu8(a,b)
+#define SIMD_MASK(v) _mm_movemask_epi8(v)
+#include "val_strscan_simd.h"
+
+#define SIMD_SFX(name) name##_avx2
+#define SIMD_TARGET __attribute__((target("avx2")))
+#define SIMD_V __m256i
+#define SIMD_W 32
+#define SIMD_FULL 0xffffffffu
+#define SIMD_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define SIMD_SET1(c) _mm256_set1_epi8(c)
+#define SIMD_EQ(a,b) _mm256_cmpeq_epi8(a,b)
+#define SIMD_AND(a,b) _mm256_and_si256(a,b)
+#define SIMD_OR(a,b) _mm256_or_si256(a,b)
+#define SIMD_SUB(a,b) _mm256_sub_epi8(a,b)
+#define SIMD_MINU(a,b) _mm256_min_epu8(a,b)
+#define SIMD_MASK(v) _mm256_movemask_epi8(v)
+#include "val_strscan_simd.h"
+
+#endif
+
+struct strscan_ops {
+  const char *(*find)(const char*, unsigned int, const char*, unsigned int);
+  const char *(*firstof)(const char*, unsigned int, const char*, unsigned int);
+  const char *(*firstspace)(const char*, unsigned int);
+  const char *(*firstnotspace)(const char*, unsigned int);
+  const char *(*lastnotspace)(const char*, unsigned int);
+};
+
+static const struct strscan_ops _strscan_levels[] = {
+  [STRSCAN_SCALAR] = { strnstrn, strnfirstof, _firstspace_scalar, _firstnotspace_scalar, _lastnotspace_scalar },
+#ifdef STRSCAN_X86
+  [STRSCAN_SSE2] = { _find_sse2, _firstof_sse2, _firstspace_sse2, _firstnotspace_sse2, _lastnotspace_sse2 },
+  [STRSCAN_AVX2] = { _find_avx2, _firstof_avx2, _firstspace_avx2, _firstnotspace_avx2, _lastnotspace_avx2 },
+#endif
+};
+
+//starts scalar so kernels work before strscan_init()
+static const struct strscan_ops *_strscan = &_strscan_levels[STRSCAN_SCALAR];
+static enum strscan_level _level = STRSCAN_SCALAR;
+
+static int _strscan_supported(enum strscan_level level) {
+  switch(level) {
+    case STRSCAN_SCALAR: return 1;
+#ifdef STRSCAN_X86
+    case STRSCAN_SSE2: return __builtin_cpu_supports("sse2");
+    case STRSCAN_AVX2: return __builtin_cpu_supports("avx2");
+#endif
+    default: return 0;
+  }
+}
+
+void strscan_init() {
+  const char *s;
+  enum strscan_level level;
+#ifdef STRSCAN_X86
+  __builtin_cpu_init();
+#endif
+  if ((s = getenv("CONCAT_SIMD"))) {
+    if (!strcmp(s,"avx2")) level = STRSCAN_AVX2;
+    else if (!strcmp(s,"sse2")) level = STRSCAN_SSE2;
+    else level = STRSCAN_SCALAR;
+    if (!strscan_set_level(level)) return;
+  }
+  for(level = STRSCAN_AVX2; strscan_set_level(level); --level);
+}
+
+enum strscan_level strscan_level() {
+  return _level;
+}
+
+const char *strscan_level_name(enum strscan_level level) {
+  switch(level) {
+    case STRSCAN_SSE2: return "sse2";
+    case STRSCAN_AVX2: return "avx2";
+    default: return "scalar";
+  }
+}
+
+int strscan_set_level(enum strscan_level level) {
+  if (!_strscan_supported(level)) return -1;
+  _level = level;
+  _strscan = &_strscan_levels[level];
+  return 0;
+}
+
+const char *strscan_find(const char *haystack, unsigned int haystackn, const char *needle, unsigned int needlen) {
+  return _strscan->find(haystack,haystackn,needle,needlen);
+}
+const char *strscan_firstof(const char *haystack, unsigned int haystackn, const char *chars, unsigned int charsn) {
+  return _strscan->firstof(haystack,haystackn,chars,charsn);
+}
+const char *strscan_firstspace(const char *haystack, unsigned int haystackn) {
+  return _strscan->firstspace(haystack,haystackn);
+}
+const char *strscan_firstnotspace(const char *haystack, unsigned int haystackn) {
+  return _strscan->firstnotspace(haystack,haystackn);
+}
+const char *strscan_lastnotspace(const char *haystack, unsigned int haystackn) {
+  return _strscan->lastnotspace(haystack,haystackn);
+}
@@ -0,0 +1,38 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef __VAL_STRSCAN_H__
+#define __VAL_STRSCAN_H__ 1
+
+// val_strscan - string search kernels used by find/split/trim
+// - each kernel has a scalar version (the byte-at-a-time helpers.c loops) plus SSE2 and AVX2 versions on x86
+// - strscan_init() picks the best level the cpu supports (or CONCAT_SIMD=scalar|sse2|avx2 to force one, e.g. for benchmarking)
+// - kernels return a pointer into haystack (or NULL if not found) like the strn* helpers
+// - whitespace is the C locale isspace() set (space, \t, \n, \v, \f, \r)
+//
+
+enum strscan_level { STRSCAN_SCALAR, STRSCAN_SSE2, STRSCAN_AVX2 };
+
+void strscan_init();
+enum strscan_level strscan_level();
+const char *strscan_level_name(enum strscan_level level);
+int strscan_set_level(enum strscan_level level); //returns 0, or -1 if the cpu doesn't support level
+
+const char *strscan_find(const char *haystack, unsigned int haystackn, const char *needle, unsigned int needlen); //first occurrence of needle
+const char *strscan_firstof(const char *haystack, unsigned int haystackn, const char *chars, unsigned int charsn); //first byte that is in chars
+const char *strscan_firstspace(const char *haystack, unsigned int haystackn);
+const char *strscan_firstnotspace(const char *haystack, unsigned int haystackn);
+const char *strscan_lastnotspace(const char *haystack, unsigned int haystackn);
+
+#endif
@@ -0,0 +1,120 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+// val_strscan_simd.h - vector kernel template (only included by val_strscan.c, once per vector width)
+// - the includer defines the vector type, width, intrinsics and function suffix, then we undefine them at the end
+// - each kernel does whole vectors (never reading outside the haystack) and finishes the tail with the scalar loop
+//
+// required defines:
+//   SIMD_SFX(name) - name##_sse2 / name##_avx2
+//   SIMD_TARGET - function target attribute
+//   SIMD_V - vector type
+//   SIMD_W - vector width in bytes
+//   SIMD_FULL - movemask with every byte set
+//   SIMD_LOAD(p), SIMD_SET1(c), SIMD_EQ(a,b), SIMD_AND(a,b), SIMD_OR(a,b), SIMD_SUB(a,b), SIMD_MINU(a,b), SIMD_MASK(v)
+
+//mask of whitespace bytes (' ', or \t..\r which is (c-9) <= 4 unsigned)
+SIMD_TARGET static inline SIMD_V SIMD_SFX(_space)(SIMD_V v) {
+  SIMD_V t = SIMD_SUB(v,SIMD_SET1(9));
+  return SIMD_OR(SIMD_EQ(v,SIMD_SET1(' ')),SIMD_EQ(SIMD_MINU(t,SIMD_SET1(4)),t));
+}
+
+SIMD_TARGET static const char *SIMD_SFX(_firstof)(const char *h, unsigned int n, const char *chars, unsigned int charsn) {
+  SIMD_V set[STRSCAN_MAXSET];
+  unsigned int i = 0, j;
+  if (!charsn) return NULL;
+  if (charsn > STRSCAN_MAXSET) return _firstof_table(h,n,chars,charsn);
+  for(j=0;j<charsn;++j) set[j] = SIMD_SET1(chars[j]);
+  for(; i+SIMD_W <= n; i += SIMD_W) {
+    SIMD_V v = SIMD_LOAD(h+i);
+    SIMD_V m = SIMD_EQ(v,set[0]);
+    for(j=1;j<charsn;++j) m = SIMD_OR(m,SIMD_EQ(v,set[j]));
+    unsigned int mask = (unsigned int)SIMD_MASK(m);
+    if (mask) return h + i + __builtin_ctz(mask);
+  }
+  for(; i<n; ++i) {
+    if (strnchr(chars,charsn,h[i])) return h+i;
+  }
+  return NULL;
+}
+
+//first+last byte filter, then memcmp the middle of each candidate
+SIMD_TARGET static const char *SIMD_SFX(_find)(const char *h, unsigned int n, const char *needle, unsigned int needlen) {
+  if (!needlen) return h;
+  else if (needlen > n) return NULL;
+  else if (needlen == 1) return SIMD_SFX(_firstof)(h,n,needle,1);
+  SIMD_V first = SIMD_SET1(needle[0]);
+  SIMD_V last = SIMD_SET1(needle[needlen-1]);
+  unsigned int i = 0;
+  for(; i + needlen - 1 + SIMD_W <= n; i += SIMD_W) {
+    unsigned int mask = (unsigned int)SIMD_MASK(SIMD_AND(SIMD_EQ(SIMD_LOAD(h+i),first),SIMD_EQ(SIMD_LOAD(h+i+needlen-1),last)));
+    while (mask) {
+      unsigned int k = i + __builtin_ctz(mask);
+      if (!memcmp(h+k+1,needle+1,needlen-2)) return h+k;
+      mask &= mask-1;
+    }
+  }
+  return _find_tail(h,n,needle,needlen,i);
+}
+
+SIMD_TARGET static const char *SIMD_SFX(_firstspace)(const char *h, unsigned int n) {
+  unsigned int i = 0;
+  for(; i+SIMD_W <= n; i += SIMD_W) {
+    unsigned int mask = (unsigned int)SIMD_MASK(SIMD_SFX(_space)(SIMD_LOAD(h+i)));
+    if (mask) return h + i + __builtin_ctz(mask);
+  }
+  for(; i<n; ++i) {
+    if (_is_space(h[i])) return h+i;
+  }
+  return NULL;
+}
+
+SIMD_TARGET static const char *SIMD_SFX(_firstnotspace)(const char *h, unsigned int n) {
+  unsigned int i = 0;
+  for(; i+SIMD_W <= n; i += SIMD_W) {
+    unsigned int mask = ~(unsigned int)SIMD_MASK(SIMD_SFX(_space)(SIMD_LOAD(h+i))) & SIMD_FULL;
+    if (mask) return h + i + __builtin_ctz(mask);
+  }
+  for(; i<n; ++i) {
+    if (!_is_space(h[i])) return h+i;
+  }
+  return NULL;
+}
+
+SIMD_TARGET static const char *SIMD_SFX(_lastnotspace)(const char *h, unsigned int n) {
+  unsigned int i = n;
+  while (i >= SIMD_W) {
+    i -= SIMD_W;
+    unsigned int mask = ~(unsigned int)SIMD_MASK(SIMD_SFX(_space)(SIMD_LOAD(h+i))) & SIMD_FULL;
+    if (mask) return h + i + 31 - __builtin_clz(mask);
+  }
+  while (i--) {
+    if (!_is_space(h[i])) return h+i;
+  }
+  return NULL;
+}
+
+#undef SIMD_SFX
+#undef SIMD_TARGET
+#undef SIMD_V
+#undef SIMD_W
+#undef SIMD_FULL
+#undef SIMD_LOAD
+#undef SIMD_SET1
+#undef SIMD_EQ
+#undef SIMD_AND
+#undef SIMD_OR
+#undef SIMD_SUB
+#undef SIMD_MINU
+#undef SIMD_MASK
@@ -0,0 +1,515 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "val_vec.h"
+#include "val_list.h"
+#include "val_int.h"
+#include "val_num.h"
+#include "val_printf.h"
+#include "val_strscan.h"
+#include "helpers.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VEC_X86 1
+#include <immintrin.h>
+#endif
+
+#define VEC_DBLP(b) ((double*)(b)->p)
+#define VEC_INTP(b) ((int64_t*)(b)->p)
+
+//scalar kernels
+#define VEC_SCALAR_DBL_BINOP(name,COP) \
+static void name##_vv_scalar(double *d, const double *a, const double *b, unsigned int n) { \
+  for(unsigned int i=0; i<n; ++i) d[i] = a[i] COP b[i]; \
+} \
+static void name##_vs_scalar(double *d, const double *a, double s, unsigned int n) { \
+  for(unsigned int i=0; i<n; ++i) d[i] = a[i] COP s; \
+} \
+static void name##_sv_scalar(double *d, double s, const double *b, unsigned int n) { \
+  for(unsigned int i=0; i<n; ++i) d[i] = s COP b[i]; \
+}
+VEC_SCALAR_DBL_BINOP(_vec_dbl_add,+)
+VEC_SCALAR_DBL_BINOP(_vec_dbl_sub,-)
+VEC_SCALAR_DBL_BINOP(_vec_dbl_mul,*)
+VEC_SCALAR_DBL_BINOP(_vec_dbl_div,/)
+#undef VEC_SCALAR_DBL_BINOP
+
+//int64 ops wrap (through uint64_t, since signed overflow is undefined)
+#define VEC_SCALAR_INT_BINOP(name,COP) \
+static void name##_vv_scalar(int64_t *d, const int64_t *a, const int64_t *b, unsigned int n) { \
+  for(unsigned int i=0; i<n; ++i) d[i] = (int64_t)((uint64_t)a[i] COP (uint64_t)b[i]); \
+} \
+static void name##_vs_scalar(int64_t *d, const int64_t *a, int64_t s, unsigned int n) { \
+  for(unsigned int i=0; i<n; ++i) d[i] = (int64_t)((uint64_t)a[i] COP (uint64_t)s); \
+} \
+static void name##_sv_scalar(int64_t *d, int64_t s, const int64_t *b, unsigned int n) { \
+  for(unsigned int i=0; i<n; ++i) d[i] = (int64_t)((uint64_t)s COP (uint64_t)b[i]); \
+}
+VEC_SCALAR_INT_BINOP(_vec_int_add,+)
+VEC_SCALAR_INT_BINOP(_vec_int_sub,-)
+VEC_SCALAR_INT_BINOP(_vec_int_mul,*)
+#undef VEC_SCALAR_INT_BINOP
+
+static double _vec_dbl_sum_scalar(const double *a, unsigned int n) {
+  double r = 0;
+  for(unsigned int i=0; i<n; ++i) r += a[i];
+  return r;
+}
+static int64_t _vec_int_sum_scalar(const int64_t *a, unsigned int n) {
+  uint64_t r = 0;
+  for(unsigned int i=0; i<n; ++i) r += (uint64_t)a[i];
+  return (int64_t)r;
+}
+static double _vec_dbl_sqdev_scalar(const double *a, double m, unsigned int n) {
+  double r = 0;
+  for(unsigned int i=0; i<n; ++i) r += (a[i]-m)*(a[i]-m);
+  return r;
+}
+static double _vec_dbl_dot_scalar(const double *a, const double *b, unsigned int n) {
+  double r = 0;
+  for(unsigned int i=0; i<n; ++i) r += a[i]*b[i];
+  return r;
+}
+static void _vec_dbl_minmax_scalar(const double *a, unsigned int n, double *min, double *max) {
+  double rmin = a[0], rmax = a[0];
+  for(unsigned int i=1; i<n; ++i) {
+    if (a[i] < rmin || rmin != rmin) rmin = a[i];
+    if (a[i] > rmax || rmax != rmax) rmax = a[i];
+  }
+  *min = rmin;
+  *max = rmax;
+}
+static void _vec_int_minmax_scalar(const int64_t *a, unsigned int n, int64_t *min, int64_t *max) {
+  int64_t rmin = a[0], rmax = a[0];
+  for(unsigned int i=1; i<n; ++i) {
+    if (a[i] < rmin) rmin = a[i];
+    if (a[i] > rmax) rmax = a[i];
+  }
+  *min = rmin;
+  *max = rmax;
+}
+
+#ifdef VEC_X86
+
+#define SIMD_SFX(name) name##_sse2
+#define SIMD_TARGET __attribute__((target("sse2")))
+#define SIMD_VD __m128d
+#define SIMD_VI __m128i
+#define SIMD_WD 2
+#define SIMD_LOADD(p) _mm_loadu_pd(p)
+#define SIMD_STORED(p,v) _mm_storeu_pd(p,v)
+#define SIMD_SET1D(x) _mm_set1_pd(x)
+#define SIMD_ADDD(a,b) _mm_add_pd(a,b)
+#define SIMD_SUBD(a,b) _mm_sub_pd(a,b)
+#define SIMD_MULD(a,b) _mm_mul_pd(a,b)
+#define SIMD_DIVD(a,b) _mm_div_pd(a,b)
+#define SIMD_MIND(a,b) _mm_min_pd(a,b)
+#define SIMD_MAXD(a,b) _mm_max_pd(a,b)
+#define SIMD_LOADI(p) _mm_loadu_si128((const __m128i*)(p))
+#define SIMD_STOREI(p,v) _mm_storeu_si128((__m128i*)(p),v)
+#define SIMD_SET1I(x) _mm_set1_epi64x(x)
+#define SIMD_ADDI(a,b) _mm_add_epi64(a,b)
+#define SIMD_SUBI(a,b) _mm_sub_epi64(a,b)
+#include "val_vec_simd.h"
+
+#define SIMD_SFX(name) name##_avx2
+#define SIMD_TARGET __attribute__((target("avx2")))
+#define SIMD_VD __m256d
+#define SIMD_VI __m256i
+#define SIMD_WD 4
+#define SIMD_LOADD(p) _mm256_loadu_pd(p)
+#define SIMD_STORED(p,v) _mm256_storeu_pd(p,v)
+#define SIMD_SET1D(x) _mm256_set1_pd(x)
+#define SIMD_ADDD(a,b) _mm256_add_pd(a,b)
+#define SIMD_SUBD(a,b) _mm256_sub_pd(a,b)
+#define SIMD_MULD(a,b) _mm256_mul_pd(a,b)
+#define SIMD_DIVD(a,b) _mm256_div_pd(a,b)
+#define SIMD_MIND(a,b) _mm256_min_pd(a,b)
+#define SIMD_MAXD(a,b) _mm256_max_pd(a,b)
+#define SIMD_LOADI(p) _mm256_loadu_si256((const __m256i*)(p))
+#define SIMD_STOREI(p,v) _mm256_storeu_si256((__m256i*)(p),v)
+#define SIMD_SET1I(x) _mm256_set1_epi64x(x)
+#define SIMD_ADDI(a,b) _mm256_add_epi64(a,b)
+#define SIMD_SUBI(a,b) _mm256_sub_epi64(a,b)
+#define SIMD_CMPGTI(a,b) _mm256_cmpgt_epi64(a,b)
+#define SIMD_BLENDI(a,b,mask) _mm256_blendv_epi8(a,b,mask)
+#include "val_vec_simd.h"
+
+#endif
+
+typedef void (vec_dbl_vv_f)(double*, const double*, const double*, unsigned int);
+typedef void (vec_dbl_vs_f)(double*, const double*, double, unsigned int);
+typedef void (vec_dbl_sv_f)(double*, double, const double*, unsigned int);
+typedef void (vec_int_vv_f)(int64_t*, const int64_t*, const int64_t*, unsigned int);
+typedef void (vec_int_vs_f)(int64_t*, const int64_t*, int64_t, unsigned int);
+typedef void (vec_int_sv_f)(int64_t*, int64_t, const int64_t*, unsigned int);
+
+//int mul (no 64-bit vector multiply before avx512) and div are scalar at every level
+struct vec_kernels {
+  vec_dbl_vv_f *dbl_vv[4];
+  vec_dbl_vs_f *dbl_vs[4];
+  vec_dbl_sv_f *dbl_sv[4];
+  vec_int_vv_f *int_vv[3];
+  vec_int_vs_f *int_vs[3];
+  vec_int_sv_f *int_sv[3];
+  double (*dbl_sum)(const double*, unsigned int);
+  int64_t (*int_sum)(const int64_t*, unsigned int);
+  double (*dbl_sqdev)(const double*, double, unsigned int);
+  double (*dbl_dot)(const double*, const double*, unsigned int);
+  void (*dbl_minmax)(const double*, unsigned int, double*, double*);
+  void (*int_minmax)(const int64_t*, unsigned int, int64_t*, int64_t*);
+};
+
+#define VEC_KERNELS(sfx) { \
+  { _vec_dbl_add_vv##sfx, _vec_dbl_sub_vv##sfx, _vec_dbl_mul_vv##sfx, _vec_dbl_div_vv##sfx }, \
+  { _vec_dbl_add_vs##sfx, _vec_dbl_sub_vs##sfx, _vec_dbl_mul_vs##sfx, _vec_dbl_div_vs##sfx }, \
+  { _vec_dbl_add_sv##sfx, _vec_dbl_sub_sv##sfx, _vec_dbl_mul_sv##sfx, _vec_dbl_div_sv##sfx }, \
+  { _vec_int_add_vv##sfx, _vec_int_sub_vv##sfx, _vec_int_mul_vv_scalar }, \
+  { _vec_int_add_vs##sfx, _vec_int_sub_vs##sfx, _vec_int_mul_vs_scalar }, \
+  { _vec_int_add_sv##sfx, _vec_int_sub_sv##sfx, _vec_int_mul_sv_scalar }, \
+  _vec_dbl_sum##sfx, _vec_int_sum##sfx, _vec_dbl_sqdev##sfx, _vec_dbl_dot##sfx, \
+  _vec_dbl_minmax##sfx, _vec_int_minmax##sfx }
+
+static const struct vec_kernels _vec_levels[] = {
+  [STRSCAN_SCALAR] = VEC_KERNELS(_scalar),
+#ifdef VEC_X86
+  [STRSCAN_SSE2] = VEC_KERNELS(_sse2),
+  [STRSCAN_AVX2] = VEC_KERNELS(_avx2),
+#endif
+};
+
+static inline const struct vec_kernels *_vec_kernels() {
+  return &_vec_levels[strscan_level()];
+}
+
+
+static vbuf_t *_vbuf_alloc(unsigned int n) {
+  vbuf_t *b = malloc(sizeof(vbuf_t) + sizeof(uint64_t)*(n ? n : 1));
+  if (!b) return NULL;
+  b->size = n;
+  b->refcount = 1;
+  return b;
+}
+static void _vbuf_release(vbuf_t *b) {
+  if (0 == refcount_dec(b->refcount)) free(b);
+}
+
+//double copy of an int vec (for mixed int/double math)
+static vbuf_t *_vbuf_todbl(valstruct_t *vec) {
+  unsigned int i, n = vec->v.vec.len;
+  vbuf_t *b;
+  if (!(b = _vbuf_alloc(n))) return NULL;
+  for(i=0;i<n;++i) VEC_DBLP(b)[i] = (double)VEC_INTP(vec->v.vec.buf)[i];
+  return b;
+}
+
+//element i as a double (for comparing mixed vecs)
+static double _vec_dbl_at(valstruct_t *vec, unsigned int i) {
+  return vec->v.vec.kind == VEC_INT ? (double)VEC_INTP(vec->v.vec.buf)[i] : VEC_DBLP(vec->v.vec.buf)[i];
+}
+
+err_t val_vec_init(val_t *ret, enum vec_kind kind, unsigned int len) {
+  valstruct_t *v;
+  if (!(v = _valstruct_alloc())) return _throw(ERR_MALLOC);
+  if (!(v->v.vec.buf = _vbuf_alloc(len))) {
+    _valstruct_release(v);
+    return _throw(ERR_MALLOC);
+  }
+  v->type = TYPE_VEC;
+  v->v.vec.len = len;
+  v->v.vec.kind = kind;
+  *ret = __vec_val(v);
+  return 0;
+}
+
+err_t val_vec_from_list(val_t *ret, valstruct_t *lst) {
+  err_t e;
+  unsigned int i, n = _val_lst_len(lst);
+  val_t *p = n ? _val_lst_begin(lst) : NULL;
+  enum vec_kind kind = VEC_INT;
+  valstruct_t *v;
+  for(i=0;i<n;++i) {
+    if (val_is_double(p[i])) kind = VEC_DBL;
+    else if (!val_is_integer(p[i])) return _throw(ERR_BADTYPE);
+  }
+  if ((e = val_vec_init(ret,kind,n))) return e;
+  v = __vec_ptr(*ret);
+  if (kind == VEC_INT) {
+    for(i=0;i<n;++i) VEC_INTP(v->v.vec.buf)[i] = val_int64(p[i]);
+  } else {
+    for(i=0;i<n;++i) VEC_DBLP(v->v.vec.buf)[i] = val_num_dbl(p[i]);
+  }
+  return 0;
+}
+
+err_t val_vec_get(val_t *ret, valstruct_t *vec, unsigned int i) {
+  if (vec->v.vec.kind == VEC_INT) return val_int64_init(ret,VEC_INTP(vec->v.vec.buf)[i]);
+  *ret = __dbl_val(VEC_DBLP(vec->v.vec.buf)[i]);
+  return 0;
+}
+
+err_t val_vec_to_list(val_t *ret, valstruct_t *vec) {
+  err_t e;
+  unsigned int i, n = vec->v.vec.len;
+  val_t *p;
+  *ret = val_empty_list();
+  if (!n) return 0;
+  if ((e = _val_lst_rextend(__lst_ptr(*ret),n,&p))) {
+    val_destroy(*ret);
+    return e;
+  }
+  for(i=0;i<n;++i) {
+    if ((e = val_vec_get(p+i,vec,i))) { //the rest of the list is still ints
+      for(;i<n;++i) p[i] = __int_val(0);
+      val_destroy(*ret);
+      return e;
+    }
+  }
+  return 0;
+}
+
+//int division truncates like ints (the caller checks for zero divisors first)
+static void _vec_int_div(int64_t *d, const int64_t *a, int64_t as, const int64_t *b, int64_t bs, unsigned int n) {
+  unsigned int i;
+  for(i=0;i<n;++i) {
+    int64_t x = a ? a[i] : as, y = b ? b[i] : bs;
+    d[i] = (y == -1) ? (int64_t)(0 - (uint64_t)x) : x / y; //INT64_MIN / -1 wraps like the other ops
+  }
+}
+
+err_t val_vec_binop(val_t *lhs, val_t rhs, enum vec_op op) {
+  const struct vec_kernels *k = _vec_kernels();
+  valstruct_t *a = val_is_vec(*lhs) ? __vec_ptr(*lhs) : NULL;
+  valstruct_t *b = val_is_vec(rhs) ? __vec_ptr(rhs) : NULL;
+  enum vec_kind kind = VEC_INT;
+  vbuf_t *dst, *ta = NULL, *tb = NULL;
+  unsigned int n;
+
+  if (!a && !b) return _throw(ERR_BADTYPE);
+  if (!a && !val_is_integer(*lhs) && !val_is_double(*lhs)) return _throw(ERR_BADTYPE);
+  if (!b && !val_is_integer(rhs) && !val_is_double(rhs)) return _throw(ERR_BADTYPE);
+  if (a && b && a->v.vec.len != b->v.vec.len) return _throw(ERR_BADARGS);
+  n = a ? a->v.vec.len : b->v.vec.len;
+
+  if (a ? a->v.vec.kind == VEC_DBL : val_is_double(*lhs)) kind = VEC_DBL;
+  if (b ? b->v.vec.kind == VEC_DBL : val_is_double(rhs)) kind = VEC_DBL;
+
+  if (kind == VEC_INT && op == VEC_DIV) { //divide by zero fails before we touch either operand
+    if (b) {
+      for(unsigned int i=0;i<n;++i) if (!VEC_INTP(b->v.vec.buf)[i]) return _throw(ERR_BADARGS);
+    } else if (!val_int64(rhs)) {
+      return _throw(ERR_BADARGS);
+    }
+  }
+
+  //output goes to an operand buffer we own outright (of the result kind), else a new one
+  if (a && a->v.vec.kind == kind && a->v.vec.buf->refcount == 1) dst = a->v.vec.buf;
+  else if (b && b->v.vec.kind == kind && b->v.vec.buf->refcount == 1) dst = b->v.vec.buf;
+  else if (!(dst = _vbuf_alloc(n))) return _throw(ERR_MALLOC);
+
+  if (kind == VEC_INT) {
+    int64_t *d = VEC_INTP(dst);
+    if (op == VEC_DIV) _vec_int_div(d, a ? VEC_INTP(a->v.vec.buf) : NULL, a ? 0 : val_int64(*lhs), b ? VEC_INTP(b->v.vec.buf) : NULL, b ? 0 : val_int64(rhs), n);
+    else if (a && b) k->int_vv[op](d,VEC_INTP(a->v.vec.buf),VEC_INTP(b->v.vec.buf),n);
+    else if (a) k->int_vs[op](d,VEC_INTP(a->v.vec.buf),val_int64(rhs),n);
+    else k->int_sv[op](d,val_int64(*lhs),VEC_INTP(b->v.vec.buf),n);
+  } else {
+    const double *pa = NULL, *pb = NULL;
+    double sa = 0, sb = 0;
+    if (a && a->v.vec.kind == VEC_INT && !(ta = _vbuf_todbl(a))) goto bad_malloc;
+    if (b && b->v.vec.kind == VEC_INT && !(tb = _vbuf_todbl(b))) goto bad_malloc;
+    if (a) pa = ta ? VEC_DBLP(ta) : VEC_DBLP(a->v.vec.buf);
+    else sa = val_num_dbl(*lhs);
+    if (b) pb = tb ? VEC_DBLP(tb) : VEC_DBLP(b->v.vec.buf);
+    else sb = val_num_dbl(rhs);
+
+    if (a && b) k->dbl_vv[op](VEC_DBLP(dst),pa,pb,n);
+    else if (a) k->dbl_vs[op](VEC_DBLP(dst),pa,sb,n);
+    else k->dbl_sv[op](VEC_DBLP(dst),sa,pb,n);
+    if (ta) _vbuf_release(ta);
+    if (tb) _vbuf_release(tb);
+  }
+
+  //result replaces lhs (reusing whichever vec valstruct we have)
+  if (a) {
+    if (dst != a->v.vec.buf) {
+      if (b && dst == b->v.vec.buf) refcount_inc(dst->refcount); //rhs still holds a ref until we destroy it
+      _vbuf_release(a->v.vec.buf);
+      a->v.vec.buf = dst;
+    }
+    a->v.vec.kind = kind;
+    val_destroy(rhs);
+  } else {
+    if (dst != b->v.vec.buf) {
+      _vbuf_release(b->v.vec.buf);
+      b->v.vec.buf = dst;
+    }
+    b->v.vec.kind = kind;
+    __val_reset(lhs,__vec_val(b)); //lhs may be a heap int64
+    __val_dbg_destroy(rhs);
+  }
+  return 0;
+
+bad_malloc:
+  if (ta) _vbuf_release(ta);
+  if ((!a || dst != a->v.vec.buf) && (!b || dst != b->v.vec.buf)) _vbuf_release(dst);
+  return _throw(ERR_MALLOC);
+}
+
+err_t val_vec_reduce_parse(enum vec_reduce *r, const char *name, unsigned int len) {
+  static const struct { const char *name; enum vec_reduce r; } modes[] = {
+    {"sum",VEC_SUM}, {"min",VEC_MIN}, {"max",VEC_MAX}, {"mean",VEC_MEAN}, {"variance",VEC_VARIANCE},
+  };
+  unsigned int i;
+  for(i=0;i<sizeof(modes)/sizeof(modes[0]);++i) {
+    if (len == strlen(modes[i].name) && !memcmp(name,modes[i].name,len)) {
+      *r = modes[i].r;
+      return 0;
+    }
+  }
+  return _throw(ERR_BADARGS);
+}
+
+err_t val_vec_reduce(val_t *ret, valstruct_t *vec, enum vec_reduce r) {
+  const struct vec_kernels *k = _vec_kernels();
+  unsigned int n = vec->v.vec.len;
+  vbuf_t *buf = vec->v.vec.buf, *t;
+  int isint = vec->v.vec.kind == VEC_INT;
+
+  if (r == VEC_SUM) {
+    if (isint) return val_int64_init(ret,k->int_sum(VEC_INTP(buf),n));
+    *ret = __dbl_val(k->dbl_sum(VEC_DBLP(buf),n));
+    return 0;
+  }
+  if (!n) return _throw(ERR_EMPTY);
+  switch(r) {
+    case VEC_MIN: case VEC_MAX:
+      if (isint) {
+        int64_t min,max;
+        k->int_minmax(VEC_INTP(buf),n,&min,&max);
+        return val_int64_init(ret,r == VEC_MIN ? min : max);
+      } else {
+        double min,max;
+        k->dbl_minmax(VEC_DBLP(buf),n,&min,&max);
+        *ret = __dbl_val(r == VEC_MIN ? min : max);
+      }
+      return 0;
+    case VEC_MEAN:
+      *ret = __dbl_val((isint ? (double)k->int_sum(VEC_INTP(buf),n) : k->dbl_sum(VEC_DBLP(buf),n)) / n);
+      return 0;
+    case VEC_VARIANCE:
+      if (n < 2) return _throw(ERR_BADARGS);
+      if (isint) {
+        if (!(t = _vbuf_todbl(vec))) return _throw(ERR_MALLOC);
+      } else {
+        t = buf;
+      }
+      {
+        double m = k->dbl_sum(VEC_DBLP(t),n) / n;
+        *ret = __dbl_val(k->dbl_sqdev(VEC_DBLP(t),m,n) / (n - 1));
+      }
+      if (t != buf) _vbuf_release(t);
+      return 0;
+    default:
+      return _throw(ERR_BADARGS);
+  }
+}
+
+err_t val_vec_dot(val_t *ret, valstruct_t *a, valstruct_t *b) {
+  unsigned int i, n = a->v.vec.len;
+  vbuf_t *ta = NULL, *tb = NULL;
+  if (n != b->v.vec.len) return _throw(ERR_BADARGS);
+  if (a->v.vec.kind == VEC_INT && b->v.vec.kind == VEC_INT) {
+    const int64_t *pa = VEC_INTP(a->v.vec.buf), *pb = VEC_INTP(b->v.vec.buf);
+    uint64_t r = 0;
+    for(i=0;i<n;++i) r += (uint64_t)pa[i] * (uint64_t)pb[i];
+    return val_int64_init(ret,(int64_t)r);
+  }
+  if (a->v.vec.kind == VEC_INT && !(ta = _vbuf_todbl(a))) return _throw(ERR_MALLOC);
+  if (b->v.vec.kind == VEC_INT && !(tb = _vbuf_todbl(b))) {
+    if (ta) _vbuf_release(ta);
+    return _throw(ERR_MALLOC);
+  }
+  *ret = __dbl_val(_vec_kernels()->dbl_dot(VEC_DBLP(ta ? ta : a->v.vec.buf),VEC_DBLP(tb ? tb : b->v.vec.buf),n));
+  if (ta) _vbuf_release(ta);
+  if (tb) _vbuf_release(tb);
+  return 0;
+}
+
+unsigned int _val_vec_len(valstruct_t *vec) {
+  return vec->v.vec.len;
+}
+
+int _val_vec_eq(valstruct_t *a, valstruct_t *b) {
+  unsigned int i, n = a->v.vec.len;
+  if (n != b->v.vec.len) return 0;
+  if (a->v.vec.buf == b->v.vec.buf) return 1;
+  if (a->v.vec.kind == VEC_INT && b->v.vec.kind == VEC_INT) return !memcmp(VEC_INTP(a->v.vec.buf),VEC_INTP(b->v.vec.buf),n*sizeof(int64_t));
+  for(i=0;i<n;++i) {
+    if (_vec_dbl_at(a,i) != _vec_dbl_at(b,i)) return 0;
+  }
+  return 1;
+}
+
+err_t _val_vec_clone(val_t *ret, valstruct_t *orig) {
+  valstruct_t *v;
+  if (!(v = _valstruct_alloc())) return _throw(ERR_MALLOC);
+  v->type = TYPE_VEC;
+  v->v.vec = orig->v.vec;
+  refcount_inc(v->v.vec.buf->refcount);
+  *ret = __vec_val(v);
+  return 0;
+}
+
+void _val_vec_destroy(valstruct_t *vec) {
+  _vbuf_release(vec->v.vec.buf);
+  _valstruct_release(vec);
+}
+
+int val_vec_fprintf(valstruct_t *vec, FILE *file, const fmt_t *fmt) {
+  int rlen = 0, r;
+  unsigned int i;
+  if (0 > (r = val_fprint_(file,"vec(",4))) return r;
+  rlen += r;
+  for(i=0;i<vec->v.vec.len;++i) {
+    if (0 > (r = val_fprint_ch(file,' '))) return r;
+    rlen += r;
+    if (vec->v.vec.kind == VEC_INT) r = val_int64_fprintf(VEC_INTP(vec->v.vec.buf)[i],file,fmt_V);
+    else r = val_fprintf_(__dbl_val(VEC_DBLP(vec->v.vec.buf)[i]),file,fmt_V);
+    if (0 > r) return r;
+    rlen += r;
+  }
+  if (0 > (r = val_fprint_(file," )",2))) return r;
+  return rlen + r;
+}
+int val_vec_sprintf(valstruct_t *vec, valstruct_t *buf, const fmt_t *fmt) {
+  int rlen = 0, r;
+  unsigned int i;
+  if (0 > (r = val_sprint_(buf,"vec(",4))) return r;
+  rlen += r;
+  for(i=0;i<vec->v.vec.len;++i) {
+    if (0 > (r = val_sprint_ch(buf,' '))) return r;
+    rlen += r;
+    if (vec->v.vec.kind == VEC_INT) r = val_int64_sprintf(VEC_INTP(vec->v.vec.buf)[i],buf,fmt_V);
+    else r = val_sprintf_(__dbl_val(VEC_DBLP(vec->v.vec.buf)[i]),buf,fmt_V);
+    if (0 > r) return r;
+    rlen += r;
+  }
+  if (0 > (r = val_sprint_(buf," )",2))) return r;
+  return rlen + r;
+}
@@ -0,0 +1,51 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef __VAL_VEC_H__
+#define __VAL_VEC_H__ 1
+
+#include "val.h"
+
+// val_vec - packed numeric arrays (vec vals) with SIMD elementwise math and reductions
+// - a vec holds int64 or double elements unboxed (vec_t in val.h), so math over it runs in C loops instead of through map
+// - elementwise + - * / take two vecs of the same length, or a vec and a number (on either side)
+//   - int vecs stay int (int64 math that wraps, and / truncates like ints), anything with a double gives a double vec
+//   - the result reuses an operand's buffer when we are its only owner, so chained math on a fresh vec doesn't allocate
+// - kernels are scalar/SSE2/AVX2, at the CONCAT_SIMD level picked for the string kernels (see val_strscan.h)
+//   - SIMD sums keep a partial sum per lane, so double sums can differ in the last bits between levels
+// - int elements convert back to ints (int32, or wide ints -- see val_int.h)
+// - variance is the sample variance (divides by n-1, like stddev in examples/stats.cat)
+
+enum vec_op { VEC_ADD, VEC_SUB, VEC_MUL, VEC_DIV };
+enum vec_reduce { VEC_SUM, VEC_MIN, VEC_MAX, VEC_MEAN, VEC_VARIANCE };
+
+err_t val_vec_init(val_t *ret, enum vec_kind kind, unsigned int len); //new vec of len (uninitialized) elements
+err_t val_vec_from_list(val_t *ret, valstruct_t *lst); //ints/doubles to vec (BADTYPE for any other val)
+err_t val_vec_to_list(val_t *ret, valstruct_t *vec);
+err_t val_vec_get(val_t *ret, valstruct_t *vec, unsigned int i); //element i as int or double val
+
+err_t val_vec_binop(val_t *lhs, val_t rhs, enum vec_op op); //lhs = lhs op rhs (one of them a vec), consumes rhs on success
+err_t val_vec_reduce(val_t *ret, valstruct_t *vec, enum vec_reduce r);
+err_t val_vec_reduce_parse(enum vec_reduce *r, const char *name, unsigned int len); //"sum", "min", "max", "mean" or "variance"
+err_t val_vec_dot(val_t *ret, valstruct_t *a, valstruct_t *b);
+
+unsigned int _val_vec_len(valstruct_t *vec);
+int _val_vec_eq(valstruct_t *a, valstruct_t *b);
+err_t _val_vec_clone(val_t *ret, valstruct_t *orig);
+void _val_vec_destroy(valstruct_t *vec);
+
+int val_vec_fprintf(valstruct_t *vec, FILE *file, const struct printf_fmt *fmt);
+int val_vec_sprintf(valstruct_t *vec, valstruct_t *buf, const struct printf_fmt *fmt);
+
+#endif
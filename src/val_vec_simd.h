@@ -0,0 +1,200 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+// val_vec_simd.h - vec kernel template (only included by val_vec.c, once per vector width)
+// - same scheme as val_strscan_simd.h: the includer defines the vector types and intrinsics, we undefine them at the end
+// - each kernel does whole vectors with unaligned loads/stores, then finishes the tail with the scalar loop
+// - reductions keep one partial result per lane (so sums are added in a different order than the scalar loop)
+//
+// required defines:
+//   SIMD_SFX(name) - name##_sse2 / name##_avx2
+//   SIMD_TARGET - function target attribute
+//   SIMD_VD, SIMD_VI - double and int64 vector types
+//   SIMD_WD - lanes per vector (doubles or int64s)
+//   SIMD_LOADD(p), SIMD_STORED(p,v), SIMD_SET1D(x), SIMD_ADDD, SIMD_SUBD, SIMD_MULD, SIMD_DIVD, SIMD_MIND, SIMD_MAXD
+//   SIMD_LOADI(p), SIMD_STOREI(p,v), SIMD_SET1I(x), SIMD_ADDI, SIMD_SUBI
+//   SIMD_CMPGTI(a,b) and SIMD_BLENDI(a,b,mask) (optional -- int64 min/max stay scalar without them)
+
+//elementwise double ops -- vec op vec, vec op scalar, scalar op vec
+#define VEC_SIMD_DBL_BINOP(name,VOP,COP) \
+SIMD_TARGET static void SIMD_SFX(name##_vv)(double *d, const double *a, const double *b, unsigned int n) { \
+  unsigned int i = 0; \
+  for(; i+SIMD_WD <= n; i += SIMD_WD) SIMD_STORED(d+i,VOP(SIMD_LOADD(a+i),SIMD_LOADD(b+i))); \
+  for(; i<n; ++i) d[i] = a[i] COP b[i]; \
+} \
+SIMD_TARGET static void SIMD_SFX(name##_vs)(double *d, const double *a, double s, unsigned int n) { \
+  unsigned int i = 0; \
+  SIMD_VD vs = SIMD_SET1D(s); \
+  for(; i+SIMD_WD <= n; i += SIMD_WD) SIMD_STORED(d+i,VOP(SIMD_LOADD(a+i),vs)); \
+  for(; i<n; ++i) d[i] = a[i] COP s; \
+} \
+SIMD_TARGET static void SIMD_SFX(name##_sv)(double *d, double s, const double *b, unsigned int n) { \
+  unsigned int i = 0; \
+  SIMD_VD vs = SIMD_SET1D(s); \
+  for(; i+SIMD_WD <= n; i += SIMD_WD) SIMD_STORED(d+i,VOP(vs,SIMD_LOADD(b+i))); \
+  for(; i<n; ++i) d[i] = s COP b[i]; \
+}
+VEC_SIMD_DBL_BINOP(_vec_dbl_add,SIMD_ADDD,+)
+VEC_SIMD_DBL_BINOP(_vec_dbl_sub,SIMD_SUBD,-)
+VEC_SIMD_DBL_BINOP(_vec_dbl_mul,SIMD_MULD,*)
+VEC_SIMD_DBL_BINOP(_vec_dbl_div,SIMD_DIVD,/)
+#undef VEC_SIMD_DBL_BINOP
+
+//elementwise int64 add/sub (wrapping, so the scalar tail goes through uint64_t)
+#define VEC_SIMD_INT_BINOP(name,VOP,COP) \
+SIMD_TARGET static void SIMD_SFX(name##_vv)(int64_t *d, const int64_t *a, const int64_t *b, unsigned int n) { \
+  unsigned int i = 0; \
+  for(; i+SIMD_WD <= n; i += SIMD_WD) SIMD_STOREI(d+i,VOP(SIMD_LOADI(a+i),SIMD_LOADI(b+i))); \
+  for(; i<n; ++i) d[i] = (int64_t)((uint64_t)a[i] COP (uint64_t)b[i]); \
+} \
+SIMD_TARGET static void SIMD_SFX(name##_vs)(int64_t *d, const int64_t *a, int64_t s, unsigned int n) { \
+  unsigned int i = 0; \
+  SIMD_VI vs = SIMD_SET1I(s); \
+  for(; i+SIMD_WD <= n; i += SIMD_WD) SIMD_STOREI(d+i,VOP(SIMD_LOADI(a+i),vs)); \
+  for(; i<n; ++i) d[i] = (int64_t)((uint64_t)a[i] COP (uint64_t)s); \
+} \
+SIMD_TARGET static void SIMD_SFX(name##_sv)(int64_t *d, int64_t s, const int64_t *b, unsigned int n) { \
+  unsigned int i = 0; \
+  SIMD_VI vs = SIMD_SET1I(s); \
+  for(; i+SIMD_WD <= n; i += SIMD_WD) SIMD_STOREI(d+i,VOP(vs,SIMD_LOADI(b+i))); \
+  for(; i<n; ++i) d[i] = (int64_t)((uint64_t)s COP (uint64_t)b[i]); \
+}
+VEC_SIMD_INT_BINOP(_vec_int_add,SIMD_ADDI,+)
+VEC_SIMD_INT_BINOP(_vec_int_sub,SIMD_SUBI,-)
+#undef VEC_SIMD_INT_BINOP
+
+SIMD_TARGET static double SIMD_SFX(_vec_dbl_sum)(const double *a, unsigned int n) {
+  double lanes[SIMD_WD], r = 0;
+  unsigned int i = 0;
+  SIMD_VD acc = SIMD_SET1D(0);
+  for(; i+SIMD_WD <= n; i += SIMD_WD) acc = SIMD_ADDD(acc,SIMD_LOADD(a+i));
+  SIMD_STORED(lanes,acc);
+  for(unsigned int j=0; j<SIMD_WD; ++j) r += lanes[j];
+  for(; i<n; ++i) r += a[i];
+  return r;
+}
+
+SIMD_TARGET static int64_t SIMD_SFX(_vec_int_sum)(const int64_t *a, unsigned int n) {
+  int64_t lanes[SIMD_WD];
+  uint64_t r = 0;
+  unsigned int i = 0;
+  SIMD_VI acc = SIMD_SET1I(0);
+  for(; i+SIMD_WD <= n; i += SIMD_WD) acc = SIMD_ADDI(acc,SIMD_LOADI(a+i));
+  SIMD_STOREI(lanes,acc);
+  for(unsigned int j=0; j<SIMD_WD; ++j) r += (uint64_t)lanes[j];
+  for(; i<n; ++i) r += (uint64_t)a[i];
+  return (int64_t)r;
+}
+
+//sum of (a[i]-m)^2 -- second pass of variance
+SIMD_TARGET static double SIMD_SFX(_vec_dbl_sqdev)(const double *a, double m, unsigned int n) {
+  double lanes[SIMD_WD], r = 0;
+  unsigned int i = 0;
+  SIMD_VD acc = SIMD_SET1D(0), vm = SIMD_SET1D(m);
+  for(; i+SIMD_WD <= n; i += SIMD_WD) {
+    SIMD_VD d = SIMD_SUBD(SIMD_LOADD(a+i),vm);
+    acc = SIMD_ADDD(acc,SIMD_MULD(d,d));
+  }
+  SIMD_STORED(lanes,acc);
+  for(unsigned int j=0; j<SIMD_WD; ++j) r += lanes[j];
+  for(; i<n; ++i) r += (a[i]-m)*(a[i]-m);
+  return r;
+}
+
+SIMD_TARGET static double SIMD_SFX(_vec_dbl_dot)(const double *a, const double *b, unsigned int n) {
+  double lanes[SIMD_WD], r = 0;
+  unsigned int i = 0;
+  SIMD_VD acc = SIMD_SET1D(0);
+  for(; i+SIMD_WD <= n; i += SIMD_WD) acc = SIMD_ADDD(acc,SIMD_MULD(SIMD_LOADD(a+i),SIMD_LOADD(b+i)));
+  SIMD_STORED(lanes,acc);
+  for(unsigned int j=0; j<SIMD_WD; ++j) r += lanes[j];
+  for(; i<n; ++i) r += a[i]*b[i];
+  return r;
+}
+
+//min/max of a non-empty vec (NaNs are skipped like the scalar a<b compare, unless every element is NaN)
+SIMD_TARGET static void SIMD_SFX(_vec_dbl_minmax)(const double *a, unsigned int n, double *min, double *max) {
+  double lmin[SIMD_WD], lmax[SIMD_WD], rmin = a[0], rmax = a[0];
+  unsigned int i = 0;
+  if (n >= SIMD_WD) {
+    SIMD_VD vmin = SIMD_LOADD(a), vmax = vmin;
+    for(i = SIMD_WD; i+SIMD_WD <= n; i += SIMD_WD) {
+      SIMD_VD v = SIMD_LOADD(a+i);
+      vmin = SIMD_MIND(v,vmin);
+      vmax = SIMD_MAXD(v,vmax);
+    }
+    SIMD_STORED(lmin,vmin);
+    SIMD_STORED(lmax,vmax);
+    for(unsigned int j=0; j<SIMD_WD; ++j) {
+      if (lmin[j] < rmin || rmin != rmin) rmin = lmin[j];
+      if (lmax[j] > rmax || rmax != rmax) rmax = lmax[j];
+    }
+  }
+  for(; i<n; ++i) {
+    if (a[i] < rmin || rmin != rmin) rmin = a[i];
+    if (a[i] > rmax || rmax != rmax) rmax = a[i];
+  }
+  *min = rmin;
+  *max = rmax;
+}
+
+SIMD_TARGET static void SIMD_SFX(_vec_int_minmax)(const int64_t *a, unsigned int n, int64_t *min, int64_t *max) {
+  int64_t rmin = a[0], rmax = a[0];
+  unsigned int i = 0;
+#ifdef SIMD_CMPGTI
+  int64_t lmin[SIMD_WD], lmax[SIMD_WD];
+  if (n >= SIMD_WD) {
+    SIMD_VI vmin = SIMD_LOADI(a), vmax = vmin;
+    for(i = SIMD_WD; i+SIMD_WD <= n; i += SIMD_WD) {
+      SIMD_VI v = SIMD_LOADI(a+i);
+      vmin = SIMD_BLENDI(vmin,v,SIMD_CMPGTI(vmin,v));
+      vmax = SIMD_BLENDI(vmax,v,SIMD_CMPGTI(v,vmax));
+    }
+    SIMD_STOREI(lmin,vmin);
+    SIMD_STOREI(lmax,vmax);
+    for(unsigned int j=0; j<SIMD_WD; ++j) {
+      if (lmin[j] < rmin) rmin = lmin[j];
+      if (lmax[j] > rmax) rmax = lmax[j];
+    }
+  }
+#endif
+  for(; i<n; ++i) {
+    if (a[i] < rmin) rmin = a[i];
+    if (a[i] > rmax) rmax = a[i];
+  }
+  *min = rmin;
+  *max = rmax;
+}
+
+#undef SIMD_SFX
+#undef SIMD_TARGET
+#undef SIMD_VD
+#undef SIMD_VI
+#undef SIMD_WD
+#undef SIMD_LOADD
+#undef SIMD_STORED
+#undef SIMD_SET1D
+#undef SIMD_ADDD
+#undef SIMD_SUBD
+#undef SIMD_MULD
+#undef SIMD_DIVD
+#undef SIMD_MIND
+#undef SIMD_MAXD
+#undef SIMD_LOADI
+#undef SIMD_STOREI
+#undef SIMD_SET1I
+#undef SIMD_ADDI
+#undef SIMD_SUBI
+#undef SIMD_CMPGTI
+#undef SIMD_BLENDI
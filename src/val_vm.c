@@ -100,15 +100,20 @@ err_t val_vm_init_(val_t *val,vm_t *vm) {
   *val = __vm_val(v);
   return 0;
 }
-void val_vm_clonedict(valstruct_t *vmdst,vm_t *vmsrc) {
+err_t val_vm_clonedict(valstruct_t *vmdst,vm_t *vmsrc) {
+  valstruct_t dict;
+  err_t e;
+  if ((e = _val_dict_clone_(&dict,&vmsrc->dict))) return e;
   _val_dict_destroy_(&vmdst->v.vm->dict);
-  _val_dict_clone_(&vmdst->v.vm->dict,&vmsrc->dict);
+  vmdst->v.vm->dict = dict;
+  return 0;
 }
 
 err_t val_vm_clone(val_t *ret, vm_t *orig) {
   valstruct_t *v;
+  err_t e;
   if (!(v = _val_vm_alloc())) return _throw(ERR_MALLOC);
-  vm_clone(v->v.vm,orig);
+  if ((e = vm_clone(v->v.vm,orig))) { _val_vm_free(v); return e; }
   *ret = __vm_val(v);
   return 0;
 }
@@ -126,9 +131,14 @@ err_t val_vm_eval_final(val_t *ret, valstruct_t *vm) {
   err_t e;
   if (ERR_LOCKED == (e = _vm_trylock(vm->v.vm))) {
     e = vm_wait(vm->v.vm);
+  } else if (vm->v.vm->state != STOPPED) { //thread/task already finished, just join
+    e = _vm_join(vm->v.vm);
+    vm->v.vm->state = STOPPED;
+    _vm_unlock(vm->v.vm);
   } else {
     ANNOTATE_HAPPENS_AFTER(vm->v.vm);
     e = vm_dowork(vm->v.vm);
+    _vm_unlock(vm->v.vm);
   }
   return val_vm_finalize(ret,vm,e);
 }
@@ -142,7 +152,7 @@ err_t val_vm_finalize(val_t *ret, valstruct_t *vm, err_t e) { //destroys vm and
     }
   } else if (e) { //else exception in e
     *ret = __int_val(e);
-    return ERR_THROW;
+    e = ERR_THROW; //still destroy the vm below
   } else { //no error, replace val with stack
     *ret = val_empty_list();
     valstruct_t *tv = __lst_ptr(*ret);
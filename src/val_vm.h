@@ -25,7 +25,7 @@ err_t val_vm_init(val_t *val);
 err_t val_vm_init2(val_t *val,valstruct_t *stack, valstruct_t *work);
 err_t val_vm_init3(val_t *val,valstruct_t *stack, valstruct_t *work, valstruct_t *dict);
 err_t val_vm_init_(val_t *val,vm_t *vm);
-void val_vm_clonedict(valstruct_t *vmdst,vm_t *vmsrc);
+err_t val_vm_clonedict(valstruct_t *vmdst,vm_t *vmsrc);
 void _val_vm_destroy(valstruct_t *vm);
 err_t val_vm_clone(val_t *ret, vm_t *orig);
 
@@ -18,10 +18,17 @@
 #include "vm_err.h"
 #include "vm_debug.h"
 #include "vm_parser.h"
+#include "vm_sched.h"
+#include "vm_par.h"
+#include "vm_super.h"
+#include "val_vec.h"
+#include "val_parser.h"
+#include "vm_out.h"
 #include "val.h"
 #include "val_list.h"
 #include "val_string.h"
 #include "val_num.h"
+#include "val_int.h"
 #include "val_math.h"
 #include "val_file.h"
 #include "val_fd.h"
@@ -30,6 +37,9 @@
 #include "val_printf.h"
 #include "val_sort.h"
 #include "val_vm.h"
+#include "val_chan.h"
+#include "val_bytecode.h"
+#include "val_strscan.h"
 #include "helpers.h"
 
 #include <sys/socket.h>
@@ -41,6 +51,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <time.h>
 
 //needed for platform natives:
 #include <unistd.h>
@@ -86,7 +97,6 @@
 //    randf
 //    srand
 //  string manipulation (searching and splitting):
-//    split
 //    split2
 //    find
 //    rfind
@@ -121,9 +131,7 @@
 //    vm.nextw
 //    vm.stats -- only when compiled in debug mode -- returns internal vm counters
 //    debuginfo -- name??? only when compiled in debug mode -- takes val, returns attached debug info
-//  time: -- need to figure out general solution (right now we use int32 for integers, so using standard unix timestamps only works until 2038)
-//    time -- only works until 2038 in 32bit int -- figure out long-term solution (e.g. int64 support, or use int47)
-//    time.us -- won't fit in 32bit int -- figure this out
+//  time: -- clock op returns int64 wall/monotonic time in s/ms/us/ns (time and time.us are builtins on top of it)
 //    localtime -- like perl localtime (which just uses c localtime and extracts struct tm fields into list)
 //    gmtime -- like perl gmtime (which just uses c gmtime and extracts struct tm fields into list)
 //    sleep
@@ -139,6 +147,7 @@
 err_t concat_init() {
   err_t e;
   if ((e = concat_file_init())) return e;
+  strscan_init();
   return 0;
 }
 
@@ -160,6 +169,7 @@ int _vm_qeval(vm_t *vm, valstruct_t *ident, err_t *e) { //pre-evaluate val (hand
     if (len) c = *_val_str_begin(ident);
     if (c=='_') {
       if (0 == _val_str_strcmp(ident,"_quit")) {
+        vm_out_flush(vm);
         exit(0);
       } else if (0 == _val_str_strcmp(ident,"_list")) {
         *e = vm_list(vm);
@@ -234,17 +244,23 @@ err_t _vm_close_code(vm_t *vm) {
 
 
 err_t vm_wait(vm_t *vm) {
-  err_t e;
-  fatal_if(e,(e = _vm_lock(vm)));
+  err_t e,ret=0;
+  fatal_if(e,(e = vm->sched ? vm_sched_lock(vm) : _vm_lock(vm)));
   if (vm->state != STOPPED) { //need to join thread
-    e = _vm_join(vm);
+    ret = _vm_join(vm);
     vm->state = STOPPED; //STOPPED after we have called join
   }
   fatal_if(e,(e = _vm_unlock(vm)));
-  return e;
+  return ret;
 }
 err_t _vm_join(vm_t *vm) { //must already have lock
   void *ret;
+  if (vm->sched) { //finished vm_sched task -- no thread, result left in vm->err
+    err_t e = vm->err;
+    ANNOTATE_HAPPENS_AFTER(vm);
+    vm->sched = 0;
+    return e ? _throw(e) : e;
+  }
   throw_if(ERR_THREAD,(pthread_join(vm->thread, &ret)));
   ANNOTATE_HAPPENS_AFTER(vm);
   if (ret == PTHREAD_CANCELED) {
@@ -311,7 +327,7 @@ int vm_dict_put(vm_t *vm, valstruct_t *opname, val_t val) {
   return r;
 }
 val_t vm_dict_get(vm_t *vm, valstruct_t *key) {
-  return _val_dict_get(&vm->dict,key);
+  return _val_dict_get_ident(&vm->dict,key);
 }
 
 err_t vm_val_rresolve(vm_t *vm, val_t *val) {
@@ -387,6 +403,73 @@ err_t vm_val_resolve(vm_t *vm, val_t *val) {
   }
 }
 
+//val as compile encodes it (idents defined as ops are resolved to the opcode)
+static val_t _vm_compile_val(vm_t *vm, val_t val) {
+  val_t def;
+  if (val_is_ident(val) && !_val_str_escaped(__ident_ptr(val)) && !val_is_null(def = vm_dict_get(vm,__ident_ptr(val))) && val_is_op(def)) {
+    return __op_val(__val_op(def));
+  }
+  return val;
+}
+
+//op that a quotation of a single op word evals (e.g. [dup] or \dup), or OP_NULL
+static opcode_t _vm_compile_quoted_op(vm_t *vm, val_t val) {
+  valstruct_t key;
+  val_t def;
+  if (!val_is_null(__val_dbg_val(val))) return OP_NULL; //may eval something else (DEBUG_VAL_EVAL)
+  if (val_is_code(val)) {
+    if (_val_lst_len(__code_ptr(val)) != 1) return OP_NULL;
+    val = _vm_compile_val(vm,*_val_lst_begin(__code_ptr(val)));
+    return (val_is_op(val) && val_is_null(__val_dbg_val(val))) ? __val_op(val) : OP_NULL;
+  }
+  if (!val_is_ident(val) || _val_str_escaped_levels(__ident_ptr(val)) != 1) return OP_NULL;
+  //lookup with a temp ident that skips the escape
+  key = *__ident_ptr(val);
+  key.v.str.off += 1;
+  key.v.str.len -= 1;
+  _val_str_clearcache(&key);
+  def = _val_dict_get(&vm->dict,&key);
+  return val_is_op(def) ? __val_op(def) : OP_NULL;
+}
+
+//compile code to bytecode (appended to b)
+// - nested quotations are compiled too (and pushed as bytecode vals, which eval the same as the quotation)
+// - idents defined as ops are resolved to the opcode, other idents are still looked up when the bytecode is evaled
+// - op sequences with a superinstruction are fused as we go (see vm_super.h)
+err_t vm_bytecode_compile(vm_t *vm, valstruct_t *b, val_t code) {
+  valstruct_t *lst = __code_ptr(code);
+  val_t *p,*end,t,prev;
+  unsigned int off,prevoff = 0;
+  int haveprev = 0;
+  opcode_t op;
+  err_t e;
+  if (_val_lst_empty(lst)) return 0;
+  for(p=_val_lst_begin(lst),end=_val_lst_end(lst);p!=end;++p) {
+    off = _val_str_len(b);
+    if (p+1 != end && (op = _vm_compile_quoted_op(vm,*p)) && val_is_op(t = _vm_compile_val(vm,p[1])) && (op = vm_superop_quoted(op,__val_op(t)))) {
+      ++p; //quoted op and the op after it (e.g. \dup dip)
+      t = __op_val(op);
+    } else if (val_is_code(*p)) {
+      t = val_empty_bytecode();
+      if ((e = vm_bytecode_compile(vm,__bytecode_ptr(t),*p)) || 0>(e = bytecode_rpush(b,t))) { val_destroy(t); return e; }
+      val_destroy(t);
+      haveprev = 0;
+      continue;
+    } else {
+      t = _vm_compile_val(vm,*p);
+    }
+    if (haveprev && (op = vm_superop(prev,t))) { //replace the previous val's bytes with the superinstruction
+      b->v.str.len = off = prevoff;
+      t = __op_val(op);
+    }
+    if (0>(e = bytecode_rpush(b,t))) return e;
+    prev = t;
+    prevoff = off;
+    haveprev = 1;
+  }
+  return 0;
+}
+
 int vm_empty(vm_t *vm) { return _val_lst_empty(vm->open_list); }
 err_t vm_push(vm_t *vm, val_t val) { return _val_lst_rpush(vm->open_list,val); }
 err_t vm_wpush(vm_t *vm, val_t val) { return _val_lst_rpush(&vm->work,val); }
@@ -509,6 +592,7 @@ bad_cont:
 }
 
 int vm_stack_printf(vm_t *vm, const char *format) {
+  vm_out_flush(vm);
   return val_printfv_(format, strlen(format), vm->open_list,1);
 }
 //int vm_printf_(vm_t *vm, const char *format, int len) {
@@ -538,6 +622,7 @@ err_t _vm_init_dict(vm_t *vm) {
   if (0>(e = vm_dict_put_op(vm,OP_eval))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_parsecode))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_parsecode_))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_compile))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_pop))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_swap))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_dup))) goto out_err;
@@ -578,6 +663,8 @@ err_t _vm_init_dict(vm_t *vm) {
   if (0>(e = vm_dict_put_op(vm,OP_expand))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_sort))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_rsort))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_sortby))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_psort))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_clearlist))) goto out_err;
 
   if (0>(e = vm_dict_put_op(vm,OP_quote))) goto out_err;
@@ -596,6 +683,10 @@ err_t _vm_init_dict(vm_t *vm) {
 
   if (0>(e = vm_dict_put_op(vm,OP_sqrt))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_log))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_vec))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_vreduce))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_dot))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_clock))) goto out_err;
 
   if (0>(e = vm_dict_put_op(vm,OP_pow))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_mod))) goto out_err;
@@ -625,8 +716,11 @@ err_t _vm_init_dict(vm_t *vm) {
   if (0>(e = vm_dict_put_op(vm,OP_or_))) goto out_err;
 
   if (0>(e = vm_dict_put_op(vm,OP_find))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_split))) goto out_err;
 
   if (0>(e = vm_dict_put_op(vm,OP_parsenum))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_parser))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_parse))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_toint))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_tofloat))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_tostring))) goto out_err;
@@ -675,6 +769,7 @@ err_t _vm_init_dict(vm_t *vm) {
   if (0>(e = vm_dict_put_op(vm,OP_print_))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_printV))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_printV_))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_flush))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_printf))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_fprintf))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_sprintf))) goto out_err;
@@ -700,6 +795,7 @@ err_t _vm_init_dict(vm_t *vm) {
   if (0>(e = vm_dict_put_op(vm,OP_dict_has))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_dict_get))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_dict_put))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_dict_keys))) goto out_err;
 
   t = val_file_stdin_ref();
   if ((e = val_code_wrap(&t))) goto out_err;
@@ -720,6 +816,11 @@ err_t _vm_init_dict(vm_t *vm) {
   if (0>(e = vm_dict_put_op(vm,OP_seek))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_fpos))) goto out_err;
 
+  if (0>(e = vm_dict_put_op(vm,OP_chan))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_send))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_recv))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_try_recv))) goto out_err;
+
   if (0>(e = vm_dict_put_op(vm,OP_ref))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_deref))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_refswap))) goto out_err;
@@ -734,6 +835,8 @@ err_t _vm_init_dict(vm_t *vm) {
 
   if (0>(e = vm_dict_put_op(vm,OP_vm))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_thread))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_submit))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_await))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_debug))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_vm_exec))) goto out_err;
   if (0>(e = vm_dict_put_op(vm,OP_vm_continue))) goto out_err;
@@ -823,6 +926,15 @@ err_t _vm_init_dict(vm_t *vm) {
   //TODO: opcodes common list manipulation (wrap2,wrap3,mapnth)???
   if (0>(e = vm_dict_put_compile(vm,"wrap2","wrap lpush")))goto out_err;
   if (0>(e = vm_dict_put_compile(vm,"wrap3","wrap lpush lpush")))goto out_err;
+  //reductions over vecs (or lists of numbers)
+  if (0>(e = vm_dict_put_compile(vm,"sum","\"sum\" vreduce")))goto out_err;
+  if (0>(e = vm_dict_put_compile(vm,"min","\"min\" vreduce")))goto out_err;
+  if (0>(e = vm_dict_put_compile(vm,"max","\"max\" vreduce")))goto out_err;
+  if (0>(e = vm_dict_put_compile(vm,"mean","\"mean\" vreduce")))goto out_err;
+  if (0>(e = vm_dict_put_compile(vm,"variance","\"variance\" vreduce")))goto out_err;
+  //unix time (wide ints, so these are fine past 2038)
+  if (0>(e = vm_dict_put_compile(vm,"time","\"s\" clock")))goto out_err;
+  if (0>(e = vm_dict_put_compile(vm,"time.us","\"us\" clock")))goto out_err;
   if (0>(e = vm_dict_put_compile(vm,"mapnth","dup [ swapd 0 swap swapnth bury2 \\eval dip ] dip swapd setnth")))goto out_err;
 
 
@@ -846,19 +958,29 @@ err_t _vm_init_dict(vm_t *vm) {
   if (0>(e = vm_dict_put_compile(vm,"flip4","4 flipn")))goto out_err;
 
 
-  //TODO: at least basic loop opcodes
-  if (0>(e = vm_dict_put_compile(vm,"each","[ dup3 size [ [ \\lpop dip dup dip2 ] dip dup eval ] if ] dup eval pop pop pop"))) goto out_err;
-  if (0>(e = vm_dict_put_compile(vm,"eachr","[ dup3 size [ [ \\rpop dip dup dip2 ] dip dup eval ] if ] dup eval pop pop pop"))) goto out_err;
-  if (0>(e = vm_dict_put_compile(vm,"while","[ dup3 dip3 dig3 [ [ dup dip2 ] dip dup eval ] if ] dup eval pop pop pop"))) goto out_err;
-  if (0>(e = vm_dict_put_compile(vm,"times","[ dup3 0 > [ [ \\dec dip dup dip2 ] dip dup eval ] if ] dup eval pop pop pop"))) goto out_err;
+  //loop ops (native versions of the compiled definitions below)
+  if (0>(e = vm_dict_put_op(vm,OP_each))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_eachr))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_map))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_mapr))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_filter))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_pmap))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_pfilter))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_times))) goto out_err;
+  if (0>(e = vm_dict_put_op(vm,OP_while))) goto out_err;
+  //reference definitions for the loop ops -- the native ops must match these (tests/loops.cat checks them against each other)
+  //if (0>(e = vm_dict_put_compile(vm,"each","[ dup3 size [ [ \\lpop dip dup dip2 ] dip dup eval ] if ] dup eval pop pop pop"))) goto out_err;
+  //if (0>(e = vm_dict_put_compile(vm,"eachr","[ dup3 size [ [ \\rpop dip dup dip2 ] dip dup eval ] if ] dup eval pop pop pop"))) goto out_err;
+  //if (0>(e = vm_dict_put_compile(vm,"while","[ dup3 dip3 dig3 [ [ dup dip2 ] dip dup eval ] if ] dup eval pop pop pop"))) goto out_err;
+  //if (0>(e = vm_dict_put_compile(vm,"times","[ dup3 0 > [ [ \\dec dip dup dip2 ] dip dup eval ] if ] dup eval pop pop pop"))) goto out_err;
+  //if (0>(e = vm_dict_put_compile(vm,"filter","dup2 clearlist flip3 [ flip3 dup3 flip3 dup dip3 [ dig2 \\rpush \\popd ifelse] dip ] each pop"))) goto out_err;
+  //if (0>(e = vm_dict_put_compile(vm,"map","dup2 clearlist flip3 [ bury2 dup dip2 \\rpush dip ] each pop"))) goto out_err;
+  //if (0>(e = vm_dict_put_compile(vm,"mapr","dup2 clearlist flip3 [ bury2 dup dip2 \\lpush dip ] eachr pop"))) goto out_err;
   if (0>(e = vm_dict_put_compile(vm,"loop_","[[dup dip] dip dup eval] dup eval"))) goto out_err;
 
 
   //TODO: at least some of these loop words should probably be ops, which ones???
-  if (0>(e = vm_dict_put_compile(vm,"filter","dup2 clearlist flip3 [ flip3 dup3 flip3 dup dip3 [ dig2 \\rpush \\popd ifelse] dip ] each pop"))) goto out_err;
   if (0>(e = vm_dict_put_compile(vm,"filter2","[ dup clearlist dup flip3 ] dip swap [ bury3 \\dup dip3 dup 4 dipn 4 dign [ \\rpush dip2 ] [ [ swapd rpush ] dip ] ifelse ] each pop"))) goto out_err;
-  if (0>(e = vm_dict_put_compile(vm,"map","dup2 clearlist flip3 [ bury2 dup dip2 \\rpush dip ] each pop"))) goto out_err;
-  if (0>(e = vm_dict_put_compile(vm,"mapr","dup2 clearlist flip3 [ bury2 dup dip2 \\lpush dip ] eachr pop"))) goto out_err;
   if (0>(e = vm_dict_put_compile(vm,"mmap","dup2 clearlist flip3 [ bury2 dup dip2 \\rappend dip ] each pop"))) goto out_err;
   if (0>(e = vm_dict_put_compile(vm,"cleave","dup clearlist swap [ swap [sip swap] dip rpush ] each swap pop"))) goto out_err;
   if (0>(e = vm_dict_put_compile(vm,"spread","dup clearlist swap dup size swap [ dup2 inc dipn dup inc dign dig2 rpush swap dec ] each pop"))) goto out_err;
@@ -877,7 +999,9 @@ err_t _vm_init_dict(vm_t *vm) {
   //TODO: use include searchpath (which also should be modifiable) when opening file for include
   if (0>(e = vm_dict_put_compile(vm,"include","fopenr eval"))) goto out_err;
   if (0>(e = vm_dict_put_compile(vm,"writeline","\"\n\" cat write"))) goto out_err;
+  if (0>(e = vm_dict_put_compile(vm,"mapfile","\"m\" open"))) goto out_err; //whole file as a (zero-copy) read-only string
   if (0>(e = vm_dict_put_compile(vm,"eachline","swap [ readline dup isint not ] [ bury2 dup2 dip2 ] while [pop pop] dip"))) goto out_err; //TODO: dup eval impl???
+  if (0>(e = vm_dict_put_compile(vm,"parse.each","\\parse dip each"))) goto out_err; //str/file parser [q] -- (q run on each token)
   if (0>(e = vm_dict_put_compile(vm,"isferr","0 <"))) goto out_err;
   if (0>(e = vm_dict_put_compile(vm,"isfeof","-18 ="))) goto out_err;
 
@@ -887,6 +1011,31 @@ out_err:
   return e;
 }
 
+//root dictionary -- builtin ops and compiled defs, built once and shared (by hashtable ref) as the bottom scope of every vm
+// - never written after init (puts go to the vm's own scope, and dict puts deref any shared hashtable before writing)
+static valstruct_t vm_root_dict;
+static pthread_once_t vm_root_dict_once = PTHREAD_ONCE_INIT;
+static err_t vm_root_dict_err = 0;
+
+static void _vm_root_dict_destroy() {
+  _val_dict_destroy_(&vm_root_dict); //just drops root ref -- any live vms still hold their own
+}
+static void _vm_root_dict_init() {
+  vm_t vm;
+  memset(&vm,0,sizeof(vm));
+  if (!(vm.p = vm_get_parser())) { vm_root_dict_err = _throw(ERR_NO_PARSER); return; }
+  if ((vm_root_dict_err = _val_dict_init(&vm.dict))) return;
+  if ((vm_root_dict_err = _vm_init_dict(&vm))) { _val_dict_destroy_(&vm.dict); return; }
+  vm_root_dict = vm.dict;
+  atexit(_vm_root_dict_destroy);
+}
+
+err_t _vm_dict_init(vm_t *vm) {
+  pthread_once(&vm_root_dict_once,_vm_root_dict_init);
+  if (vm_root_dict_err) return vm_root_dict_err;
+  return _val_dict_init_scope(&vm->dict,&vm_root_dict);
+}
+
 err_t vm_init(vm_t *vm) {
   //TODO: clean error handling (and cleanup)
   sem_init(&vm->lock,0,1);
@@ -900,12 +1049,13 @@ err_t vm_init(vm_t *vm) {
   vm->debug_val_eval = 0;
 #endif
   vm->state = STOPPED;
+  vm->sched = 0;
+  vm->out = NULL;
 
   if (!(vm->p = vm_get_parser())) return _throw(ERR_NO_PARSER);
 
   int e;
-  if ((e = _val_dict_init(&vm->dict))) return e;
-  if ((e = _vm_init_dict(vm))) return e;
+  if ((e = _vm_dict_init(vm))) return e;
 
   return 0;
 }
@@ -918,12 +1068,13 @@ err_t vm_init2(vm_t *vm, valstruct_t *stack, valstruct_t *work) {
   vm->groupi=0;
   vm->noeval=0;
   vm->state = STOPPED;
+  vm->sched = 0;
+  vm->out = NULL;
 
   if (!(vm->p = vm_get_parser())) return _throw(ERR_NO_PARSER);
 
   int e;
-  if ((e = _val_dict_init(&vm->dict))) return e;
-  if ((e = _vm_init_dict(vm))) return e;
+  if ((e = _vm_dict_init(vm))) return e;
 
   return 0;
 }
@@ -932,31 +1083,44 @@ err_t vm_init3(vm_t *vm, valstruct_t *stack, valstruct_t *work, valstruct_t *dic
   vm->stack = *stack; _valstruct_release(stack);
   vm->work = *work; _valstruct_release(work);
   vm->dict = *dict; _valstruct_release(dict);
+  _val_list_init(&vm->cont);
   vm->open_list = &vm->stack;
   vm->groupi=0;
   vm->noeval=0;
   vm->state = STOPPED;
+  vm->sched = 0;
+  vm->out = NULL;
 
   if (!(vm->p = vm_get_parser())) return _throw(ERR_NO_PARSER);
   return 0;
 }
-void vm_clone(vm_t *vm, vm_t *orig) {
+err_t vm_clone(vm_t *vm, vm_t *orig) {
+  err_t e;
+  if ((e = _val_dict_clone_(&vm->dict,&orig->dict))) return e;
   sem_init(&vm->lock,0,1);
   _val_lst_clone(&vm->stack,&orig->stack);
   _val_lst_clone(&vm->work,&orig->work);
-  _val_dict_clone_(&vm->dict,&orig->work);
+  _val_lst_clone(&vm->cont,&orig->cont);
   vm->groupi=orig->groupi;
+  vm->noeval=orig->noeval;
   _vm_fix_open_list(vm);
   vm->state = STOPPED;
+  vm->sched = 0;
+  vm->out = NULL;
   vm->p = orig->p;
+  return 0;
 }
 void vm_destroy(vm_t *vm) {
   int mustjoin=0;
   err_t e;
   if (ERR_LOCKED == (e = _vm_trylock(vm))) {
-    //vm currently running, need to kill
-    if ((e = _vm_cancel(vm))) _fatal(e); return;
-    mustjoin = 1;
+    if (vm->sched) { //scheduled task can't be cancelled, wait for it to finish
+      if ((e = vm_sched_lock(vm))) { _fatal(e); return; }
+      mustjoin = 1;
+    } else { //vm currently running, need to kill
+      if ((e = _vm_cancel(vm))) _fatal(e); return;
+      mustjoin = 1;
+    }
   } else if (e) {
     _fatal(e); return;
   } else { //we got lock, wait for thread if needed
@@ -965,6 +1129,7 @@ void vm_destroy(vm_t *vm) {
   if (mustjoin) {
     e = _vm_join(vm);
   }
+  vm_out_destroy(vm);
   _val_lst_destroy_(&vm->stack);
   _val_lst_destroy_(&vm->work);
   _val_lst_destroy_(&vm->cont);
@@ -1024,6 +1189,7 @@ int vm_list(vm_t *vm) {
   //return val_stack_list(vm->open_list);
   if (!vm_empty(vm)) {
     err_t e;
+    if ((e = vm_out_flush(vm))) return e;
     if (0>(e = val_list_fprintf_(vm->open_list,stdout,list_fmt_lines,fmt_V))) return e;
     if (0>(e = val_fprint_(stdout,"\n",1))) return e;
   }
@@ -1032,6 +1198,8 @@ int vm_list(vm_t *vm) {
 int vm_listn(vm_t *vm, unsigned int n) {
   //return val_stack_listn(vm->open_list,n);
   list_fmt_t lfmt;
+  err_t e;
+  if ((e = vm_out_flush(vm))) return e;
   val_list_format_listn(&lfmt,n);
   return val_list_fprintf_(vm->open_list,stdout,&lfmt,fmt_V);
 }
@@ -1039,11 +1207,13 @@ int vm_listn(vm_t *vm, unsigned int n) {
 err_t vm_stackline(vm_t *vm) {
   err_t e;
   //if (0 > (e = val_list_fprintf_(vm->open_list,stdout,list_fmt_V,fmt_V))) return e;
+  if ((e = vm_out_flush(vm))) return e;
   if (0 > (e = val_fprintf(stdout, "%V\n", __lst_val(vm->open_list)))) return e;
   return 0;
 }
 
 err_t vm_printstate(vm_t *vm) {
+  vm_out_flush(vm);
   printf("Stack:\n");
   vm_list(vm);
   printf("\nWork:\n");
@@ -1062,6 +1232,7 @@ err_t vm_qstate(vm_t *vm) {
   if (0>(r = val_sprint_cstr(bufv,"State: "))) goto out;
   if (0>(r = vm_sprintf(vm,bufv,&fmt))) goto out;
   if (0>(r = val_sprint_ch(bufv,'\n'))) goto out;
+  if ((r = vm_out_flush(vm))) goto out;
   r = val_string_fprintf(bufv,stdout,fmt_v);
 out:
   val_destroy(buf);
@@ -1077,6 +1248,7 @@ err_t _vm_qstate(vm_t *vm,val_t *stack, unsigned int stackn, val_t *work, unsign
   if (0>(r = val_sprint_cstr(bufv,"State: "))) goto out;
   if (0>(r = _vm_sprintf(bufv,&fmt,stack,stackn,work,workn,vm->cont.v.lst.buf ? _val_lst_begin(&vm->cont) : NULL, _val_lst_len(&vm->cont), state>0 ? 1 : 0, top))) goto out;
   if (0>(r = val_sprint_ch(bufv,'\n'))) goto out;
+  if ((r = vm_out_flush(vm))) goto out;
   r = val_string_fprintf(bufv,stdout,fmt_v);
 out:
   val_destroy(buf);
@@ -1085,6 +1257,7 @@ out:
 
 err_t vm_vstate(vm_t *vm) {
   err_t r;
+  if ((r = vm_out_flush(vm))) return r;
   if (0>(r = val_fprint_cstr(stdout,"State: "))) return r;
   if (0>(r = vm_fprintf(vm,stdout,fmt_V))) return r;
   if (0>(r = val_fprint_(stdout,"\n",1))) return r;
@@ -1098,6 +1271,7 @@ err_t _vm_vstate(vm_t *vm,val_t *stack, unsigned int stackn, val_t *work, unsign
   if (0>(r = val_sprint_cstr(bufv,"State: "))) goto out;
   if (0>(r = _vm_sprintf(bufv,fmt_V,stack,stackn,work,workn,vm->cont.v.lst.buf ? _val_lst_begin(&vm->cont) : NULL, _val_lst_len(&vm->cont), state>0 ? 1 : 0, top))) goto out;
   if (0>(r = val_sprint_ch(bufv,'\n'))) goto out;
+  if ((r = vm_out_flush(vm))) goto out;
   r = val_string_fprintf(bufv,stdout,fmt_v);
 out:
   val_destroy(buf);
@@ -1272,6 +1446,134 @@ err_t _vm_reserve(valstruct_t *stackval, val_t **stackbase, val_t **stack, val_t
   return 0;
 }
 
+//borrowed code frames (see frame_return in vm_dowork) are 3 work stack slots: end index, next index, then the _FRAME_TAG buffer on top
+// - _vm_frame_code turns the frame at p[0..2] back into a code val at p[0] (the code val takes over the frame's buffer reference)
+// - _vm_unborrow_work does that for the whole work stack when we leave vm_dowork, so only vm_dowork ever sees frames
+static err_t _vm_frame_code(val_t *p) {
+  valstruct_t *v;
+  if (!(v = _valstruct_alloc())) return _fatal(ERR_MALLOC);
+  v->type = TYPE_CODE;
+  v->v.lst.buf = __frame_buf(p[2]);
+  v->v.lst.off = __val_int(p[1]);
+  v->v.lst.len = __val_int(p[0]) - __val_int(p[1]);
+  p[0] = __lst_val(v);
+  val_clear(p+1);
+  val_clear(p+2);
+  return 0;
+}
+static err_t _vm_unborrow_work(val_t *workbase, val_t **work) {
+  val_t *p,*q,*end=*work;
+  err_t e=0;
+  for(p=q=workbase; p!=end; ++p,++q) {
+    if (end-p > 2 && val_is_frame(p[2]) && !e && !(e = _vm_frame_code(p))) {
+      *q = *p;
+      p += 2;
+    } else if (q != p) {
+      *q = *p;
+    }
+  }
+  for(p=q; p!=end; ++p) val_clear(p);
+  *work = q;
+  return e;
+}
+
+//_vm_child - new vm val (for thread/submit) with stack and work lists (consumed on success), and a clone of vm's dict
+// - dict clone is threadsafe -- shared hashtable nodes are never written (see op_vm)
+// - stack/work buffers are derefed first, so the child never shares a list buffer with us while it runs on another thread
+static err_t _vm_child(vm_t *vm, valstruct_t *stack, valstruct_t *work, val_t *child) {
+  val_t dict;
+  err_t e;
+  if ((e = _val_lst_deref(stack))) return e;
+  if ((e = _val_lst_deref(work))) return e;
+  if ((e = _val_dict_clone(&dict,&vm->dict))) return e;
+  if ((e = val_vm_init3(child,stack,work,__dict_ptr(dict)))) {
+    val_destroy(dict);
+    return e;
+  }
+  return 0;
+}
+
+//_vm_stdin_next - parse the next line of stdin into code (see _vm_file_next)
+// - stdin is read a line at a time, since the script may read stdin itself (and it is usually interactive)
+static err_t _vm_stdin_next(vm_t *vm, valstruct_t *f, val_t *code, int *eof) {
+  val_t buf = val_empty_string(); //line is a view into the file's read buffer
+  err_t e;
+  int n = _val_file_readline(f,__str_ptr(buf));
+  if (n < 0) {
+    val_destroy(buf);
+    *eof = 1;
+    return (n == ERR_EOF ? 0 : n);
+  } else if (n==0 || (n==1 && *_val_str_begin(__str_ptr(buf))=='\n')) { //empty line
+    val_destroy(buf);
+    return 0;
+  }
+  *code = val_empty_code();
+  e = _vm_parse_input(vm->p,_val_str_begin(__str_ptr(buf)),n,__lst_ptr(*code));
+  val_destroy(buf);
+  if (e || _val_lst_empty(__lst_ptr(*code))) {
+    val_destroy(*code);
+    *code = VAL_NULL;
+  }
+  return e;
+}
+
+//_vm_file_next - parse the next part of a file or fd being evaluated into code (VAL_NULL if nothing to eval yet)
+// - other than stdin, we take everything buffered at once and feed it to the file's streaming parse state a line at a time
+//   - a token cut off by the end of a read is carried in the parse state until the next read (or EOF) finishes it
+//   - the fsm ends every token at a newline (even an unterminated string), so nothing else carries from line to line
+//   - a line that doesn't parse is given back (when lines before it parsed), so the earlier lines eval before we hit the error
+// - sets *eof when the file is done (on EOF or read error)
+static err_t _vm_file_next(vm_t *vm, valstruct_t *f, val_t *code, int *eof) {
+  struct vm_parse_code_state **parse = (f->type == TYPE_FILE ? &f->v.file.parse : &f->v.fd.parse);
+  val_t buf;
+  const char *begin, *p, *q, *end;
+  unsigned int ncode;
+  err_t e = 0;
+  int n;
+  *code = VAL_NULL;
+  *eof = 0;
+  if (f->type == TYPE_FILE && _val_file_f(f) == stdin) return _vm_stdin_next(vm,f,code,eof);
+  if (!*parse) {
+    if (!(*parse = malloc(sizeof(struct vm_parse_code_state)))) return _throw(ERR_MALLOC);
+    vm_parse_code_state_init(*parse,NULL);
+  }
+  buf = val_empty_string(); //chunk is a view into the file's read buffer
+  if (f->type == TYPE_FILE) n = _val_file_readchunk(f,__str_ptr(buf));
+  else n = _val_fd_readchunk(f,__str_ptr(buf));
+  *code = val_empty_code();
+  if (n < 0) { //EOF (or read error) -- finish the carried token (if any)
+    *eof = 1;
+    if (!(e = _vm_parse_input_finish(vm->p,*parse,__lst_ptr(*code))) && n != ERR_EOF) e = n;
+  } else {
+    begin = _val_str_begin(__str_ptr(buf));
+    end = begin + n;
+    for(p = begin; p != end; p = q) {
+      if (!(q = memchr(p,'\n',end-p))) q = end;
+      else ++q;
+      ncode = _val_lst_len(__lst_ptr(*code));
+      if ((e = _vm_parse_input_feed(vm->p,p,q-p,*parse,__lst_ptr(*code)))) {
+        while (_val_lst_len(__lst_ptr(*code)) > ncode) _val_lst_rdrop(__lst_ptr(*code));
+        vm_parse_code_state_destroy(*parse); //drop any carry, so the next line starts fresh
+        if (p != begin) { //eval the lines before this one first, and parse it again next time
+          if (f->type == TYPE_FILE) _val_file_unread(f,end-p);
+          else _val_fd_unread(f,end-p);
+          e = 0;
+        } else { //skip this line (it may have started in an earlier read), but keep the rest for next time
+          if (f->type == TYPE_FILE) _val_file_unread(f,end-q);
+          else _val_fd_unread(f,end-q);
+        }
+        break;
+      }
+    }
+  }
+  val_destroy(buf);
+  if (e || _val_lst_empty(__lst_ptr(*code))) {
+    val_destroy(*code);
+    *code = VAL_NULL;
+  }
+  return e;
+}
+
 // vm_dowork(vm) - evaluates work stack until empty or error
 // 
 // This function is the core vm work loop.
@@ -1287,6 +1589,9 @@ err_t vm_dowork(vm_t *vm) {
 #undef OP_LABEL1
 #undef OP_LABEL2
   const void **stateops[] = { _ops, _ops+N_OPS, _ops+2*N_OPS };
+#ifdef VM_OPSTATS
+  unsigned int opstat_prev[2] = { 0, 0 }; //last two ops dispatched (+1, 0 for none)
+#endif
 
   // - my main goals were: keep it short, minimize number of conditionals in common cases, minimize CPU instructions-per-op
   //   - we duplicate some portions to eliminate some checks we always need otherwise, but want to balance code bloat and instructions-per-op
@@ -1360,7 +1665,7 @@ err_t vm_dowork(vm_t *vm) {
   }
 
   //temp vars
-  val_t t;
+  val_t t,t2;
 #ifdef DEBUG_VAL
   val64_t dbg; //debug val
 #ifdef DEBUG_VAL_EVAL
@@ -1369,6 +1674,12 @@ err_t vm_dowork(vm_t *vm) {
 #endif
   valstruct_t *v,*tv;
   val_t *p;
+  valstruct_t key; //temp ident for bytecode lookups
+  lbuf_t *fb; //buffer of the borrowed code frame on top of the work stack
+  const char *ip; //bytecode pointer
+  int32_t i32;
+  int64_t i64;
+  uint32_t len;
 
   //unsigned int tui;
   //int ti;
@@ -1388,6 +1699,8 @@ err_t vm_dowork(vm_t *vm) {
 
 #define SET_LOOP_RETURN do{_op_return=&&loop_return;}while(0)
 #define SET_CODE_RETURN do{_op_return=&&code_return;}while(0)
+#define SET_BYTECODE_RETURN do{_op_return=&&bytecode_return;}while(0)
+#define SET_FRAME_RETURN do{_op_return=&&frame_return;}while(0)
 #define SET_NOEVAL_RETURN do{_op_return=&&noeval_return;}while(0)
 
 //TODO: clean up naming convension for stack macros (reserve, fix, restore, ...)
@@ -1419,6 +1732,35 @@ err_t vm_dowork(vm_t *vm) {
 #define WPUSH2(x,y) do{ if ((workend-work) < 2) WRESERVE; *(work++)=x; *(work++)=y; }while(0)
 #define WPUSH3(x,y,z) do{ if ((workend-work) < 3) WRESERVE; *(work++)=x; *(work++)=y; *(work++)=z; }while(0)
 #define WPROTECT(x) do{ if (work==workend) WRESERVE; VM_TRY(val_protect(&(x))); *(work++)=x; }while(0)
+#define WDROP do{ --work; val_destroy(*work); val_clear(work); }while(0)
+
+//push a val we don't own (a dictionary def, loop body, or quotation still on the stack) onto the work stack to be evaled
+// - code gets a borrowed frame (buffer reference + index, see frame_return) instead of a clone, anything else is cloned
+#define WPUSH_BORROW(x) do{ \
+    if (val_is_code(x) && val_is_null(__val_dbg_val(x)) && !_val_lst_empty(__lst_ptr(x))) { \
+      if ((workend-work) < 3) WRESERVE; \
+      tv = __lst_ptr(x); \
+      _lbuf_borrow(tv->v.lst.buf); \
+      work[0] = __int_val(tv->v.lst.off + tv->v.lst.len); \
+      work[1] = __int_val(tv->v.lst.off); \
+      work[2] = __frame_val(tv->v.lst.buf); \
+      work += 3; \
+    } else { \
+      VM_TRY(val_clone(&x,x)); \
+      WPUSH(x); \
+    } \
+  }while(0)
+//step the frame on top of the work stack past element n-1, dropping it after the last one
+#define FRAME_NEXT do{ \
+    if (n == __val_int(work[-3])) { \
+      work -= 3; \
+      val_clear(work); val_clear(work+1); val_clear(work+2); \
+      _lbuf_release(fb); \
+      SET_LOOP_RETURN; \
+    } else { \
+      work[-2] = __int_val(n); \
+    } \
+  }while(0)
 
 #define BURY1_1(x) do{ *(stack++)=x; state=2; }while(0)
 #define BURY1_2(x) do{ if (stack==stackend) RESERVE; *(stack++)=x; }while(0)
@@ -1477,7 +1819,7 @@ err_t vm_dowork(vm_t *vm) {
   // - current options:
   //   - array lookup (current)
   //   - multiply state by num ops per state
-#define GOTO_OP(x) goto *stateops[state][__val_op(x)]
+#define GOTO_OP(x) do{ VM_OPSTAT(opstat_prev,__val_op(x)); goto *stateops[state][__val_op(x)]; }while(0)
 //#define GOTO_OP(x) goto *_ops[state*N_OPS+__val_op(x)]
 
 
@@ -1489,7 +1831,7 @@ err_t vm_dowork(vm_t *vm) {
 #define NEXTW do{ SET_LOOP_RETURN; goto vm_debug_step; }while(0)
 #else
 #define NEXT goto *_op_return
-#define NEXTW do{ SET_LOOP_RETURN; goto loop_next; }while(0)
+#define NEXTW do{ SET_LOOP_RETURN; goto loop_return; }while(0) //via loop_return so we recheck for empty work (finished loop ops drop their work items)
 #endif
 
 //VM_try and VM_try_t assume an argument that returns an err_t; VM_TRY_t additionally makes sure t is destroyed
@@ -1536,7 +1878,6 @@ err_t vm_dowork(vm_t *vm) {
 #endif
 
   while(work != workbase) {
-loop_next:
     w = *(--work); //get next workitem and decrement work ptr (still need to destroy/clear *work as needed below)
     VM_DEBUG_EVAL(&w);
 #ifdef DEBUG_VAL_EVAL
@@ -1586,11 +1927,10 @@ loop_next:
                   GOTO_OP(t);
 #endif
                 } else { //else we replace ident with definition on work stack
-                  val_t def;
-                  VM_TRY(val_clone(&def,t));
-                  *(work++) = def; //replace *work with def
+                  WPUSH_BORROW(t);
                 }
               } else { //undefined - print error and throw undefined <====
+                vm_out_flush(vm);
                 fflush(stdout);
                 fprintf(stderr,"unknown word '%.*s'\n",_val_str_len(v),_val_str_begin(v)); //TODO: only when in terminal
                 //TODO: can we pass undefined word to exception handler???
@@ -1600,8 +1940,95 @@ loop_next:
               }
             }
             break;
-          case TYPE_BYTECODE: //bytecode - not implemented yet in this version <====
-            E_NOIMPL;
+          case TYPE_BYTECODE: //bytecode - decode and eval in place (like code, it stays on the work stack until empty) <====
+            if (_val_str_empty(v)) { val_destroy(*work); val_clear(work); NEXT; }
+            SET_BYTECODE_RETURN;
+            ++work; //undo the decrement we did above (if w not empty we keep it at top of stack)
+            if (!_bytecode_valid(v)) VM_TRY(bytecode_validate(v)); //sliced/edited by string ops since it was validated
+
+bytecode_return: //we keep looping here until v is empty or the work stack gets updated
+            _bytecode_setvalid(v); //we only step over whole items, so the rest is still valid if we get back here from the work stack
+            //ops and inline numbers decode straight from the buffer, idents are looked up in place (only strings/lists/nested bytecode get a valstruct)
+            ip = _val_str_begin(v);
+            n = (unsigned char)*ip;
+            if (n < N_CORE_OPS || n == TYPECODE_extop) { //opcode (extended ops are escaped, with the offset in the next byte)
+              if (n == TYPECODE_extop) {
+                n = N_CORE_OPS + (unsigned char)ip[1];
+                ++v->v.str.off;
+                --v->v.str.len;
+              }
+              ++v->v.str.off;
+              if (!--v->v.str.len) { //last el
+                val_destroy(*(--work)); val_clear(work);
+                SET_LOOP_RETURN;
+              }
+              VM_OPSTAT(opstat_prev,n);
+              goto *stateops[state][n];
+            }
+            switch(n) {
+              case TYPECODE_int8:
+                t = __int_val((int8_t)ip[1]);
+                n = 2;
+                break;
+              case TYPECODE_int32:
+                memcpy(&i32,ip+1,sizeof(i32));
+                t = __int_val(i32);
+                n = 1+sizeof(i32);
+                break;
+              case TYPECODE_float:
+                memcpy(&f,ip+1,sizeof(f));
+                t = __dbl_val(f);
+                n = 1+sizeof(f);
+                break;
+              case TYPECODE_qident:
+              case TYPECODE_ident:
+                if (n == TYPECODE_qident) {
+                  len = (unsigned char)ip[1];
+                  n = 2;
+                } else {
+                  n = 1 + _bytecode_read_vbyte32(ip+1,&len);
+                }
+                if (!len || ip[n] == '\\') { //escaped, push unescaped copy onto stack
+                  VM_TRY(bytecode_lpop(v,&t));
+                  if (len) _val_str_unescape(__ident_ptr(t));
+                  goto bytecode_push;
+                }
+                //lookup with a temp ident pointing into the bytecode (so we don't need a valstruct for each eval)
+                key = *v;
+                key.type = TYPE_IDENT;
+                key.v.str.off += n;
+                key.v.str.len = len;
+                _val_str_clearcache(&key);
+                t = _val_dict_get(&vm->dict,&key);
+                if (val_is_null(t)) { //undefined
+                  vm_out_flush(vm);
+                  fflush(stdout);
+                  fprintf(stderr,"unknown word '%.*s'\n",(int)len,ip+n); //TODO: only when in terminal
+                  fflush(stderr);
+                  E_UNDEFINED;
+                }
+                v->v.str.off += n+len;
+                v->v.str.len -= n+len;
+                if (!v->v.str.len) { //last el (t is owned by the dict, so it is safe to destroy the bytecode)
+                  val_destroy(*(--work)); val_clear(work);
+                  SET_LOOP_RETURN;
+                }
+                if (val_is_op(t) && val_is_null(__val_dbg_val(t))) GOTO_OP(t);
+                WPUSH_BORROW(t);
+                NEXTW;
+              default: //strings, lists, and nested bytecode (pushed, like quotations inside code)
+                VM_TRY(bytecode_lpop(v,&t));
+                goto bytecode_push;
+            }
+            v->v.str.off += n;
+            v->v.str.len -= n;
+bytecode_push:
+            if (!v->v.str.len) { //last el
+              val_destroy(*(--work)); val_clear(work);
+              SET_LOOP_RETURN;
+            }
+            PUSH(t);
+            NEXT; //keep looping on current bytecode val until it is empty
           default: //string (or other str-based push types we add) - push it <====
             PUSH(w);
             val_clear(work); //clear *work since we moved it to stack
@@ -1621,11 +2048,27 @@ code_return: //we keep looping here until w is empty or the work stack gets upda
             //TODO: optimization (lpop vs iterate with pointers vs mixed)
             //  - lpop up front is simple, and makes for simple last el handling
             //  - iterating with pointers could skip lots of administration for some common cases (e.g. opcode, file)
+
+            //defined ident -- lookup in place instead of lpop (which clones from shared code), so the ident keeps its hash/def caches across evals
+            t = *_val_lst_begin(v);
+            if (val_is_ident(t) && val_is_null(__val_dbg_val(t)) && !_val_str_escaped(__ident_ptr(t))
+                && !val_is_null(t = vm_dict_get(vm,__ident_ptr(t))) && val_is_null(__val_dbg_val(t))) {
+              _val_lst_ldrop(v);
+              if (_val_lst_empty(v)) { //last el (t is owned by the dict, so it is safe to destroy the code)
+                val_destroy(*(--work)); val_clear(work);
+                SET_LOOP_RETURN;
+              }
+              if (val_is_op(t)) GOTO_OP(t);
+              WPUSH_BORROW(t);
+              NEXTW;
+            }
+
             VM_TRY(_val_lst_lpop(v,&t));
             if (_val_lst_empty(v)) { //last el
               val_destroy(*(--work)); val_clear(work);
               SET_LOOP_RETURN;
             }
+code_eval: //eval t (which we own) -- shared with borrowed frames for the vals that escape them
 #ifdef DEBUG_VAL_EVAL
             //if debug_val_eval, we eval debug val in place of val (if debug val is not null/push-type)
             if( debug_val_eval ) {
@@ -1667,11 +2110,11 @@ code_return: //we keep looping here until w is empty or the work stack gets upda
                           GOTO_OP(t);
 #endif
                         } else { //else we push definition onto work stack TODO: if push type, directly push to stack instead
-                          VM_TRY(val_clone(&t,t));
-                          WPUSH(t);
+                          WPUSH_BORROW(t);
                           NEXTW;
                         }
                       } else { //undefined
+                        vm_out_flush(vm);
                         fflush(stdout);
                         fprintf(stderr,"unknown word '%.*s'\n",_val_str_len(tv),_val_str_begin(tv)); //TODO: only when in terminal
                         fflush(stderr);
@@ -1680,8 +2123,7 @@ code_return: //we keep looping here until w is empty or the work stack gets upda
                       }
                     }
                     break;
-                  case TYPE_BYTECODE:
-                    E_NOIMPL;
+                  //case TYPE_BYTECODE: -- pushed (same as code inside code)
                   default:
                     PUSH(t);
                 }
@@ -1748,24 +2190,19 @@ code_return: //we keep looping here until w is empty or the work stack gets upda
         v = __val_ptr(w);
         switch(v->type) {
           case TYPE_FILE:
+          case TYPE_FD:
             ++work; //undo the decrement we did above (file stays on stack until empty)
-            if (0>(e = _val_file_readline_(v,FILE_BUF,FILE_BUFLEN))) {
-              val_destroy(w); val_clear(--work); //done with file;
-              if (e != ERR_EOF) HANDLE_e;
-            } else if (e==0 || (e==1 && FILE_BUF[0]=='\n')) { //empty line
-              goto loop_next; //TODO: or should we just re-read in a tight loop over empty lines???
-            } else {
-              int len = e;
-              t = val_empty_code();
-              VM_TRY_t(_vm_parse_input(vm->p,FILE_BUF,len,__lst_ptr(t)));
-              if (_val_lst_empty(__lst_ptr(t))) {
-                val_destroy(t);
-              } else {
-                WPUSH(t);
+            if (v->type == TYPE_FILE && _val_file_f(v) == stdin) VM_TRY(vm_out_flush(vm)); //show partial lines (e.g. prompts) before blocking on input
+            {
+              int eof;
+              e = _vm_file_next(vm,v,&t,&eof);
+              if (eof) {
+                val_destroy(w); val_clear(--work); //done with file;
               }
-              goto loop_next;
+              if (e) HANDLE_e;
+              if (!val_is_null(t)) WPUSH(t);
             }
-            break;
+            break; //back to the loop test -- the work stack may be empty now
 
           case TYPE_VM:
             e = val_vm_eval_final(&t,v);
@@ -1777,12 +2214,40 @@ code_return: //we keep looping here until w is empty or the work stack gets upda
             break;
           //case TYPE_DICT:
           //case TYPE_REF:
-          //case TYPE_FD:
           default:
             val_clear(work); //clear *work since we moved it to stack
             PUSH(w);
         }
         break;
+      case _FRAME_TAG: //borrowed code frame -- eval next val in the frame's buffer <================
+        ++work; //undo the decrement we did above (the frame stays on the work stack until done)
+        SET_FRAME_RETURN;
+
+frame_return: //we keep looping here until the frame is done or the work stack gets updated
+        //frames borrow their elements from the (usually shared) code buffer, so ops, inline vals and defined idents never need a copy
+        // - we only clone a val when it escapes the frame (pushed to the stack, or handed to code_eval)
+        fb = __frame_buf(work[-1]);
+        n = __val_int(work[-2]);
+        t = fb->p[n++];
+        if (val_is_null(__val_dbg_val(t))) {
+          if (val_is_op(t)) {
+            FRAME_NEXT;
+            GOTO_OP(t);
+          } else if (val_is_int(t) || val_is_double(t)) {
+            FRAME_NEXT;
+            PUSH(t);
+            NEXT;
+          } else if (val_is_ident(t) && !_val_str_escaped(__ident_ptr(t))
+              && !val_is_null(t2 = vm_dict_get(vm,__ident_ptr(t))) && val_is_null(__val_dbg_val(t2))) {
+            FRAME_NEXT; //t2 is owned by the dict, so it is safe to drop the frame
+            if (val_is_op(t2)) GOTO_OP(t2);
+            WPUSH_BORROW(t2);
+            NEXTW;
+          }
+        }
+        VM_TRY(val_clone(&t,t)); //t escapes the frame -- the only copy a frame makes
+        FRAME_NEXT;
+        goto code_eval;
       case _TAG5: // we don't use this type tage yet <================
         E_BADTYPE;
       //case _INT_TAG:
@@ -1798,7 +2263,7 @@ loop_return:
   }
 
   FIXSTACKS;
-  return 0;
+  return vm_out_flush(vm);
 
 
   //in noeval mode, we don't use the stack pointers, but directly operate on vm->open_list (remember to update stackval and call RESTORESTACK before leaving noeval)
@@ -1806,26 +2271,16 @@ loop_return:
 //noeval_next:
     w = *(--work); //get next workitem and decrement work ptr (still need to destroy/clear *work as needed below)
     VM_DEBUG_EVAL(&w);
-    if (val_is_file(w)) {
+    if (val_is_file(w) || val_is_fd(w)) {
       ++work; //undo the decrement we did above (file stays on wstack until empty)
-      v = __file_ptr(w);
-      if (0>(e = _val_file_readline_(v,FILE_BUF,FILE_BUFLEN))) {
+      v = __val_ptr(w);
+      int eof;
+      e = _vm_file_next(vm,v,&t,&eof);
+      if (eof) {
         val_destroy(w); val_clear(--work); //done with file;
-        if (e != ERR_EOF) goto handle_noeval_err;
-      } else if (e==0 || (e==1 && FILE_BUF[0]=='\n')) { //empty line
-        //continue;
-      } else {
-        int len = e;
-        t = val_empty_code();
-        if ((e = _vm_parse_input(vm->p,FILE_BUF,len,__lst_ptr(t)))) {
-          val_destroy(t);
-          goto handle_noeval_err;
-        } else if (_val_lst_empty(__lst_ptr(t))) {
-          val_destroy(t);
-        } else {
-          WPUSH(t);
-        }
       }
+      if (e) goto handle_noeval_err;
+      if (!val_is_null(t)) WPUSH(t);
     } else if (val_is_ident(w) && _vm_qeval(vm,__ident_ptr(w),&e)) {
       val_destroy(w); val_clear(work); //done with file -- assumes qeval doesn't use or modify wstack
 
@@ -1838,6 +2293,10 @@ loop_return:
         STATE_0;
         NEXTW;
       }
+    } else if (val_is_frame(w)) { //back to a code val, so we can qeval idents in place
+      ++work;
+      if ((e = _vm_frame_code(work-3))) goto handle_noeval_err;
+      work -= 2;
     } else if (val_is_code(w)) {
       ++work; //undo above dec (code stays on wstack until empty)
       v = __code_ptr(w);
@@ -1901,7 +2360,9 @@ op_end_2:
 op_break_0:
 op_break_1:
 op_break_2:
+  VM_TRY(_vm_unborrow_work(workbase,&work));
   FIXSTACKS;
+  vm_out_flush(vm);
   return ERR_BREAK;
 
 op_eval_0: STATE_0TO1;
@@ -1922,6 +2383,21 @@ op_parsecode_2:
   VM_TRY_t(vm_parse_code(vm,_val_str_begin(tv),_val_str_len(tv),__lst_ptr(t)));
   __val_reset(&_TOP_12,t);
   NEXT;
+op_compile_0: STATE_0TO1;
+op_compile_1:
+op_compile_2:
+  if (val_is_code(_TOP_12)) {
+    t = val_empty_bytecode();
+    VM_TRY_t(vm_bytecode_compile(vm,__bytecode_ptr(t),_TOP_12));
+    _bytecode_setvalid(__bytecode_ptr(t)); //our own output, so no need to validate it
+    __val_reset(&_TOP_12,t);
+  } else if (val_is_string(_TOP_12)) { //precompiled bytecode (e.g. read from file) -- validate before we let it be evaled
+    VM_TRY(bytecode_validate(__str_ptr(_TOP_12)));
+    __str_ptr(_TOP_12)->type = TYPE_BYTECODE;
+  } else if (!val_is_bytecode(_TOP_12)) {
+    E_BADTYPE;
+  }
+  NEXT;
 op_parsecode__0: STATE_0TO1;
 op_parsecode__1:
 op_parsecode__2:
@@ -2051,6 +2527,8 @@ op_size_2:
     t = __int_val(_val_lst_len(__lst_ptr(_TOP_12)));
   } else if (val_is_str(_TOP_12)) {
     t = __int_val(_val_str_len(__str_ptr(_TOP_12)));
+  } else if (val_is_vec(_TOP_12)) {
+    t = __int_val(_val_vec_len(__vec_ptr(_TOP_12)));
   } else {
     E_BADTYPE;
   }
@@ -2430,7 +2908,7 @@ op_sort_2:
   if (!val_is_lst(_TOP_12)) E_BADTYPE;
   tv = __lst_ptr(_TOP_12);
   VM_TRY(_val_lst_deref(tv));
-  val_qsort(_val_lst_begin(tv),_val_lst_len(tv));
+  val_sort(_val_lst_begin(tv),_val_lst_len(tv));
   NEXT;
 
 op_rsort_0: STATE_0TO1;
@@ -2439,9 +2917,51 @@ op_rsort_2:
   if (!val_is_lst(_TOP_12)) E_BADTYPE;
   tv = __lst_ptr(_TOP_12);
   VM_TRY(_val_lst_deref(tv));
-  val_rqsort(_val_lst_begin(tv),_val_lst_len(tv));
+  val_rsort(_val_lst_begin(tv),_val_lst_len(tv));
   NEXT;
 
+op_sortby_0: STATE_0TO1;
+op_sortby_1: STATE_1TO2;
+op_sortby_2:
+  if (!val_is_lst(_SECOND_2) || !val_is_code(_TOP_2)) E_BADTYPE;
+  tv = __lst_ptr(_SECOND_2);
+  VM_TRY(_val_lst_deref(tv));
+  //[<] and [>] -- native stable sort
+  if (_val_lst_len(__lst_ptr(_TOP_2)) == 1) {
+    t = *_val_lst_begin(__lst_ptr(_TOP_2));
+    if (val_is_ident(t) && val_is_null(__val_dbg_val(t)) && !_val_str_escaped(__ident_ptr(t))) t = vm_dict_get(vm,__ident_ptr(t));
+    if (val_is_op(t) && (__val_op(t) == OP_lt || __val_op(t) == OP_gt)) {
+      VM_TRY(__val_op(t) == OP_lt ? val_msort(_val_lst_begin(tv),_val_lst_len(tv)) : val_rmsort(_val_lst_begin(tv),_val_lst_len(tv)));
+      POP_2;
+      NEXT;
+    }
+  }
+  if (_val_lst_len(tv) < 2) {
+    POP_2;
+    NEXT;
+  }
+  {
+    val_t st[6];
+    VM_TRY(val_msort_init(st,_SECOND_2));
+    WPUSH3(st[0],st[1],st[2]);
+    WPUSH3(st[3],st[4],st[5]);
+  }
+  WPUSH2(_TOP_2,__op_val(OP_sortby));
+  val_clear(--stack); STATE_0;
+  i = -1;
+  goto loop_sortby_next;
+op_psort_0: STATE_0TO1;
+op_psort_1:
+op_psort_2: //sort chunks in child vms on the worker pool, then merge them (see vm_par.h)
+  if (!val_is_lst(_TOP_12)) E_BADTYPE;
+  tv = __lst_ptr(_TOP_12);
+  if (2 > (n = vm_par_chunks(_val_lst_len(tv))) || !val_sort_mergeable(_val_lst_begin(tv),_val_lst_len(tv))) goto op_sort_2;
+  e = vm_par_eval(vm,tv,VAL_NULL,OP_sort,n,&t);
+  if (e==ERR_THROW || e==ERR_USER_THROW) PUSH(t); //list is left as it was under the thrown val
+  if (e) HANDLE_e;
+  POP_12;
+  goto op_par_done;
+
 op_clearlist_0: STATE_0TO1;
 op_clearlist_1:
 op_clearlist_2:
@@ -2477,6 +2997,23 @@ op_protect_2:
   VM_TRY(val_protect(&_TOP_12));
   NEXT;
 
+  //wide int math (int47/int64, or an int32 op that overflowed) -- checked after the int32/double cases so they stay as fast as before
+#define WIDE_MATH(op) \
+  if ((val_is_integer(_SECOND_2) || val_is_double(_SECOND_2)) && (val_is_integer(_TOP_2) || val_is_double(_TOP_2))) { \
+    VM_TRY(val_int_binop(&_SECOND_2,_TOP_2,op)); \
+    _POP_2; \
+    NEXT; \
+  }
+
+  //vec math (elementwise, or broadcasting a number) -- checked after the number cases so they stay as fast as before
+#define VEC_MATH(op) \
+  if (val_is_vec(_SECOND_2) || val_is_vec(_TOP_2)) { \
+    VM_TRY(val_vec_binop(&_SECOND_2,_TOP_2,op)); \
+    _POP_2; \
+    NEXT; \
+  } \
+  E_BADTYPE
+
   //TODO: use the math ops defined in val_math.h
 op_add_0: STATE_0TO1;
 op_add_1: STATE_1TO2;
@@ -2487,7 +3024,8 @@ op_add_2:
   __val_dbg_destroy(_TOP_2); //destroy dbg val of top (second retains)
   if (val_is_int(_TOP_2)) {
     if (val_is_int(_SECOND_2)) {
-      __val_set(&_SECOND_2, __int_val( __val_int(_SECOND_2) + __val_int(_TOP_2) ) );
+      if (__builtin_add_overflow(__val_int(_SECOND_2),__val_int(_TOP_2),&i32)) goto op_add_wide;
+      __val_set(&_SECOND_2, __int_val(i32));
       _POP_2;
       NEXT;
     } else if (val_is_double(_SECOND_2)) {
@@ -2506,7 +3044,9 @@ op_add_2:
       NEXT;
     }
   }
-  E_BADTYPE;
+op_add_wide:
+  WIDE_MATH(INT_ADD);
+  VEC_MATH(VEC_ADD);
 
 op_sub_0: STATE_0TO1;
 op_sub_1: STATE_1TO2;
@@ -2515,7 +3055,8 @@ op_sub_2:
   __val_dbg_destroy(_TOP_2); //destroy dbg val of top (second retains)
   if (val_is_int(_TOP_2)) {
     if (val_is_int(_SECOND_2)) {
-      __val_set(&_SECOND_2, __int_val( __val_int(_SECOND_2) - __val_int(_TOP_2) ) );
+      if (__builtin_sub_overflow(__val_int(_SECOND_2),__val_int(_TOP_2),&i32)) goto op_sub_wide;
+      __val_set(&_SECOND_2, __int_val(i32));
       _POP_2;
       NEXT;
     } else if (val_is_double(_SECOND_2)) {
@@ -2534,7 +3075,9 @@ op_sub_2:
       NEXT;
     }
   }
-  E_BADTYPE;
+op_sub_wide:
+  WIDE_MATH(INT_SUB);
+  VEC_MATH(VEC_SUB);
 
 op_mul_0: STATE_0TO1;
 op_mul_1: STATE_1TO2;
@@ -2543,7 +3086,8 @@ op_mul_2:
   __val_dbg_destroy(_TOP_2); //destroy dbg val of top (second retains)
   if (val_is_int(_TOP_2)) {
     if (val_is_int(_SECOND_2)) {
-      __val_set(&_SECOND_2, __int_val( __val_int(_SECOND_2) * __val_int(_TOP_2) ) );
+      if (__builtin_mul_overflow(__val_int(_SECOND_2),__val_int(_TOP_2),&i32)) goto op_mul_wide;
+      __val_set(&_SECOND_2, __int_val(i32));
       _POP_2;
       NEXT;
     } else if (val_is_double(_SECOND_2)) {
@@ -2562,7 +3106,9 @@ op_mul_2:
       NEXT;
     }
   }
-  E_BADTYPE;
+op_mul_wide:
+  WIDE_MATH(INT_MUL);
+  VEC_MATH(VEC_MUL);
 
 op_div_0: STATE_0TO1;
 op_div_1: STATE_1TO2;
@@ -2571,7 +3117,9 @@ op_div_2:
   __val_dbg_destroy(_TOP_2); //destroy dbg val of top (second retains)
   if (val_is_int(_TOP_2)) {
     if (val_is_int(_SECOND_2)) {
-      __val_set(&_SECOND_2, __int_val( __val_int(_SECOND_2) / __val_int(_TOP_2) ) );
+      i32 = __val_int(_TOP_2);
+      if (!i32 || (i32 == -1 && __val_int(_SECOND_2) == INT32_MIN)) goto op_div_wide; //throws / promotes
+      __val_set(&_SECOND_2, __int_val( __val_int(_SECOND_2) / i32 ) );
       _POP_2;
       NEXT;
     } else if (val_is_double(_SECOND_2)) {
@@ -2590,15 +3138,19 @@ op_div_2:
       NEXT;
     }
   }
-  E_BADTYPE;
+op_div_wide:
+  WIDE_MATH(INT_DIV);
+  VEC_MATH(VEC_DIV);
 
 op_inc_0: STATE_0TO1;
 op_inc_1:
 op_inc_2:
-  if (val_is_int(_TOP_12)) {
+  if (val_is_int(_TOP_12) && __val_int(_TOP_12) != INT32_MAX) {
     ++*(int32_t*)(&_TOP_12);
   } else if (val_is_double(_TOP_12)) {
     __val_set(&_TOP_12, __dbl_val(__val_dbl(_TOP_12) + 1));
+  } else if (val_is_integer(_TOP_12)) {
+    VM_TRY(val_int_binop(&_TOP_12,__int_val(1),INT_ADD));
   } else {
     E_BADTYPE;
   }
@@ -2607,10 +3159,12 @@ op_inc_2:
 op_dec_0: STATE_0TO1;
 op_dec_1:
 op_dec_2:
-  if (val_is_int(_TOP_12)) {
+  if (val_is_int(_TOP_12) && __val_int(_TOP_12) != INT32_MIN) {
     --*(int32_t*)(&_TOP_12);
   } else if (val_is_double(_TOP_12)) {
     __val_set(&_TOP_12, __dbl_val(__val_dbl(_TOP_12) - 1));
+  } else if (val_is_integer(_TOP_12)) {
+    VM_TRY(val_int_binop(&_TOP_12,__int_val(1),INT_SUB));
   } else {
     E_BADTYPE;
   }
@@ -2619,10 +3173,12 @@ op_dec_2:
 op_neg_0: STATE_0TO1;
 op_neg_1:
 op_neg_2:
-  if (val_is_int(_TOP_12)) {
+  if (val_is_int(_TOP_12) && __val_int(_TOP_12) != INT32_MIN) {
     *(int32_t*)(&_TOP_12) *= -1;
   } else if (val_is_double(_TOP_12)) {
     __val_set(&_TOP_12, __dbl_val(-__val_dbl(_TOP_12)));
+  } else if (val_is_integer(_TOP_12)) {
+    VM_TRY(val_int_neg(&_TOP_12));
   } else {
     E_BADTYPE;
   }
@@ -2631,7 +3187,7 @@ op_neg_2:
 op_abs_0: STATE_0TO1;
 op_abs_1:
 op_abs_2:
-  if (val_is_int(_TOP_12)) {
+  if (val_is_int(_TOP_12) && __val_int(_TOP_12) != INT32_MIN) {
     i = __val_int(_TOP_12);
     if (i<0) {
       *(int32_t*)(&_TOP_12) *= -1;
@@ -2642,6 +3198,8 @@ op_abs_2:
       f *= -1;
       __val_set(&_TOP_12, __dbl_val(f));
     }
+  } else if (val_is_integer(_TOP_12)) {
+    if (val_int64(_TOP_12) < 0) VM_TRY(val_int_neg(&_TOP_12));
   } else {
     E_BADTYPE;
   }
@@ -2656,6 +3214,9 @@ op_sqrt_2:
     __val_set(&_TOP_12, __int_val( (int)sqrt( (double)__val_int(_TOP_12) ) ));
   } else if (val_is_double(_TOP_12)) {
     __val_set(&_TOP_12, __dbl_val(sqrt(__val_dbl(_TOP_12))));
+  } else if (val_is_integer(_TOP_12)) {
+    VM_TRY(val_int_fromdbl(&t,sqrt(val_num_dbl(_TOP_12))));
+    __val_reset(&_TOP_12,t);
   } else {
     E_BADTYPE;
   }
@@ -2668,9 +3229,88 @@ op_log_2:
     __val_set(&_TOP_12, __int_val( (int)log( (double)__val_int(_TOP_12) ) ));
   } else if (val_is_double(_TOP_12)) {
     __val_set(&_TOP_12, __dbl_val(log(__val_dbl(_TOP_12))));
+  } else if (val_is_integer(_TOP_12)) {
+    VM_TRY(val_int_fromdbl(&t,log(val_num_dbl(_TOP_12))));
+    __val_reset(&_TOP_12,t);
+  } else {
+    E_BADTYPE;
+  }
+  NEXT;
+
+op_vec_0: STATE_0TO1;
+op_vec_1:
+op_vec_2:
+  if (val_is_lst(_TOP_12)) {
+    VM_TRY(val_vec_from_list(&t,__lst_ptr(_TOP_12)));
+  } else if (val_is_vec(_TOP_12)) {
+    VM_TRY(val_vec_to_list(&t,__vec_ptr(_TOP_12)));
   } else {
     E_BADTYPE;
   }
+  val_destroy(_TOP_12);
+  _TOP_12 = t;
+  NEXT;
+
+op_vreduce_0: STATE_0TO1;
+op_vreduce_1: STATE_1TO2;
+op_vreduce_2: //lists are reduced through a temporary vec
+  STATE_1;
+  if (!val_is_str(_TOP_2)) E_BADARGS;
+  {
+    enum vec_reduce r;
+    VM_TRY(val_vec_reduce_parse(&r,_val_str_begin(__str_ptr(_TOP_2)),_val_str_len(__str_ptr(_TOP_2))));
+    if (val_is_vec(_SECOND_2)) {
+      VM_TRY(val_vec_reduce(&t,__vec_ptr(_SECOND_2),r));
+    } else if (val_is_lst(_SECOND_2)) {
+      val_t v;
+      VM_TRY(val_vec_from_list(&v,__lst_ptr(_SECOND_2)));
+      e = val_vec_reduce(&t,__vec_ptr(v),r);
+      val_destroy(v);
+      if (e) HANDLE_e;
+    } else {
+      E_BADTYPE;
+    }
+  }
+  POP_2;
+  val_destroy(_TOP_1);
+  _TOP_1 = t;
+  NEXT;
+
+op_dot_0: STATE_0TO1;
+op_dot_1: STATE_1TO2;
+op_dot_2:
+  STATE_1;
+  if (!val_is_vec(_SECOND_2) || !val_is_vec(_TOP_2)) E_BADTYPE;
+  VM_TRY(val_vec_dot(&t,__vec_ptr(_SECOND_2),__vec_ptr(_TOP_2)));
+  POP_2;
+  val_destroy(_TOP_1);
+  _TOP_1 = t;
+  NEXT;
+
+op_clock_0: STATE_0TO1;
+op_clock_1:
+op_clock_2: //"s"/"ms"/"us"/"ns" since the epoch, or with a "mono." prefix from the monotonic clock (for timing)
+  if (!val_is_str(_TOP_12)) E_BADARGS;
+  {
+    struct timespec ts;
+    clockid_t clk = CLOCK_REALTIME;
+    int64_t unit;
+    const char *s = _val_str_begin(__str_ptr(_TOP_12));
+    unsigned int sn = _val_str_len(__str_ptr(_TOP_12));
+    if (sn > 5 && !strncmp(s,"mono.",5)) {
+      clk = CLOCK_MONOTONIC;
+      s += 5; sn -= 5;
+    }
+    if (sn == 1 && s[0] == 's') unit = 1000000000;
+    else if (sn == 2 && s[0] == 'm' && s[1] == 's') unit = 1000000;
+    else if (sn == 2 && s[0] == 'u' && s[1] == 's') unit = 1000;
+    else if (sn == 2 && s[0] == 'n' && s[1] == 's') unit = 1;
+    else E_BADARGS;
+    if (clock_gettime(clk,&ts)) E_BADARGS;
+    VM_TRY(val_int64_init(&t,((int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec) / unit));
+  }
+  val_destroy(_TOP_12);
+  _TOP_12 = t;
   NEXT;
 
 op_pow_0: STATE_0TO1;
@@ -2699,62 +3339,99 @@ op_pow_2:
       NEXT;
     }
   }
+  if ((val_is_integer(_SECOND_2) || val_is_double(_SECOND_2)) && (val_is_integer(_TOP_2) || val_is_double(_TOP_2))) { //wide ints
+    f = pow(val_num_dbl(_SECOND_2),val_num_dbl(_TOP_2));
+    val_destroy(_TOP_2);
+    __val_reset(&_SECOND_2,__dbl_val(f));
+    _POP_2;
+    NEXT;
+  }
   E_BADTYPE;
 
 op_mod_0: STATE_0TO1;
 op_mod_1: STATE_1TO2;
 op_mod_2:
-  if (!val_is_int(_TOP_2) || !val_is_int(_SECOND_2)) E_BADTYPE;
+  if (!val_is_integer(_TOP_2) || !val_is_integer(_SECOND_2)) E_BADTYPE;
   __val_dbg_destroy(_TOP_2);
-  __val_set(&_SECOND_2, __int_val(__val_int(_SECOND_2) % __val_int(_TOP_2)));
+  if (val_is_int(_TOP_2) && val_is_int(_SECOND_2) && __val_int(_TOP_2) > 0) {
+    __val_set(&_SECOND_2, __int_val(__val_int(_SECOND_2) % __val_int(_TOP_2)));
+  } else { //wide ints, and the divisors int32 % can trap on (0 and -1)
+    VM_TRY(val_int_binop(&_SECOND_2,_TOP_2,INT_MOD));
+  }
   _POP_2;
   NEXT;
 
 op_bit_and_0: STATE_0TO1;
 op_bit_and_1: STATE_1TO2;
 op_bit_and_2:
-  if (!val_is_int(_TOP_2) || !val_is_int(_SECOND_2)) E_BADTYPE;
+  if (!val_is_integer(_TOP_2) || !val_is_integer(_SECOND_2)) E_BADTYPE;
   __val_dbg_destroy(_TOP_2);
-  __val_set(&_SECOND_2, __int_val(__val_int(_SECOND_2) & __val_int(_TOP_2)));
+  if (val_is_int(_TOP_2) && val_is_int(_SECOND_2)) {
+    __val_set(&_SECOND_2, __int_val(__val_int(_SECOND_2) & __val_int(_TOP_2)));
+  } else { //wide ints
+    VM_TRY(val_int_binop(&_SECOND_2,_TOP_2,INT_AND));
+  }
   _POP_2;
   NEXT;
 op_bit_or_0: STATE_0TO1;
 op_bit_or_1: STATE_1TO2;
 op_bit_or_2:
-  if (!val_is_int(_TOP_2) || !val_is_int(_SECOND_2)) E_BADTYPE;
+  if (!val_is_integer(_TOP_2) || !val_is_integer(_SECOND_2)) E_BADTYPE;
   __val_dbg_destroy(_TOP_2);
-  __val_set(&_SECOND_2, __int_val(__val_int(_SECOND_2) | __val_int(_TOP_2)));
+  if (val_is_int(_TOP_2) && val_is_int(_SECOND_2)) {
+    __val_set(&_SECOND_2, __int_val(__val_int(_SECOND_2) | __val_int(_TOP_2)));
+  } else { //wide ints
+    VM_TRY(val_int_binop(&_SECOND_2,_TOP_2,INT_OR));
+  }
   _POP_2;
   NEXT;
 op_bit_xor_0: STATE_0TO1;
 op_bit_xor_1: STATE_1TO2;
 op_bit_xor_2:
-  if (!val_is_int(_TOP_2) || !val_is_int(_SECOND_2)) E_BADTYPE;
+  if (!val_is_integer(_TOP_2) || !val_is_integer(_SECOND_2)) E_BADTYPE;
   __val_dbg_destroy(_TOP_2);
-  __val_set(&_TOP_12, __int_val(__val_int(_SECOND_2) ^ __val_int(_TOP_2)));
+  if (val_is_int(_TOP_2) && val_is_int(_SECOND_2)) {
+    __val_set(&_SECOND_2, __int_val(__val_int(_SECOND_2) ^ __val_int(_TOP_2)));
+  } else { //wide ints
+    VM_TRY(val_int_binop(&_SECOND_2,_TOP_2,INT_XOR));
+  }
   _POP_2;
   NEXT;
 op_bit_not_0: STATE_0TO1;
 op_bit_not_1:
 op_bit_not_2:
-  if (!val_is_int(_TOP_12)) E_BADTYPE;
-  __val_set(&_TOP_12, __int_val( ~__val_int(_TOP_12)));
+  if (val_is_int(_TOP_12)) {
+    __val_set(&_TOP_12, __int_val( ~__val_int(_TOP_12)));
+  } else if (val_is_wideint(_TOP_12)) {
+    VM_TRY(val_int_not(&_TOP_12));
+  } else {
+    E_BADTYPE;
+  }
   NEXT;
 
 op_bit_lshift_0: STATE_0TO1;
 op_bit_lshift_1: STATE_1TO2;
 op_bit_lshift_2:
-  if (!val_is_int(_TOP_2) || !val_is_int(_SECOND_2)) E_BADTYPE;
+  if (!val_is_integer(_TOP_2) || !val_is_integer(_SECOND_2)) E_BADTYPE;
   __val_dbg_destroy(_TOP_2);
-  __val_set(&_SECOND_2, __int_val(__val_int(_SECOND_2) << __val_int(_TOP_2)));
+  if (val_is_int(_TOP_2) && val_is_int(_SECOND_2) && __val_int(_TOP_2) >= 0 && __val_int(_TOP_2) < 32
+      && (i64 = (int64_t)__val_int(_SECOND_2) * ((int64_t)1 << __val_int(_TOP_2))) >= INT32_MIN && i64 <= INT32_MAX) {
+    __val_set(&_SECOND_2, __int_val((int32_t)i64));
+  } else { //shifted past int32 (promotes like *), wide ints, and negative counts (which throw)
+    VM_TRY(val_int_binop(&_SECOND_2,_TOP_2,INT_LSHIFT));
+  }
   _POP_2;
   NEXT;
 op_bit_rshift_0: STATE_0TO1;
 op_bit_rshift_1: STATE_1TO2;
 op_bit_rshift_2:
-  if (!val_is_int(_TOP_2) || !val_is_int(_SECOND_2)) E_BADTYPE;
+  if (!val_is_integer(_TOP_2) || !val_is_integer(_SECOND_2)) E_BADTYPE;
   __val_dbg_destroy(_TOP_2);
-  __val_set(&_SECOND_2, __int_val(__val_int(_SECOND_2) >> __val_int(_TOP_2)));
+  if (val_is_int(_TOP_2) && val_is_int(_SECOND_2) && __val_int(_TOP_2) >= 0 && __val_int(_TOP_2) < 32) {
+    __val_set(&_SECOND_2, __int_val(__val_int(_SECOND_2) >> __val_int(_TOP_2)));
+  } else { //wide ints, counts past 31, and negative counts (which throw)
+    VM_TRY(val_int_binop(&_SECOND_2,_TOP_2,INT_RSHIFT));
+  }
   _POP_2;
   NEXT;
 
@@ -2922,6 +3599,17 @@ op_find_2:
   POPD_2;
   NEXT;
 
+op_split_0: STATE_0TO1;
+op_split_1: STATE_1TO2;
+op_split_2:
+  if (!val_is_str(_TOP_2) || !val_is_str(_SECOND_2)) E_BADTYPE;
+  if (_val_str_empty(__str_ptr(_TOP_2))) E_BADARGS;
+  VM_TRY(_val_str_split(&t,__str_ptr(_SECOND_2),_val_str_begin(__str_ptr(_TOP_2)),_val_str_len(__str_ptr(_TOP_2))));
+  val_destroy(_TOP_2);
+  _TOP_2 = t;
+  POPD_2;
+  NEXT;
+
 op_parsenum_0: STATE_0TO1;
 op_parsenum_1: 
 op_parsenum_2: 
@@ -2930,13 +3618,41 @@ op_parsenum_2:
   __val_reset(&_TOP_12,t); //preserve debug val from string
   NEXT;
 
+op_parser_0: STATE_0TO1;
+op_parser_1: STATE_1TO2;
+op_parser_2:
+  STATE_1;
+  if (!val_is_lst(_SECOND_2) || !val_is_lst(_TOP_2)) E_BADTYPE;
+  VM_TRY(val_parser_init(&t,__lst_ptr(_SECOND_2),__lst_ptr(_TOP_2)));
+  POP_2;
+  val_destroy(_TOP_1);
+  _TOP_1 = t;
+  NEXT;
+
+op_parse_0: STATE_0TO1;
+op_parse_1: STATE_1TO2;
+op_parse_2: //strings are split in one go, files are read to EOF (a read buffer at a time)
+  STATE_1;
+  if (!val_is_parser(_TOP_2)) E_BADTYPE;
+  if (val_is_str(_SECOND_2)) {
+    VM_TRY(val_parser_parse(&t,__parser_ptr(_TOP_2),__str_ptr(_SECOND_2)));
+  } else if (val_is_file(_SECOND_2)) {
+    VM_TRY(val_parser_parse_file(&t,__parser_ptr(_TOP_2),__file_ptr(_SECOND_2)));
+  } else {
+    E_BADTYPE;
+  }
+  POP_2;
+  val_destroy(_TOP_1);
+  _TOP_1 = t;
+  NEXT;
+
 op_toint_0: STATE_0TO1;
 op_toint_1: 
 op_toint_2: 
   if (val_is_double(_TOP_12)) {
-    t = __int_val((int32_t)__val_dbl(_TOP_12));
+    VM_TRY(val_int_fromdbl(&t,__val_dbl(_TOP_12)));
     __val_reset(&_TOP_12,t);
-  } else if (!val_is_int(_TOP_12)) {
+  } else if (!val_is_integer(_TOP_12)) {
     E_BADTYPE;
   }
   NEXT;
@@ -2944,8 +3660,8 @@ op_toint_2:
 op_tofloat_0: STATE_0TO1;
 op_tofloat_1: 
 op_tofloat_2: 
-  if (val_is_int(_TOP_12)) {
-    t = __dbl_val((double)__val_int(_TOP_12));
+  if (val_is_integer(_TOP_12)) {
+    t = __dbl_val(val_num_dbl(_TOP_12));
     __val_reset(&_TOP_12,t);
   } else if (!val_is_double(_TOP_12)) {
     E_BADTYPE;
@@ -2997,14 +3713,14 @@ op_trim_2:
 op_isnum_0: STATE_0TO1;
 op_isnum_1: 
 op_isnum_2: 
-  t = __int_val(val_is_int(_TOP_12) || val_is_double(_TOP_12));
+  t = __int_val(val_is_integer(_TOP_12) || val_is_double(_TOP_12));
   val_destroy(_TOP_12);
   _TOP_12 = t;
   NEXT;
 op_isint_0: STATE_0TO1;
 op_isint_1: 
 op_isint_2: 
-  t = __int_val(val_is_int(_TOP_12));
+  t = __int_val(val_is_integer(_TOP_12));
   val_destroy(_TOP_12);
   _TOP_12 = t;
   NEXT;
@@ -3101,6 +3817,40 @@ op_dip_2:
   WPUSH(_TOP_2);
   STATE_0;
   NEXTW;
+
+  //superinstructions (see vm_super.h) -- each does the work of its sequence in one dispatch
+op_dup_eval_0: STATE_0TO1;
+op_dup_eval_1:
+op_dup_eval_2:
+  t = _TOP_12;
+  WPUSH_BORROW(t);
+  NEXTW;
+op_dip_eval_0: STATE_0TO1;
+op_dip_eval_1: STATE_1TO2;
+op_dip_eval_2: //like dip, but A goes on the work stack unprotected (so it is evaled instead of pushed back)
+  WPUSH2(_SECOND_2,_TOP_2);
+  val_clear(--stack);
+  STATE_0;
+  NEXTW;
+op_swap_pop_0: STATE_0TO1;
+op_swap_pop_1: STATE_1TO2;
+op_swap_pop_2:
+  POPD_2;
+  NEXT;
+op_dup_dip_0: STATE_0TO1;
+op_dup_dip_1: STATE_1TO2;
+op_dup_dip_2:
+  VM_TRY(val_clone(&t,_SECOND_2));
+  BURY1_2(t);
+  NEXT;
+op_zero_gt_0: STATE_0TO1;
+op_zero_gt_1:
+op_zero_gt_2:
+  if (val_is_int(_TOP_12)) t = __int_val(__val_int(_TOP_12) > 0);
+  else t = __int_val(val_lt(__int_val(0),_TOP_12));
+  val_destroy(_TOP_12);
+  _TOP_12 = t;
+  NEXT;
 op_dip2_0: STATE_0TO1;
 op_dip2_1:
 op_dip2_2:
@@ -3339,6 +4089,221 @@ op_swapgt_2:
   }
   NEXT;
 
+//loop ops -- each loop keeps its state on the work stack under the loop op (op(each), op(map), ...) and OP__loop
+// - the body evals on the caller's stack (same as the compiled definitions these replace -- see tests/loops.cat)
+// - work stack layout (top last): each/eachr: (list) [body] op(each) _loop
+//                                 map/mapr/filter: (list) (result) [body] op(map) _loop
+//                                 times: n [body] op(times) _loop
+//                                 while: [cond] [body] op(while) _loop
+//                                 sortby: (src) (dst) width lo i j [cmp] op(sortby) _loop (see val_msort_step)
+op_each_0: STATE_0TO1;
+op_each_1: STATE_1TO2;
+op_each_2:
+  if (!val_is_lst(_SECOND_2) && !val_is_str(_SECOND_2)) E_BADTYPE;
+  WPUSH3(_SECOND_2,_TOP_2,__op_val(OP_each));
+  val_clear(--stack); STATE_0;
+  goto loop_each;
+op_eachr_0: STATE_0TO1;
+op_eachr_1: STATE_1TO2;
+op_eachr_2:
+  if (!val_is_lst(_SECOND_2) && !val_is_str(_SECOND_2)) E_BADTYPE;
+  WPUSH3(_SECOND_2,_TOP_2,__op_val(OP_eachr));
+  val_clear(--stack); STATE_0;
+  goto loop_each;
+op_map_0: STATE_0TO1;
+op_map_1: STATE_1TO2;
+op_map_2:
+  if (!val_is_lst(_SECOND_2)) E_BADTYPE;
+  WPUSH3(_SECOND_2,(val_is_code(_SECOND_2) ? val_empty_code() : val_empty_list()),_TOP_2);
+  WPUSH(__op_val(OP_map));
+  val_clear(--stack); STATE_0;
+  goto loop_map_next;
+op_mapr_0: STATE_0TO1;
+op_mapr_1: STATE_1TO2;
+op_mapr_2:
+  if (!val_is_lst(_SECOND_2)) E_BADTYPE;
+  WPUSH3(_SECOND_2,(val_is_code(_SECOND_2) ? val_empty_code() : val_empty_list()),_TOP_2);
+  WPUSH(__op_val(OP_mapr));
+  val_clear(--stack); STATE_0;
+  goto loop_map_next;
+op_filter_0: STATE_0TO1;
+op_filter_1: STATE_1TO2;
+op_filter_2:
+  if (!val_is_lst(_SECOND_2)) E_BADTYPE;
+  WPUSH3(_SECOND_2,(val_is_code(_SECOND_2) ? val_empty_code() : val_empty_list()),_TOP_2);
+  WPUSH(__op_val(OP_filter));
+  val_clear(--stack); STATE_0;
+  goto loop_filter_next;
+op_pmap_0: STATE_0TO1;
+op_pmap_1: STATE_1TO2;
+op_pmap_2: //map/filter over chunks in child vms on the worker pool -- the body only sees its element (see vm_par.h)
+  if (!val_is_lst(_SECOND_2)) E_BADTYPE;
+  if (2 > (n = vm_par_chunks(_val_lst_len(__lst_ptr(_SECOND_2))))) goto op_map_2;
+  e = vm_par_eval(vm,__lst_ptr(_SECOND_2),_TOP_2,OP_map,n,&t);
+  if (e == ERR_EMPTY) goto op_map_2; //body needs the stack under its element (see vm_par.h)
+  goto op_pmap_done;
+op_pfilter_0: STATE_0TO1;
+op_pfilter_1: STATE_1TO2;
+op_pfilter_2:
+  if (!val_is_lst(_SECOND_2)) E_BADTYPE;
+  if (2 > (n = vm_par_chunks(_val_lst_len(__lst_ptr(_SECOND_2))))) goto op_filter_2;
+  e = vm_par_eval(vm,__lst_ptr(_SECOND_2),_TOP_2,OP_filter,n,&t);
+  if (e == ERR_EMPTY) goto op_filter_2;
+op_pmap_done:
+  POP_2;
+  if (e==ERR_THROW || e==ERR_USER_THROW) PUSH(t); //list is left as it was under the thrown val
+  if (e) HANDLE_e;
+  POP_12;
+op_par_done: //t is what the op leaves -- any extra vals from the body, then the result list
+  FIXSTACK;
+  VM_TRY_t(_val_lst_cat(stackval,__lst_ptr(t)));
+  RESTORESTACK;
+  NEXT;
+op_times_0: STATE_0TO1;
+op_times_1: STATE_1TO2;
+op_times_2:
+  if (val_is_int(_SECOND_2)) {
+    t = __int_val(__val_int(_SECOND_2));
+  } else if (val_is_wideint(_SECOND_2)) { //moves to the work stack (and stays wide until the count fits in int32)
+    t = _SECOND_2;
+  } else if (val_is_double(_SECOND_2)) { //same count as the compiled def (which decs until <= 0)
+    f = __val_dbl(_SECOND_2);
+    VM_TRY(val_int_fromdbl(&t,f > 0 ? ceil(f) : 0));
+  } else {
+    E_BADTYPE;
+  }
+  WPUSH3(t,_TOP_2,__op_val(OP_times));
+  val_clear(--stack); STATE_0;
+  goto loop_times;
+op_while_0: STATE_0TO1;
+op_while_1: STATE_1TO2;
+op_while_2:
+  WPUSH3(_SECOND_2,_TOP_2,__op_val(OP_while));
+  val_clear(--stack); STATE_0;
+  t = work[-3];
+  WPUSH(__op_val(OP__loop));
+  WPUSH_BORROW(t);
+  NEXTW;
+
+op__loop_0:
+op__loop_1:
+op__loop_2:
+  if (work-workbase < 3 || !val_is_op(work[-1])) E_BADOP; //TODO: debug assert -- only the loop ops push _loop
+  switch(__val_op(work[-1])) {
+    case OP_each: case OP_eachr: goto loop_each;
+    case OP_map: case OP_mapr: goto loop_map;
+    case OP_filter: goto loop_filter;
+    case OP_times: goto loop_times;
+    case OP_while: goto loop_while;
+    case OP_sortby: goto loop_sortby;
+    default: E_BADOP;
+  }
+
+loop_each: // (list) [body] op(each)  --  el  |  (list) [body] op(each) _loop body
+  if (val_is_lst(work[-3])) {
+    tv = __lst_ptr(work[-3]);
+    if (_val_lst_empty(tv)) { WDROP; WDROP; WDROP; NEXTW; }
+    VM_TRY(__val_op(work[-1]) == OP_each ? _val_lst_lpop(tv,&t) : _val_lst_rpop(tv,&t));
+  } else { //string -- split off first char (for eachr too, same as rpop on strings)
+    tv = __str_ptr(work[-3]);
+    if (!_val_str_len(tv)) { WDROP; WDROP; WDROP; NEXTW; }
+    VM_TRY(_val_str_splitn(tv,&t,1));
+    val_swap(&work[-3],&t);
+  }
+  PUSH(t);
+  goto loop_body;
+
+loop_map: // result el  --  result+el
+  if (!state) STATE_0TO1;
+  VM_TRY(__val_op(work[-1]) == OP_map ? _val_lst_rpush(__lst_ptr(work[-3]),top) : _val_lst_lpush(__lst_ptr(work[-3]),top));
+  _POP_12;
+loop_map_next: // (list) (result) [body] op(map)  --  (result)  |  el  (list) (result) [body] op(map) _loop body
+  tv = __lst_ptr(work[-4]);
+  if (_val_lst_empty(tv)) goto loop_map_end;
+  VM_TRY(__val_op(work[-1]) == OP_map ? _val_lst_lpop(tv,&t) : _val_lst_rpop(tv,&t));
+  PUSH(t);
+  goto loop_body;
+loop_map_end:
+  WDROP; WDROP;
+  t = *(--work); val_clear(work);
+  WDROP;
+  PUSH(t);
+  NEXTW;
+
+loop_filter: // el bool  --  (el moved from list to result if bool)
+  if (!state) STATE_0TO1;
+  i = val_as_bool(top);
+  POP_12;
+  VM_TRY(_val_lst_lpop(__lst_ptr(work[-4]),&t));
+  if (i) {
+    VM_TRY_t(_val_lst_rpush(__lst_ptr(work[-3]),t));
+  } else {
+    val_destroy(t);
+  }
+loop_filter_next: // (list) (result) [body] op(filter)  --  (result)  |  el  (list) (result) [body] op(filter) _loop body
+  tv = __lst_ptr(work[-4]);
+  if (_val_lst_empty(tv)) goto loop_map_end;
+  VM_TRY(val_clone(&t,*_val_lst_begin(tv))); //leave el in list until we have the result
+  PUSH(t);
+  goto loop_body;
+
+loop_times: // n [body] op(times)  --  |  n-1 [body] op(times) _loop body
+  if (val_is_int(work[-3])) {
+    n = __val_int(work[-3]);
+    if (n <= 0) { WDROP; WDROP; WDROP; NEXTW; }
+    work[-3] = __int_val(n-1);
+  } else { //wide count
+    if ((i64 = val_int64(work[-3])) <= 0) { WDROP; WDROP; WDROP; NEXTW; }
+    VM_TRY(val_int64_init(&t,i64-1));
+    val_destroy(work[-3]);
+    work[-3] = t;
+  }
+  goto loop_body;
+
+loop_while: // [cond] [body] op(while) bool  --  |  [cond] [body] op(while) _loop cond body
+  if (!state) STATE_0TO1;
+  i = val_as_bool(top);
+  POP_12;
+  if (!i) { WDROP; WDROP; WDROP; NEXTW; }
+  t = work[-3];
+  t2 = work[-2];
+  WPUSH(__op_val(OP__loop));
+  WPUSH_BORROW(t);
+  WPUSH_BORROW(t2);
+  NEXTW;
+
+loop_sortby: // lhs<rhs  --  |  lhs rhs  (src) (dst) w lo i j [cmp] op(sortby) _loop cmp  (see val_msort_step)
+  if (!state) STATE_0TO1;
+  i = val_as_bool(top);
+  POP_12;
+loop_sortby_next: // (src) (dst) w lo i j [cmp] op(sortby)  --  (sorted)  |  lhs rhs  (src) (dst) w lo i j [cmp] op(sortby) _loop cmp
+  if (0>(e = val_msort_step(work-8,i,&t,&t2))) HANDLE_e;
+  if (e) {
+    PUSH(t);
+    PUSH(t2);
+    goto loop_body;
+  }
+  WDROP; WDROP; WDROP; WDROP; WDROP; WDROP; WDROP;
+  t = *(--work); val_clear(work);
+  PUSH(t);
+  NEXTW;
+
+loop_body: // ... [body] op(X)  --  ... [body] op(X) _loop body
+  t = work[-2];
+  WPUSH(__op_val(OP__loop));
+  //single-op body (e.g. [+]) -- dispatch directly instead of evaluating a clone of the body
+  if (val_is_code(t) && _val_lst_len(__lst_ptr(t)) == 1) {
+    t = *_val_lst_begin(__lst_ptr(t));
+    if (val_is_ident(t) && val_is_null(__val_dbg_val(t)) && !_val_str_escaped(__ident_ptr(t))) t = vm_dict_get(vm,__ident_ptr(t));
+    if (val_is_op(t) && val_is_null(__val_dbg_val(t))) {
+      SET_LOOP_RETURN;
+      GOTO_OP(t);
+    }
+  }
+  t = work[-3];
+  WPUSH_BORROW(t);
+  NEXTW;
+
 op_list_0:
 op_list_1:
 op_list_2:
@@ -3350,37 +4315,43 @@ op_print_0: STATE_0TO1;
 op_print_1:
 op_print_2:
   //VM_TRY(val_print(top));
-  VM_TRY(val_printv(_TOP_12));
+  VM_TRY(vm_out_print(vm,_TOP_12,fmt_v,1));
   POP_12;
   NEXT;
 op_print__0: STATE_0TO1;
 op_print__1:
 op_print__2:
   //VM_TRY(val_print_(top));
-  VM_TRY(val_printv_(_TOP_12));
+  VM_TRY(vm_out_print(vm,_TOP_12,fmt_v,0));
   POP_12;
   NEXT;
 op_printV_0: STATE_0TO1;
 op_printV_1:
 op_printV_2:
   //VM_TRY(val_print_code(top));
-  VM_TRY(val_printV(_TOP_12));
+  VM_TRY(vm_out_print(vm,_TOP_12,fmt_V,1));
   POP_12;
   NEXT;
 op_printV__0: STATE_0TO1;
 op_printV__1:
 op_printV__2:
   //VM_TRY(val_print_code_(top));
-  VM_TRY(val_printV_(_TOP_12));
+  VM_TRY(vm_out_print(vm,_TOP_12,fmt_V,0));
   POP_12;
   NEXT;
+op_flush_0:
+op_flush_1:
+op_flush_2:
+  VM_TRY(vm_out_flush(vm));
+  if (fflush(stdout)) { e = _throw(ERR_IO_ERROR); HANDLE_e; }
+  NEXT;
 op_printf_0: STATE_0TO1;
 op_printf_1:
 op_printf_2:
   if (!val_is_str(_TOP_12)) E_BADTYPE;
   STATE_0;
   FIXSTACK; //fixes stack (without top, so we still need to destroy after)
-  e = val_printfv(__str_ptr(top), vm->open_list,1);
+  e = vm_out_printfv(vm,__str_ptr(top), vm->open_list,1, vm->open_list,1);
   RESTORESTACK;
   val_destroy(top);
   if (0>e) HANDLE_e;
@@ -3392,6 +4363,7 @@ op_fprintf_2:
   t = _SECOND_2; val_clear(--stack);
   STATE_0;
   FIXSTACK; //fixes stack (without top, so we still need to destroy after)
+  if (_val_file_f(__file_ptr(t)) == stdout) vm_out_flush(vm); //keep buffered print output ahead of direct writes
   e = val_fprintfv(_val_file_f(__file_ptr(t)),__str_ptr(top), vm->open_list,1, vm->open_list,1);
   RESTORESTACK;
   val_destroy(top);
@@ -3429,7 +4401,7 @@ op_printlf_0: STATE_0TO1;
 op_printlf_1: STATE_1TO2;
 op_printlf_2:
   if (!val_is_str(_TOP_12) || !val_is_lst(_SECOND_2)) E_BADTYPE;
-  e = val_printfv(__str_ptr(_TOP_2), __lst_ptr(_SECOND_2),0);
+  e = vm_out_printfv(vm,__str_ptr(_TOP_2), __lst_ptr(_SECOND_2),0, __lst_ptr(_SECOND_2),0);
   POP_2;
   if (0>e) HANDLE_e;
   NEXT;
@@ -3451,7 +4423,7 @@ op_printlf2_1:
 op_printlf2_2:
   if (!HAVE(2)) E_MISSINGARGS; STATE_2;
   if (!val_is_str(_TOP_12) || !val_is_lst(_SECOND_2) || !val_is_lst(_THIRD_2)) E_BADTYPE;
-  e = val_fprintfv(stdout,__str_ptr(_TOP_2), __lst_ptr(_THIRD_2),0, __lst_ptr(_SECOND_2),0);
+  e = vm_out_printfv(vm,__str_ptr(_TOP_2), __lst_ptr(_THIRD_2),0, __lst_ptr(_SECOND_2),0);
 
   if (0>e) {
     HANDLE_e;
@@ -3511,6 +4483,7 @@ op_getdef_2:
   if (!val_is_str(_TOP_12)) E_BADARGS;
   t = vm_dict_get(vm,__str_ptr(_TOP_12));
   if (val_is_null(t)) {
+    vm_out_flush(vm);
     fflush(stdout);
     fprintf(stderr,"unknown word '%.*s'\n",_val_str_len(__str_ptr(_TOP_12)),_val_str_begin(__str_ptr(_TOP_12))); //TODO: only when in terminal
     fflush(stderr);
@@ -3623,6 +4596,13 @@ op_dict_put_2:
   if (0>(e = _val_dict_put(__dict_ptr(_THIRD_2),__str_ptr(_TOP_2),_SECOND_2))) HANDLE_e; e=0;
   _POP2_2;
   NEXT;
+op_dict_keys_0: STATE_0TO1;
+op_dict_keys_1:
+op_dict_keys_2:
+  if (!val_is_dict(_TOP_12)) E_BADARGS;
+  VM_TRY(_val_dict_keys(__dict_ptr(_TOP_12),&t));
+  PUSH(t);
+  NEXT;
 
 op_open_0: STATE_0TO1;
 op_open_1: STATE_1TO2;
@@ -3630,7 +4610,11 @@ op_open_2:
   if (!val_is_str(_SECOND_2) || !val_is_str(_TOP_2)) E_BADARGS;
   VM_TRY(_val_str_make_cstr(__str_ptr(_SECOND_2)));
   VM_TRY(_val_str_make_cstr(__str_ptr(_TOP_2)));
-  VM_TRY(val_file_init(&t,_val_str_begin(__str_ptr(_SECOND_2)),_val_str_begin(__str_ptr(_TOP_2))));
+  if (!strcmp(_val_str_begin(__str_ptr(_TOP_2)),"m")) { //"m" maps the file read-only as a string
+    VM_TRY(val_file_map(&t,_val_str_begin(__str_ptr(_SECOND_2))));
+  } else {
+    VM_TRY(val_file_init(&t,_val_str_begin(__str_ptr(_SECOND_2)),_val_str_begin(__str_ptr(_TOP_2))));
+  }
   val_destroy(_TOP_2);
   _TOP_2 = t;
   POPD_2;
@@ -3643,6 +4627,8 @@ op_close_2:
     VM_TRY(_val_file_close(__file_ptr(_TOP_12)));
   } else if (val_is_fd(_TOP_12)) {
     VM_TRY(_val_fd_close(__fd_ptr(_TOP_12)));
+  } else if (val_is_chan(_TOP_12)) {
+    VM_TRY(_val_chan_close(__chan_ptr(_TOP_12)));
   } else {
     E_BADARGS;
   }
@@ -3651,9 +4637,16 @@ op_close_2:
 op_readline_0: STATE_0TO1;
 op_readline_1:
 op_readline_2:
-  if (!val_is_file(_TOP_12)) E_BADARGS;
-  t = val_empty_string();
-  if (0>(n = _val_file_readline(__file_ptr(_TOP_12),__str_ptr(t)))) {
+  t = val_empty_string(); //line is a view into the file's read buffer
+  if (val_is_file(_TOP_12)) {
+    n = _val_file_readline(__file_ptr(_TOP_12),__str_ptr(t));
+  } else if (val_is_fd(_TOP_12)) {
+    n = _val_fd_readline(__fd_ptr(_TOP_12),__str_ptr(t));
+  } else {
+    val_destroy(t);
+    E_BADARGS;
+  }
+  if (0>n) {
     val_destroy(t);
     t = __int_val(n);
   }
@@ -3663,6 +4656,7 @@ op_readline_2:
 op_stdin_readline_0:
 op_stdin_readline_1:
 op_stdin_readline_2:
+  VM_TRY(vm_out_flush(vm)); //show any prompt before blocking on input
   t = val_empty_string();
   if (0>(n = _val_file_readline(&_val_file_stdin,__str_ptr(t)))) {
     val_destroy(t);
@@ -3699,9 +4693,10 @@ op_write_1: STATE_1TO2;
 op_write_2:
   if (!val_is_string(_TOP_2)) E_BADARGS;
   if (val_is_file(_SECOND_2)) {
-    VM_TRY(_val_file_write(__file_ptr(_SECOND_2),__str_ptr(_TOP_2)));
+    if (_val_file_f(__file_ptr(_SECOND_2)) == stdout) VM_TRY(vm_out_flush(vm));
+    if (0>(e = _val_file_write(__file_ptr(_SECOND_2),__str_ptr(_TOP_2)))) HANDLE_e; //returns bytes written
   } else if (val_is_fd(_SECOND_2)) {
-    VM_TRY(_val_fd_write(__fd_ptr(_SECOND_2),__str_ptr(_TOP_2)));
+    if (0>(e = _val_fd_write(__fd_ptr(_SECOND_2),__str_ptr(_TOP_2)))) HANDLE_e;
   } else {
     E_BADARGS;
   }
@@ -3727,15 +4722,54 @@ op_seek_2:
 op_fpos_0: STATE_0TO1;
 op_fpos_1:
 op_fpos_2:
-  if (val_is_file(_SECOND_2)) {
+  if (val_is_file(_TOP_12)) {
     PUSH(__int_val(_val_file_pos(__file_ptr(_TOP_12))));
-  } else if(val_is_fd(_SECOND_2)) {
+  } else if(val_is_fd(_TOP_12)) {
     PUSH(__int_val(_val_fd_pos(__fd_ptr(_TOP_12))));
   } else {
     E_BADARGS;
   }
   NEXT;
 
+op_chan_0: STATE_0TO1;
+op_chan_1:
+op_chan_2:
+  if (!val_is_int(_TOP_12) || __val_int(_TOP_12) < 0) E_BADARGS;
+  VM_TRY(val_chan_init(&t,__val_int(_TOP_12)));
+  __val_set(&_TOP_12,t); //top was int so no destroy
+  NEXT;
+op_send_0: STATE_0TO1;
+op_send_1: STATE_1TO2;
+op_send_2:
+  if (!val_is_chan(_SECOND_2)) E_BADARGS;
+  VM_TRY(_val_chan_send(__chan_ptr(_SECOND_2),_TOP_2));
+  _POP_2; //channel owns val now
+  NEXT;
+op_recv_0: STATE_0TO1;
+op_recv_1:
+op_recv_2: //blocks until val sent or channel closed and drained
+  if (!val_is_chan(_TOP_12)) E_BADARGS;
+  if ((e = _val_chan_recv(__chan_ptr(_TOP_12),&t))) {
+    if (e != ERR_EOF) HANDLE_e;
+    PUSH(__int_val(0));
+  } else {
+    PUSH(t);
+    PUSH(__int_val(1));
+  }
+  NEXT;
+op_try_recv_0: STATE_0TO1;
+op_try_recv_1:
+op_try_recv_2: //same as recv, but never blocks (0 if nothing ready)
+  if (!val_is_chan(_TOP_12)) E_BADARGS;
+  if ((e = _val_chan_tryrecv(__chan_ptr(_TOP_12),&t))) {
+    if (e != ERR_EOF && e != ERR_EMPTY) HANDLE_e;
+    PUSH(__int_val(0));
+  } else {
+    PUSH(t);
+    PUSH(__int_val(1));
+  }
+  NEXT;
+
   //FIXME: validate full error checking and error recovery/cleanup for ref ops
 op_ref_0: STATE_0TO1;
 op_ref_1:
@@ -4005,7 +5039,7 @@ op_vm_2:
 
   //VM_TRY(val_vm_init2(&t,__lst_ptr(_SECOND_2),__lst_ptr(_TOP_2))); //TODO: do we copy dict to child vm???
   //  - if we don't copy dict, then default init child dict (could pass scope/dict val to child as needed)
-  //FIXME: make dict is threadsafe (either do deep clone, or don't copy over, or something)
+  //child gets clone of dict (O(1) -- hashtables are persistent, so defs in either vm copy just the touched path)
   VM_TRY(_val_dict_clone(&t,&vm->dict));
   VM_TRY_t(val_vm_init3(&t,__lst_ptr(_SECOND_2),__lst_ptr(_TOP_2),__dict_ptr(t)));
   __val_set(&_TOP_2, t); //replace top val with vm (retains old top debug)
@@ -4016,21 +5050,37 @@ op_thread_1: STATE_1TO2;
 op_thread_2:
   if (!val_is_lst(_TOP_2) || !val_is_lst(_SECOND_2)) E_BADTYPE;
   __val_dbg_destroy(_SECOND_2); //vm keeps debug val of work stack (top), drops second debug val
-  //FIXME: make dict is threadsafe (either do deep clone, or don't copy over, or something)
-  //  - see op_vm above
-  VM_TRY(_val_dict_clone(&t,&vm->dict));
   //FIXME: make sure we pass threadsafe stacks (e.g. any refcounted objects should have their own references so we can CoW)
-  VM_TRY_t(val_vm_init3(&t,__lst_ptr(_SECOND_2),__lst_ptr(_TOP_2),__dict_ptr(t)));
-  tv = __vm_ptr(t);
-  VM_TRY(_val_lst_deref(&tv->v.vm->stack));
-  VM_TRY(_val_lst_deref(&tv->v.vm->work));
+  VM_TRY(_vm_child(vm,__lst_ptr(_SECOND_2),__lst_ptr(_TOP_2),&t));
   __val_set(&_TOP_2, t); //replace top val with vm (retains old top debug)
   _POPD_2;
   VM_TRY(_val_vm_runthread(__vm_ptr(t)));
   NEXT;
+op_submit_0: STATE_0TO1;
+op_submit_1: STATE_1TO2;
+op_submit_2: //same as thread, but queued on vm_sched worker pool
+  if (!val_is_lst(_TOP_2) || !val_is_lst(_SECOND_2)) E_BADTYPE;
+  __val_dbg_destroy(_SECOND_2);
+  VM_TRY(_vm_child(vm,__lst_ptr(_SECOND_2),__lst_ptr(_TOP_2),&t));
+  __val_set(&_TOP_2, t); //replace top val with vm (retains old top debug)
+  _POPD_2;
+  VM_TRY(vm_sched_submit(__vm_ptr(t)->v.vm));
+  NEXT;
+op_await_0: STATE_0TO1;
+op_await_1:
+op_await_2: //join vm (same as eval of vm val, but only accepts vms)
+  if (!val_is_vm(_TOP_12)) E_BADTYPE;
+  e = val_vm_eval_final(&t,__vm_ptr(_TOP_12)); //consumes vm
+  _POP_12;
+  if (e==0 || e==ERR_THROW || e==ERR_USER_THROW) {
+    PUSH(t);
+  }
+  if (e) HANDLE_e;
+  NEXT;
 op_debug_0:
 op_debug_1:
 op_debug_2:
+  VM_TRY(_vm_unborrow_work(workbase,&work)); //debuggee work stack is user visible
   FIXSTACKS;
   VM_TRY(vm_debug_wrap(vm));
   RESTORESTACKS;
@@ -4120,6 +5170,7 @@ op_vm_vstate_2:
 op_catch_debug_0:
 op_catch_debug_1:
 op_catch_debug_2:
+  VM_TRY(_vm_unborrow_work(workbase,&work));
   FIXSTACKS;
   vm_perror(vm); //TODO: normalize error printing -- also, does catch_debug need to be opcode, or could it just be in dict???
   vm_drop(vm); //pop error we just printed
@@ -4202,6 +5253,7 @@ op_throw_2:
 op_perror_0: STATE_0TO1;
 op_perror_1:
 op_perror_2:
+  VM_TRY(vm_out_flush(vm));
   VM_TRY(errval_fprintf(stdout,top));
   POP_12;
   NEXT;
@@ -4247,6 +5299,7 @@ op_quit_0:
 op_quit_1:
 op_quit_2:
   FIXSTACKS;
+  vm_out_flush(vm);
   exit(0); //TODO: or return???
 
 //
@@ -4414,9 +5467,12 @@ err_fatal: e = _fatal(e); HANDLE_e;
 
 handle_noeval_err: //TODO: allow recovery from noeval errors
   //RESTORESTACKS;
+  _vm_unborrow_work(workbase,&work);
   FIXSTACKS;
+  vm_out_flush(vm);
   return e;
 handle_err:
+  vm_out_flush(vm); //anything printed so far goes out before the error is reported
   if (err_isfatal(e)) return e;
   else {
     if (e != ERR_THROW && e != ERR_USER_THROW) { //if err not already on stack, push e to stack
@@ -4430,6 +5486,7 @@ handle_err:
       //NEXT;
       NEXTW;
     } else {
+      if ((ee = _vm_unborrow_work(workbase,&work))) return ee; //leave the work stack as plain vals (for vm.wstack, debugging or continuing later)
       FIXSTACKS;
       return e;
     }
@@ -4445,6 +5502,10 @@ vm_debug_step: //print some debug state before each vm step
     }
   } else if (_op_return == &&code_return) {
     val_fprintf(stdout,"VM_STEP(c%d): %V\n",__int_val(state),*_val_lst_begin(v));
+  } else if (_op_return == &&bytecode_return) {
+    val_fprintf(stdout,"VM_STEP(b%d): %V\n",__int_val(state),__bytecode_val(v));
+  } else if (_op_return == &&frame_return) {
+    val_fprintf(stdout,"VM_STEP(f%d): %V\n",__int_val(state),__frame_buf(work[-1])->p[__val_int(work[-2])]);
   } else if (_op_return == &&noeval_return) {
     if (work != workbase) {
       val_fprintf(stdout,"VM_STEP(n%d): %V\n",__int_val(state),work[-1]);
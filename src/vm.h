@@ -31,6 +31,7 @@ struct vm_stats {
 // - parser - currently just global default vm_parser
 // - nested list/code tracking
 // - thread, lock, and thread state
+// - print output buffer
 // - stats (for debugging)
 // - debug_val_eval flag (if DEBUG_VAL_EVAL defined)
 //
@@ -48,6 +49,11 @@ typedef struct _vm_t {
 
   pthread_t thread; //thread for parallel evaluation
   int threadid; //used for printing threadid in state
+  int sched; //running as vm_sched task instead of on own thread (no pthread to join)
+  err_t err; //result of vm_sched task (read by _vm_join)
+
+  valstruct_t *out; //buffered print output (see vm_out.h), NULL until first print
+  unsigned long out_time; //ms timestamp of last flush (for time flush policy)
 
   sem_t lock; //lock for thread
   enum state_enum { //thread state
@@ -70,7 +76,7 @@ err_t concat_init();
 int vm_init(vm_t *vm);
 err_t vm_init2(vm_t *vm, valstruct_t *stack, valstruct_t *work);
 err_t vm_init3(vm_t *vm, valstruct_t *stack, valstruct_t *work, valstruct_t *dict);
-void vm_clone(vm_t *vm, vm_t *orig);
+err_t vm_clone(vm_t *vm, vm_t *orig);
 void vm_destroy(vm_t *vm);
 
 // vm_validate - validates 
@@ -88,7 +94,7 @@ int vm_vstate(vm_t *vm);
 int vm_fprintf(vm_t *vm, FILE *file, const fmt_t *fmt);
 int vm_sprintf(vm_t *vm, valstruct_t *buf, const fmt_t *fmt);
 
-err_t vm_wait(vm_t *vm); //wait for running VM to finish (and join thread)
+err_t vm_wait(vm_t *vm); //wait for running VM to finish (and join thread or scheduled task)
 
 int vm_noeval(vm_t *vm);
 
@@ -99,6 +105,7 @@ val_t vm_dict_get(vm_t *vm, valstruct_t *key);
 
 err_t vm_val_rresolve(vm_t *vm, val_t *val);
 err_t vm_val_resolve(vm_t *vm, val_t *val);
+err_t vm_bytecode_compile(vm_t *vm, valstruct_t *b, val_t code);
 
 int vm_empty(vm_t *vm);
 err_t vm_push(vm_t *vm, val_t val);
@@ -91,7 +91,8 @@
   errcode(NOT_IMPLEMENTED, "Not implemented"), \
   errcode(STARTDEBUG, "Debug trigger"), \
   errcode(THROW, "Internal throw"), \
-  errcode(USER_THROW, "Throw from code")
+  errcode(USER_THROW, "Throw from code"), \
+  errcode(CLOSED, "Channel closed")
 
 //this enum only so we don't have to count them
 #define ERR_PENUM(e,s) POS_ERR_##e
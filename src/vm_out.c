@@ -0,0 +1,137 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "vm_out.h"
+#include "val_string.h"
+#include "val_printf.h"
+#include "vm_err.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static enum {
+  OUT_LINE,
+  OUT_SIZE,
+  OUT_TIME,
+  OUT_EXPLICIT
+} out_policy = OUT_LINE;
+static unsigned long out_limit = 0; //bytes for OUT_SIZE, ms for OUT_TIME
+static pthread_once_t out_once = PTHREAD_ONCE_INIT;
+
+static void _vm_out_init() {
+  const char *s;
+  if (!(s = getenv("CONCAT_FLUSH")) || !strcmp(s,"line")) {
+    out_policy = OUT_LINE;
+  } else if (!strcmp(s,"explicit")) {
+    out_policy = OUT_EXPLICIT;
+  } else if (!strncmp(s,"size:",5)) {
+    out_policy = OUT_SIZE;
+    out_limit = strtoul(s+5,NULL,10);
+  } else if (!strncmp(s,"time:",5)) {
+    out_policy = OUT_TIME;
+    out_limit = strtoul(s+5,NULL,10);
+  }
+}
+
+static unsigned long _vm_out_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+//write first n buffered bytes to stdout and drop them from buffer
+static err_t _vm_out_write(vm_t *vm, unsigned int n) {
+  valstruct_t *out = vm->out;
+  if (!n) return 0;
+  if (n != fwrite(_val_str_begin(out),1,n,stdout)) return _throw(ERR_IO_ERROR);
+  _val_str_substr(out,n,_val_str_len(out)-n);
+  _val_str_slide(out,0); //move leftover partial line back to the front, so free space stays on the right
+  if (out_policy == OUT_TIME) vm->out_time = _vm_out_ms();
+  return 0;
+}
+
+valstruct_t* vm_out(vm_t *vm) {
+  if (!vm->out) {
+    val_t t;
+    pthread_once(&out_once,_vm_out_init);
+    if (val_string_init_empty(&t)) return NULL;
+    if (_val_str_rreserve(__str_ptr(t),VM_OUT_CHUNK)) {
+      val_destroy(t);
+      return NULL;
+    }
+    vm->out = __str_ptr(t);
+    vm->out_time = out_policy == OUT_TIME ? _vm_out_ms() : 0;
+  }
+  return vm->out;
+}
+
+//keep at least VM_OUT_CHUNK bytes free (doubling as needed) so formatting into the buffer doesn't realloc per print
+static err_t _vm_out_reserve(valstruct_t *out) {
+  unsigned int len = _val_str_len(out);
+  if (_val_str_size(out) - len >= VM_OUT_CHUNK) return 0; //contents start at offset 0 (see _vm_out_write), so this is right space
+  return _val_str_rreserve(out,len > VM_OUT_CHUNK ? len : VM_OUT_CHUNK);
+}
+
+err_t vm_out_commit(vm_t *vm) {
+  valstruct_t *out = vm->out;
+  unsigned int len, n;
+  const char *p;
+  if (!out || !(len = _val_str_len(out))) return 0;
+  if (len < VM_OUT_MAX) {
+    switch(out_policy) {
+      case OUT_LINE: break;
+      case OUT_SIZE: if (len < out_limit) return 0; break;
+      case OUT_TIME: if (_vm_out_ms() - vm->out_time < out_limit) return 0; break;
+      default: return 0; //OUT_EXPLICIT
+    }
+  }
+  p = _val_str_begin(out);
+  for(n = len; n && p[n-1] != '\n'; --n); //only complete lines
+  if (!n && len >= VM_OUT_MAX) n = len; //unless one line filled the whole buffer
+  return _vm_out_write(vm,n);
+}
+
+err_t vm_out_flush(vm_t *vm) {
+  if (!vm->out) return 0;
+  return _vm_out_write(vm,_val_str_len(vm->out));
+}
+
+void vm_out_destroy(vm_t *vm) {
+  if (vm->out) {
+    vm_out_flush(vm);
+    val_destroy(__str_val(vm->out));
+    vm->out = NULL;
+  }
+}
+
+err_t vm_out_print(vm_t *vm, val_t val, const fmt_t *fmt, int nl) {
+  valstruct_t *out;
+  int r;
+  if (!(out = vm_out(vm))) return _fatal(ERR_MALLOC);
+  if ((r = _vm_out_reserve(out))) return r;
+  if (0>(r = val_sprintf_(val,out,fmt))) return r;
+  if (nl && 0>(r = val_sprint_ch(out,'\n'))) return r;
+  return vm_out_commit(vm);
+}
+
+int vm_out_printfv(vm_t *vm, valstruct_t *format, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack) {
+  valstruct_t *out;
+  int r;
+  if (!(out = vm_out(vm))) return _fatal(ERR_MALLOC);
+  if ((r = _vm_out_reserve(out))) return r;
+  if (0>(r = val_sprintfv(out,format,v_args,v_isstack,f_args,f_isstack))) return r; //partial output goes out when vm handles the error
+  return vm_out_commit(vm);
+}
@@ -0,0 +1,44 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef __VM_OUT_H__
+#define __VM_OUT_H__ 1
+#include "vm.h"
+
+// vm_out - per-vm output buffer for the print ops (print/printV/printf/printlf...)
+// - print ops format into vm->out, then vm_out_commit writes whatever the flush policy allows to stdout in one fwrite
+//   - one fwrite per flush means output from concurrent threads only interleaves at line (or record) boundaries,
+//     and each thread takes the stdout lock once per flush instead of once per printed piece
+// - flush policy is process-wide, from CONCAT_FLUSH:
+//   - line (default) - flush complete lines after each print (partial line waits for its newline)
+//   - size:N - flush complete lines once N bytes are buffered
+//   - time:MS - flush complete lines when at least MS milliseconds have passed since the last flush
+//   - explicit - only flush on the flush op (or complete lines once VM_OUT_MAX bytes are buffered)
+// - everything buffered is flushed when vm_dowork returns or handles an error, before anything else the vm writes to stdout
+//   directly (stack listing, error messages, stdout file ops), before reading from stdin, and on the flush op
+//
+
+#define VM_OUT_MAX (1<<20) //always flush once this much is buffered (even a partial line)
+#define VM_OUT_CHUNK 4096 //minimum free space kept in buffer (grows by doubling, so appends stay amortized O(1))
+
+valstruct_t* vm_out(vm_t *vm); //output buffer to print into (NULL on malloc failure)
+err_t vm_out_commit(vm_t *vm); //flush what the policy allows (call after each print into vm_out)
+err_t vm_out_flush(vm_t *vm); //flush everything buffered
+void vm_out_destroy(vm_t *vm); //flush and free buffer
+
+//print ops -- format into vm_out then commit
+err_t vm_out_print(vm_t *vm, val_t val, const fmt_t *fmt, int nl); //print val (with trailing newline if nl)
+int vm_out_printfv(vm_t *vm, valstruct_t *format, valstruct_t *v_args, int v_isstack, valstruct_t *f_args, int f_isstack); //<0 on error
+
+#endif
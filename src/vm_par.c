@@ -0,0 +1,148 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "vm_par.h"
+#include "vm_sched.h"
+#include "vm_err.h"
+#include "val_list.h"
+#include "val_dict.h"
+#include "val_vm.h"
+#include "val_sort.h"
+#include "opcodes.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+static unsigned int par_min = VM_PAR_MIN;
+static pthread_once_t par_once = PTHREAD_ONCE_INIT;
+
+static void _vm_par_init() {
+  const char *s;
+  long n;
+  if ((s = getenv("CONCAT_PAR_MIN")) && (n = atol(s)) > 0) par_min = n;
+}
+
+unsigned int vm_par_chunks(unsigned int len) {
+  unsigned int n;
+  pthread_once(&par_once,_vm_par_init);
+  if (len/2 < par_min) return 1;
+  n = vm_sched_workers();
+  if (n > len/par_min) n = len/par_min;
+  if (n > VM_PAR_MAX_CHUNKS) n = VM_PAR_MAX_CHUNKS;
+  return n;
+}
+
+//child vm for one chunk -- stack is (chunk) [body] (or just (chunk) for sort), work is the op
+static err_t _vm_par_task(vm_t *vm, val_t *task, val_t *p, unsigned int n, val_t body, int op) {
+  val_t stack, work, dict, t;
+  err_t e;
+  if ((e = val_list_wrap_arr_clone(&t,p,n))) return e;
+  if (op == OP_sort) {
+    stack = t;
+    e = val_list_wrap(&stack);
+  } else {
+    val_t b;
+    if ((e = val_clone(&b,body))) { val_destroy(t); return e; }
+    e = val_list_wrap2(&stack,t,b);
+  }
+  if (e) return e;
+  work = __op_val(op);
+  if ((e = val_list_wrap(&work))) { val_destroy(stack); return e; }
+  if ((e = _val_dict_clone(&dict,&vm->dict))) goto out_work;
+  if ((e = val_vm_init3(task,__lst_ptr(stack),__lst_ptr(work),__dict_ptr(dict)))) goto out_dict;
+  if ((e = vm_sched_submit(__vm_ptr(*task)->v.vm))) {
+    val_destroy(*task);
+    return e;
+  }
+  return 0;
+
+out_dict:
+  val_destroy(dict);
+out_work:
+  val_destroy(work);
+  val_destroy(stack);
+  return e;
+}
+
+err_t vm_par_eval(vm_t *vm, valstruct_t *lst, val_t body, int op, unsigned int nchunks, val_t *ret) {
+  val_t tasks[VM_PAR_MAX_CHUNKS];
+  unsigned int runs[VM_PAR_MAX_CHUNKS];
+  unsigned int i, len, nruns = 0, ntasks = 0;
+  val_t *p, extra, result;
+  valstruct_t *rv;
+  err_t e, ret_e = 0;
+
+  if (nchunks > VM_PAR_MAX_CHUNKS) nchunks = VM_PAR_MAX_CHUNKS;
+  len = _val_lst_len(lst);
+  p = _val_lst_begin(lst);
+  for(; ntasks < nchunks; ++ntasks) {
+    unsigned int lo = (unsigned long)len*ntasks/nchunks, hi = (unsigned long)len*(ntasks+1)/nchunks;
+    if ((ret_e = _vm_par_task(vm,&tasks[ntasks],p+lo,hi-lo,body,op))) break;
+  }
+
+  //join in order -- each child's stack is whatever the body left besides its results (e.g. [dup]), then the result list
+  // - those extra vals go onto the end of extra, and the results onto the end of result (so both stay in list order)
+  extra = val_empty_list();
+  result = (lst->type == TYPE_CODE ? val_empty_code() : val_empty_list()); //same type as the list, like map/filter
+  rv = __lst_ptr(result);
+  for(i=0; i<ntasks; ++i) {
+    val_t t, r, *dst;
+    valstruct_t *tv;
+    unsigned int n;
+    e = val_vm_eval_final(&t,__vm_ptr(tasks[i]));
+    if (ret_e) { //already failed -- just wait for the rest
+      val_destroy(t);
+      continue;
+    } else if (e) { //thrown val (or error code) from the child
+      if (val_is_int(t) && __val_int(t) == ERR_EMPTY) { //body reached below its element -- caller reruns the op sequentially
+        val_destroy(t);
+        ret_e = ERR_EMPTY;
+      } else {
+        *ret = t;
+        ret_e = e;
+      }
+      continue;
+    }
+    tv = __lst_ptr(t);
+    if (_val_lst_empty(tv) || !val_is_lst(_val_lst_end(tv)[-1])) {
+      val_destroy(t);
+      ret_e = _throw(ERR_BADARGS);
+      continue;
+    }
+    _val_lst_rpop(tv,&r);
+    if ((ret_e = _val_lst_cat(__lst_ptr(extra),tv))) { //cat only takes tv on success
+      val_destroy(t);
+      val_destroy(r);
+      continue;
+    }
+    if (!(n = _val_lst_len(__lst_ptr(r)))) {
+      val_destroy(r);
+    } else if ((ret_e = _val_lst_rextend(rv,n,&dst))) {
+      val_destroy(r);
+    } else {
+      runs[nruns++] = _val_lst_len(rv)-n;
+      _val_lst_move(__lst_ptr(r),dst); //r is the child's own stack list (single owner), so this is a memcpy and can't fail
+      _valstruct_release(__lst_ptr(r));
+    }
+  }
+  if (!ret_e && op == OP_sort) ret_e = val_sort_mergen(_val_lst_begin(rv),_val_lst_len(rv),runs,nruns);
+  if (!ret_e) ret_e = _val_lst_rpush(__lst_ptr(extra),result);
+  else val_destroy(result);
+  if (ret_e) {
+    val_destroy(extra);
+    return ret_e;
+  }
+  *ret = extra;
+  return 0;
+}
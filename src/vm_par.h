@@ -0,0 +1,43 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef __VM_PAR_H__
+#define __VM_PAR_H__ 1
+#include "vm.h"
+
+// vm_par - data-parallel list ops (psort/pmap/pfilter) on the vm_sched worker pool
+// - the list is cut into one chunk per worker, cloning the vals into each chunk (so the list is untouched if anything fails)
+// - each chunk runs the sequential op (sort/map/filter) in a child vm submitted to the pool
+//   - children get a clone of the caller's dict (O(1), and shared read-only between them -- see op_vm)
+//   - so the body only sees its own element (like a submitted vm), not the caller's stack
+//   - vals the body leaves besides its result (e.g. [dup]) are collected in chunk order, so they land under the result like map/filter
+//   - a body that reaches below its element underflows in the child (ERR_EMPTY), and the caller reruns the sequential op on its own stack instead
+// - results are collected in chunk order (psort then merges the sorted chunks)
+//   - psort only runs in parallel when that gives the same order as sort (see val_sort_mergeable)
+// - lists shorter than 2*VM_PAR_MIN (or CONCAT_PAR_MIN from the environment) run sequentially instead (vm_par_chunks returns 1)
+//
+
+#define VM_PAR_MIN 4096 //fewest vals per chunk
+#define VM_PAR_MAX_CHUNKS 256
+
+unsigned int vm_par_chunks(unsigned int len); //how many chunks to split a len-val list into (< 2 means don't bother)
+
+// evaluate op (OP_sort, OP_map or OP_filter) over lst in nchunks child vms, leaving lst as it was
+// - body is the map/filter quotation (ignored for sort)
+// - on success ret is a list of what the op leaves on the stack in place of lst and body: the extra vals, then the result list
+// - if any child throws, returns ERR_THROW with the first thrown val in ret
+// - returns ERR_EMPTY (without throwing) if the body underflowed the child's stack
+err_t vm_par_eval(vm_t *vm, valstruct_t *lst, val_t body, int op, unsigned int nchunks, val_t *ret);
+
+#endif
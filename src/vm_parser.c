@@ -18,7 +18,12 @@
 #include "val_string.h"
 #include "val_list.h"
 #include "val_math.h"
+#include "val_int.h"
 #include "helpers.h"
+#ifndef VM_PARSER_BUILD_FSM
+#include "vm_parser_fsm.h"
+STATIC_ASSERT(VM_PARSER_FSM_NSTATES==PSTATE_COUNT+1 && VM_PARSER_FSM_NCLASSES==PCLASS_COUNT,"vm_parser_fsm.h doesn't match parse_state/parse_class (run make parser-fsm)");
+#endif
 
 #include <ctype.h>
 
@@ -58,16 +63,38 @@ err_t vm_parse_tok(const char *tok, int len, enum parse_state state, enum parse_
   }
 }
 
+//parse token into val_t using what the fsm already knows about it (single pass) -- see the WORD/NUMBER states in vm_new_parser
+// - NUMBER tokens are [+-]digits, and the value was accumulated by the ACC ops as they were scanned
+// - WORD tokens start with a letter or '_' (never a number), and the fsm only keeps valid ident chars in them
+// - single char operator tokens are idents
+// - everything else (strings, comments, escaped idents, floats, 2dup, ...) goes through vm_parse_tok
+static err_t _vm_parse_tok(const char *tok, int len, int state, struct parser_state *ps, val_t *v) {
+  switch(state) {
+    case PSTATE_NUMBER:
+      if (len - (tok[0] == '-' || tok[0] == '+') <= 18) { //no overflow (longer ones might be doubles)
+        return val_int64_init(v,(tok[0] == '-' ? -(int64_t)ps->acc : (int64_t)ps->acc));
+      }
+      break;
+    case PSTATE_WORD:
+    case PSTATE_WORD_DIGIT:
+    case PSTATE_OP:
+    case PSTATE_SIGN:
+    case PSTATE_CLOSE_GROUP:
+      return val_ident_init_cstr(v,tok,len);
+  }
+  return vm_parse_tok(tok,len,state,state,v);
+}
+
 // vm_parse_input_handler - handles tokens for parse_input
-// - just calls parse_tok and rpushes onto the list arg
+// - just calls parse_tok and rpushes onto the open list
 int vm_parse_input_handler(const char *tok, int len, int state, int target, void* arg) {
   int ret;
-  valstruct_t *code=arg;
+  struct vm_parse_code_state *pstate = arg;
   val_t t;
 
-  if ((ret = vm_parse_tok(tok,len,state,target,&t))) return ret;
+  if ((ret = _vm_parse_tok(tok,len,state,&pstate->ps,&t))) return ret;
   if (!val_is_null(t)) {
-    if ((ret = _val_lst_rpush(code,t))) return ret;
+    if ((ret = _val_lst_rpush(pstate->open_list,t))) return ret;
   }
   return ret;
 }
@@ -75,8 +102,9 @@ int vm_parse_input_handler(const char *tok, int len, int state, int target, void
 
 // _vm_parse_input - parses string to code (treating parens/brackets like any other ident)
 int _vm_parse_input(struct parser_rules *p, const char *str, int len, valstruct_t *code) {
+  struct vm_parse_code_state pstate = { .root_list = code, .open_list = code, .groupi = 0 };
   if (len == 0 || str[0] == '\0') return 0;
-  return parser_eval(p,str,len,NULL,vm_parse_input_handler,code,NULL,NULL,vm_parse_input_handler,code);
+  return parser_eval(p,str,len,&pstate.ps,vm_parse_input_handler,&pstate,NULL,NULL,vm_parse_input_handler,&pstate);
 }
 
 // vm_parse_code_handler - handles tokens for parse_code, with grouping op handling
@@ -90,7 +118,7 @@ int vm_parse_code_handler(const char *tok, int len, int state, int target, void*
   int r;
 
   val_t t;
-  if ((r = vm_parse_tok(tok,len,state,target,&t))) return r;
+  if ((r = _vm_parse_tok(tok,len,state,&pstate->ps,&t))) return r;
 
   valstruct_t *v = __str_ptr(t); //need to check for val_is_str() before using
 
@@ -147,7 +175,7 @@ int vm_parse_code_handler(const char *tok, int len, int state, int target, void*
 // - if groupi = 0 at end, all open lists have been closed
 int _vm_parse_code_(struct parser_rules *p, const char *str, int len, struct vm_parse_code_state *pstate) {
   if (len == 0 || str[0] == '\0') return 0;
-  return parser_eval(p,str,len,NULL,vm_parse_code_handler,pstate,NULL,NULL,vm_parse_code_handler,pstate);
+  return parser_eval(p,str,len,&pstate->ps,vm_parse_code_handler,pstate,NULL,NULL,vm_parse_code_handler,pstate);
 }
 
 // _vm_parse_code(p,str,len,code) -  parses string to code (parsing grouping ops and verifying complete val)
@@ -160,15 +188,67 @@ int _vm_parse_code(struct parser_rules *p, const char *str, int len, valstruct_t
   return 0;
 }
 
+// _vm_parse_input_feed(p,str,len,pstate,code) - parses the next chunk of input to code (see parse_input)
+int _vm_parse_input_feed(struct parser_rules *p, const char *str, int len, struct vm_parse_code_state *pstate, valstruct_t *code) {
+  pstate->root_list = pstate->open_list = code;
+  return parser_feed(p,str,len,&pstate->ps,vm_parse_input_handler,pstate);
+}
+
+// _vm_parse_input_finish(p,pstate,code) - end of input (parses any carried token to code)
+int _vm_parse_input_finish(struct parser_rules *p, struct vm_parse_code_state *pstate, valstruct_t *code) {
+  pstate->root_list = pstate->open_list = code;
+  return parser_finish(p,&pstate->ps,vm_parse_input_handler,pstate);
+}
+
+void vm_parse_code_state_init(struct vm_parse_code_state *pstate, valstruct_t *code) {
+  pstate->root_list = code;
+  pstate->open_list = code;
+  pstate->groupi = 0;
+  parser_state_init(&pstate->ps);
+}
+
+void vm_parse_code_state_destroy(struct vm_parse_code_state *pstate) {
+  parser_state_destroy(&pstate->ps);
+}
+
 // vm_get_parser() - get a pointer to the shared concat parser rules
-// - initializes on first call
-// TODO: eventually we should store this statically so we don't need to actually call the init functions every time
+// - initializes on first call (loading the prebuilt tables from vm_parser_fsm.h, or building with vm_new_parser if VM_PARSER_BUILD_FSM)
+// - with DEBUG_CHECKS the prebuilt tables are checked against vm_new_parser (so a stale vm_parser_fsm.h fails the debug tests)
 struct parser_rules* vm_get_parser() { //get shared parser
   static struct parser_rules *p = NULL;
+#ifdef VM_PARSER_BUILD_FSM
   if (!p) p = vm_new_parser();
+#else
+  static struct parser_rules rules;
+  if (!p) {
+    parser_rules_load(&rules,vm_parser_fsm_entries,vm_parser_fsm_classes,
+        VM_PARSER_FSM_NSTATES,VM_PARSER_FSM_NCLASSES,VM_PARSER_FSM_INIT_STATE,VM_PARSER_FSM_FIN_STATE,vm_classify);
+#ifdef DEBUG_CHECKS
+    struct parser_rules *built = vm_new_parser();
+    int same = built && parser_rules_equal(&rules,built);
+    if (built) { parser_rules_destroy(built); free(built); }
+    if (!same) {
+      fprintf(stderr,"vm_parser_fsm.h is out of date (run make parser-fsm)\n");
+      return NULL;
+    }
+#endif
+    p = &rules;
+  }
+#endif
   return p;
 }
 
+// vm_write_parser(f) - write the concat parser rules as C source (this is how vm_parser_fsm.h is generated)
+int vm_write_parser(FILE *f) {
+  struct parser_rules *p = vm_new_parser();
+  int r;
+  if (!p) return -1;
+  r = parser_rules_write(f,p,"vm_parser_fsm");
+  parser_rules_destroy(p);
+  free(p);
+  return r;
+}
+
 // vm_new_parser() - construct concat parser rules
 struct parser_rules* vm_new_parser() {
   struct parser_rules *p = NULL;
@@ -275,20 +355,22 @@ struct parser_rules* vm_new_parser() {
   // - split before and goto state with same name as pclass
   //
   // -- these rules all split before and start a new token based on current char --
-  //   fsm[all][DIGIT] = (SPLIT before, DIGIT)
-  //   fsm[all][IDENT] = (SPLIT before, IDENT)
+  //   fsm[all][DIGIT] = (ACC_BEGIN, NUMBER) -- split before, and start accumulating the number
+  //   fsm[all][IDENT] = (SPLIT before, WORD)
+  //   fsm[all][DOT] = (SPLIT before, IDENT)
   //   fsm[all][IDENT_ESCAPE] = (SPLIT before, IDENT_ESCAPE)
   //   fsm[all][OP] = (SPLIT before, OP)
-  //   fsm[all][SIGN] = (SPLIT before, SIGN)
+  //   fsm[all][SIGN] = (ACC_BEGIN, SIGN) -- split before, and zero the accumulator in case a number follows
   //   fsm[all][CLOSE_GROUP] = (SPLIT before, CLOSE_GROUP)
   //   fsm[all][COMMENT] = (SPLIT before, COMMENT)
   //   fsm[all][SSTRING] = (SPLIT before, SSTRING)
   //   fsm[all][DSTRING] = (SPLIT before, DSTRING)
-  parser_set_global_op_target(p,PCLASS_DIGIT, PARSE_SPLITA_BEFORE, PSTATE_DIGIT); //general case is that digits switch us to ident mode
-  parser_set_global_op_target(p,PCLASS_IDENT, PARSE_SPLITA_BEFORE, PSTATE_IDENT); //remaining letters all send us to ident case
+  parser_set_global_op_target(p,PCLASS_DIGIT, PARSE_ACC_BEGIN,     PSTATE_NUMBER); //general case is that digits start a number
+  parser_set_global_op_target(p,PCLASS_IDENT, PARSE_SPLITA_BEFORE, PSTATE_WORD); //remaining letters all send us to ident case
+  parser_set_global_op_target(p,PCLASS_DOT,   PARSE_SPLITA_BEFORE, PSTATE_IDENT); //leading dot could still be a number (e.g. .5)
   parser_set_global_op_target(p,PCLASS_BSLASH, PARSE_SPLITA_BEFORE, PSTATE_IDENT_ESCAPE); //leading backslashes to escape identifier
   parser_set_global_op_target(p,PCLASS_OP,    PARSE_SPLITA_BEFORE, PSTATE_OP); //operator chars send us to op state
-  parser_set_global_op_target(p,PCLASS_SIGN,  PARSE_SPLITA_BEFORE, PSTATE_SIGN); //sign chars send us to sign state
+  parser_set_global_op_target(p,PCLASS_SIGN,  PARSE_ACC_BEGIN,     PSTATE_SIGN); //sign chars send us to sign state
   parser_set_global_op_target(p,PCLASS_CLOSE_GROUP,    PARSE_SPLITA_BEFORE, PSTATE_CLOSE_GROUP); //close group chars always close the current group
   parser_set_global_op_target(p,PCLASS_HASH, PARSE_SPLITA_BEFORE, PSTATE_COMMENT); //# sends us to comment
   parser_set_global_op_target(p,PCLASS_SQUOTE, PARSE_SPLITA_BEFORE, PSTATE_SSTRING); //dquote sends us to single quoted string case
@@ -302,38 +384,53 @@ struct parser_rules* vm_new_parser() {
   //
   // The current ident/number fsm states have a simplified ruleset (with final validation in vm_parse_tok).
   // - this probably needs a redesign, but is a simplified version of the old complete fsm number parser
-  // - currently not precise enough to tag tokens for parsing number vs ident (but smaller fsm)
+  // - NUMBER and WORD(_DIGIT) tag the common tokens precisely enough that the handler can skip vm_parse_tok (see _vm_parse_tok)
+  //   - NUMBER/WORD/WORD_DIGIT follow the same splitting rules as DIGIT/IDENT/DIGIT, so they tokenize exactly the same
   // FIXME: vm_parser refactor - review and possibly update these rules
   //
   // DIGIT stays in DIGIT for DIGIT chars
-  // SIGN goes to DIGIT for DIGIT chars   -- handles sign prefix on number (the only time sign isn't an op)
+  // NUMBER stays in NUMBER for DIGIT chars (accumulating them)
+  // SIGN goes to NUMBER for DIGIT chars   -- handles sign prefix on number (the only time sign isn't an op)
   //
-  // IDENT stays in IDENT for (IDENT|OP|SIGN) chars
-  // DIGIT goes to IDENT for IDENT chars -- lets things like 2dup work
+  // IDENT stays in IDENT for (IDENT|DOT|OP|SIGN) chars
+  // DIGIT,NUMBER go to IDENT for (IDENT|DOT) chars -- lets things like 2dup and 1.5 work
   // IDENT goes to DIGIT for DIGIT chars
   //
+  // WORD stays in WORD for (IDENT|DOT|OP|SIGN) chars
+  // WORD goes to WORD_DIGIT for DIGIT chars, and WORD_DIGIT back to WORD for (IDENT|DOT) chars
+  //
   // IDENT_ESCAPE stays in IDENT_ESCAPE for BSLASH char
-  // IDENT_ESCAPE goes to IDENT for IDENT chars
+  // IDENT_ESCAPE goes to IDENT for (IDENT|DOT) chars
   // IDENT_ESCAPE goes to DIGIT for DIGIT chars
   // IDENT_ESCAPE goes to OP for (OP|SIGN) chars
   //
   //
   // -- these rules all do NOSPLIT (continue building the current token) --
-  //   fsm[SIGN][DIGIT] = (NOSPLIT, DIGIT)
-  //   fsm[IDENT][IDENT,NOSPLIT,OP,SIGN] = (NOSPLIT, IDENT)
-  //   fsm[DIGIT][IDENT] = (NOSPLIT, IDENT)
+  //   fsm[SIGN][DIGIT] = (ACC_DIGIT, NUMBER)
+  //   fsm[NUMBER][DIGIT] = (ACC_DIGIT, NUMBER)
+  //   fsm[IDENT][IDENT,DOT,OP,SIGN] = (NOSPLIT, IDENT)
+  //   fsm[DIGIT,NUMBER][IDENT,DOT] = (NOSPLIT, IDENT)
   //   fsm[IDENT][DIGIT] = (NOSPLIT, DIGIT)
   //   fsm[DIGIT][DIGIT] = (NOSPLIT, DIGIT)
-  //   fsm[IDENT_ESCAPE][IDENT] = (NOSPLIT, IDENT)
+  //   fsm[WORD][IDENT,DOT,OP,SIGN] = (NOSPLIT, WORD)
+  //   fsm[WORD_DIGIT][IDENT,DOT] = (NOSPLIT, WORD)
+  //   fsm[WORD,WORD_DIGIT][DIGIT] = (NOSPLIT, WORD_DIGIT)
+  //   fsm[IDENT_ESCAPE][IDENT,DOT] = (NOSPLIT, IDENT)
   //   fsm[IDENT_ESCAPE][DIGIT] = (NOSPLIT, DIGIT)
   //   fsm[IDENT_ESCAPE][PCLASS_BSLASH] = (NOSPLIT, IDENT_ESCAPE)
   //   fsm[IDENT_ESCAPE][OP,PCLASS_SIGN] = (NOSPLIT, OP)
-  parser_set_list_op_target(p,PSTATE_SIGN,           PARSE_NOSPLIT,       PSTATE_DIGIT,   1, PCLASS_DIGIT); //sign goes to digit (if digit follows)
-  parser_set_list_op_target(p,PSTATE_IDENT,          PARSE_NOSPLIT,       PSTATE_IDENT,   3, PCLASS_IDENT, PCLASS_OP, PCLASS_SIGN); //idents keep ident chars (ident,digits, 'e', and '.')
-  parser_set_list_op_target(p,PSTATE_DIGIT,          PARSE_NOSPLIT,       PSTATE_IDENT,   1, PCLASS_IDENT); //idents keep ident chars (ident,digits, 'e', and '.')
+  parser_set_list_op_target(p,PSTATE_SIGN,           PARSE_ACC_DIGIT,     PSTATE_NUMBER,  1, PCLASS_DIGIT); //sign goes to number (if digit follows)
+  parser_set_list_op_target(p,PSTATE_NUMBER,         PARSE_ACC_DIGIT,     PSTATE_NUMBER,  1, PCLASS_DIGIT); //numbers keep accumulating digits
+  parser_set_list_op_target(p,PSTATE_IDENT,          PARSE_NOSPLIT,       PSTATE_IDENT,   4, PCLASS_IDENT, PCLASS_DOT, PCLASS_OP, PCLASS_SIGN); //idents keep ident chars (ident,digits, 'e', and '.')
+  parser_set_list_op_target(p,PSTATE_DIGIT,          PARSE_NOSPLIT,       PSTATE_IDENT,   2, PCLASS_IDENT, PCLASS_DOT); //idents keep ident chars (ident,digits, 'e', and '.')
+  parser_set_list_op_target(p,PSTATE_NUMBER,         PARSE_NOSPLIT,       PSTATE_IDENT,   2, PCLASS_IDENT, PCLASS_DOT); //number becomes ident/float (e.g. 2dup, 1.5, 1e3)
   parser_set_list_op_target(p,PSTATE_IDENT,          PARSE_NOSPLIT,       PSTATE_DIGIT,   1, PCLASS_DIGIT); //idents keep ident chars (ident,digits, 'e', and '.')
   parser_set_list_op_target(p,PSTATE_DIGIT,          PARSE_NOSPLIT,       PSTATE_DIGIT,   1, PCLASS_DIGIT); //idents keep ident chars (ident,digits, 'e', and '.')
-  parser_set_list_op_target(p,PSTATE_IDENT_ESCAPE,   PARSE_NOSPLIT,       PSTATE_IDENT,   1, PCLASS_IDENT); //idents keep ident chars (ident,digits, 'e', and '.')
+  parser_set_list_op_target(p,PSTATE_WORD,           PARSE_NOSPLIT,       PSTATE_WORD,    4, PCLASS_IDENT, PCLASS_DOT, PCLASS_OP, PCLASS_SIGN); //words keep ident chars
+  parser_set_list_op_target(p,PSTATE_WORD_DIGIT,     PARSE_NOSPLIT,       PSTATE_WORD,    2, PCLASS_IDENT, PCLASS_DOT); //words keep ident chars
+  parser_set_list_op_target(p,PSTATE_WORD,           PARSE_NOSPLIT,       PSTATE_WORD_DIGIT, 1, PCLASS_DIGIT); //words keep digits
+  parser_set_list_op_target(p,PSTATE_WORD_DIGIT,     PARSE_NOSPLIT,       PSTATE_WORD_DIGIT, 1, PCLASS_DIGIT); //words keep digits
+  parser_set_list_op_target(p,PSTATE_IDENT_ESCAPE,   PARSE_NOSPLIT,       PSTATE_IDENT,   2, PCLASS_IDENT, PCLASS_DOT); //idents keep ident chars (ident,digits, 'e', and '.')
   parser_set_list_op_target(p,PSTATE_IDENT_ESCAPE,   PARSE_NOSPLIT,       PSTATE_DIGIT,   1, PCLASS_DIGIT); //idents keep ident chars (ident,digits, 'e', and '.')
   parser_set_op_target(p,PSTATE_IDENT_ESCAPE,PCLASS_BSLASH,PARSE_NOSPLIT,PSTATE_IDENT_ESCAPE); //can have multiple leading backslashes to escape ident
   parser_set_list_op_target(p,PSTATE_IDENT_ESCAPE,PARSE_SPLITA_AFTER, PSTATE_OP, 2, PCLASS_OP, PCLASS_SIGN); //op chars can also be escaped with bslash
@@ -361,18 +458,22 @@ struct parser_rules* vm_new_parser() {
   //
 
   // SSTRING goes to INIT for SQUOTE char -- single quoted string ends on '\''
+  // SSTRING goes to INIT for NEWLINE char -- strings never span lines (an unterminated string ends with its line)
   // SSTRING stays in SSTRING for all chars except SQUOTE -- single-quoted string has no escapes
   //
   //   fsm[SSTRING][all] = (NOSPLIT, SSTRING)
   //   fsm[SSTRING][PCLASS_SQUOTE] = (SPLITA_AFTER, INIT)
+  //   fsm[SSTRING][PCLASS_NEWLINE] = (SPLITA_AFTER, INIT)
   parser_set_state_op_target(p,PSTATE_SSTRING, PARSE_NOSPLIT,       PSTATE_SSTRING); //string always goes to string (except '\'')
   parser_set_op_target(p,PSTATE_SSTRING,PCLASS_SQUOTE,PARSE_SPLITA_AFTER,PSTATE_INIT); //dquote ends string
+  parser_set_op_target(p,PSTATE_SSTRING,PCLASS_NEWLINE,PARSE_SPLITA_AFTER,PSTATE_INIT); //newline ends string (and stands in for the closing quote)
 
   //
   // == double quoted string parsing rules ==
   //
 
   //   DSTRING goes to INIT for DQUOTE char -- end of string '"'
+  //   DSTRING (and DSTRING_ESCAPE) go to INIT for NEWLINE char -- strings never span lines, like SSTRING
   //   DSTRING stays in DSTRING for all except (DQUOTE|BSLASH)
   //   DSTRING goes to DSTRING_ESCAPE for BSLASH -- bslash starts escape
   //   DSTRING_ESCAPE goes back to DSTRING for any char -- bslash escapes any char into string
@@ -383,18 +484,21 @@ struct parser_rules* vm_new_parser() {
   //   fsm[DSTRING][PCLASS_DQUOTE] = (SPLITA_AFTER, INIT)
   //   fsm[DSTRING][PCLASS_BSLASH] = (NOSPLIT, DSTRING_ESCAPE)
   //   fsm[DSTRING_ESCAPE][all] = (NOSPLIT, DSTRING)
+  //   fsm[DSTRING|DSTRING_ESCAPE][PCLASS_NEWLINE] = (SPLITA_AFTER, INIT)
   parser_set_state_op_target(p,PSTATE_DSTRING, PARSE_NOSPLIT,       PSTATE_DSTRING); //string always goes to string (except '"' and '\\')
   parser_set_op_target(p,PSTATE_DSTRING,PCLASS_DQUOTE,PARSE_SPLITA_AFTER,PSTATE_INIT); //dquote ends string
   parser_set_op_target(p,PSTATE_DSTRING,PCLASS_BSLASH,PARSE_NOSPLIT,PSTATE_DSTRING_ESCAPE); //in escape state we keep all chars in string
   parser_set_state_op_target(p,PSTATE_DSTRING_ESCAPE, PARSE_NOSPLIT,       PSTATE_DSTRING); //after escape always go back to string
+  parser_set_op_target(p,PSTATE_DSTRING,PCLASS_NEWLINE,PARSE_SPLITA_AFTER,PSTATE_INIT); //newline ends string (and stands in for the closing quote)
+  parser_set_op_target(p,PSTATE_DSTRING_ESCAPE,PCLASS_NEWLINE,PARSE_SPLITA_AFTER,PSTATE_INIT); //escaped newline too (so it is a bad escape, like at the end of a stdin line)
 
   //+/- special cases -- trailing number (where it becomes an op), or trailing group (where it becomes an op)
   //
-  // DIGIT,CLOSEGROUP go to OP on SIGN -- +/- following digit or )/] is an op and not a sign before a number
+  // DIGIT,NUMBER,WORD_DIGIT,CLOSEGROUP go to OP on SIGN -- +/- following digit or )/] is an op and not a sign before a number
   //
-  //   fsm[DIGIT][SIGN] = (SPLITA_BEFORE, OP)
+  //   fsm[DIGIT,NUMBER,WORD_DIGIT][SIGN] = (SPLITA_BEFORE, OP)
   //   fsm[CLOSE_GROUP][SIGN] = (SPLITA_BEFORE, OP)
-  parser_set_op_target(p,PSTATE_DIGIT,PCLASS_SIGN,PARSE_SPLITA_BEFORE,PSTATE_OP); //sign after digit is op
+  parser_list_set_op_target(p,PCLASS_SIGN,PARSE_SPLITA_BEFORE,PSTATE_OP,3,PSTATE_DIGIT,PSTATE_NUMBER,PSTATE_WORD_DIGIT); //sign after digit is op
   parser_set_op_target(p,PSTATE_CLOSE_GROUP,PCLASS_SIGN,PARSE_SPLITA_BEFORE,PSTATE_OP); //sign after end-of-group is op TODO: ??? for concat
 
   // all states go to FIN on NULL char
@@ -421,8 +525,8 @@ int vm_classify(char c) {
     case '"': return PCLASS_DQUOTE;
     case '+':
     case '-': return PCLASS_SIGN;
-    case '_':
-    case '.': return PCLASS_IDENT;
+    case '_': return PCLASS_IDENT;
+    case '.': return PCLASS_DOT;
     default:
       if (isspace(c)) return PCLASS_SPACE;
       else if (isdigit(c)) return PCLASS_DIGIT;
@@ -445,6 +549,7 @@ const char* vm_get_classname(int pclass) {
     case PCLASS_DIGIT: return "digit";
     case PCLASS_SIGN: return "sign char";
     case PCLASS_IDENT: return "identifier";
+    case PCLASS_DOT: return "dot";
     case PCLASS_OP: return "operator";
     case PCLASS_CLOSE_GROUP: return "end-of-group operator";
     case PCLASS_OTHER: return "invalid char";
@@ -467,6 +572,9 @@ const char* vm_get_statename(int pstate) {
     case PSTATE_CLOSE_GROUP: return "end of group";
     case PSTATE_COMMENT: return "code comment";
     case PSTATE_SIGN: return "sign";
+    case PSTATE_NUMBER: return "number";
+    case PSTATE_WORD: return "word";
+    case PSTATE_WORD_DIGIT: return "word (digit)";
     default: return NULL;
   }
   return NULL; //just for complainy compilers
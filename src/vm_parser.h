@@ -35,11 +35,9 @@
 //    - rules current described and defined in vm_parser.c in vm_new_parser()
 // 3. fsm op controls tokenizing to split off concat tokens (string/number/op/ident/comment)
 //    - each token split off is a complete concat token (number/ident could still have parse error)
-//      - token is ultimately parsed into val_t in vm_parse_tok()
-//      - the old tokenizer fully validated, but duplicated work with parse_tok
-//        - tokenizing is decoupled from parsing to keep things cleaner
-//        - to make parsing truly single-pass and reduce code size we could parse during tokenizing, but that will get messier
-//        - TODO: consider single-pass concat parser (use spare parser.h opcodes to control sub-token/token parsing)
+//      - token is ultimately parsed into val_t by the handler, using the state the fsm finished the token in
+//      - the common cases are single-pass: the fsm tells ints (with the value accumulated by the ACC ops), idents and ops apart
+//      - anything else (strings, floats, escaped idents, ...) is re-scanned by vm_parse_tok()
 //    - whitespace between tokens is dropped/ignored
 // 4. calls handler on each complete concate token to get a val_t
 //    - first char determines d/s-quoted string, operator, escaped ident, or comment
@@ -65,7 +63,8 @@ enum parse_class {
   PCLASS_SPACE,  //whitespace
   PCLASS_DIGIT,  //digit [0-9]
   PCLASS_SIGN,   //sign char [+-]
-  PCLASS_IDENT,  //letters, underscore and dot
+  PCLASS_IDENT,  //letters and underscore
+  PCLASS_DOT,    //dot (ident char, but a token starting with one could be a number)
   PCLASS_OP,     //operator chars (except those that end expressions) [[(~!@#$%^&*=/;]
   PCLASS_CLOSE_GROUP,//operators that end groups (e.g. ')') -- triggers different sign handling
   PCLASS_OTHER,  //any characters we don't need to handle specially
@@ -89,16 +88,22 @@ enum parse_state {
   PSTATE_COMMENT,        //in comment (until end of line)
 
   PSTATE_SIGN,           //+/- just seen (someplace that a number could start)
+  PSTATE_NUMBER,         //like DIGIT, but only [+-]digits so far (value in the parser accumulator)
+  PSTATE_WORD,           //like IDENT, but started with a letter or underscore (so always an ident)
+  PSTATE_WORD_DIGIT,     //like DIGIT, but in a WORD
 
   PSTATE_COUNT,  //count of parse states
   PSTATE_FIN,    //termination state
 };
 
 
+// vm_parse_code_state - nesting state for parse_code (plus fsm state for streaming parses and the ACC ops)
+// - ps only carries between calls for the _feed/_finish functions (init/destroy with vm_parse_code_state_init/destroy)
 struct vm_parse_code_state {
   valstruct_t *root_list;
   valstruct_t *open_list;
   unsigned int groupi;
+  struct parser_state ps;
 };
 
 
@@ -107,8 +112,23 @@ int _vm_parse_input(struct parser_rules *p, const char *str, int len, valstruct_
 int _vm_parse_code(struct parser_rules *p, const char *str, int len, valstruct_t *code);
 int _vm_parse_code_(struct parser_rules *p, const char *str, int len, struct vm_parse_code_state *pstate);
 
+// streaming parses - input arrives in arbitrary chunks (e.g. file/fd reads when evaluating them), see parser_feed
+// - vals are pushed onto code as soon as each token completes
+// - a token cut off by the end of a chunk is carried in the parser state (the rest of the input is never copied)
+// - finish parses the carried tail (if any) and resets the state for the next parse
+// - input mode only uses pstate for the fsm state (the vals go to code)
+// - init/destroy the state with vm_parse_code_state_init/destroy (destroy also resets it, dropping any carry)
+int _vm_parse_input_feed(struct parser_rules *p, const char *str, int len, struct vm_parse_code_state *pstate, valstruct_t *code);
+int _vm_parse_input_finish(struct parser_rules *p, struct vm_parse_code_state *pstate, valstruct_t *code);
+void vm_parse_code_state_init(struct vm_parse_code_state *pstate, valstruct_t *code);
+void vm_parse_code_state_destroy(struct vm_parse_code_state *pstate);
+
+// the shared parser is loaded from the prebuilt tables in vm_parser_fsm.h (regenerate with make parser-fsm after changing vm_new_parser)
+// - VM_PARSER_BUILD_FSM builds the rules with vm_new_parser on first use instead
+//#define VM_PARSER_BUILD_FSM 1
 struct parser_rules* vm_get_parser();
 struct parser_rules* vm_new_parser();
+int vm_write_parser(FILE *f);
 
 const char* vm_get_classname(int pclass);
 const char* vm_get_statename(int pstate);
@@ -0,0 +1,62 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef __VM_PARSER_FSM_H__
+#define __VM_PARSER_FSM_H__ 1
+
+//vm_parser_fsm.h - prebuilt parser fsm (written by parser_rules_write, do not edit)
+
+#define VM_PARSER_FSM_NSTATES 15
+#define VM_PARSER_FSM_NCLASSES 15
+#define VM_PARSER_FSM_INIT_STATE 0
+#define VM_PARSER_FSM_FIN_STATE 15
+
+static const state_entry_t vm_parser_fsm_entries[225] = {
+  0xef, 0x2f, 0x26, 0x29, 0x60, 0x23, 0x22, 0x60, 0x8b, 0x8a, 0x2c, 0x24, 0x27, 0x28, 0xef, //state 0
+  0x02, 0x2f, 0x02, 0x02, 0x40, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, //state 1
+  0x02, 0x2f, 0x01, 0x02, 0x40, 0x02, 0x40, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, //state 2
+  0x03, 0x2f, 0x03, 0x03, 0x40, 0x40, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, //state 3
+  0xef, 0x2f, 0x26, 0x29, 0x60, 0x23, 0x22, 0x60, 0x05, 0x04, 0x04, 0x04, 0x04, 0x28, 0xef, //state 4
+  0xef, 0x2f, 0x26, 0x29, 0x60, 0x23, 0x22, 0x60, 0x05, 0x27, 0x04, 0x04, 0x27, 0x28, 0xef, //state 5
+  0xef, 0x2f, 0x06, 0x29, 0x60, 0x23, 0x22, 0x60, 0x05, 0x47, 0x04, 0x04, 0x47, 0x28, 0xef, //state 6
+  0xef, 0x2f, 0x26, 0x29, 0x60, 0x23, 0x22, 0x60, 0x8b, 0x8a, 0x2c, 0x24, 0x27, 0x28, 0xef, //state 7
+  0xef, 0x2f, 0x26, 0x29, 0x60, 0x23, 0x22, 0x60, 0x8b, 0x27, 0x2c, 0x24, 0x27, 0x28, 0xef, //state 8
+  0x09, 0x40, 0x09, 0x09, 0x40, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, //state 9
+  0xef, 0x2f, 0x26, 0x29, 0x60, 0x23, 0x22, 0x60, 0xab, 0x8a, 0x2c, 0x24, 0x27, 0x28, 0xef, //state 10
+  0xef, 0x2f, 0x26, 0x29, 0x60, 0x23, 0x22, 0x60, 0xab, 0x27, 0x04, 0x04, 0x27, 0x28, 0xef, //state 11
+  0xef, 0x2f, 0x26, 0x29, 0x60, 0x23, 0x22, 0x60, 0x0d, 0x0c, 0x0c, 0x0c, 0x0c, 0x28, 0xef, //state 12
+  0xef, 0x2f, 0x26, 0x29, 0x60, 0x23, 0x22, 0x60, 0x0d, 0x27, 0x0c, 0x0c, 0x27, 0x28, 0xef, //state 13
+  0xef, 0x2f, 0x26, 0x29, 0x60, 0x23, 0x22, 0x60, 0x8b, 0x8a, 0x2c, 0x24, 0x27, 0x28, 0xef, //state 14
+};
+
+static const unsigned char vm_parser_fsm_classes[256] = {
+   1, 14, 14, 14, 14, 14, 14, 14, 14,  7,  4,  7,  7,  7, 14, 14, //0x00
+  14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, //0x10
+   7, 12,  6,  3, 12, 12, 12,  5, 12, 13, 12,  9, 12,  9, 11, 12, //0x20
+   8,  8,  8,  8,  8,  8,  8,  8,  8,  8, 14, 12, 12, 12, 12, 14, //0x30
+  12, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, //0x40
+  10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 12,  2, 13, 12, 10, //0x50
+  14, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, //0x60
+  10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 12, 12, 12, 12, 14, //0x70
+  14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, //0x80
+  14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, //0x90
+  14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, //0xa0
+  14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, //0xb0
+  14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, //0xc0
+  14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, //0xd0
+  14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, //0xe0
+  14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, 14, //0xf0
+};
+
+#endif
@@ -0,0 +1,247 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#include "vm_sched.h"
+#include "vm_internal.h"
+#include "vm_err.h"
+#include "helpers.h"
+
+#include <valgrind/helgrind.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define SCHED_DEQUE_INIT 64 //initial deque capacity (power of 2, grows by doubling)
+#define SCHED_MAX_WORKERS 256
+
+//per-worker task deque
+// - top/bottom are free-running counters (index with & (cap-1)), tasks live in [top,bottom)
+// - owner pushes/pops at bottom, thieves take from top
+// - each deque has its own lock, so contention is only between a worker and whoever is stealing from it
+struct sched_deque {
+  pthread_mutex_t lock;
+  vm_t **buf;
+  unsigned int cap;
+  unsigned int top, bottom;
+};
+
+struct sched_worker {
+  struct sched_deque q;
+  pthread_t thread;
+  unsigned int id;
+};
+
+static struct sched_worker *sched_workers = NULL;
+static unsigned int sched_nworkers = 0;
+static unsigned int sched_next = 0; //round-robin target for submits from outside the pool
+static unsigned int sched_queued = 0; //tasks sitting in deques (idle workers sleep while this is 0)
+static unsigned int sched_idle = 0; //workers sleeping on sched_wake
+static unsigned int sched_joining = 0; //workers in vm_sched_lock sleeping on sched_wake until a task finishes
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sched_wake = PTHREAD_COND_INITIALIZER;
+
+static pthread_once_t sched_once = PTHREAD_ONCE_INIT;
+static err_t sched_init_err = 0;
+
+static __thread struct sched_worker *sched_self = NULL; //worker for current thread (NULL outside pool)
+
+static err_t _deque_push(struct sched_deque *q, vm_t *vm) {
+  pthread_mutex_lock(&q->lock);
+  if (q->bottom - q->top == q->cap) { //full, double capacity (unwrapping into new buffer)
+    unsigned int i, cap = q->cap ? q->cap*2 : SCHED_DEQUE_INIT;
+    vm_t **buf;
+    if (!(buf = malloc(sizeof(vm_t*)*cap))) {
+      pthread_mutex_unlock(&q->lock);
+      return _throw(ERR_MALLOC);
+    }
+    for(i = q->top; i != q->bottom; ++i) buf[i & (cap-1)] = q->buf[i & (q->cap-1)];
+    free(q->buf);
+    q->buf = buf;
+    q->cap = cap;
+  }
+  q->buf[q->bottom & (q->cap-1)] = vm;
+  __atomic_store_n(&q->bottom,q->bottom+1,__ATOMIC_RELAXED); //atomic stores for the unlocked peek in _deque_steal
+  pthread_mutex_unlock(&q->lock);
+  return 0;
+}
+
+static vm_t* _deque_pop(struct sched_deque *q) {
+  vm_t *vm = NULL;
+  pthread_mutex_lock(&q->lock);
+  if (q->bottom != q->top) {
+    __atomic_store_n(&q->bottom,q->bottom-1,__ATOMIC_RELAXED);
+    vm = q->buf[q->bottom & (q->cap-1)];
+  }
+  pthread_mutex_unlock(&q->lock);
+  return vm;
+}
+
+static vm_t* _deque_steal(struct sched_deque *q) {
+  vm_t *vm = NULL;
+  //peek without lock first so idle workers scanning empty deques don't contend with the owner
+  if (__atomic_load_n(&q->bottom,__ATOMIC_RELAXED) == __atomic_load_n(&q->top,__ATOMIC_RELAXED)) return NULL;
+  pthread_mutex_lock(&q->lock);
+  if (q->bottom != q->top) {
+    vm = q->buf[q->top & (q->cap-1)];
+    __atomic_store_n(&q->top,q->top+1,__ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&q->lock);
+  return vm;
+}
+
+//take a task -- own deque first (newest task, still warm), then steal oldest task from the other workers
+static vm_t* _sched_take(struct sched_worker *self) {
+  vm_t *vm;
+  unsigned int i, n = __atomic_load_n(&sched_nworkers,__ATOMIC_ACQUIRE);
+  if (!(vm = _deque_pop(&self->q))) {
+    for(i = 1; i < n; ++i) {
+      if ((vm = _deque_steal(&sched_workers[(self->id + i) % n].q))) break;
+    }
+  }
+  if (vm) __atomic_sub_fetch(&sched_queued,1,__ATOMIC_SEQ_CST);
+  return vm;
+}
+
+static void _sched_run(vm_t *vm) {
+  ANNOTATE_HAPPENS_AFTER(vm);
+  vm->err = vm_dowork(vm);
+  ANNOTATE_HAPPENS_BEFORE(vm);
+  vm->state = FINISHED;
+  _vm_unlock(vm); //vm may be joined and destroyed as soon as we unlock
+  //wake workers blocked in vm_sched_lock so they can recheck their task (fence pairs with the joining count, like sched_idle/sched_queued)
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&sched_joining,__ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&sched_lock);
+    pthread_cond_broadcast(&sched_wake);
+    pthread_mutex_unlock(&sched_lock);
+  }
+}
+
+//sleep until there is something to steal
+// - sched_idle/sched_queued are seq_cst on both sides, so either the submitter sees us idle (and signals under sched_lock)
+//   or we see its task before waiting
+static void _sched_sleep() {
+  pthread_mutex_lock(&sched_lock);
+  __atomic_add_fetch(&sched_idle,1,__ATOMIC_SEQ_CST);
+  while (!__atomic_load_n(&sched_queued,__ATOMIC_SEQ_CST)) {
+    pthread_cond_wait(&sched_wake,&sched_lock);
+  }
+  __atomic_sub_fetch(&sched_idle,1,__ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&sched_lock);
+}
+
+static void* _sched_worker(void *arg) {
+  vm_t *vm;
+  sched_self = (struct sched_worker*)arg;
+  for(;;) {
+    if ((vm = _sched_take(sched_self))) _sched_run(vm);
+    else _sched_sleep();
+  }
+  return NULL;
+}
+
+static void _sched_init() {
+  long n;
+  unsigned int i;
+  const char *s;
+  if ((s = getenv("CONCAT_WORKERS"))) n = atol(s);
+  else n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n < 1) n = 1;
+  if (n > SCHED_MAX_WORKERS) n = SCHED_MAX_WORKERS;
+
+  if (!(sched_workers = calloc(n,sizeof(struct sched_worker)))) {
+    sched_init_err = _throw(ERR_MALLOC);
+    return;
+  }
+  for(i = 0; i < n; ++i) {
+    sched_workers[i].id = i;
+    pthread_mutex_init(&sched_workers[i].q.lock,NULL);
+  }
+  //workers live for the rest of the process (detached, so exit doesn't wait on them)
+  for(i = 0; i < n; ++i) {
+    if (pthread_create(&sched_workers[i].thread,NULL,_sched_worker,&sched_workers[i])) break;
+    pthread_detach(sched_workers[i].thread);
+  }
+  if (!i) {
+    sched_init_err = _throw(ERR_THREAD);
+    return;
+  }
+  //publish worker count (other workers only ever scan the ones that started)
+  __atomic_store_n(&sched_nworkers,i,__ATOMIC_RELEASE);
+}
+
+err_t vm_sched_submit(vm_t *vm) {
+  err_t e;
+  struct sched_worker *w;
+  pthread_once(&sched_once,_sched_init);
+  if (sched_init_err) return sched_init_err;
+
+  fatal_if(ERR_LOCK,_vm_lock(vm));
+  if (vm->state != STOPPED) {
+    _vm_unlock(vm);
+    return _throw(ERR_BADARGS);
+  }
+  vm->state = RUNNING;
+  vm->sched = 1;
+  vm->err = 0;
+  ANNOTATE_HAPPENS_BEFORE(vm);
+
+  if (sched_self) w = sched_self;
+  else w = &sched_workers[refcount_inc(sched_next) % sched_nworkers];
+  __atomic_add_fetch(&sched_queued,1,__ATOMIC_SEQ_CST); //count before push so takers never see it go negative
+  if ((e = _deque_push(&w->q,vm))) {
+    __atomic_sub_fetch(&sched_queued,1,__ATOMIC_SEQ_CST);
+    vm->state = STOPPED;
+    vm->sched = 0;
+    _vm_unlock(vm);
+    return e;
+  }
+  if (__atomic_load_n(&sched_idle,__ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&sched_lock);
+    pthread_cond_signal(&sched_wake);
+    pthread_mutex_unlock(&sched_lock);
+  }
+  return 0;
+}
+
+err_t vm_sched_lock(vm_t *vm) {
+  err_t e;
+  vm_t *t;
+  if (!sched_self) return _vm_lock(vm); //outside pool -- just block until task unlocks
+  //on a worker we can't just block on the vm (the task we wait on may be queued behind us), so keep the pool moving until it finishes
+  // - with nothing to run we sleep on sched_wake, counted as idle (so submits wake us) and joining (so finished tasks wake us)
+  while (ERR_LOCKED == (e = _vm_trylock(vm))) {
+    if ((t = _sched_take(sched_self))) {
+      _sched_run(t);
+      continue;
+    }
+    pthread_mutex_lock(&sched_lock);
+    __atomic_add_fetch(&sched_idle,1,__ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&sched_joining,1,__ATOMIC_SEQ_CST);
+    while (!__atomic_load_n(&sched_queued,__ATOMIC_SEQ_CST) && ERR_LOCKED == (e = _vm_trylock(vm))) {
+      pthread_cond_wait(&sched_wake,&sched_lock);
+    }
+    __atomic_sub_fetch(&sched_joining,1,__ATOMIC_SEQ_CST);
+    __atomic_sub_fetch(&sched_idle,1,__ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&sched_lock);
+    if (e != ERR_LOCKED) return e; //got the lock (or lock error) while waiting
+  }
+  return e;
+}
+
+unsigned int vm_sched_workers() {
+  pthread_once(&sched_once,_sched_init);
+  if (sched_init_err) return 0;
+  return __atomic_load_n(&sched_nworkers,__ATOMIC_ACQUIRE);
+}
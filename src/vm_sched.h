@@ -0,0 +1,32 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+#ifndef __VM_SCHED_H__
+#define __VM_SCHED_H__ 1
+#include "vm.h"
+
+// vm_sched - work-stealing scheduler for running vms as lightweight tasks (submit/await ops)
+// - fixed pool of worker threads (one per online cpu, or CONCAT_WORKERS), started on first submit
+// - each worker owns a deque of tasks: the owner pushes/pops at the bottom (LIFO), idle workers steal from the top (FIFO)
+//   - submits from a worker go to its own deque, submits from outside the pool are spread round-robin
+// - a task is just a vm_t that stays locked while queued/running (like vm_runthread), so vm_wait/eval/destroy join it as usual
+//   - vm->sched is set while the vm belongs to the scheduler, and _vm_join reads vm->err instead of joining a pthread
+// - a worker waiting on an unfinished task runs other queued tasks meanwhile, so nested submit/await can't starve the pool
+//
+
+err_t vm_sched_submit(vm_t *vm); //queue stopped vm to run on the worker pool
+err_t vm_sched_lock(vm_t *vm); //lock scheduled vm (waiting for it to finish), running other tasks meanwhile if called from a worker
+unsigned int vm_sched_workers(); //number of worker threads (starting the pool if needed), 0 if the pool couldn't start
+
+#endif
@@ -0,0 +1,131 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+
+#include "vm_super.h"
+#include "val_list.h"
+#include "opcodes.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+//superinstruction table -- the first val of the sequence is an op, an int literal, or a quotation of a single op (e.g. [dup] or \dup)
+enum super_kind { SUPER_OP, SUPER_INT, SUPER_QUOTED };
+static const struct {
+  enum super_kind kind;
+  int first; //op (or int value)
+  opcode_t second;
+  opcode_t op;
+} superops[] = {
+  { SUPER_OP, OP_dup, OP_eval, OP_dup_eval },
+  { SUPER_OP, OP_dip, OP_eval, OP_dip_eval },
+  { SUPER_OP, OP_swap, OP_pop, OP_swap_pop },
+  { SUPER_QUOTED, OP_dup, OP_dip, OP_dup_dip },
+  { SUPER_INT, 0, OP_gt, OP_zero_gt },
+};
+
+//superinstruction for a sequence starting with first (of the given kind) followed by op second (or OP_NULL if none)
+static opcode_t _superop(enum super_kind kind, int first, opcode_t second) {
+  unsigned int i;
+  for(i=0;i<sizeof(superops)/sizeof(superops[0]);++i) {
+    if (superops[i].kind == kind && superops[i].first == first && superops[i].second == second) return superops[i].op;
+  }
+  return OP_NULL;
+}
+
+opcode_t vm_superop(val_t a, val_t b) {
+  //vals with debug vals attached may eval something else (DEBUG_VAL_EVAL), so they never fuse
+  if (!val_is_op(b) || !val_is_null(__val_dbg_val(a)) || !val_is_null(__val_dbg_val(b))) return OP_NULL;
+  if (val_is_op(a)) return _superop(SUPER_OP,__val_op(a),__val_op(b));
+  if (val_is_int(a)) return _superop(SUPER_INT,__val_int(a),__val_op(b));
+  return OP_NULL;
+}
+
+opcode_t vm_superop_quoted(opcode_t quoted, opcode_t b) {
+  return _superop(SUPER_QUOTED,quoted,b);
+}
+
+#ifdef VM_OPSTATS
+
+//counts are shared by every vm (and thread), so updates are relaxed atomics
+// - singles and pairs are arrays indexed by op, triples go in an open addressed table (new triples are dropped once it is full)
+#define OPSTATS_TRIPLES (1<<16)
+static uint64_t opstats_singles[N_OPS];
+static uint64_t opstats_pairs[N_OPS*N_OPS];
+static struct { uint32_t key; uint64_t count; } opstats_triples[OPSTATS_TRIPLES]; //key is 1+ the triple index (0 is empty)
+
+void vm_opstats_count(unsigned int *prev, unsigned int op) {
+  __atomic_fetch_add(&opstats_singles[op],1,__ATOMIC_RELAXED);
+  if (prev[1]) {
+    __atomic_fetch_add(&opstats_pairs[(prev[1]-1)*N_OPS + op],1,__ATOMIC_RELAXED);
+    if (prev[0]) {
+      uint32_t key = 1 + ((prev[0]-1)*N_OPS + (prev[1]-1))*N_OPS + op;
+      uint32_t i, h = (key * 2654435761u) >> 16;
+      for(i=0;i<OPSTATS_TRIPLES;++i,h=(h+1)&(OPSTATS_TRIPLES-1)) {
+        uint32_t k = __atomic_load_n(&opstats_triples[h].key,__ATOMIC_RELAXED), empty = 0;
+        if (!k && __atomic_compare_exchange_n(&opstats_triples[h].key,&empty,key,0,__ATOMIC_RELAXED,__ATOMIC_RELAXED)) k = key;
+        else if (!k) k = empty; //lost the race, see who won
+        if (k == key) {
+          __atomic_fetch_add(&opstats_triples[h].count,1,__ATOMIC_RELAXED);
+          break;
+        }
+      }
+    }
+  }
+  prev[0] = prev[1];
+  prev[1] = op+1;
+}
+
+struct opstat { uint64_t count; uint32_t ops; };
+static int _opstat_cmp(const void *a, const void *b) {
+  uint64_t x = ((const struct opstat*)a)->count, y = ((const struct opstat*)b)->count;
+  return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+//print the top n entries of stats (ops is the n-gram index, len ops long)
+static void _opstats_fprint_top(FILE *file, const char *title, struct opstat *stats, unsigned int nstats, unsigned int len, unsigned int n) {
+  unsigned int i, j, d;
+  qsort(stats,nstats,sizeof(stats[0]),_opstat_cmp);
+  fprintf(file,"%s:\n",title);
+  for(i=0;i<n && i<nstats && stats[i].count;++i) {
+    fprintf(file,"%12" PRIu64 " ",stats[i].count);
+    for(j=len,d=1;--j;) d *= N_OPS;
+    for(j=0;j<len;++j,d/=N_OPS) fprintf(file," %s",opstrings[(stats[i].ops/d)%N_OPS]);
+    fprintf(file,"\n");
+  }
+}
+
+#define OPSTATS_TOP 25
+
+void vm_opstats_fprint(FILE *file) {
+  struct opstat *stats;
+  unsigned int i, n;
+  if (!(stats = malloc(sizeof(*stats)*(N_OPS*N_OPS > OPSTATS_TRIPLES ? N_OPS*N_OPS : OPSTATS_TRIPLES)))) return;
+  for(i=0;i<N_OPS;++i) stats[i] = (struct opstat){ opstats_singles[i], i };
+  _opstats_fprint_top(file,"ops",stats,N_OPS,1,OPSTATS_TOP);
+  for(i=0;i<N_OPS*N_OPS;++i) stats[i] = (struct opstat){ opstats_pairs[i], i };
+  _opstats_fprint_top(file,"op pairs",stats,N_OPS*N_OPS,2,OPSTATS_TOP);
+  for(i=0,n=0;i<OPSTATS_TRIPLES;++i) {
+    if (opstats_triples[i].key) stats[n++] = (struct opstat){ opstats_triples[i].count, opstats_triples[i].key-1 };
+  }
+  _opstats_fprint_top(file,"op triples",stats,n,3,OPSTATS_TOP);
+  free(stats);
+}
+
+#else
+
+void vm_opstats_fprint(FILE *file) {}
+
+#endif
@@ -0,0 +1,40 @@
+//Copyright (C) 2024 D. Michael Agun
+//
+//Licensed under the Apache License, Version 2.0 (the "License");
+//you may not use this file except in compliance with the License.
+//You may obtain a copy of the License at
+//
+//http://www.apache.org/licenses/LICENSE-2.0
+//
+//Unless required by applicable law or agreed to in writing, software
+//distributed under the License is distributed on an "AS IS" BASIS,
+//WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//See the License for the specific language governing permissions and
+//limitations under the License.
+
+
+#ifndef __VM_SUPER_H__
+#define __VM_SUPER_H__ 1
+#include "vm.h"
+
+// vm_super - superinstructions (single opcodes for common op sequences) and the op n-gram counts used to pick them
+// - each superinstruction does the work of its sequence in one dispatch (and one code lpop instead of two or three)
+//   - they print as the sequence they replace (their opstring is e.g. "dup eval"), so resolved code reads the same
+//   - they aren't in the dictionary -- only compile creates them, as it binds names to ops while encoding bytecode
+//   - code lists are never fused (not even by rresolve), since their structure is visible (e.g. [ swap pop ] rresolve size is 2)
+//   - plain parsed/def'd code holds idents that are looked up on each eval, so there is nothing to fuse until it is compiled
+// - with VM_OPSTATS defined (make concat-opstats) vm_dowork counts every op dispatch, and the most common ops,
+//   op pairs and op triples are printed to stderr on exit (candidates for new superinstructions)
+
+opcode_t vm_superop(val_t a, val_t b); //superinstruction for resolved vals a b (or OP_NULL if none)
+opcode_t vm_superop_quoted(opcode_t quoted, opcode_t b); //superinstruction for a quoted op followed by op b, e.g. \dup dip (or OP_NULL if none)
+
+#ifdef VM_OPSTATS
+#define VM_OPSTAT(prev,op) vm_opstats_count(prev,op)
+void vm_opstats_count(unsigned int *prev, unsigned int op); //count op after the previous two ops in prev (and update prev)
+#else
+#define VM_OPSTAT(prev,op) do{}while(0)
+#endif
+void vm_opstats_fprint(FILE *file); //print top ops/pairs/triples (nothing without VM_OPSTATS)
+
+#endif